@@ -95,18 +95,22 @@ public:
       : m_cantCompress(false)
       , m_builder(0)
       , m_imageInfo(0)
-      , m_modified(false) {}
+      , m_modified(false)
+      , m_compressing(false) {}
 
   CacheItem(ImageBuilder *builder, ImageInfo *imageInfo)
       : m_cantCompress(false)
       , m_builder(builder)
       , m_imageInfo(imageInfo)
       , m_historyCount(0)
-      , m_modified(false) {}
+      , m_modified(false)
+      , m_compressing(false) {}
 
   virtual ~CacheItem() {}
 
   virtual TUINT32 getSize() const = 0;
+  //! Size of the swap file, for items shipped to disk
+  virtual TUINT32 getDiskSize() const { return 0; }
 
   // getImage restituisce un'immagine non compressa
   virtual TImageP getImage() const = 0;
@@ -117,6 +121,7 @@ public:
   std::string m_id;
   TUINT32 m_historyCount;
   bool m_modified;
+  bool m_compressing;  //!< Compressed outside the lock; reset by any access
 };
 
 #ifdef _WIN32
@@ -474,8 +479,10 @@ public:
   ~CompressedOnDiskCacheItem();
 
   TUINT32 getSize() const override { return 0; }
+  TUINT32 getDiskSize() const override { return m_diskSize; }
   TImageP getImage() const override;
   TFilePath m_fp;
+  TUINT32 m_diskSize;
 };
 
 #ifdef _WIN32
@@ -497,6 +504,7 @@ CompressedOnDiskCacheItem::CompressedOnDiskCacheItem(
   Tofstream oss(m_fp);
   assert(compressedRas->getLy() == 1 && compressedRas->getPixelSize() == 1);
   TUINT32 size = compressedRas->getLx();
+  m_diskSize   = sizeof(TUINT32) + size;
   oss.write((char *)&size, sizeof(TUINT32));
   oss.write((char *)compressedRas->getRawData(), size);
   assert(!oss.fail());
@@ -539,10 +547,12 @@ public:
   ~UncompressedOnDiskCacheItem();
 
   TUINT32 getSize() const override { return 0; }
+  TUINT32 getDiskSize() const override { return m_diskSize; }
   TImageP getImage() const override;
   // TRaster32P getRaster32() const;
 
   TFilePath m_fp;
+  TUINT32 m_diskSize;
 };
 #ifdef _WIN32
 template class DVAPI TSmartPointerT<UncompressedOnDiskCacheItem>;
@@ -581,6 +591,7 @@ UncompressedOnDiskCacheItem::UncompressedOnDiskCacheItem(const TFilePath &fp,
   m_builder = 0;
 
   int dataSize = ras->getLx() * ras->getLy() * ras->getPixelSize();
+  m_diskSize   = dataSize;
 
   int lx      = ras->getLx();
   int ly      = ras->getLy();
@@ -876,59 +887,71 @@ void TImageCache::Imp::doCompress() {
 //------------------------------------------------------------------------------
 
 void TImageCache::Imp::doCompress(std::string id) {
-  TThread::MutexLocker sl(&m_mutex);
+  CacheItemP item;
+  UncompressedOnMemoryCacheItemP uitem;
+  TImageP image;
+  {
+    TThread::MutexLocker sl(&m_mutex);
 
-  // search id in m_uncompressedItems
-  std::map<std::string, CacheItemP>::iterator it = m_uncompressedItems.find(id);
-  if (it == m_uncompressedItems.end()) return;  // id not found: return
+    // search id in m_uncompressedItems
+    std::map<std::string, CacheItemP>::iterator it =
+        m_uncompressedItems.find(id);
+    if (it == m_uncompressedItems.end()) return;  // id not found: return
+
+    // is item suitable for compression ?
+    item  = it->second;
+    uitem = item;
+    if (item->m_cantCompress || !uitem || !uitem->m_image ||
+        hasExternalReferences(uitem->m_image))
+      return;
 
-  // is item suitable for compression ?
-  CacheItemP item                      = it->second;
-  UncompressedOnMemoryCacheItemP uitem = item;
-  if (item->m_cantCompress ||
-      (uitem && (!uitem->m_image || hasExternalReferences(uitem->m_image))))
-    return;
+    // check if item has been already compressed. this should never happen
+    if (m_compressedItems.find(id) != m_compressedItems.end()) return;
 
-  // search id in m_itemHistory
-  std::map<TUINT32, std::string>::iterator itu = m_itemHistory.begin();
-  while (itu != m_itemHistory.end() && itu->second != id) ++itu;
-  if (itu == m_itemHistory.end()) return;  // id not found: return
+    // The codec pass runs unlocked, so other threads can use the cache
+    // meanwhile. Any access to the item meanwhile discards the result.
+    item->m_cantCompress = true;
+    item->m_compressing  = true;
+    image                = uitem->m_image;
+  }
 
-// delete itu from m_itemHistory
-#ifdef _WIN32
-  assert(itu->first == it->second->m_historyCount);
-  itu = m_itemHistory.erase(itu);
-  m_itemsByImagePointer.erase(getPointer(item->getImage()));
-#else
-  std::map<TUINT32, std::string>::iterator itu2 = itu;
-  itu++;
-  m_itemHistory.erase(itu2);
-  m_itemsByImagePointer.erase(item->getImage().getPointer());
-#endif
+  // WARNING the codec buffer allocation can CHANGE the cache.
+  CacheItemP newItem = new CompressedOnMemoryCacheItem(image);
+  image              = TImageP();
 
-  // delete item from m_uncompressedItems
-  m_uncompressedItems.erase(it);
+  TThread::MutexLocker sl(&m_mutex);
+
+  bool accessed        = !item->m_compressing;
+  item->m_cantCompress = false;
+  item->m_compressing  = false;
 
-  // check if item has been already compressed. this should never happen
-  if (m_compressedItems.find(id) != m_compressedItems.end()) return;
+  // The item may have been accessed, removed or replaced meanwhile
+  std::map<std::string, CacheItemP>::iterator it = m_uncompressedItems.find(id);
+  if (accessed || it == m_uncompressedItems.end() || it->second != item ||
+      hasExternalReferences(uitem->m_image) ||
+      m_compressedItems.find(id) != m_compressedItems.end())
+    return;
 
-  assert(uitem);
-  item->m_cantCompress = true;  // ??
-  CacheItemP newItem   = new CompressedOnMemoryCacheItem(
-      item->getImage());  // WARNING the codec buffer  allocation can CHANGE the
-                          // cache.
-  item->m_cantCompress = false;  // ??
   if (newItem->getSize() ==
       0)  /// non c'era memoria sufficiente per il buffer compresso....
   {
     assert(m_rootDir != TFilePath());
     TFilePath fp =
         m_rootDir + TFilePath(std::to_string(TImageCache::Imp::m_fileid++));
-    newItem = new UncompressedOnDiskCacheItem(fp, item->getImage());
+    newItem = new UncompressedOnDiskCacheItem(fp, uitem->m_image);
   }
+
+  // delete item from m_itemHistory and m_uncompressedItems
+  assert(m_itemHistory.find(item->m_historyCount) != m_itemHistory.end());
+  m_itemHistory.erase(item->m_historyCount);
+#ifdef _WIN32
+  m_itemsByImagePointer.erase(getPointer(uitem->m_image));
+#else
+  m_itemsByImagePointer.erase(uitem->m_image.getPointer());
+#endif
+  m_uncompressedItems.erase(it);
+
   m_compressedItems[id] = newItem;
-  item                  = CacheItemP();
-  uitem                 = UncompressedOnMemoryCacheItemP();
 }
 
 /*
@@ -1689,7 +1712,8 @@ TImageP TImageCache::Imp::get(const std::string &id, bool toBeModified) {
   std::map<std::string, CacheItemP>::iterator itu =
       m_uncompressedItems.find(id);
   if (itu != m_uncompressedItems.end()) {
-    img = itu->second->getImage();
+    img                       = itu->second->getImage();
+    itu->second->m_compressing = false;
     if (itu->second->m_historyCount !=
         HistoryCount - 1)  // significa che l'ultimo get non era sulla stessa
                            // immagine, quindi  serve aggiornare l'history!
@@ -1788,6 +1812,8 @@ UINT TImageCache::getDiskUsage() const { return 0; }
 //------------------------------------------------------------------------------
 
 UINT TImageCache::getMemUsage(const std::string &id) const {
+  TThread::MutexLocker sl(&m_imp->m_mutex);
+
   std::map<std::string, CacheItemP>::iterator it =
       m_imp->m_uncompressedItems.find(id);
   if (it != m_imp->m_uncompressedItems.end()) return it->second->getSize();
@@ -1822,7 +1848,17 @@ int TImageCache::getItemCount() const
 */
 //------------------------------------------------------------------------------
 
-UINT TImageCache::getDiskUsage(const std::string &id) const { return 0; }
+UINT TImageCache::getDiskUsage(const std::string &id) const {
+  TThread::MutexLocker sl(&m_imp->m_mutex);
+
+  std::map<std::string, CacheItemP>::iterator it =
+      m_imp->m_uncompressedItems.find(id);
+  if (it != m_imp->m_uncompressedItems.end()) return it->second->getDiskSize();
+
+  it = m_imp->m_compressedItems.find(id);
+  if (it != m_imp->m_compressedItems.end()) return it->second->getDiskSize();
+  return 0;
+}
 
 //------------------------------------------------------------------------------
 
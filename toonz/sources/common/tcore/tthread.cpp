@@ -15,6 +15,8 @@
 // STL includes
 #include <set>
 #include <deque>
+#include <memory>
+#include <algorithm>
 
 // tcg includes
 #include "tcg/tcg_pool.h"
@@ -26,6 +28,9 @@
 #include <QWaitCondition>
 #include <QMetaType>
 #include <QCoreApplication>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QAtomicInt>
 
 //==============================================================================
 
@@ -1135,3 +1140,104 @@ inline void Worker::takeTask() {
     }
   }
 }
+
+//==============================================================================
+
+//==================================================
+//    Bands
+//--------------------------------------------------
+
+namespace {
+
+class Bands : public std::enable_shared_from_this<Bands> {
+  class Task final : public QRunnable {
+    std::shared_ptr<Bands> m_bands;
+
+  public:
+    Task(const std::shared_ptr<Bands> &bands) : m_bands(bands) {}
+    void run() override { m_bands->work(); }
+  };
+
+  const std::function<void(int, int)> *m_func;
+  QAtomicInt m_next;
+  int m_count, m_bandCount, m_doneCount;
+  bool m_failed;
+
+  QMutex m_mutex;
+  QWaitCondition m_allDone;
+
+public:
+  Bands(int count, int bandCount, const std::function<void(int, int)> &func)
+      : m_func(&func)
+      , m_next(0)
+      , m_count(count)
+      , m_bandCount(bandCount)
+      , m_doneCount(0)
+      , m_failed(false) {}
+
+  bool run() {
+    // Helpers are only started on idle threads: pool threads waiting for
+    // each other could otherwise deadlock
+    QThreadPool *pool = QThreadPool::globalInstance();
+    int taskCount     = std::min(m_bandCount, pool->maxThreadCount());
+    for (int i = 1; i < taskCount; ++i) {
+      Task *task = new Task(shared_from_this());
+      if (!pool->tryStart(task)) {
+        delete task;
+        break;
+      }
+    }
+
+    work();
+
+    QMutexLocker locker(&m_mutex);
+    while (m_doneCount < m_bandCount) m_allDone.wait(&m_mutex);
+
+    return !m_failed;
+  }
+
+private:
+  // Late helpers find no band left, and never touch m_func
+  void work() {
+    int band;
+    while ((band = m_next.fetchAndAddOrdered(1)) < m_bandCount) {
+      bool ok = true;
+      try {
+        (*m_func)((int)((long long)m_count * band / m_bandCount),
+                  (int)((long long)m_count * (band + 1) / m_bandCount));
+      } catch (...) {
+        ok = false;
+      }
+
+      QMutexLocker locker(&m_mutex);
+      if (!ok) m_failed = true;
+      if (++m_doneCount == m_bandCount) m_allDone.wakeAll();
+    }
+  }
+};
+
+}  // namespace
+
+//------------------------------------------------------------------------------
+
+bool TThread::forEachBand(int count, int grain,
+                          const std::function<void(int, int)> &func) {
+  if (count <= 0) return true;
+
+  grain = std::max(grain, 1);
+
+  int threadCount =
+      std::max(1, QThreadPool::globalInstance()->maxThreadCount());
+  int bandCount = std::min((count + grain - 1) / grain, 4 * threadCount);
+  if (bandCount <= 1 || threadCount <= 1) {
+    try {
+      func(0, count);
+    } catch (...) {
+      return false;
+    }
+    return true;
+  }
+
+  std::shared_ptr<Bands> bands(new Bands(count, bandCount, func));
+  return bands->run();
+}
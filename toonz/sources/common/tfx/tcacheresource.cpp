@@ -1,5 +1,8 @@
 
 
+// STD includes
+#include <set>
+
 // String includes
 #include "tconvert.h"
 
@@ -21,6 +24,10 @@
 // Qt classes
 #include <QRegion>
 #include <QByteArray>
+#include <QDir>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QVector>
 
 // Resources pool manager
 #include "tcacheresourcepool.h"
@@ -125,6 +132,11 @@ namespace {
 // MB each.
 const int latticeStep = 512;
 
+// Compressed cells store the size of their compressed data in the header.
+// Earlier versions stored the raw size in extension-less files instead - the
+// extension keeps either format from being read as the other.
+const std::string compressedCellType = "tcc";
+
 static unsigned long cacheId = 0;
 
 //-----------------------------------------------------------------
@@ -184,48 +196,85 @@ inline bool contains(const QRegion &region, const TRect &rect) {
 
 //----------------------------------------------------------------------------
 
-inline void saveCompressed(const TFilePath &fp, const TRasterP &ras) {
+//! Writes data to the specified file. Returns false if any write, or the
+//! final close, fails.
+inline bool writeFile(const TFilePath &fp, const QByteArray &data) {
+  QFile file(fp.getQString());
+  if (!file.open(QIODevice::WriteOnly)) return false;
+
+  bool ok = (file.write(data) == data.size());
+  file.close();
+
+  return ok && file.error() == QFileDevice::NoError;
+}
+
+//----------------------------------------------------------------------------
+
+inline bool saveCompressed(const TFilePath &fp, const TRasterP &ras) {
   assert(ras->getLx() == latticeStep && ras->getLy() == latticeStep);
   unsigned int size = sq(latticeStep) * ras->getPixelSize();
 
   ras->lock();
-  QByteArray data = qCompress((const char *)ras->getRawData(), size);
+  QByteArray compressed = qCompress((const char *)ras->getRawData(), size);
   ras->unlock();
 
-  Tofstream oss(fp);
-  oss.write((const char *)&size, sizeof(unsigned int));
-  oss.write(data.constData(), data.size());
-  assert(!oss.fail());
+  unsigned int dataSize = compressed.size();
+  QByteArray data((const char *)&dataSize, sizeof(unsigned int));
+  data += compressed;
+
+  return writeFile(fp.withType(compressedCellType), data);
 }
 
 //----------------------------------------------------------------------------
 
-inline void loadCompressed(const TFilePath &fp, TRasterP &ras,
+//! Loads a cell stored by saveCompressed(). Returns false, leaving ras empty,
+//! unless the file holds a whole cell of the specified type.
+inline bool loadCompressed(const TFilePath &fp, TRasterP &ras,
                            TCacheResource::Type rasType) {
-  Tifstream is(fp);
+  ras = TRasterP();
 
+  TRasterP cellRas;
   if (rasType == TCacheResource::CM32)
-    ras = TRasterCM32P(latticeStep, latticeStep);
+    cellRas = TRasterCM32P(latticeStep, latticeStep);
   else if (rasType == TCacheResource::RGBM32)
-    ras = TRaster32P(latticeStep, latticeStep);
+    cellRas = TRaster32P(latticeStep, latticeStep);
   else if (rasType == TCacheResource::RGBM64)
-    ras = TRaster64P(latticeStep, latticeStep);
-  else
+    cellRas = TRaster64P(latticeStep, latticeStep);
+  else {
     assert(false);
+    return false;
+  }
 
-  ras->lock();
+  int size = sq(latticeStep) * cellRas->getPixelSize();
 
-  char *rawData = (char *)ras->getRawData();
+  QFile file(fp.withType(compressedCellType).getQString());
+  if (!file.open(QIODevice::ReadOnly)) return false;
+
+  // The stored size must fit both the file and zlib's worst case expansion
   unsigned int dataSize;
-  is.read((char *)&dataSize, sizeof(unsigned int));
-  is.read(rawData, dataSize);
+  if (file.read((char *)&dataSize, sizeof(unsigned int)) !=
+          sizeof(unsigned int) ||
+      dataSize < 4 || dataSize > file.size() - sizeof(unsigned int) ||
+      dataSize > (unsigned int)(size + size / 8 + 64))
+    return false;
+
+  QByteArray data(file.read(dataSize));
+  if (data.size() != (int)dataSize) return false;
+
+  // qCompress() prepends the uncompressed size, big-endian
+  const uchar *header = (const uchar *)data.constData();
+  if ((header[0] << 24 | header[1] << 16 | header[2] << 8 | header[3]) != size)
+    return false;
 
-  // Observe that QByteArray::fromRawData does NOT cause a deep copy to occur.
-  QByteArray data(QByteArray::fromRawData(rawData, dataSize));
   data = qUncompress(data);
-  memcpy(rawData, data.constData(), data.size());
+  if (data.size() != size) return false;
 
-  ras->unlock();
+  cellRas->lock();
+  memcpy(cellRas->getRawData(), data.constData(), size);
+  cellRas->unlock();
+
+  ras = cellRas;
+  return true;
 }
 }
 
@@ -851,7 +900,8 @@ TRasterP TCacheResource::load(const PointLess &cellPos) {
                      TFilePath(getCellName(cellPos.x, cellPos.y)));
   TRasterP ras;
   if (m_tileType == CM32) {
-    ::loadCompressed(cellPath, ras, CM32);
+    // A missing or damaged cell is rebuilt, like a missing tif one
+    if (!::loadCompressed(cellPath, ras, CM32)) return 0;
   } else {
     TImageReader::load(cellPath.withType(".tif"), ras);
   }
@@ -934,6 +984,132 @@ void TCacheResource::save(const TFilePath &fp) {
 
 //-----------------------------------------------------------------
 
+//! Stores the whole resource content in the specified folder, so that other
+//! processes (typically, render farm nodes sharing the same folder) can
+//! retrieve it through the retrieve() method.
+//! The folder is first written under a temporary name, and then renamed to
+//! the specified one - so readers never see a partially written resource.
+//! Returns false if the resource could not be published, or if another
+//! process has already published it.
+bool TCacheResource::publish(const TFilePath &fp) {
+  assert(!fp.isEmpty());
+
+  // Colormap resources would require the palette too - they are not shared
+  if (m_tileType != RGBM32 && m_tileType != RGBM64) return false;
+  if (m_invalidated || m_region.isEmpty()) return false;
+
+  QDir parentDir(fp.getParentDir().getQString());
+  if (!parentDir.mkpath(".")) return false;
+
+  QTemporaryDir tempDir(
+      parentDir.filePath(QString::fromStdWString(fp.getWideName()) +
+                         ".XXXXXX"));
+  if (!tempDir.isValid()) return false;
+
+  TFilePath tempFp(tempDir.path());
+
+  QVector<QRect> rects(m_region.rects());
+  {
+    int count = rects.size();
+    QByteArray data((const char *)&m_tileType, sizeof(int));
+    data.append((const char *)&count, sizeof(int));
+    for (const QRect &rect : rects) {
+      int coords[4] = {rect.x(), rect.y(), rect.width(), rect.height()};
+      data.append((const char *)coords, sizeof(coords));
+    }
+
+    if (!::writeFile(tempFp + "resource", data)) return false;
+  }
+
+  std::map<PointLess, CellData>::iterator it;
+  for (it = m_cellDatas.begin(); it != m_cellDatas.end(); ++it) {
+    TPoint cellPos(getCellPos(it->first));
+    if (!m_region.intersects(
+            QRect(cellPos.x, cellPos.y, latticeStep, latticeStep)))
+      continue;
+
+    TImageP img(TImageCache::instance()->get(
+        getCellCacheId(it->first.x, it->first.y), false));
+    if (!img) return false;
+
+    if (!::saveCompressed(tempFp + getCellName(it->first.x, it->first.y),
+                          getRaster(img)))
+      return false;
+  }
+
+  // Publish. Renaming fails if someone else did it first - which is fine.
+  if (!QDir().rename(tempDir.path(), fp.getQString())) return false;
+
+  return true;
+}
+
+//-----------------------------------------------------------------
+
+//! Loads the content of a resource previously published in the specified
+//! folder. Only empty resources can be retrieved.
+bool TCacheResource::retrieve(const TFilePath &fp) {
+  assert(!fp.isEmpty());
+
+  if (m_tileType != NONE) return false;
+
+  int rasType = NONE;
+  QRegion region;
+  {
+    Tifstream is(fp + "resource");
+    if (!is.isOpen()) return false;
+
+    int count = 0;
+    is.read((char *)&rasType, sizeof(int));
+    is.read((char *)&count, sizeof(int));
+    if (is.fail() || (rasType != RGBM32 && rasType != RGBM64) || count < 0)
+      return false;
+
+    for (int i = 0; i < count; ++i) {
+      int coords[4];
+      is.read((char *)coords, sizeof(coords));
+      if (is.fail()) return false;
+
+      region += QRect(coords[0], coords[1], coords[2], coords[3]);
+    }
+  }
+
+  // Retrieve the cells intersecting the stored region
+  std::set<PointLess> cellIndices;
+  QVector<QRect> rects(region.rects());
+  for (const QRect &rect : rects) {
+    PointLess first(getCellIndex(TPoint(rect.left(), rect.top()))),
+        last(getCellIndex(TPoint(rect.right(), rect.bottom())));
+
+    for (int x = first.x; x <= last.x; ++x)
+      for (int y = first.y; y <= last.y; ++y)
+        cellIndices.insert(PointLess(x, y));
+  }
+
+  std::vector<std::pair<PointLess, TRasterP>> cells;
+  for (const PointLess &cellIndex : cellIndices) {
+    TFilePath cellFp(fp + getCellName(cellIndex.x, cellIndex.y));
+
+    // Missing or damaged cells make the whole resource unavailable
+    TRasterP ras;
+    if (!::loadCompressed(cellFp, ras, (Type)rasType)) return false;
+    cells.push_back(std::make_pair(cellIndex, ras));
+  }
+
+  for (const std::pair<PointLess, TRasterP> &cell : cells) {
+    TImageCache::instance()->add(
+        getCellCacheId(cell.first.x, cell.first.y), TRasterImageP(cell.second));
+    m_cellDatas[cell.first];
+    ++m_cellsCount;
+  }
+
+  m_tileType = rasType;
+  m_region   = region;
+
+  return true;
+}
+
+//-----------------------------------------------------------------
+
 void TCacheResource::clear() {
   std::map<PointLess, CellData>::iterator it;
   for (it = m_cellDatas.begin(); it != m_cellDatas.end(); ++it) {
@@ -0,0 +1,244 @@
+
+
+#include "trenderer.h"
+#include "trasterfx.h"
+#include "tcacheresource.h"
+
+#include <set>
+
+#include <QThread>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QCryptographicHash>
+#include <QDir>
+
+#include "tsharedcachemanager.h"
+
+//************************************************************************************************
+//    Preliminaries
+//************************************************************************************************
+
+class TSharedCacheManagerGenerator final
+    : public TRenderResourceManagerGenerator {
+public:
+  TSharedCacheManagerGenerator() : TRenderResourceManagerGenerator(true) {}
+
+  TRenderResourceManager *operator()(void) override {
+    return new TSharedCacheManager;
+  }
+};
+
+MANAGER_FILESCOPE_DECLARATION_DEP(TSharedCacheManager,
+                                  TSharedCacheManagerGenerator,
+                                  TFxCacheManager::deps())
+
+//-------------------------------------------------------------------------
+
+namespace {
+
+QMutex settingsMutex;
+TFilePath sharedRootPath;
+std::string sharedKeyPrefix;
+
+//-------------------------------------------------------------------------
+
+std::string getContentKey(const std::string &keyPrefix,
+                          const std::string &alias, const TRenderSettings &rs) {
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+  hash.addData(keyPrefix.c_str(), keyPrefix.size());
+  hash.addData(alias.c_str(), alias.size());
+
+  std::string rsString(rs.toString());
+  hash.addData(rsString.c_str(), rsString.size());
+
+  return hash.result().toHex().toStdString();
+}
+
+}  // namespace
+
+//-------------------------------------------------------------------------
+
+TSharedCacheManager *TSharedCacheManager::instance() {
+  return static_cast<TSharedCacheManager *>(
+      TSharedCacheManager::gen()->getManager(TRenderer::renderId()));
+}
+
+//************************************************************************************************
+//    TSharedCacheManager::Imp definition
+//************************************************************************************************
+
+class TSharedCacheManager::Imp {
+public:
+  typedef std::map<std::string, TCacheResourceP> ResourcesMap;
+
+  int m_renderStatus;
+
+  TFilePath m_rootPath;
+  std::string m_keyPrefix;
+
+  //! Resources accessed by each render thread since its current frame start
+  std::map<QThread *, ResourcesMap> m_frameResources;
+  //! Keys known to be published in the shared folder
+  std::set<std::string> m_publishedKeys;
+
+  QMutex m_mutex;
+
+public:
+  Imp() : m_renderStatus(TRenderer::IDLE) {
+    QMutexLocker locker(&settingsMutex);
+    m_rootPath  = sharedRootPath;
+    m_keyPrefix = sharedKeyPrefix;
+  }
+
+  TFilePath getEntryPath(const std::string &key) const {
+    return m_rootPath + key.substr(0, 2) + key;
+  }
+
+  void publish(ResourcesMap &resources);
+};
+
+//-------------------------------------------------------------------------
+
+void TSharedCacheManager::Imp::publish(ResourcesMap &resources) {
+  ResourcesMap::iterator it;
+  for (it = resources.begin(); it != resources.end(); ++it) {
+    const std::string &key = it->first;
+
+    {
+      QMutexLocker locker(&m_mutex);
+      if (m_publishedKeys.count(key)) continue;
+    }
+
+    TFilePath entryPath(getEntryPath(key));
+
+    bool published;
+    {
+      QMutexLocker locker(it->second->getMutex());
+      published = it->second->publish(entryPath) ||
+                  QDir(entryPath.getQString()).exists();
+    }
+
+    if (published) {
+      QMutexLocker locker(&m_mutex);
+      m_publishedKeys.insert(key);
+    }
+  }
+}
+
+//************************************************************************************************
+//    TSharedCacheManager methods
+//************************************************************************************************
+
+TSharedCacheManager::TSharedCacheManager()
+    : m_imp(new TSharedCacheManager::Imp()) {}
+
+//---------------------------------------------------------------------------
+
+TSharedCacheManager::~TSharedCacheManager() {}
+
+//---------------------------------------------------------------------------
+
+//! Sets the shared folder used by render instances started from now on.
+//! An empty path disables resources sharing.
+void TSharedCacheManager::setRootPath(const TFilePath &rootPath) {
+  QMutexLocker locker(&settingsMutex);
+  sharedRootPath = rootPath;
+}
+
+//---------------------------------------------------------------------------
+
+TFilePath TSharedCacheManager::getRootPath() {
+  QMutexLocker locker(&settingsMutex);
+  return sharedRootPath;
+}
+
+//---------------------------------------------------------------------------
+
+void TSharedCacheManager::setKeyPrefix(const std::string &keyPrefix) {
+  QMutexLocker locker(&settingsMutex);
+  sharedKeyPrefix = keyPrefix;
+}
+
+//---------------------------------------------------------------------------
+
+std::string TSharedCacheManager::getKeyPrefix() {
+  QMutexLocker locker(&settingsMutex);
+  return sharedKeyPrefix;
+}
+
+//---------------------------------------------------------------------------
+
+void TSharedCacheManager::getResource(TCacheResourceP &resource,
+                                      const std::string &alias,
+                                      const TFxP &fx, double frame,
+                                      const TRenderSettings &rs,
+                                      ResourceDeclaration *resData) {
+  if (m_imp->m_rootPath.isEmpty()) return;
+
+  // Predictive runs do not compute anything
+  if (m_imp->m_renderStatus != TRenderer::IDLE &&
+      m_imp->m_renderStatus != TRenderer::COMPUTING)
+    return;
+
+  // Zerary fxs are typically level columns - just share the fxs applied on
+  // them
+  if (!(fx && rs.m_userCachable) || fx->isZerary() || alias.empty()) return;
+
+  std::string key(getContentKey(m_imp->m_keyPrefix, alias, rs));
+
+  if (!resource) resource = TCacheResourceP(alias, true);
+
+  bool retrieved;
+  {
+    QMutexLocker locker(resource->getMutex());
+    retrieved = resource->getRasterType() == TCacheResource::NONE &&
+                resource->retrieve(m_imp->getEntryPath(key));
+  }
+
+  QMutexLocker locker(&m_imp->m_mutex);
+
+  if (retrieved) m_imp->m_publishedKeys.insert(key);
+
+  // Hold the resource until the end of the frame
+  m_imp->m_frameResources[QThread::currentThread()].insert(
+      std::make_pair(key, resource));
+}
+
+//---------------------------------------------------------------------------
+
+void TSharedCacheManager::onRenderStatusStart(int renderStatus) {
+  m_imp->m_renderStatus = renderStatus;
+}
+
+//---------------------------------------------------------------------------
+
+void TSharedCacheManager::onRenderFrameEnd(double frame) {
+  Imp::ResourcesMap resources;
+  {
+    QMutexLocker locker(&m_imp->m_mutex);
+
+    std::map<QThread *, Imp::ResourcesMap>::iterator it =
+        m_imp->m_frameResources.find(QThread::currentThread());
+    if (it == m_imp->m_frameResources.end()) return;
+
+    resources.swap(it->second);
+    m_imp->m_frameResources.erase(it);
+  }
+
+  m_imp->publish(resources);
+}
+
+//---------------------------------------------------------------------------
+
+void TSharedCacheManager::onRenderInstanceEnd(unsigned long renderId) {
+  // Publish resources accessed outside of the frame brackets, if any
+  std::map<QThread *, Imp::ResourcesMap> frameResources;
+  {
+    QMutexLocker locker(&m_imp->m_mutex);
+    frameResources.swap(m_imp->m_frameResources);
+  }
+
+  std::map<QThread *, Imp::ResourcesMap>::iterator it;
+  for (it = frameResources.begin(); it != frameResources.end(); ++it)
+    m_imp->publish(it->second);
+}
@@ -12,6 +12,7 @@
 #include "tiio_jpg_exif.h"
 #include "tproperty.h"
 #include "tpixel.h"
+#include "texception.h"
 
 /*
  * Include file for users of JPEG library.
@@ -23,6 +24,8 @@
 
 #include <assert.h>
 #include <stdio.h>
+#include <string.h>
+#include <algorithm>
 
 //=========================================================
 
@@ -51,7 +54,7 @@ JMETHOD(void, reset_error_mgr, (j_common_ptr cinfo));
 
 using namespace Tiio;
 
-JpgReader::JpgReader() : m_chan(0), m_isOpen(false) {
+JpgReader::JpgReader() : m_chan(0), m_isOpen(false), m_dataOffset(-1) {
   memset(&m_cinfo, 0, sizeof m_cinfo);
   memset(&m_jerr, 0, sizeof m_jerr);
   memset(&m_buffer, 0, sizeof m_buffer);
@@ -78,7 +81,8 @@ void JpgReader::open(FILE *file) {
 
   jpeg_create_decompress(&m_cinfo);
 
-  m_chan = file;
+  m_chan       = file;
+  m_dataOffset = ftell(m_chan);
   jpeg_stdio_src(&m_cinfo, m_chan);
   jpeg_save_markers(&m_cinfo, JPEG_APP0 + 1, 0xffff);  // EXIF
   bool ret = jpeg_read_header(&m_cinfo, TRUE);
@@ -182,6 +186,91 @@ int JpgReader::skipLines(int lineCount) {
   return lineCount;
 }
 
+// Restarts the decompression from the beginning of the image data, at the
+// specified DCT scale reduction.
+bool JpgReader::restart(int scale) {
+  jpeg_abort_decompress(&m_cinfo);
+  fseek(m_chan, m_dataOffset, SEEK_SET);
+  jpeg_stdio_src(&m_cinfo, m_chan);
+
+  m_cinfo.scale_num   = 1;
+  m_cinfo.scale_denom = scale;
+
+  m_isOpen = jpeg_read_header(&m_cinfo, TRUE) == JPEG_HEADER_OK &&
+             jpeg_start_decompress(&m_cinfo);
+  if (!m_isOpen) return false;
+
+  // The image pool has been released by the abort
+  m_buffer = (*m_cinfo.mem->alloc_sarray)(
+      (j_common_ptr)&m_cinfo, JPOOL_IMAGE,
+      m_cinfo.output_width * m_cinfo.output_components, 1);
+  return true;
+}
+
+// Decodes the image at the largest DCT scale reduction (1/2, 1/4 or 1/8)
+// dividing shrink, which saves most of the inverse DCT, upsampling and color
+// conversion work. The rest of the shrink is applied by sampling.
+bool JpgReader::readRegion(char *buffer, ptrdiff_t lineStride, int x0, int y0,
+                           int x1, int y1, int shrink) {
+  int components = m_cinfo.out_color_components;
+  if (!m_isOpen || m_cinfo.output_scanline != 0 ||
+      !((m_cinfo.out_color_space == JCS_RGB && components == 3) ||
+        components == 1))
+    return false;
+
+  int scale = 1;
+  if (shrink % 8 == 0)
+    scale = 8;
+  else if (shrink % 4 == 0)
+    scale = 4;
+  else if (shrink % 2 == 0)
+    scale = 2;
+
+  if (scale == 1 || m_dataOffset < 0) return false;
+
+  int lx = (x1 - x0) / shrink + 1, ly = (y1 - y0) / shrink + 1;
+
+  // Should the reduced scale fail, the full scale decompression is restored
+  // for the caller's line-by-line reading
+  if (!restart(scale)) {
+    if (!restart(1)) throw TException("Can't decode the jpeg image");
+    return false;
+  }
+
+  components = m_cinfo.output_components;
+
+  int scaledLx = m_cinfo.output_width, scaledLy = m_cinfo.output_height;
+
+  // Scanlines come from the top
+  int scanline = 0;
+  for (int j = ly - 1; j >= 0; --j) {
+    int y  = m_info.m_ly - 1 - (y0 + j * shrink);
+    int sy = std::min(y / scale, scaledLy - 1);
+
+    for (; scanline <= sy; ++scanline) {
+      int ret = jpeg_read_scanlines(&m_cinfo, m_buffer, 1);
+      assert(ret == 1);
+    }
+
+    TPixel32 *dst = (TPixel32 *)(buffer + j * lineStride);
+    for (int i = 0; i < lx; ++i, ++dst) {
+      int sx             = std::min((x0 + i * shrink) / scale, scaledLx - 1);
+      unsigned char *src = m_buffer[0] + sx * components;
+
+      if (components == 3) {
+        dst->r = src[0];
+        dst->g = src[1];
+        dst->b = src[2];
+      } else
+        dst->r = dst->g = dst->b = *src;
+
+      dst->m = (char)255;
+    }
+  }
+
+  return true;
+}
+
 class JpgWriter final : public Tiio::Writer {
   struct jpeg_compress_struct m_cinfo;
   struct jpeg_error_mgr m_jerr;
@@ -285,31 +285,51 @@ void readRaster(const TRasterPT<Pix> &ras, Tiio::Reader *reader, int x0, int y0,
                 int x1, int y1, int inLx, int inLy, int shrink) {
   typedef typename pixel_traits<Pix>::buffer_type buffer_type;
 
+  // Readers supporting it decode just the required region (see
+  // Tiio::Reader::readRegion())
+  ras->lock();
+  bool regionRead =
+      reader->readRegion((buffer_type *)ras->getRawData(),
+                         ras->getWrap() * ras->getPixelSize(), x0, y0, x1, y1,
+                         shrink);
+  ras->unlock();
+
+  if (regionRead) return;
+
   if (shrink == 1) {
     // Direct read
     ras->lock();
 
-    ptrdiff_t linePad = -x0 * ras->getPixelSize();
+    ptrdiff_t linePad    = -x0 * ras->getPixelSize();
+    ptrdiff_t lineStride = ras->getWrap() * ras->getPixelSize();
 
+    // Readers supporting it get all the lines at once (see
+    // Tiio::Reader::readLines())
     if (reader->getRowOrder() == Tiio::BOTTOM2TOP) {
       int start = reader->skipLines(y0);
       int stop  = y1 + 1;
 
-      for (int y = start; y < stop; ++y)
-        if (y >= y0 && y <= y1) {
-          buffer_type *line =
-              (buffer_type *)(ras->getRawData(0, y - y0) + linePad);
-          reader->readLine(line, x0, x1, 1);
-        }
+      if (start != y0 ||
+          !reader->readLines((buffer_type *)(ras->getRawData() + linePad),
+                             y1 - y0 + 1, x0, x1, lineStride))
+        for (int y = start; y < stop; ++y)
+          if (y >= y0 && y <= y1) {
+            buffer_type *line =
+                (buffer_type *)(ras->getRawData(0, y - y0) + linePad);
+            reader->readLine(line, x0, x1, 1);
+          }
     } else  // TOP2BOTTOM
     {
       reader->skipLines(inLy - y1 - 1);
 
-      for (int y = y1; y >= y0; --y) {
-        buffer_type *line =
-            (buffer_type *)(ras->getRawData(0, y - y0) + linePad);
-        reader->readLine(line, x0, x1, 1);
-      }
+      if (!reader->readLines(
+              (buffer_type *)(ras->getRawData(0, y1 - y0) + linePad),
+              y1 - y0 + 1, x0, x1, -lineStride))
+        for (int y = y1; y >= y0; --y) {
+          buffer_type *line =
+              (buffer_type *)(ras->getRawData(0, y - y0) + linePad);
+          reader->readLine(line, x0, x1, 1);
+        }
     }
 
     ras->unlock();
@@ -646,20 +666,39 @@ void TImageWriter::save(const TImageP &img) {
 
     ras->lock();
 
-    if (writer->getRowOrder() == Tiio::BOTTOM2TOP) {
-      if (bpp == 1 || bpp == 8 || bpp == 24 || bpp == 32 || bpp == 16)
-        for (int i = 0; i < ras->getLy(); i++)
-          writer->writeLine((char *)ras->getRawData(0, i));
-      else
-        for (int i = 0; i < ras->getLy(); i++)
-          writer->writeLine((short *)ras->getRawData(0, i));
-    } else {
-      if (bpp == 1 || bpp == 8 || bpp == 24 || bpp == 32 || bpp == 16)
-        for (int i = ras->getLy() - 1; i >= 0; i--)
-          writer->writeLine((char *)ras->getRawData(0, i));
-      else
-        for (int i = ras->getLy() - 1; i >= 0; i--)
-          writer->writeLine((short *)ras->getRawData(0, i));
+    // Writers supporting it get the whole image at once (see
+    // Tiio::Writer::writeLines())
+    bool charLines = (bpp == 1 || bpp == 8 || bpp == 24 || bpp == 32 ||
+                      bpp == 16);
+
+    ptrdiff_t lineStride = ras->getWrap() * ras->getPixelSize();
+    UCHAR *firstLine     = ras->getRawData();
+    if (writer->getRowOrder() != Tiio::BOTTOM2TOP) {
+      firstLine  = ras->getRawData(0, ras->getLy() - 1);
+      lineStride = -lineStride;
+    }
+
+    bool written = charLines ? writer->writeLines((char *)firstLine,
+                                                  ras->getLy(), lineStride)
+                             : writer->writeLines((short *)firstLine,
+                                                  ras->getLy(), lineStride);
+
+    if (!written) {
+      if (writer->getRowOrder() == Tiio::BOTTOM2TOP) {
+        if (charLines)
+          for (int i = 0; i < ras->getLy(); i++)
+            writer->writeLine((char *)ras->getRawData(0, i));
+        else
+          for (int i = 0; i < ras->getLy(); i++)
+            writer->writeLine((short *)ras->getRawData(0, i));
+      } else {
+        if (charLines)
+          for (int i = ras->getLy() - 1; i >= 0; i--)
+            writer->writeLine((char *)ras->getRawData(0, i));
+        else
+          for (int i = ras->getLy() - 1; i >= 0; i--)
+            writer->writeLine((short *)ras->getRawData(0, i));
+      }
     }
 
     ras->unlock();
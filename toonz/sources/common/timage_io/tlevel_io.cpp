@@ -9,9 +9,14 @@
 
 // STD includes
 #include <map>
+#include <set>
 
 // Qt includes
 #include <QDir>
+#include <QDateTime>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QWaitCondition>
 
 #include "tlevel_io.h"
 
@@ -100,33 +105,26 @@ const TImageInfo *TLevelReader::getImageInfo() {
 //-----------------------------------------------------------
 
 TLevelP TLevelReader::loadInfo() {
-  TFilePath parentDir = m_path.getParentDir();
-  TFilePath levelName(m_path.getLevelName());
-  //  cout << "Parent dir = '" << parentDir << "'" << endl;
-  //  cout << "Level name = '" << levelName << "'" << endl;
-  TFilePathSet files;
+  vector<TFilePath> files;
   try {
-    files = TSystem::readDirectory(parentDir, false, true, true);
+    files = TLevelDirectoryIndex::instance()->getLevelFiles(m_path);
   } catch (...) {
     throw TImageException(m_path, "unable to read directory content");
   }
   TLevelP level;
   vector<TFilePath> data;
-  for (TFilePathSet::iterator it = files.begin(); it != files.end(); it++) {
-    TFilePath ln(it->getLevelName());
-    // cout << "try " << *it << "  " << it->getLevelName() <<  endl;
-    if (levelName == TFilePath(it->getLevelName())) {
-      try {
-        level->setFrame(it->getFrame(), TImageP());
-        data.push_back(*it);
-      } catch (TMalformedFrameException tmfe) {
-        // skip frame named incorrectly warning to the user in the message
-        // center.
-        DVGui::warning(QString::fromStdWString(
-            tmfe.getMessage() + L": " +
-            QObject::tr("Skipping frame.").toStdWString()));
-        continue;
-      }
+  for (vector<TFilePath>::iterator it = files.begin(); it != files.end();
+       it++) {
+    try {
+      level->setFrame(it->getFrame(), TImageP());
+      data.push_back(*it);
+    } catch (TMalformedFrameException tmfe) {
+      // skip frame named incorrectly warning to the user in the message
+      // center.
+      DVGui::warning(QString::fromStdWString(
+          tmfe.getMessage() + L": " +
+          QObject::tr("Skipping frame.").toStdWString()));
+      continue;
     }
   }
   if (!data.empty()) {
@@ -179,6 +177,169 @@ TSoundTrack *TLevelReader::loadSoundTrack() { return 0; }
 
 //===========================================================
 
+namespace {
+
+const int maxIndexedFoldersCount = 64;
+
+// Folders modified within this many seconds before being listed may be
+// modified again without their modification time changing
+const int modificationTimeResolution = 2;
+
+std::wstring getLevelKey(const TFilePath &path) {
+#ifdef _WIN32
+  // Level names are compared case-insensitively, like TFilePath::operator==
+  return QString::fromStdWString(path.getLevelNameW()).toLower().toStdWString();
+#else
+  return path.getLevelNameW();
+#endif
+}
+
+}  // namespace
+
+//-----------------------------------------------------------
+
+class TLevelDirectoryIndex::Imp {
+public:
+  struct Folder {
+    QDateTime m_modificationTime, m_listingTime;
+    std::map<std::wstring, std::vector<TFilePath>> m_levels;
+    unsigned int m_lastAccess;
+
+    bool isValid(const QDateTime &modificationTime) const {
+      return m_modificationTime.isValid() &&
+             m_modificationTime == modificationTime &&
+             m_modificationTime.secsTo(m_listingTime) >=
+                 modificationTimeResolution;
+    }
+  };
+
+  std::map<std::wstring, Folder> m_folders;  //!< Folders by path
+  std::set<std::wstring> m_listing;          //!< Folders currently being listed
+  unsigned int m_accessCount;
+
+  QMutex m_mutex;
+  QWaitCondition m_listed;  //!< Signaled when a folder listing ends
+
+public:
+  Imp() : m_accessCount(0) {}
+
+  void insert(const std::wstring &folderKey, Folder &folder);
+};
+
+//-----------------------------------------------------------
+
+void TLevelDirectoryIndex::Imp::insert(const std::wstring &folderKey,
+                                       Folder &folder) {
+  if (!m_folders.count(folderKey) &&
+      (int)m_folders.size() >= maxIndexedFoldersCount) {
+    // Drop the least recently accessed folder
+    std::map<std::wstring, Folder>::iterator it, oldest = m_folders.begin();
+    for (it = m_folders.begin(); it != m_folders.end(); ++it)
+      if (it->second.m_lastAccess < oldest->second.m_lastAccess) oldest = it;
+
+    m_folders.erase(oldest);
+  }
+
+  folder.m_lastAccess  = ++m_accessCount;
+  m_folders[folderKey] = std::move(folder);
+}
+
+//-----------------------------------------------------------
+
+TLevelDirectoryIndex::TLevelDirectoryIndex() : m_imp(new Imp) {}
+
+//-----------------------------------------------------------
+
+TLevelDirectoryIndex::~TLevelDirectoryIndex() {}
+
+//-----------------------------------------------------------
+
+TLevelDirectoryIndex *TLevelDirectoryIndex::instance() {
+  static TLevelDirectoryIndex theInstance;
+  return &theInstance;
+}
+
+//-----------------------------------------------------------
+
+std::vector<TFilePath> TLevelDirectoryIndex::getLevelFiles(
+    const TFilePath &levelPath) {
+  TFilePath folderPath = levelPath.getParentDir();
+  std::wstring folderKey(folderPath.getWideString()),
+      levelKey(getLevelKey(levelPath));
+
+  // Taken before listing, so that later modifications invalidate the listing
+  QDateTime modificationTime =
+      TFileStatus(folderPath).getLastModificationTime();
+
+  {
+    QMutexLocker locker(&m_imp->m_mutex);
+
+    // Wait for the listing of the same folder by another reader, if any
+    while (m_imp->m_listing.count(folderKey))
+      m_imp->m_listed.wait(&m_imp->m_mutex);
+
+    std::map<std::wstring, Imp::Folder>::iterator it =
+        m_imp->m_folders.find(folderKey);
+    if (it != m_imp->m_folders.end() && it->second.isValid(modificationTime)) {
+      it->second.m_lastAccess = ++m_imp->m_accessCount;
+
+      std::map<std::wstring, std::vector<TFilePath>>::iterator lt =
+          it->second.m_levels.find(levelKey);
+      return (lt == it->second.m_levels.end()) ? std::vector<TFilePath>()
+                                               : lt->second;
+    }
+
+    m_imp->m_listing.insert(folderKey);
+  }
+
+  // List the folder, grouping its files by level name. Large folders take
+  // time, so other folders remain accessible meanwhile.
+  TFilePathSet files;
+  try {
+    files = TSystem::readDirectory(folderPath, false, true, true);
+  } catch (...) {
+    QMutexLocker locker(&m_imp->m_mutex);
+    m_imp->m_listing.erase(folderKey);
+    m_imp->m_listed.wakeAll();
+    throw;
+  }
+
+  Imp::Folder folder;
+  folder.m_modificationTime = modificationTime;
+  folder.m_listingTime      = QDateTime::currentDateTime();
+
+  for (TFilePathSet::iterator ft = files.begin(); ft != files.end(); ++ft)
+    folder.m_levels[getLevelKey(*ft)].push_back(*ft);
+
+  std::vector<TFilePath> levelFiles;
+  std::map<std::wstring, std::vector<TFilePath>>::iterator lt =
+      folder.m_levels.find(levelKey);
+  if (lt != folder.m_levels.end()) levelFiles = lt->second;
+
+  QMutexLocker locker(&m_imp->m_mutex);
+  m_imp->insert(folderKey, folder);
+  m_imp->m_listing.erase(folderKey);
+  m_imp->m_listed.wakeAll();
+
+  return levelFiles;
+}
+
+//-----------------------------------------------------------
+
+void TLevelDirectoryIndex::invalidate(const TFilePath &folder) {
+  QMutexLocker locker(&m_imp->m_mutex);
+  m_imp->m_folders.erase(folder.getWideString());
+}
+
+//-----------------------------------------------------------
+
+void TLevelDirectoryIndex::clear() {
+  QMutexLocker locker(&m_imp->m_mutex);
+  m_imp->m_folders.clear();
+}
+
+//===========================================================
+
 TLevelWriter::TLevelWriter(const TFilePath &path, TPropertyGroup *prop)
     : TSmartObject(m_classCode)
     , m_path(path)
@@ -193,6 +354,9 @@ TLevelWriter::TLevelWriter(const TFilePath &path, TPropertyGroup *prop)
 TLevelWriter::~TLevelWriter() {
   delete m_properties;
   delete m_contentHistory;
+
+  // The written frames may not change the folder's modification time
+  TLevelDirectoryIndex::instance()->invalidate(m_path.getParentDir());
 }
 
 //-----------------------------------------------------------
@@ -4,6 +4,8 @@
 #include "trop.h"
 #include "tpixelgr.h"
 
+#include "tthread.h"
+
 #if defined(_WIN32) && defined(x64)
 #define USE_SSE2
 #endif
@@ -38,28 +40,6 @@ struct BlurPixel {
 
 //===================================================================
 
-#define LOAD_COL_CODE                                                          \
-                                                                               \
-  buffer += x;                                                                 \
-  pix = col + by1;                                                             \
-                                                                               \
-  for (i = by1; i < ly + by1; i++) {                                           \
-    *pix++ = *buffer;                                                          \
-    buffer += lx;                                                              \
-  }                                                                            \
-                                                                               \
-  pix += by2;                                                                  \
-  left_val  = col[0];                                                          \
-  right_val = *(pix - 1);                                                      \
-  col--;                                                                       \
-                                                                               \
-  for (i = 0; i < brad; i++) {                                                 \
-    *col-- = left_val;                                                         \
-    *pix++ = right_val;                                                        \
-  }
-
-//-------------------------------------------------------------------
-
 #define BLUR_CODE(round_fac, channel_type)                                     \
   pix1 = row1;                                                                 \
   pix2 = row1 - 1;                                                             \
@@ -481,81 +461,84 @@ inline void blur_code_SSE2(BlurPixel<P> *row1, T *row2, int length, float coeff,
 
 //-------------------------------------------------------------------
 
-#define STORE_COL_CODE(crop_val)                                               \
-  {                                                                            \
-    int i, val;                                                                \
-    double ampl;                                                               \
-    buffer += x;                                                               \
-                                                                               \
-    ampl = 1.0 + blur / 15.0;                                                  \
-                                                                               \
-    if (backlit)                                                               \
-      for (i = ((dy >= 0) ? 0 : -dy); i < std::min(ly, r_ly - dy); i++) {      \
-        val       = troundp(col[i].r * ampl);                                  \
-        buffer->r = (val > crop_val) ? crop_val : val;                         \
-        val       = troundp(col[i].g * ampl);                                  \
-        buffer->g = (val > crop_val) ? crop_val : val;                         \
-        val       = troundp(col[i].b * ampl);                                  \
-        buffer->b = (val > crop_val) ? crop_val : val;                         \
-        val       = troundp(col[i].m * ampl);                                  \
-        buffer->m = (val > crop_val) ? crop_val : val;                         \
-        buffer += wrap;                                                        \
-      }                                                                        \
-    else                                                                       \
-      for (i = ((dy >= 0) ? 0 : -dy); i < std::min(ly, r_ly - dy); i++) {      \
-        *buffer = col[i];                                                      \
-        buffer += wrap;                                                        \
-      }                                                                        \
+// Scratch memory of a blur pass. The SSE2 code needs it 16-byte aligned.
+template <class T>
+class BlurBuffer {
+  T *m_data;
+  bool m_aligned;
+
+public:
+  BlurBuffer(int count, bool aligned) : m_aligned(false) {
+#ifdef _WIN32
+    if (aligned) {
+      m_data = (T *)_aligned_malloc(count * sizeof(T), 16);
+      if (!m_data) throw std::bad_alloc();
+      m_aligned = true;
+      return;
+    }
+#endif
+    m_data = new T[count];
   }
 
-//-------------------------------------------------------------------
-template <class T>
-void store_colRgb(T *buffer, int wrap, int r_ly, T *col, int ly, int x, int dy,
-                  int backlit, double blur) {
-  int val = T::maxChannelValue;
-
-  if (val == 255)
-    STORE_COL_CODE(204)
-  else if (val == 65535)
-    STORE_COL_CODE(204 * 257)
-  else
-    assert(false);
-}
+  ~BlurBuffer() {
+#ifdef _WIN32
+    if (m_aligned) {
+      _aligned_free(m_data);
+      return;
+    }
+#endif
+    delete[] m_data;
+  }
 
-//-------------------------------------------------------------------
-template <class T>
-void store_colGray(T *buffer, int wrap, int r_ly, T *col, int ly, int x, int dy,
-                   int backlit, double blur) {
-  int i;
-  double ampl;
-  buffer += x;
+  T *get() const { return m_data; }
 
-  ampl = 1.0 + blur / 15.0;
+private:
+  BlurBuffer(const BlurBuffer &);
+  BlurBuffer &operator=(const BlurBuffer &);
+};
 
-  for (i = ((dy >= 0) ? 0 : -dy); i < std::min(ly, r_ly - dy); i++) {
-    *buffer = col[i];
-    buffer += wrap;
-  }
-}
+//-------------------------------------------------------------------
+
+// Number of columns transposed together by the column pass
+const int blurColsBlock = 16;
 
 //-------------------------------------------------------------------
+// Copies count columns of the row-filtered buffer, starting at x, into cols
+// (one every colWrap elements), extending each of them by brad border pixels
+// on both sides. The buffer is read by rows of count pixels.
 template <class P>
-void load_colRgb(BlurPixel<P> *buffer, BlurPixel<P> *col, int lx, int ly, int x,
-                 int brad, int by1, int by2) {
-  int i;
-  BlurPixel<P> *pix, left_val, right_val;
-
-  LOAD_COL_CODE
+void load_cols(const P *buffer, P *cols, int colWrap, int lx, int ly, int x,
+               int count, int brad) {
+  int i, k;
+  const P *row = buffer + x;
+
+  for (i = 0; i < ly; i++, row += lx)
+    for (k = 0; k < count; k++) cols[k * colWrap + brad + i] = row[k];
+
+  for (k = 0; k < count; k++) {
+    P *col      = cols + k * colWrap + brad;
+    P left_val  = col[0];
+    P right_val = col[ly - 1];
+
+    for (i = 1; i <= brad; i++) {
+      col[-i]         = left_val;
+      col[ly - 1 + i] = right_val;
+    }
+  }
 }
 
 //-------------------------------------------------------------------
-
-void load_channel_col32(float *buffer, float *col, int lx, int ly, int x,
-                        int brad, int by1, int by2) {
-  int i;
-  float *pix, left_val, right_val;
-
-  LOAD_COL_CODE
+// Stores count filtered columns (one every colWrap pixels) in the output
+// raster, at column x and shifted by dy rows. The raster is written by rows of
+// count pixels.
+template <class T>
+void store_cols(T *buffer, int wrap, int r_ly, const T *cols, int colWrap,
+                int ly, int x, int count, int dy) {
+  int i, k;
+  for (i = ((dy >= 0) ? 0 : -dy); i < std::min(ly, r_ly - dy); i++) {
+    T *pix = buffer + (i + dy) * wrap + x;
+    for (k = 0; k < count; k++) pix[k] = cols[k * colWrap + i];
+  }
 }
 
 //-------------------------------------------------------------------
@@ -760,10 +743,14 @@ void do_filtering_floatRgb(T *row1, BlurPixel<P> *row2, int length, float coeff,
 }
 
 //-------------------------------------------------------------------
+// Both passes run on bands of the raster in parallel: the rows of srcRas are
+// filtered into fbuffer, and the columns of fbuffer into dstRas. Columns are
+// transposed in blocks of blurColsBlock, so that fbuffer and dstRas are
+// traversed by rows while each column is filtered in contiguous memory.
 template <class T, class Q, class P>
 void doBlurRgb(TRasterPT<T> &dstRas, TRasterPT<T> &srcRas, double blur, int dx,
                int dy, bool useSSE) {
-  int i, lx, ly, llx, lly, brad;
+  int lx, ly, llx, lly, brad;
   float coeff, coeffq, diff;
   int bx1 = 0, by1 = 0, bx2 = 0, by2 = 0;
 
@@ -785,18 +772,14 @@ void doBlurRgb(TRasterPT<T> &dstRas, TRasterPT<T> &srcRas, double blur, int dx,
   llx = lx + bx1 + bx2;
   lly = ly + by1 + by2;
 
-  T *row1, *col2, *buffer;
-  BlurPixel<P> *row2, *col1, *fbuffer;
+  BlurPixel<P> *fbuffer;
   TRasterGR8P r1;
 
 #ifdef _WIN32
   if (useSSE) {
     fbuffer =
         (BlurPixel<P> *)_aligned_malloc(llx * ly * sizeof(BlurPixel<P>), 16);
-    row1 = (T *)_aligned_malloc((llx + 2 * brad) * sizeof(T), 16);
-    col1 = (BlurPixel<P> *)_aligned_malloc(
-        (lly + 2 * brad) * sizeof(BlurPixel<P>), 16);
-    col2 = (T *)_aligned_malloc(lly * sizeof(T), 16);
+    if (!fbuffer) return;
   } else
 #endif
   {
@@ -804,70 +787,53 @@ void doBlurRgb(TRasterPT<T> &dstRas, TRasterPT<T> &srcRas, double blur, int dx,
     r1 = raux;
     r1->lock();
     fbuffer = (BlurPixel<P> *)r1->getRawData();  // new CASM_FPIXEL [llx *ly];
-    row1    = new T[llx + 2 * brad];
-    col1    = new BlurPixel<P>[ lly + 2 * brad ];
-    col2    = new T[lly];
   }
 
-  if ((!fbuffer) || (!row1) || (!col1) || (!col2)) {
-    if (!useSSE) r1->unlock();
-#ifdef _WIN32
-    if (useSSE) {
-      _aligned_free(col2);
-      _aligned_free(col1);
-      _aligned_free(row1);
-      _aligned_free(fbuffer);
-    } else
-#endif
-    {
-      delete[] col2;
-      delete[] col1;
-      delete[] row1;
+  bool ok = TThread::forEachBand(ly, 16, [&](int y0, int y1) {
+    BlurBuffer<T> row1(llx + 2 * brad, useSSE);
+    for (int y = y0; y < y1; y++) {
+      load_rowRgb<T>(srcRas, row1.get() + brad, lx, y, brad, bx1, bx2);
+      do_filtering_floatRgb<T>(row1.get() + brad, fbuffer + y * llx, llx, coeff,
+                               coeffq, brad, diff, useSSE);
     }
-    return;
-  }
+  });
 
-  row2 = fbuffer;
-
-  try {
-    for (i = 0; i < ly; i++) {
-      load_rowRgb<T>(srcRas, row1 + brad, lx, i, brad, bx1, bx2);
-      do_filtering_floatRgb<T>(row1 + brad, row2, llx, coeff, coeffq, brad,
-                               diff, useSSE);
-      row2 += llx;
-    }
-    dstRas->lock();
-    buffer = (T *)dstRas->getRawData();
-
-    if (dy >= 0) buffer += (dstRas->getWrap()) * dy;
-
-    for (i = (dx >= 0) ? 0 : -dx; i < std::min(llx, dstRas->getLx() - dx);
-         i++) {
-      load_colRgb<P>(fbuffer, col1 + brad, llx, ly, i, brad, by1, by2);
-      do_filtering_chan<T, Q, P>(col1 + brad, col2, lly, coeff, coeffq, brad,
-                                 diff, useSSE);
-      store_colRgb<T>(buffer, dstRas->getWrap(), dstRas->getLy(), col2, lly,
-                      i + dx, dy, 0, blur);
-    }
-    dstRas->unlock();
-  } catch (...) {
-    dstRas->clear();
-  }
+  dstRas->lock();
+  T *buffer = (T *)dstRas->getRawData();
+  int wrap = dstRas->getWrap(), r_ly = dstRas->getLy();
+
+  int x0 = (dx >= 0) ? 0 : -dx, x1 = std::min(llx, dstRas->getLx() - dx);
+  int colWrap = lly + 2 * brad;
+
+  if (ok && x0 < x1)
+    ok = TThread::forEachBand(
+        (x1 - x0 + blurColsBlock - 1) / blurColsBlock, 1, [&](int b0, int b1) {
+          BlurBuffer<BlurPixel<P>> col1(blurColsBlock * colWrap, useSSE);
+          BlurBuffer<T> col2(blurColsBlock * lly, useSSE);
+
+          for (int b = b0; b < b1; b++) {
+            int x = x0 + b * blurColsBlock,
+                count = std::min(blurColsBlock, x1 - x);
+
+            load_cols(fbuffer, col1.get(), colWrap, llx, ly, x, count, brad);
+            for (int k = 0; k < count; k++)
+              do_filtering_chan<T, Q, P>(col1.get() + k * colWrap + brad,
+                                         col2.get() + k * lly, lly, coeff,
+                                         coeffq, brad, diff, useSSE);
+            store_cols(buffer, wrap, r_ly, col2.get(), lly, lly, x + dx, count,
+                       dy);
+          }
+        });
+
+  if (!ok) dstRas->clear();
+  dstRas->unlock();
 
 #ifdef _WIN32
-  if (useSSE) {
-    _aligned_free(col2);
-    _aligned_free(col1);
-    _aligned_free(row1);
+  if (useSSE)
     _aligned_free(fbuffer);
-  } else
+  else
 #endif
-  {
-    delete[] col2;
-    delete[] col1;
-    delete[] row1;
     r1->unlock();
-  }
 }
 
 //-------------------------------------------------------------------
@@ -875,7 +841,7 @@ void doBlurRgb(TRasterPT<T> &dstRas, TRasterPT<T> &srcRas, double blur, int dx,
 template <class T>
 void doBlurGray(TRasterPT<T> &dstRas, TRasterPT<T> &srcRas, double blur, int dx,
                 int dy) {
-  int i, lx, ly, llx, lly, brad;
+  int lx, ly, llx, lly, brad;
   float coeff, coeffq, diff;
   int bx1 = 0, by1 = 0, bx2 = 0, by2 = 0;
 
@@ -894,50 +860,48 @@ void doBlurGray(TRasterPT<T> &dstRas, TRasterPT<T> &srcRas, double blur, int dx,
   llx = lx + bx1 + bx2;
   lly = ly + by1 + by2;
 
-  T *row1, *col2, *buffer;
-  float *row2, *col1, *fbuffer;
-
   TRasterGR8P r1(llx * sizeof(float), ly);
   r1->lock();
-  fbuffer = (float *)r1->getRawData();  // new float[llx *ly];
-
-  row1 = new T[llx + 2 * brad];
-  col1 = new float[lly + 2 * brad];
-  col2 = new T[lly];
-
-  if ((!fbuffer) || (!row1) || (!col1) || (!col2)) {
-    delete[] row1;
-    delete[] col1;
-    delete[] col2;
-    return;
-  }
-
-  row2 = fbuffer;
+  float *fbuffer = (float *)r1->getRawData();  // new float[llx *ly];
+
+  bool ok = TThread::forEachBand(ly, 16, [&](int y0, int y1) {
+    BlurBuffer<T> row1(llx + 2 * brad, false);
+    for (int y = y0; y < y1; y++) {
+      load_rowGray<T>(srcRas, row1.get() + brad, lx, y, brad, bx1, bx2);
+      do_filtering_channel_float<T>(row1.get() + brad, fbuffer + y * llx, llx,
+                                    coeff, coeffq, brad, diff);
+    }
+  });
 
-  for (i = 0; i < ly; i++) {
-    load_rowGray<T>(srcRas, row1 + brad, lx, i, brad, bx1, bx2);
-    do_filtering_channel_float<T>(row1 + brad, row2, llx, coeff, coeffq, brad,
-                                  diff);
-    row2 += llx;
-  }
   dstRas->lock();
-  buffer = (T *)dstRas->getRawData();
-
-  if (dy >= 0) buffer += (dstRas->getWrap()) * dy;
-
-  for (i = (dx >= 0) ? 0 : -dx; i < std::min(llx, dstRas->getLx() - dx); i++) {
-    load_channel_col32(fbuffer, col1 + brad, llx, ly, i, brad, by1, by2);
-    do_filtering_channel_gray<T>(col1 + brad, col2, lly, coeff, coeffq, brad,
-                                 diff);
-
-    int backlit = 0;
-    store_colGray<T>(buffer, dstRas->getWrap(), dstRas->getLy(), col2, lly,
-                     i + dx, dy, backlit, blur);
-  }
+  T *buffer = (T *)dstRas->getRawData();
+  int wrap = dstRas->getWrap(), r_ly = dstRas->getLy();
+
+  int x0 = (dx >= 0) ? 0 : -dx, x1 = std::min(llx, dstRas->getLx() - dx);
+  int colWrap = lly + 2 * brad;
+
+  if (ok && x0 < x1)
+    ok = TThread::forEachBand(
+        (x1 - x0 + blurColsBlock - 1) / blurColsBlock, 1, [&](int b0, int b1) {
+          BlurBuffer<float> col1(blurColsBlock * colWrap, false);
+          BlurBuffer<T> col2(blurColsBlock * lly, false);
+
+          for (int b = b0; b < b1; b++) {
+            int x = x0 + b * blurColsBlock,
+                count = std::min(blurColsBlock, x1 - x);
+
+            load_cols(fbuffer, col1.get(), colWrap, llx, ly, x, count, brad);
+            for (int k = 0; k < count; k++)
+              do_filtering_channel_gray<T>(col1.get() + k * colWrap + brad,
+                                           col2.get() + k * lly, lly, coeff,
+                                           coeffq, brad, diff);
+            store_cols(buffer, wrap, r_ly, col2.get(), lly, lly, x + dx, count,
+                       dy);
+          }
+        });
+
+  if (!ok) dstRas->clear();
   dstRas->unlock();
-  delete[] col2;
-  delete[] col1;
-  delete[] row1;
   r1->unlock();  // delete[]fbuffer;
 }
 
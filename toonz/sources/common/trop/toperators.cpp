@@ -3,6 +3,7 @@
 #include "trop.h"
 #include "tpixel.h"
 #include "tpixelutils.h"
+#include "tthread.h"
 
 // calls to _mm_* functions disabled in code for now (marked as comment)
 // so disable include <emmintrin.h>
@@ -27,6 +28,8 @@ inline double luminance(TPixel64 *pix) {
 
 //-----------------------------------------------------------------------------
 
+// Rows are independent, so the loop body runs on parallel bands of them
+
 #define FOR_EACH_PIXEL_BEGIN_LOOP(UpType, up, DownType, down, OutType, out)    \
   {                                                                            \
     int upWrap   = up->getWrap();                                              \
@@ -36,18 +39,20 @@ inline double luminance(TPixel64 *pix) {
     up->lock();                                                                \
     down->lock();                                                              \
     out->lock();                                                               \
-    UpType *upPix = 0, *upRow   = up->pixels();                                \
-    DownType *downPix, *downRow = down->pixels();                              \
-    OutType *outPix, *outRow    = out->pixels();                               \
-    UpType *endPix;                                                            \
-    int upLx        = up->getLx();                                             \
-    UpType *lastPix = upRow + upWrap * (up->getLy() - 1) + upLx;               \
-    while (upPix < lastPix) {                                                  \
-      upPix   = upRow;                                                         \
-      downPix = downRow;                                                       \
-      outPix  = outRow;                                                        \
-      endPix  = upPix + upLx;                                                  \
-      while (upPix < endPix) {
+    UpType *upBuf     = up->pixels();                                          \
+    DownType *downBuf = down->pixels();                                        \
+    OutType *outBuf   = out->pixels();                                         \
+    int upLx          = up->getLx();                                           \
+    bool done = TThread::forEachBand(up->getLy(), 16, [&](int y0, int y1) {    \
+      UpType *upPix, *endPix;                                                  \
+      DownType *downPix;                                                       \
+      OutType *outPix;                                                         \
+      for (int y = y0; y < y1; ++y) {                                          \
+        upPix   = upBuf + y * upWrap;                                          \
+        downPix = downBuf + y * downWrap;                                      \
+        outPix  = outBuf + y * outWrap;                                        \
+        endPix  = upPix + upLx;                                                \
+        while (upPix < endPix) {
 //-----------------------------------------------------------------------------
 
 #define FOR_EACH_PIXEL_END_LOOP(up, down, out)                                 \
@@ -55,13 +60,12 @@ inline double luminance(TPixel64 *pix) {
   ++downPix;                                                                   \
   ++outPix;                                                                    \
   }                                                                            \
-  upRow += upWrap;                                                             \
-  downRow += downWrap;                                                         \
-  outRow += outWrap;                                                           \
   }                                                                            \
+  });                                                                          \
   up->unlock();                                                                \
   down->unlock();                                                              \
   out->unlock();                                                               \
+  if (!done) throw TRopException("operator failed");                           \
   }
 
 //-----------------------------------------------------------------------------
@@ -100,7 +104,7 @@ inline double luminance(TPixel64 *pix) {
 
 #define FOR_EACH_PIXEL_8_END_LOOP                                              \
   assert(up8 &&down8 &&out8);                                                  \
-  FOR_EACH_PIXEL_END_LOOP(up32, down32, out32)
+  FOR_EACH_PIXEL_END_LOOP(up8, down8, out8)
 
 //-----------------------------------------------------------------------------
 
@@ -641,14 +645,12 @@ D_m)
     float vf = v;
 
     if (matte) {
-      float dnMf, upMf_norm, outMf;
-
       FOR_EACH_PIXEL_32_BEGIN_LOOP  // Awful... should be explicit...
 
-          dnMf  = downPix->m;
-      upMf_norm = upPix->m / maxChannelF;
+          float dnMf = downPix->m;
+      float upMf_norm = upPix->m / maxChannelF;
 
-      outMf = downPix->m * upMf_norm;
+      float outMf = downPix->m * upMf_norm;
 
       outPix->r =
           tcrop((upPix->r / upMf_norm + vf) * (downPix->r / dnMf), 0.0f, outMf);
@@ -662,11 +664,11 @@ D_m)
 
       FOR_EACH_PIXEL_32_END_LOOP
     } else {
+      FOR_EACH_PIXEL_32_BEGIN_LOOP
+
       float umf_norm, dmf_norm, umdmf_norm, outMf;
       float mSumf, uf, df, ufdf, normalizer;
 
-      FOR_EACH_PIXEL_32_BEGIN_LOOP
-
       mSumf = upPix->m + float(downPix->m);
       if (mSumf > 0.0f) {
         umf_norm = upPix->m / maxChannelF, dmf_norm = downPix->m / maxChannelF;
@@ -716,10 +718,10 @@ D_m)
         v * (TPixel64::maxChannelValue / double(TPixel32::maxChannelValue));
 
     if (matte) {
-      double dnMf, upMf_norm, outMf;
-
       FOR_EACH_PIXEL_64_BEGIN_LOOP
 
+      double dnMf, upMf_norm, outMf;
+
       dnMf      = downPix->m;
       upMf_norm = upPix->m / maxChannelF;
 
@@ -735,11 +737,11 @@ D_m)
 
       FOR_EACH_PIXEL_64_END_LOOP
     } else {
+      FOR_EACH_PIXEL_64_BEGIN_LOOP
+
       double umf_norm, dmf_norm, umdmf_norm, outMf;
       double mSumf, uf, df, ufdf, normalizer;
 
-      FOR_EACH_PIXEL_64_BEGIN_LOOP
-
       mSumf = upPix->m + double(downPix->m);
       if (mSumf > 0.0) {
         umf_norm = upPix->m / maxChannelF, dmf_norm = downPix->m / maxChannelF;
@@ -1,6 +1,7 @@
 
 
 #include "quickputP.h"
+#include "tthread.h"
 #include "tpixelutils.h"
 #include "trastercm.h"
 #include "tsystem.h"
@@ -33,44 +34,47 @@ inline bool opaque(const TPixel64 &p) { return p.m == 0xffff; }
 template <class T>
 void do_overT3(TRasterPT<T> rout, const TRasterPT<T> &rdn,
                const TRasterPT<T> &rup) {
-  for (int y = 0; y < rout->getLy(); y++) {
+  bool done = TThread::forEachBand(rout->getLy(), 16, [&](int y0, int y1) {
+    for (int y = y0; y < y1; y++) {
 #ifdef MODO1
-    const T *dn_pix = rdn->pixels(y);
-    const T *up_pix = rup->pixels(y);
-    T *out_pix      = rout->pixels(y);
+      const T *dn_pix = rdn->pixels(y);
+      const T *up_pix = rup->pixels(y);
+      T *out_pix      = rout->pixels(y);
 
 #else
 #ifdef MODO2
-    const T *dn_pix = ((T *)rdn->getRawData()) + y * rdn->getWrap();
-    const T *up_pix = ((T *)rup->getRawData()) + y * rup->getWrap();
+      const T *dn_pix = ((T *)rdn->getRawData()) + y * rdn->getWrap();
+      const T *up_pix = ((T *)rup->getRawData()) + y * rup->getWrap();
 
-    T *out_pix = ((T *)rout->getRawData()) + y * rout->getWrap();
+      T *out_pix = ((T *)rout->getRawData()) + y * rout->getWrap();
 #endif
 #endif
 
-    const T *dn_limit = dn_pix + rdn->getLx();
-    for (; dn_pix < dn_limit; dn_pix++, up_pix++, out_pix++) {
+      const T *dn_limit = dn_pix + rdn->getLx();
+      for (; dn_pix < dn_limit; dn_pix++, up_pix++, out_pix++) {
 #ifdef VELOCE
-      if (transp(*up_pix))
-        *out_pix = *dn_pix;
-      else if (opaque(*up_pix))
-        *out_pix = *up_pix;
-      else {
-        *out_pix = overPix(*dn_pix, *up_pix);
-      }
+        if (transp(*up_pix))
+          *out_pix = *dn_pix;
+        else if (opaque(*up_pix))
+          *out_pix = *up_pix;
+        else {
+          *out_pix = overPix(*dn_pix, *up_pix);
+        }
 #else
 
-      T topval = *up_pix;
-      if (transp(topval))
-        *out_pix = *dn_pix;
-      else if (opaque(topval))
-        *out_pix = topval;
-      else {
-        *out_pix = overPix(*dn_pix, topval);
-      }
+        T topval = *up_pix;
+        if (transp(topval))
+          *out_pix = *dn_pix;
+        else if (opaque(topval))
+          *out_pix = topval;
+        else {
+          *out_pix = overPix(*dn_pix, topval);
+        }
 #endif
+      }
     }
-  }
+  });
+  if (!done) throw TRopException("over failed");
 }
 
 //-----------------------------------------------------------------------------
@@ -78,30 +82,33 @@ void do_overT3(TRasterPT<T> rout, const TRasterPT<T> &rdn,
 template <typename PixTypeOut, typename PixTypeDn, typename PixTypeUp>
 void do_over(TRasterPT<PixTypeOut> rout, const TRasterPT<PixTypeDn> &rdn,
              const TRasterPT<PixTypeUp> &rup, const TRasterGR8P rmask) {
-  for (int y = 0; y < rout->getLy(); y++) {
-    const PixTypeDn *dn_pix =
-        ((PixTypeDn *)rdn->getRawData()) + y * rdn->getWrap();
-    const PixTypeUp *up_pix =
-        ((PixTypeUp *)rup->getRawData()) + y * rup->getWrap();
-
-    PixTypeOut *out_pix =
-        ((PixTypeOut *)rout->getRawData()) + y * rout->getWrap();
-    TPixelGR8 *mask_pix =
-        ((TPixelGR8 *)rmask->getRawData()) + y * rmask->getWrap();
-
-    const PixTypeDn *dn_limit = dn_pix + rout->getLx();
-    for (; dn_pix < dn_limit; dn_pix++, up_pix++, out_pix++, mask_pix++) {
-      if (mask_pix->value == 0x00)
-        *out_pix = *dn_pix;
-      else if (mask_pix->value == 0xff)
-        *out_pix = *up_pix;
-      else {
-        PixTypeUp p(*up_pix);
-        p.m      = mask_pix->value;
-        *out_pix = overPix(*dn_pix, p);  // hei!
+  bool done = TThread::forEachBand(rout->getLy(), 16, [&](int y0, int y1) {
+    for (int y = y0; y < y1; y++) {
+      const PixTypeDn *dn_pix =
+          ((PixTypeDn *)rdn->getRawData()) + y * rdn->getWrap();
+      const PixTypeUp *up_pix =
+          ((PixTypeUp *)rup->getRawData()) + y * rup->getWrap();
+
+      PixTypeOut *out_pix =
+          ((PixTypeOut *)rout->getRawData()) + y * rout->getWrap();
+      TPixelGR8 *mask_pix =
+          ((TPixelGR8 *)rmask->getRawData()) + y * rmask->getWrap();
+
+      const PixTypeDn *dn_limit = dn_pix + rout->getLx();
+      for (; dn_pix < dn_limit; dn_pix++, up_pix++, out_pix++, mask_pix++) {
+        if (mask_pix->value == 0x00)
+          *out_pix = *dn_pix;
+        else if (mask_pix->value == 0xff)
+          *out_pix = *up_pix;
+        else {
+          PixTypeUp p(*up_pix);
+          p.m      = mask_pix->value;
+          *out_pix = overPix(*dn_pix, p);  // hei!
+        }
       }
     }
-  }
+  });
+  if (!done) throw TRopException("over failed");
 }
 
 //-----------------------------------------------------------------------------
@@ -135,27 +142,30 @@ void do_overT2(TRasterPT<T> rout, const TRasterPT<T> &rup) {
   double maxD = max;
 
   assert(rout->getSize() == rup->getSize());
-  for (int y = 0; y < rout->getLy(); y++) {
-    T *out_pix       = rout->pixels(y);
-    T *const out_end = out_pix + rout->getLx();
-    const T *up_pix  = rup->pixels(y);
-
-    for (; out_pix < out_end; ++out_pix, ++up_pix) {
-      if (up_pix->m == max)
-        *out_pix = *up_pix;
-      else if (up_pix->m > 0) {
-        TUINT32 r, g, b;
-        r = up_pix->r + (out_pix->r * (max - up_pix->m)) / maxD;
-        g = up_pix->g + (out_pix->g * (max - up_pix->m)) / maxD;
-        b = up_pix->b + (out_pix->b * (max - up_pix->m)) / maxD;
-
-        out_pix->r = (r < max) ? (Q)r : (Q)max;
-        out_pix->g = (g < max) ? (Q)g : (Q)max;
-        out_pix->b = (b < max) ? (Q)b : (Q)max;
-        out_pix->m = up_pix->m + (out_pix->m * (max - up_pix->m)) / maxD;
+  bool done = TThread::forEachBand(rout->getLy(), 16, [&](int y0, int y1) {
+    for (int y = y0; y < y1; y++) {
+      T *out_pix       = rout->pixels(y);
+      T *const out_end = out_pix + rout->getLx();
+      const T *up_pix  = rup->pixels(y);
+
+      for (; out_pix < out_end; ++out_pix, ++up_pix) {
+        if (up_pix->m == max)
+          *out_pix = *up_pix;
+        else if (up_pix->m > 0) {
+          TUINT32 r, g, b;
+          r = up_pix->r + (out_pix->r * (max - up_pix->m)) / maxD;
+          g = up_pix->g + (out_pix->g * (max - up_pix->m)) / maxD;
+          b = up_pix->b + (out_pix->b * (max - up_pix->m)) / maxD;
+
+          out_pix->r = (r < max) ? (Q)r : (Q)max;
+          out_pix->g = (g < max) ? (Q)g : (Q)max;
+          out_pix->b = (b < max) ? (Q)b : (Q)max;
+          out_pix->m = up_pix->m + (out_pix->m * (max - up_pix->m)) / maxD;
+        }
       }
     }
-  }
+  });
+  if (!done) throw TRopException("over failed");
 }
 
 //-----------------------------------------------------------------------------
@@ -164,49 +174,52 @@ void do_overT2(TRasterPT<T> rout, const TRasterPT<T> &rup) {
 
 void do_over_SSE2(TRaster32P rout, const TRaster32P &rup) {
   __m128i zeros = _mm_setzero_si128();
-  __m128i out_pix_packed_i, up_pix_packed_i;
-  __m128 out_pix_packed, up_pix_packed;
 
-  float maxChannelValue    = 255.0;
-  float maxChannelValueInv = 1.0f / maxChannelValue;
+  float maxChannelValue = 255.0;
 
   __m128 maxChanneValue_packed = _mm_load1_ps(&maxChannelValue);
 
   assert(rout->getSize() == rup->getSize());
-  for (int y = 0; y < rout->getLy(); y++) {
-    TPixel32 *out_pix       = rout->pixels(y);
-    TPixel32 *const out_end = out_pix + rout->getLx();
-    const TPixel32 *up_pix  = rup->pixels(y);
-
-    for (; out_pix < out_end; ++out_pix, ++up_pix) {
-      if (up_pix->m == 0xff)
-        *out_pix = *up_pix;
-      else if (up_pix->m > 0) {
-        float factor         = (255.0f - up_pix->m) / 255.0f;
-        __m128 factor_packed = _mm_load1_ps(&factor);
-
-        // carica up_pix e out_pix in due registri a 128 bit
-        up_pix_packed_i =
-            _mm_unpacklo_epi8(_mm_cvtsi32_si128(*(DWORD *)up_pix), zeros);
-        up_pix_packed =
-            _mm_cvtepi32_ps(_mm_unpacklo_epi16(up_pix_packed_i, zeros));
-
-        out_pix_packed_i =
-            _mm_unpacklo_epi8(_mm_cvtsi32_si128(*(DWORD *)out_pix), zeros);
-        out_pix_packed =
-            _mm_cvtepi32_ps(_mm_unpacklo_epi16(out_pix_packed_i, zeros));
-
-        out_pix_packed = _mm_add_ps(up_pix_packed,
-                                    _mm_mul_ps(out_pix_packed, factor_packed));
-        out_pix_packed = _mm_min_ps(maxChanneValue_packed, out_pix_packed);
-
-        out_pix_packed_i    = _mm_cvtps_epi32(out_pix_packed);
-        out_pix_packed_i    = _mm_packs_epi32(out_pix_packed_i, zeros);
-        out_pix_packed_i    = _mm_packus_epi16(out_pix_packed_i, zeros);
-        *(DWORD *)(out_pix) = _mm_cvtsi128_si32(out_pix_packed_i);
+  bool done = TThread::forEachBand(rout->getLy(), 16, [&](int y0, int y1) {
+    __m128i out_pix_packed_i, up_pix_packed_i;
+    __m128 out_pix_packed, up_pix_packed;
+
+    for (int y = y0; y < y1; y++) {
+      TPixel32 *out_pix       = rout->pixels(y);
+      TPixel32 *const out_end = out_pix + rout->getLx();
+      const TPixel32 *up_pix  = rup->pixels(y);
+
+      for (; out_pix < out_end; ++out_pix, ++up_pix) {
+        if (up_pix->m == 0xff)
+          *out_pix = *up_pix;
+        else if (up_pix->m > 0) {
+          float factor         = (255.0f - up_pix->m) / 255.0f;
+          __m128 factor_packed = _mm_load1_ps(&factor);
+
+          // carica up_pix e out_pix in due registri a 128 bit
+          up_pix_packed_i =
+              _mm_unpacklo_epi8(_mm_cvtsi32_si128(*(DWORD *)up_pix), zeros);
+          up_pix_packed =
+              _mm_cvtepi32_ps(_mm_unpacklo_epi16(up_pix_packed_i, zeros));
+
+          out_pix_packed_i =
+              _mm_unpacklo_epi8(_mm_cvtsi32_si128(*(DWORD *)out_pix), zeros);
+          out_pix_packed =
+              _mm_cvtepi32_ps(_mm_unpacklo_epi16(out_pix_packed_i, zeros));
+
+          out_pix_packed = _mm_add_ps(
+              up_pix_packed, _mm_mul_ps(out_pix_packed, factor_packed));
+          out_pix_packed = _mm_min_ps(maxChanneValue_packed, out_pix_packed);
+
+          out_pix_packed_i    = _mm_cvtps_epi32(out_pix_packed);
+          out_pix_packed_i    = _mm_packs_epi32(out_pix_packed_i, zeros);
+          out_pix_packed_i    = _mm_packus_epi16(out_pix_packed_i, zeros);
+          *(DWORD *)(out_pix) = _mm_cvtsi128_si32(out_pix_packed_i);
+        }
       }
     }
-  }
+  });
+  if (!done) throw TRopException("over failed");
 }
 
 #endif
@@ -3,6 +3,7 @@
 #include "tmachine.h"
 #include "tpixelgr.h"
 #include "quickputP.h"
+#include "tthread.h"
 
 //#include "tspecialstyleid.h"
 #include "tsystem.h"
@@ -1112,18 +1113,8 @@ void resample_main_rgbm(TRasterPT<T> rout, const TRasterPT<T> &rin,
                         short *filter) {
   const T *buffer_in;
   T *buffer_out;
-  T *pix_out;
   int lu, lv, wrap_in, mu, mv;
   int lx, ly, wrap_out;
-  int out_x, out_y;
-  double out_x_, out_y_;
-  double out_u_, out_v_;
-  int ref_u, ref_v;
-  int pix_u, pix_v;
-  double ref_out_u_, ref_out_v_;
-  double ref_out_f_, ref_out_g_;
-  int ref_out_f, ref_out_g;
-  int pix_out_f, pix_out_g;
   int filter_mu, filter_mv;
   UINT inside_limit_u, inside_limit_v;
   int inside_nonempty;
@@ -1132,19 +1123,7 @@ void resample_main_rgbm(TRasterPT<T> rout, const TRasterPT<T> &rin,
   UCHAR *calc;
   int calc_allocsize;
   int calc_bytewrap;
-  UCHAR calc_value;
-  bool must_calc;
-  T pix_value, default_value(0, 0, 0, 0);
-  SUMS_TYPE weight, sum_weights;
-  double inv_sum_weights;
-  SUMS_TYPE sum_contribs_r, sum_contribs_g, sum_contribs_b, sum_contribs_m;
-  double out_fval_r, out_fval_g, out_fval_b, out_fval_m;
-  int out_value_r, out_value_g, out_value_b, out_value_m;
-  int i;
-
-#ifdef USE_DOUBLE_TO_INT
-  double d2iaux;
-#endif
+  T default_value(0, 0, 0, 0);
 
   if (!(rout->getLx() > 0 && rout->getLy() > 0)) return;
 
@@ -1182,169 +1161,200 @@ void resample_main_rgbm(TRasterPT<T> rout, const TRasterPT<T> &rin,
   outside_max_u   = mu - min_pix_ref_u;
   outside_max_v   = mv - min_pix_ref_v;
 
-  // For every pixel of the output image
-  for (out_y = 0, out_y_ = 0.5; out_y < ly; out_y++, out_y_ += 1.0) {
-    for (out_x = 0, out_x_ = 0.5; out_x < lx; out_x++, out_x_ += 1.0) {
-      pix_out = buffer_out + out_y * wrap_out + out_x;
-
-      // Take the pre-image of the pixel through the passed affine
-      out_u_ = affMV1(aff_xy2uv, out_x_, out_y_);
-      out_v_ = affMV2(aff_xy2uv, out_x_, out_y_);
-
-      // Convert to integer coordinates
-      ref_u = intLE(out_u_);
-      ref_v = intLE(out_v_);
-
-      // NOTE: The following condition is equivalent to:
-      // (ref_u + min_pix_ref_u >= 0 && ref_v + min_pix_ref_v >= 0 &&
-      //  ref_u + max_pix_ref_u < lu && ref_v + max_pix_ref_v < lv)
-      // - since the presence of (UINT) makes integeres < 0 become >> 0
-      if (inside_nonempty && (UINT)(ref_u + min_pix_ref_u) < inside_limit_u &&
-          (UINT)(ref_v + min_pix_ref_v) < inside_limit_v) {
-        // The filter mask starting around (ref_u, ref_v) is completely
-        // contained
-        // in the source raster
-
-        // Get the calculation array mask byte
-        calc_value = calc[(ref_u >> 3) + ref_v * calc_bytewrap];
-        if (calc_value && ((calc_value >> (ref_u & 7)) &
-                           1))  // If the mask bit for this pixel is on
-        {
-          ref_out_u_ = ref_u - out_u_;  // Fractionary part of the pre-image
-          ref_out_v_ = ref_v - out_v_;
-          ref_out_f_ = aff0MV1(aff0_uv2fg, ref_out_u_,
-                               ref_out_v_);  // Make the image of it into fg
-          ref_out_g_ = aff0MV2(aff0_uv2fg, ref_out_u_, ref_out_v_);
-          ref_out_f  = tround(ref_out_f_);  // Convert to integer coordinates
-          ref_out_g  = tround(ref_out_g_);
+  // For every pixel of the output image - rows are independent, so they are
+  // computed on parallel bands
+  bool done = TThread::forEachBand(ly, 16, [&](int y0, int y1) {
+    T *pix_out;
+    int out_x, out_y;
+    double out_x_, out_y_;
+    double out_u_, out_v_;
+    int ref_u, ref_v;
+    int pix_u, pix_v;
+    double ref_out_u_, ref_out_v_;
+    double ref_out_f_, ref_out_g_;
+    int ref_out_f, ref_out_g;
+    int pix_out_f, pix_out_g;
+    UCHAR calc_value;
+    bool must_calc;
+    T pix_value;
+    SUMS_TYPE weight, sum_weights;
+    double inv_sum_weights;
+    SUMS_TYPE sum_contribs_r, sum_contribs_g, sum_contribs_b, sum_contribs_m;
+    double out_fval_r, out_fval_g, out_fval_b, out_fval_m;
+    int out_value_r, out_value_g, out_value_b, out_value_m;
+    int i;
 
-          sum_weights    = 0;
-          sum_contribs_r = 0;
-          sum_contribs_g = 0;
-          sum_contribs_b = 0;
-          sum_contribs_m = 0;
-
-          // Make the weighted sum of source pixels
-          for (i = n_pix - 1; i >= 0; --i) {
-            // Build the weight for this pixel
-            pix_out_f = pix_ref_f[i] + ref_out_f;  // image of the integer part
-                                                   // + that of the fractionary
-                                                   // part
-            pix_out_g = pix_ref_g[i] + ref_out_g;
-            weight    = (filter[pix_out_f] * filter[pix_out_g]) >> 16;
-
-            // Add the weighted pixel contribute
-            pix_u = pix_ref_u[i] + ref_u;
-            pix_v = pix_ref_v[i] + ref_v;
-
-            pix_value = buffer_in[pix_u + pix_v * wrap_in];
-            sum_contribs_r += (SUMS_TYPE)pix_value.r * weight;
-            sum_contribs_g += (SUMS_TYPE)pix_value.g * weight;
-            sum_contribs_b += (SUMS_TYPE)pix_value.b * weight;
-            sum_contribs_m += (SUMS_TYPE)pix_value.m * weight;
-            sum_weights += weight;
-          }
+#ifdef USE_DOUBLE_TO_INT
+    double d2iaux;
+#endif
 
-          inv_sum_weights = 1.0 / sum_weights;
-          out_fval_r      = sum_contribs_r * inv_sum_weights;
-          out_fval_g      = sum_contribs_g * inv_sum_weights;
-          out_fval_b      = sum_contribs_b * inv_sum_weights;
-          out_fval_m      = sum_contribs_m * inv_sum_weights;
-          notLessThan(0.0, out_fval_r);
-          notLessThan(0.0, out_fval_g);
-          notLessThan(0.0, out_fval_b);
-          notLessThan(0.0, out_fval_m);
-          out_value_r = troundp(out_fval_r);
-          out_value_g = troundp(out_fval_g);
-          out_value_b = troundp(out_fval_b);
-          out_value_m = troundp(out_fval_m);
-          notMoreThan(T::maxChannelValue, out_value_r);
-          notMoreThan(T::maxChannelValue, out_value_g);
-          notMoreThan(T::maxChannelValue, out_value_b);
-          notMoreThan(T::maxChannelValue, out_value_m);
-          pix_out->r = out_value_r;
-          pix_out->g = out_value_g;
-          pix_out->b = out_value_b;
-          pix_out->m = out_value_m;
-        } else
-          // The pixel is copied from the corresponding source...
-          *pix_out = buffer_in[ref_u + ref_v * wrap_in];
-      } else if (outside_min_u <= ref_u && ref_u <= outside_max_u &&
-                 outside_min_v <= ref_v && ref_v <= outside_max_v) {
-        if ((UINT)ref_u >= (UINT)lu || (UINT)ref_v >= (UINT)lv)
-          must_calc = true;
-        else {
+    for (out_y = y0, out_y_ = y0 + 0.5; out_y < y1; out_y++, out_y_ += 1.0) {
+      for (out_x = 0, out_x_ = 0.5; out_x < lx; out_x++, out_x_ += 1.0) {
+        pix_out = buffer_out + out_y * wrap_out + out_x;
+
+        // Take the pre-image of the pixel through the passed affine
+        out_u_ = affMV1(aff_xy2uv, out_x_, out_y_);
+        out_v_ = affMV2(aff_xy2uv, out_x_, out_y_);
+
+        // Convert to integer coordinates
+        ref_u = intLE(out_u_);
+        ref_v = intLE(out_v_);
+
+        // NOTE: The following condition is equivalent to:
+        // (ref_u + min_pix_ref_u >= 0 && ref_v + min_pix_ref_v >= 0 &&
+        //  ref_u + max_pix_ref_u < lu && ref_v + max_pix_ref_v < lv)
+        // - since the presence of (UINT) makes integeres < 0 become >> 0
+        if (inside_nonempty && (UINT)(ref_u + min_pix_ref_u) < inside_limit_u &&
+            (UINT)(ref_v + min_pix_ref_v) < inside_limit_v) {
+          // The filter mask starting around (ref_u, ref_v) is completely
+          // contained
+          // in the source raster
+
+          // Get the calculation array mask byte
           calc_value = calc[(ref_u >> 3) + ref_v * calc_bytewrap];
-          must_calc  = calc_value && ((calc_value >> (ref_u & 7)) & 1);
-        }
-
-        if (must_calc) {
-          ref_out_u_     = ref_u - out_u_;
-          ref_out_v_     = ref_v - out_v_;
-          ref_out_f_     = aff0MV1(aff0_uv2fg, ref_out_u_, ref_out_v_);
-          ref_out_g_     = aff0MV2(aff0_uv2fg, ref_out_u_, ref_out_v_);
-          ref_out_f      = tround(ref_out_f_);
-          ref_out_g      = tround(ref_out_g_);
-          sum_weights    = 0;
-          sum_contribs_r = 0;
-          sum_contribs_g = 0;
-          sum_contribs_b = 0;
-          sum_contribs_m = 0;
-
-          for (i = n_pix - 1; i >= 0; --i) {
-            pix_out_f = pix_ref_f[i] + ref_out_f;
-            pix_out_g = pix_ref_g[i] + ref_out_g;
-            weight    = (filter[pix_out_f] * filter[pix_out_g]) >> 16;
-            pix_u     = pix_ref_u[i] + ref_u;
-            pix_v     = pix_ref_v[i] + ref_v;
-
-            if (pix_u < 0 || pix_u > mu || pix_v < 0 || pix_v > mv) {
-              sum_weights += weight;  // 0-padding
-              continue;
+          if (calc_value && ((calc_value >> (ref_u & 7)) &
+                             1))  // If the mask bit for this pixel is on
+          {
+            ref_out_u_ = ref_u - out_u_;  // Fractionary part of the pre-image
+            ref_out_v_ = ref_v - out_v_;
+            ref_out_f_ = aff0MV1(aff0_uv2fg, ref_out_u_,
+                                 ref_out_v_);  // Make the image of it into fg
+            ref_out_g_ = aff0MV2(aff0_uv2fg, ref_out_u_, ref_out_v_);
+            ref_out_f  = tround(ref_out_f_);  // Convert to integer coordinates
+            ref_out_g  = tround(ref_out_g_);
+
+            sum_weights    = 0;
+            sum_contribs_r = 0;
+            sum_contribs_g = 0;
+            sum_contribs_b = 0;
+            sum_contribs_m = 0;
+
+            // Make the weighted sum of source pixels
+            for (i = n_pix - 1; i >= 0; --i) {
+              // Build the weight for this pixel
+              pix_out_f =
+                  pix_ref_f[i] + ref_out_f;  // image of the integer part
+                                             // + that of the fractionary
+                                             // part
+              pix_out_g = pix_ref_g[i] + ref_out_g;
+              weight    = (filter[pix_out_f] * filter[pix_out_g]) >> 16;
+
+              // Add the weighted pixel contribute
+              pix_u = pix_ref_u[i] + ref_u;
+              pix_v = pix_ref_v[i] + ref_v;
+
+              pix_value = buffer_in[pix_u + pix_v * wrap_in];
+              sum_contribs_r += (SUMS_TYPE)pix_value.r * weight;
+              sum_contribs_g += (SUMS_TYPE)pix_value.g * weight;
+              sum_contribs_b += (SUMS_TYPE)pix_value.b * weight;
+              sum_contribs_m += (SUMS_TYPE)pix_value.m * weight;
+              sum_weights += weight;
             }
 
-            notLessThan(0, pix_u);  // Copy-padding
-            notLessThan(0, pix_v);
-            notMoreThan(mu, pix_u);
-            notMoreThan(mv, pix_v);
-
-            pix_value = buffer_in[pix_u + pix_v * wrap_in];
-            sum_contribs_r += (SUMS_TYPE)pix_value.r * weight;
-            sum_contribs_g += (SUMS_TYPE)pix_value.g * weight;
-            sum_contribs_b += (SUMS_TYPE)pix_value.b * weight;
-            sum_contribs_m += (SUMS_TYPE)pix_value.m * weight;
-            sum_weights += weight;
+            inv_sum_weights = 1.0 / sum_weights;
+            out_fval_r      = sum_contribs_r * inv_sum_weights;
+            out_fval_g      = sum_contribs_g * inv_sum_weights;
+            out_fval_b      = sum_contribs_b * inv_sum_weights;
+            out_fval_m      = sum_contribs_m * inv_sum_weights;
+            notLessThan(0.0, out_fval_r);
+            notLessThan(0.0, out_fval_g);
+            notLessThan(0.0, out_fval_b);
+            notLessThan(0.0, out_fval_m);
+            out_value_r = troundp(out_fval_r);
+            out_value_g = troundp(out_fval_g);
+            out_value_b = troundp(out_fval_b);
+            out_value_m = troundp(out_fval_m);
+            notMoreThan(T::maxChannelValue, out_value_r);
+            notMoreThan(T::maxChannelValue, out_value_g);
+            notMoreThan(T::maxChannelValue, out_value_b);
+            notMoreThan(T::maxChannelValue, out_value_m);
+            pix_out->r = out_value_r;
+            pix_out->g = out_value_g;
+            pix_out->b = out_value_b;
+            pix_out->m = out_value_m;
+          } else
+            // The pixel is copied from the corresponding source...
+            *pix_out = buffer_in[ref_u + ref_v * wrap_in];
+        } else if (outside_min_u <= ref_u && ref_u <= outside_max_u &&
+                   outside_min_v <= ref_v && ref_v <= outside_max_v) {
+          if ((UINT)ref_u >= (UINT)lu || (UINT)ref_v >= (UINT)lv)
+            must_calc = true;
+          else {
+            calc_value = calc[(ref_u >> 3) + ref_v * calc_bytewrap];
+            must_calc  = calc_value && ((calc_value >> (ref_u & 7)) & 1);
           }
 
-          inv_sum_weights = 1.0 / sum_weights;
-          out_fval_r      = sum_contribs_r * inv_sum_weights;
-          out_fval_g      = sum_contribs_g * inv_sum_weights;
-          out_fval_b      = sum_contribs_b * inv_sum_weights;
-          out_fval_m      = sum_contribs_m * inv_sum_weights;
-          notLessThan(0.0, out_fval_r);
-          notLessThan(0.0, out_fval_g);
-          notLessThan(0.0, out_fval_b);
-          notLessThan(0.0, out_fval_m);
-          out_value_r = troundp(out_fval_r);
-          out_value_g = troundp(out_fval_g);
-          out_value_b = troundp(out_fval_b);
-          out_value_m = troundp(out_fval_m);
-          notMoreThan(T::maxChannelValue, out_value_r);
-          notMoreThan(T::maxChannelValue, out_value_g);
-          notMoreThan(T::maxChannelValue, out_value_b);
-          notMoreThan(T::maxChannelValue, out_value_m);
-          pix_out->r = out_value_r;
-          pix_out->g = out_value_g;
-          pix_out->b = out_value_b;
-          pix_out->m = out_value_m;
+          if (must_calc) {
+            ref_out_u_     = ref_u - out_u_;
+            ref_out_v_     = ref_v - out_v_;
+            ref_out_f_     = aff0MV1(aff0_uv2fg, ref_out_u_, ref_out_v_);
+            ref_out_g_     = aff0MV2(aff0_uv2fg, ref_out_u_, ref_out_v_);
+            ref_out_f      = tround(ref_out_f_);
+            ref_out_g      = tround(ref_out_g_);
+            sum_weights    = 0;
+            sum_contribs_r = 0;
+            sum_contribs_g = 0;
+            sum_contribs_b = 0;
+            sum_contribs_m = 0;
+
+            for (i = n_pix - 1; i >= 0; --i) {
+              pix_out_f = pix_ref_f[i] + ref_out_f;
+              pix_out_g = pix_ref_g[i] + ref_out_g;
+              weight    = (filter[pix_out_f] * filter[pix_out_g]) >> 16;
+              pix_u     = pix_ref_u[i] + ref_u;
+              pix_v     = pix_ref_v[i] + ref_v;
+
+              if (pix_u < 0 || pix_u > mu || pix_v < 0 || pix_v > mv) {
+                sum_weights += weight;  // 0-padding
+                continue;
+              }
+
+              notLessThan(0, pix_u);  // Copy-padding
+              notLessThan(0, pix_v);
+              notMoreThan(mu, pix_u);
+              notMoreThan(mv, pix_v);
+
+              pix_value = buffer_in[pix_u + pix_v * wrap_in];
+              sum_contribs_r += (SUMS_TYPE)pix_value.r * weight;
+              sum_contribs_g += (SUMS_TYPE)pix_value.g * weight;
+              sum_contribs_b += (SUMS_TYPE)pix_value.b * weight;
+              sum_contribs_m += (SUMS_TYPE)pix_value.m * weight;
+              sum_weights += weight;
+            }
+
+            inv_sum_weights = 1.0 / sum_weights;
+            out_fval_r      = sum_contribs_r * inv_sum_weights;
+            out_fval_g      = sum_contribs_g * inv_sum_weights;
+            out_fval_b      = sum_contribs_b * inv_sum_weights;
+            out_fval_m      = sum_contribs_m * inv_sum_weights;
+            notLessThan(0.0, out_fval_r);
+            notLessThan(0.0, out_fval_g);
+            notLessThan(0.0, out_fval_b);
+            notLessThan(0.0, out_fval_m);
+            out_value_r = troundp(out_fval_r);
+            out_value_g = troundp(out_fval_g);
+            out_value_b = troundp(out_fval_b);
+            out_value_m = troundp(out_fval_m);
+            notMoreThan(T::maxChannelValue, out_value_r);
+            notMoreThan(T::maxChannelValue, out_value_g);
+            notMoreThan(T::maxChannelValue, out_value_b);
+            notMoreThan(T::maxChannelValue, out_value_m);
+            pix_out->r = out_value_r;
+            pix_out->g = out_value_g;
+            pix_out->b = out_value_b;
+            pix_out->m = out_value_m;
+          } else
+            *pix_out = buffer_in[ref_u + ref_v * wrap_in];
         } else
-          *pix_out = buffer_in[ref_u + ref_v * wrap_in];
-      } else
-        *pix_out = default_value;
+          *pix_out = default_value;
+      }
     }
-  }
+  });
 
   delete[] calc;
+
+  // A failed band left its rows unwritten
+  if (!done) throw TRopException("resample failed");
 }
 
 //---------------------------------------------------------------------------
@@ -1382,15 +1392,6 @@ void resample_main_rgbm_SSE2(TRasterPT<T> rout, const TRasterPT<T> &rin,
   T *buffer_out;
   int lu, lv, wrap_in, mu, mv;
   int lx, ly, wrap_out;
-  int out_x, out_y;
-  double out_x_, out_y_;
-  double out_u_, out_v_;
-  int ref_u, ref_v;
-  int pix_u, pix_v;
-  double ref_out_u_, ref_out_v_;
-  double ref_out_f_, ref_out_g_;
-  int ref_out_f, ref_out_g;
-  int pix_out_f, pix_out_g;
   int filter_mu, filter_mv;
   UINT inside_limit_u, inside_limit_v;
   int inside_nonempty;
@@ -1401,26 +1402,7 @@ void resample_main_rgbm_SSE2(TRasterPT<T> rout, const TRasterPT<T> &rin,
   UCHAR *calc;
   int calc_allocsize;
   int calc_bytewrap;
-  UCHAR calc_value;
-  bool must_calc;
-  T pix_value;
   T default_value(0, 0, 0, 0);
-  float weight;
-  float sum_weights;
-  float inv_sum_weights;
-  int i;
-
-#ifdef USE_DOUBLE_TO_INT
-  double d2iaux;
-#endif
-
-  T *pix_out;
-
-  __m128 sum_contribs_packed;
-
-  __m128i pix_value_packed_i;
-  __m128 pix_value_packed;
-  __m128 weight_packed;
 
   __m128 zeros2 = _mm_setzero_ps();
 
@@ -1458,137 +1440,175 @@ void resample_main_rgbm_SSE2(TRasterPT<T> rout, const TRasterPT<T> &rin,
   outside_max_u   = mu - min_pix_ref_u;
   outside_max_v   = mv - min_pix_ref_v;
 
-  for (out_y = 0, out_y_ = 0.5; out_y < ly; out_y++, out_y_ += 1.0) {
-    for (out_x = 0, out_x_ = 0.5; out_x < lx; out_x++, out_x_ += 1.0) {
-      pix_out = buffer_out + out_y * wrap_out + out_x;
+  // Rows are independent, so they are computed on parallel bands
+  bool done = TThread::forEachBand(ly, 16, [&](int y0, int y1) {
+    int out_x, out_y;
+    double out_x_, out_y_;
+    double out_u_, out_v_;
+    int ref_u, ref_v;
+    int pix_u, pix_v;
+    double ref_out_u_, ref_out_v_;
+    double ref_out_f_, ref_out_g_;
+    int ref_out_f, ref_out_g;
+    int pix_out_f, pix_out_g;
+    UCHAR calc_value;
+    bool must_calc;
+    T pix_value;
+    float weight;
+    float sum_weights;
+    float inv_sum_weights;
+    int i;
 
-      out_u_ = affMV1(aff_xy2uv, out_x_, out_y_);
-      out_v_ = affMV2(aff_xy2uv, out_x_, out_y_);
-      ref_u  = intLE(out_u_);
-      ref_v  = intLE(out_v_);
+#ifdef USE_DOUBLE_TO_INT
+    double d2iaux;
+#endif
 
-      if (inside_nonempty && (UINT)(ref_u + min_pix_ref_u) < inside_limit_u &&
-          (UINT)(ref_v + min_pix_ref_v) < inside_limit_v) {
-        calc_value = calc[(ref_u >> 3) + ref_v * calc_bytewrap];
+    T *pix_out;
 
-        if (calc_value && ((calc_value >> (ref_u & 7)) & 1)) {
-          ref_out_u_  = ref_u - out_u_;
-          ref_out_v_  = ref_v - out_v_;
-          ref_out_f_  = aff0MV1(aff0_uv2fg, ref_out_u_, ref_out_v_);
-          ref_out_g_  = aff0MV2(aff0_uv2fg, ref_out_u_, ref_out_v_);
-          ref_out_f   = tround(ref_out_f_);
-          ref_out_g   = tround(ref_out_g_);
-          sum_weights = 0;
+    __m128 sum_contribs_packed;
 
-          sum_contribs_packed = _mm_setzero_ps();
+    __m128i pix_value_packed_i;
+    __m128 pix_value_packed;
+    __m128 weight_packed;
 
-          for (i = n_pix - 1; i >= 0; i--) {
-            pix_out_f = pix_ref_f[i] + ref_out_f;
-            pix_out_g = pix_ref_g[i] + ref_out_g;
-            weight    = (float)((filter[pix_out_f] * filter[pix_out_g]) >> 16);
-            pix_u     = pix_ref_u[i] + ref_u;
-            pix_v     = pix_ref_v[i] + ref_v;
+    for (out_y = y0, out_y_ = y0 + 0.5; out_y < y1; out_y++, out_y_ += 1.0) {
+      for (out_x = 0, out_x_ = 0.5; out_x < lx; out_x++, out_x_ += 1.0) {
+        pix_out = buffer_out + out_y * wrap_out + out_x;
 
-            pix_value          = buffer_in[pix_u + pix_v * wrap_in];
-            pix_value_packed_i = _mm_unpacklo_epi8(
-                _mm_cvtsi32_si128(*(DWORD *)&pix_value), zeros);
-            pix_value_packed =
-                _mm_cvtepi32_ps(_mm_unpacklo_epi16(pix_value_packed_i, zeros));
-
-            weight_packed = _mm_load1_ps(&weight);
-            sum_contribs_packed =
-                _mm_add_ps(sum_contribs_packed,
-                           _mm_mul_ps(pix_value_packed, weight_packed));
+        out_u_ = affMV1(aff_xy2uv, out_x_, out_y_);
+        out_v_ = affMV2(aff_xy2uv, out_x_, out_y_);
+        ref_u  = intLE(out_u_);
+        ref_v  = intLE(out_v_);
 
-            sum_weights += weight;
-          }
-
-          inv_sum_weights               = 1.0f / sum_weights;
-          __m128 inv_sum_weights_packed = _mm_load1_ps(&inv_sum_weights);
-
-          __m128 out_fval_packed =
-              _mm_mul_ps(sum_contribs_packed, inv_sum_weights_packed);
-          out_fval_packed = _mm_max_ps(out_fval_packed, zeros2);
-          out_fval_packed = _mm_min_ps(out_fval_packed, maxChanneValue_packed);
-
-          __m128i out_value_packed_i = _mm_cvtps_epi32(out_fval_packed);
-          out_value_packed_i  = _mm_packs_epi32(out_value_packed_i, zeros);
-          out_value_packed_i  = _mm_packus_epi16(out_value_packed_i, zeros);
-          *(DWORD *)(pix_out) = _mm_cvtsi128_si32(out_value_packed_i);
-        } else
-          *pix_out = buffer_in[ref_u + ref_v * wrap_in];
-      } else
-          // if( outside_min_u_ <= out_u_ && out_u_ <= outside_max_u_ &&
-          //    outside_min_v_ <= out_v_ && out_v_ <= outside_max_v_ )
-          if (outside_min_u <= ref_u && ref_u <= outside_max_u &&
-              outside_min_v <= ref_v && ref_v <= outside_max_v) {
-        if ((UINT)ref_u >= (UINT)lu || (UINT)ref_v >= (UINT)lv)
-          must_calc = true;
-        else {
+        if (inside_nonempty && (UINT)(ref_u + min_pix_ref_u) < inside_limit_u &&
+            (UINT)(ref_v + min_pix_ref_v) < inside_limit_v) {
           calc_value = calc[(ref_u >> 3) + ref_v * calc_bytewrap];
-          must_calc  = calc_value && ((calc_value >> (ref_u & 7)) & 1);
-        }
 
-        if (must_calc) {
-          ref_out_u_          = ref_u - out_u_;
-          ref_out_v_          = ref_v - out_v_;
-          ref_out_f_          = aff0MV1(aff0_uv2fg, ref_out_u_, ref_out_v_);
-          ref_out_g_          = aff0MV2(aff0_uv2fg, ref_out_u_, ref_out_v_);
-          ref_out_f           = tround(ref_out_f_);
-          ref_out_g           = tround(ref_out_g_);
-          sum_weights         = 0;
-          sum_contribs_packed = _mm_setzero_ps();
+          if (calc_value && ((calc_value >> (ref_u & 7)) & 1)) {
+            ref_out_u_  = ref_u - out_u_;
+            ref_out_v_  = ref_v - out_v_;
+            ref_out_f_  = aff0MV1(aff0_uv2fg, ref_out_u_, ref_out_v_);
+            ref_out_g_  = aff0MV2(aff0_uv2fg, ref_out_u_, ref_out_v_);
+            ref_out_f   = tround(ref_out_f_);
+            ref_out_g   = tround(ref_out_g_);
+            sum_weights = 0;
+
+            sum_contribs_packed = _mm_setzero_ps();
+
+            for (i = n_pix - 1; i >= 0; i--) {
+              pix_out_f = pix_ref_f[i] + ref_out_f;
+              pix_out_g = pix_ref_g[i] + ref_out_g;
+              weight =
+                  (float)((filter[pix_out_f] * filter[pix_out_g]) >> 16);
+              pix_u     = pix_ref_u[i] + ref_u;
+              pix_v     = pix_ref_v[i] + ref_v;
+
+              pix_value          = buffer_in[pix_u + pix_v * wrap_in];
+              pix_value_packed_i = _mm_unpacklo_epi8(
+                  _mm_cvtsi32_si128(*(DWORD *)&pix_value), zeros);
+              pix_value_packed = _mm_cvtepi32_ps(
+                  _mm_unpacklo_epi16(pix_value_packed_i, zeros));
+
+              weight_packed = _mm_load1_ps(&weight);
+              sum_contribs_packed =
+                  _mm_add_ps(sum_contribs_packed,
+                             _mm_mul_ps(pix_value_packed, weight_packed));
 
-          for (i = n_pix - 1; i >= 0; i--) {
-            pix_out_f = pix_ref_f[i] + ref_out_f;
-            pix_out_g = pix_ref_g[i] + ref_out_g;
-            weight    = (float)((filter[pix_out_f] * filter[pix_out_g]) >> 16);
-            pix_u     = pix_ref_u[i] + ref_u;
-            pix_v     = pix_ref_v[i] + ref_v;
-
-            if (pix_u < 0 || pix_u > mu || pix_v < 0 || pix_v > mv) {
               sum_weights += weight;
-              continue;
             }
 
-            notLessThan(0, pix_u);
-            notLessThan(0, pix_v);
-            notMoreThan(mu, pix_u);
-            notMoreThan(mv, pix_v);
-
-            pix_value          = buffer_in[pix_u + pix_v * wrap_in];
-            pix_value_packed_i = _mm_unpacklo_epi8(
-                _mm_cvtsi32_si128(*(DWORD *)&pix_value), zeros);
-            pix_value_packed =
-                _mm_cvtepi32_ps(_mm_unpacklo_epi16(pix_value_packed_i, zeros));
+            inv_sum_weights               = 1.0f / sum_weights;
+            __m128 inv_sum_weights_packed = _mm_load1_ps(&inv_sum_weights);
 
-            weight_packed = _mm_load1_ps(&weight);
-            sum_contribs_packed =
-                _mm_add_ps(sum_contribs_packed,
-                           _mm_mul_ps(pix_value_packed, weight_packed));
+            __m128 out_fval_packed =
+                _mm_mul_ps(sum_contribs_packed, inv_sum_weights_packed);
+            out_fval_packed = _mm_max_ps(out_fval_packed, zeros2);
+            out_fval_packed =
+                _mm_min_ps(out_fval_packed, maxChanneValue_packed);
 
-            sum_weights += weight;
+            __m128i out_value_packed_i = _mm_cvtps_epi32(out_fval_packed);
+            out_value_packed_i  = _mm_packs_epi32(out_value_packed_i, zeros);
+            out_value_packed_i  = _mm_packus_epi16(out_value_packed_i, zeros);
+            *(DWORD *)(pix_out) = _mm_cvtsi128_si32(out_value_packed_i);
+          } else
+            *pix_out = buffer_in[ref_u + ref_v * wrap_in];
+        } else
+            // if( outside_min_u_ <= out_u_ && out_u_ <= outside_max_u_ &&
+            //    outside_min_v_ <= out_v_ && out_v_ <= outside_max_v_ )
+            if (outside_min_u <= ref_u && ref_u <= outside_max_u &&
+                outside_min_v <= ref_v && ref_v <= outside_max_v) {
+          if ((UINT)ref_u >= (UINT)lu || (UINT)ref_v >= (UINT)lv)
+            must_calc = true;
+          else {
+            calc_value = calc[(ref_u >> 3) + ref_v * calc_bytewrap];
+            must_calc  = calc_value && ((calc_value >> (ref_u & 7)) & 1);
           }
-          inv_sum_weights = 1.0f / sum_weights;
 
-          __m128 inv_sum_weights_packed = _mm_load1_ps(&inv_sum_weights);
-          __m128 out_fval_packed =
-              _mm_mul_ps(sum_contribs_packed, inv_sum_weights_packed);
-          out_fval_packed = _mm_max_ps(out_fval_packed, zeros2);
-          out_fval_packed = _mm_min_ps(out_fval_packed, maxChanneValue_packed);
+          if (must_calc) {
+            ref_out_u_          = ref_u - out_u_;
+            ref_out_v_          = ref_v - out_v_;
+            ref_out_f_          = aff0MV1(aff0_uv2fg, ref_out_u_, ref_out_v_);
+            ref_out_g_          = aff0MV2(aff0_uv2fg, ref_out_u_, ref_out_v_);
+            ref_out_f           = tround(ref_out_f_);
+            ref_out_g           = tround(ref_out_g_);
+            sum_weights         = 0;
+            sum_contribs_packed = _mm_setzero_ps();
+
+            for (i = n_pix - 1; i >= 0; i--) {
+              pix_out_f = pix_ref_f[i] + ref_out_f;
+              pix_out_g = pix_ref_g[i] + ref_out_g;
+              weight =
+                  (float)((filter[pix_out_f] * filter[pix_out_g]) >> 16);
+              pix_u     = pix_ref_u[i] + ref_u;
+              pix_v     = pix_ref_v[i] + ref_v;
+
+              if (pix_u < 0 || pix_u > mu || pix_v < 0 || pix_v > mv) {
+                sum_weights += weight;
+                continue;
+              }
+
+              notLessThan(0, pix_u);
+              notLessThan(0, pix_v);
+              notMoreThan(mu, pix_u);
+              notMoreThan(mv, pix_v);
+
+              pix_value          = buffer_in[pix_u + pix_v * wrap_in];
+              pix_value_packed_i = _mm_unpacklo_epi8(
+                  _mm_cvtsi32_si128(*(DWORD *)&pix_value), zeros);
+              pix_value_packed = _mm_cvtepi32_ps(
+                  _mm_unpacklo_epi16(pix_value_packed_i, zeros));
+
+              weight_packed = _mm_load1_ps(&weight);
+              sum_contribs_packed =
+                  _mm_add_ps(sum_contribs_packed,
+                             _mm_mul_ps(pix_value_packed, weight_packed));
 
-          __m128i out_value_packed_i = _mm_cvtps_epi32(out_fval_packed);
-          out_value_packed_i  = _mm_packs_epi32(out_value_packed_i, zeros);
-          out_value_packed_i  = _mm_packus_epi16(out_value_packed_i, zeros);
-          *(DWORD *)(pix_out) = _mm_cvtsi128_si32(out_value_packed_i);
-        } else
-          *pix_out = buffer_in[ref_u + ref_v * wrap_in];
-      } else {
-        *pix_out = default_value;
+              sum_weights += weight;
+            }
+            inv_sum_weights = 1.0f / sum_weights;
+
+            __m128 inv_sum_weights_packed = _mm_load1_ps(&inv_sum_weights);
+            __m128 out_fval_packed =
+                _mm_mul_ps(sum_contribs_packed, inv_sum_weights_packed);
+            out_fval_packed = _mm_max_ps(out_fval_packed, zeros2);
+            out_fval_packed =
+                _mm_min_ps(out_fval_packed, maxChanneValue_packed);
+
+            __m128i out_value_packed_i = _mm_cvtps_epi32(out_fval_packed);
+            out_value_packed_i  = _mm_packs_epi32(out_value_packed_i, zeros);
+            out_value_packed_i  = _mm_packus_epi16(out_value_packed_i, zeros);
+            *(DWORD *)(pix_out) = _mm_cvtsi128_si32(out_value_packed_i);
+          } else
+            *pix_out = buffer_in[ref_u + ref_v * wrap_in];
+        } else {
+          *pix_out = default_value;
+        }
       }
     }
-  }
+  });
   if (calc) delete[] calc;
+
+  if (!done) throw TRopException("resample failed");
 }
 
 namespace {
@@ -13,8 +13,12 @@
 #include "lz4frame.h"
 #endif
 
+#include <QByteArray>
+
 #include <sstream>
 #include <memory>
+#include <algorithm>
+#include <climits>
 
 using namespace std;
 
@@ -598,10 +602,14 @@ std::string TOStream::getCurrentTagName() {
 */
 class TIStream::Imp {
 public:
-  istream *m_is;
-  bool m_chanOwner;
-  int m_line;
+  //! The whole document, loaded (and decompressed) at construction. Parsing
+  //! scans it in place instead of going through per-character stream calls.
   string m_strbuffer;
+  const char *m_pos, *m_end;
+  //! Same meaning as the corresponding std::istream state bits
+  bool m_eof, m_fail;
+
+  int m_line;
   bool m_compressed;
 
   vector<std::string> m_tagStack;
@@ -616,12 +624,26 @@ public:
   VersionNumber m_versionNumber;
 
   Imp()
-      : m_is(0)
-      , m_chanOwner(false)
+      : m_pos(0)
+      , m_end(0)
+      , m_eof(false)
+      , m_fail(true)
       , m_line(0)
       , m_compressed(false)
       , m_versionNumber(0, 0) {}
 
+  void setBuffer(size_t size) {
+    m_pos  = m_strbuffer.data();
+    m_end  = m_pos + size;
+    m_fail = false;
+  }
+
+  bool good() const { return !(m_eof || m_fail); }
+
+  // std::istream::peek() and get() counterparts
+  inline int peek();
+  inline bool get(char &c);
+
   // update m_line if necessary; returns -e if eof
   int getNextChar();
 
@@ -631,6 +653,10 @@ public:
   bool matchIdent(string &ident);
   bool matchValue(string &value);
 
+  bool readInt(int &v);
+  bool readDouble(double &v);
+  void readString(string &v);
+
   void skipCurrentTag();
 };
 
@@ -647,26 +673,53 @@ TFilePath TIStream::getRepositoryPath() {
 
 //---------------------------------------------------------------
 
+int TIStream::Imp::peek() {
+  if (!good()) {
+    m_fail = true;
+    return -1;
+  }
+  if (m_pos == m_end) {
+    m_eof = true;
+    return -1;
+  }
+  return (unsigned char)*m_pos;
+}
+
+//---------------------------------------------------------------
+
+bool TIStream::Imp::get(char &c) {
+  if (!good() || m_pos == m_end) {
+    if (m_pos == m_end) m_eof = true;
+    m_fail = true;
+    return false;
+  }
+  c = *m_pos++;
+  return true;
+}
+
+//---------------------------------------------------------------
+
 int TIStream::Imp::getNextChar() {
   char c;
-  m_is->get(c);
-  if (m_is->eof()) return -1;
+  if (!get(c)) return -1;
   if (c == '\r') m_line++;
-  return c;
+  return (unsigned char)c;
 }
 
 //---------------------------------------------------------------
 
 void TIStream::Imp::skipBlanks() {
-  istream &is = *m_is;
-  istream::int_type c;
-  while (c = is.peek(), (isspace(c) || c == '\r')) getNextChar();
+  if (good()) {
+    for (; m_pos != m_end && isspace((unsigned char)*m_pos); ++m_pos)
+      if (*m_pos == '\r') m_line++;
+  }
+  peek();  // updates the state bits at the end of the document
 }
 
 //---------------------------------------------------------------
 
 bool TIStream::Imp::match(char c) {
-  if (m_is->peek() == c) {
+  if (peek() == c) {
     getNextChar();
     return true;
   } else
@@ -676,46 +729,166 @@ bool TIStream::Imp::match(char c) {
 //---------------------------------------------------------------
 
 bool TIStream::Imp::matchIdent(string &ident) {
-  istream &is = *m_is;
-  if (!isalnum(is.peek())) return false;
-  ident = "";
-  char c;
-  is.get(c);
-  ident.append(1, c);
-  while (c = is.peek(), isalnum(c) || c == '_' || c == '.' || c == '-') {
-    is.get(c);
-    ident.append(1, c);
-  }
+  if (!isalnum(peek())) return false;
+  const char *begin = m_pos++;
+  while (m_pos != m_end &&
+         (isalnum((unsigned char)*m_pos) || *m_pos == '_' || *m_pos == '.' ||
+          *m_pos == '-'))
+    ++m_pos;
+  if (m_pos == m_end) m_eof = true;
+  ident.assign(begin, m_pos);
   return true;
 }
 
 //---------------------------------------------------------------
 
 bool TIStream::Imp::matchValue(string &str) {
-  istream &is = *m_is;
-  char quote  = is.peek();
-  char c;
-  if (!is || (quote != '\'' && quote != '\"')) return false;
-  is.get(c);
+  int quote = peek();
+  if (m_fail || (quote != '\'' && quote != '\"')) return false;
+  ++m_pos;
   str = "";
   for (;;) {
-    is.get(c);
-    if (!is) throw TException("expected '\"'");
-    if (c == quote) break;
-    if (c == '\\') {
-      is.get(c);
-      if (!is) throw TException("unexpected EOF");
-      if (c != '\'' && c != '\"' && c != '\\')
-        throw TException("bad escape sequence");
+    const char *begin = m_pos;
+    while (m_pos != m_end && *m_pos != quote && *m_pos != '\\') ++m_pos;
+    str.append(begin, m_pos);
+    if (m_pos == m_end) {
+      m_eof = m_fail = true;
+      throw TException("expected '\"'");
     }
+    if (*m_pos++ == quote) break;
+
+    // escape sequence
+    if (m_pos == m_end) {
+      m_eof = m_fail = true;
+      throw TException("unexpected EOF");
+    }
+    char c = *m_pos++;
+    if (c != '\'' && c != '\"' && c != '\\')
+      throw TException("bad escape sequence");
     str.append(1, c);
   }
-  if (c != quote) throw TException("missing '\"'");
   return true;
 }
 
 //---------------------------------------------------------------
 
+//! Reads an integer the way std::istream would, skipping leading blanks.
+bool TIStream::Imp::readInt(int &v) {
+  skipBlanks();
+  if (!good()) {
+    m_fail = true;
+    return false;
+  }
+
+  const char *p = m_pos;
+  bool negative = false;
+  if (*p == '+' || *p == '-') negative = (*p++ == '-');
+
+  const char *digits = p;
+  long long value    = 0;
+  for (; p != m_end && isdigit((unsigned char)*p); ++p)
+    if (value <= INT_MAX) value = value * 10 + (*p - '0');
+
+  m_pos = p;
+  if (p == m_end) m_eof = true;
+
+  if (p == digits) {
+    v      = 0;
+    m_fail = true;
+    return false;
+  }
+  if (negative) value = -value;
+  if (value > INT_MAX || value < INT_MIN) {
+    v      = (value > 0) ? INT_MAX : INT_MIN;
+    m_fail = true;
+    return false;
+  }
+  v = (int)value;
+  return true;
+}
+
+//---------------------------------------------------------------
+
+//! Reads a double the way std::istream would, skipping leading blanks. The
+//! conversion is locale-independent, like the stream's classic locale.
+bool TIStream::Imp::readDouble(double &v) {
+  skipBlanks();
+  if (!good()) {
+    m_fail = true;
+    return false;
+  }
+
+  const char *begin = m_pos, *p = m_pos;
+  if (*p == '+' || *p == '-') ++p;
+
+  const char *mantissa = p;
+  while (p != m_end && isdigit((unsigned char)*p)) ++p;
+  if (p != m_end && *p == '.')
+    for (++p; p != m_end && isdigit((unsigned char)*p);) ++p;
+  if (p != m_end && (*p == 'e' || *p == 'E') && p != mantissa) {
+    ++p;
+    if (p != m_end && (*p == '+' || *p == '-')) ++p;
+    while (p != m_end && isdigit((unsigned char)*p)) ++p;
+  }
+
+  m_pos = p;
+  if (p == m_end) m_eof = true;
+
+  bool ok;
+  v = QByteArray::fromRawData(begin, (int)(p - begin)).toDouble(&ok);
+  if (!ok) {
+    v      = 0;
+    m_fail = true;
+  }
+  return ok;
+}
+
+//---------------------------------------------------------------
+
+//! Reads either a quoted string, or a word made of alphanumeric characters
+//! and '_', '&', '#', ';', '%'.
+void TIStream::Imp::readString(string &v) {
+  v = "";
+  skipBlanks();
+  char c;
+  if (!get(c)) return;
+  if (c == '\"') {
+    for (;;) {
+      const char *begin = m_pos;
+      while (m_pos != m_end && *m_pos != '"' && *m_pos != '\\') ++m_pos;
+      v.append(begin, m_pos);
+      if (m_pos == m_end) {
+        m_eof = m_fail = true;
+        break;
+      }
+      if (*m_pos++ == '"') break;
+
+      // escape sequence
+      if (!get(c)) throw TException("unexpected EOF");
+      if (c == '"')
+        v.append(1, '"');
+      else if (c == '\\')
+        v.append(1, '\\');
+      else if (c == '\'')
+        v.append(1, '\'');
+      else {
+        v.append(1, '\\');
+        v.append(1, c);
+      }
+    }
+  } else {
+    const char *begin = m_pos - 1;
+    while (m_pos != m_end &&
+           (isalnum((unsigned char)*m_pos) || *m_pos == '_' || *m_pos == '&' ||
+            *m_pos == '#' || *m_pos == ';' || *m_pos == '%'))
+      ++m_pos;
+    if (m_pos == m_end) m_eof = true;
+    v.assign(begin, m_pos);
+  }
+}
+
+//---------------------------------------------------------------
+
 bool TIStream::Imp::matchTag() {
   if (m_currentTag) return true;
   StreamTag &tag = m_currentTag;
@@ -726,10 +899,9 @@ bool TIStream::Imp::matchTag() {
   if (match('!')) {
     skipBlanks();
     if (!match('-') || !match('-')) throw TException("expected '<!--' tag");
-    istream &is = *m_is;
     char c;
     int status = 1;
-    while (status != 0 && is.get(c)) switch (status) {
+    while (status != 0 && get(c)) switch (status) {
       case 1:
         if (c == '-') status = 2;
         break;
@@ -782,16 +954,15 @@ bool TIStream::Imp::matchTag() {
 
 void TIStream::Imp::skipCurrentTag() {
   if (m_currentTag.m_type == StreamTag::BeginEndTag) return;
-  istream &is = *m_is;
-  int level   = 1;
+  int level = 1;
   int c;
   for (;;) {
-    if (is.eof()) break;  // unexpected eof
-    c = is.peek();
-    if (c != '<') {
-      getNextChar();
-      continue;
-    }
+    if (!good()) break;  // unexpected eof
+
+    // skip to the next tag
+    const char *next = std::find(m_pos, m_end, '<');
+    m_line += std::count(m_pos, next, '\r');
+    m_pos = next;
 
     // tag found
     c = getNextChar();
@@ -829,27 +1000,26 @@ void TIStream::Imp::skipCurrentTag() {
 
 TIStream::TIStream(const TFilePath &fp) : m_imp(new Imp) {
   m_imp->m_filepath = fp;
-  m_imp->m_is       = new Tifstream(fp);
 
-  if (m_imp->m_is->peek() == 'T')  // non comincia con '<' dev'essere compresso
+  Tifstream is(fp);
+  if (!is) return;  // the stream state stays failed
+
+  if (is.peek() == 'T')  // non comincia con '<' dev'essere compresso
   {
     bool swapForEndianess = false;
 
-    unique_ptr<std::istream> is(m_imp->m_is);
-    m_imp->m_is = 0;
-
     char magicBuffer[4];
-    is->read(magicBuffer, 4);
+    is.read(magicBuffer, 4);
     string magic(magicBuffer, 4);
     size_t in_len, out_len;
 
     if (magic == "TNZC") {
       // Tab3.0 beta
-      is->read((char *)&out_len, sizeof out_len);
-      is->read((char *)&in_len, sizeof in_len);
+      is.read((char *)&out_len, sizeof out_len);
+      is.read((char *)&in_len, sizeof in_len);
     } else if (magic == "TABc") {
       TINT32 v;
-      is->read((char *)&v, sizeof v);
+      is.read((char *)&v, sizeof v);
       printf("magic = %08X\n", v);
 
       if (v == 0x0A0B0C0D)
@@ -861,9 +1031,9 @@ TIStream::TIStream(const TFilePath &fp) : m_imp(new Imp) {
         printf("UH OH!\n");
       }
 
-      is->read((char *)&v, sizeof v);
+      is.read((char *)&v, sizeof v);
       out_len = swapForEndianess ? swapTINT32(v) : v;
-      is->read((char *)&v, sizeof v);
+      is.read((char *)&v, sizeof v);
       in_len = swapForEndianess ? swapTINT32(v) : v;
     } else
       throw TException("Bad magic number");
@@ -879,7 +1049,7 @@ TIStream::TIStream(const TFilePath &fp) : m_imp(new Imp) {
     if (LZ4F_isError(err)) throw TException("Couldn't decompress file");
 
     char *in = (char *)malloc(in_len);
-    is->read((char *)in, in_len);
+    is.read((char *)in, in_len);
 
     m_imp->m_strbuffer.resize(out_len + 1000);  // per prudenza
     char *out = (char *)m_imp->m_strbuffer.c_str();
@@ -897,39 +1067,35 @@ TIStream::TIStream(const TFilePath &fp) : m_imp(new Imp) {
 
     if (check_len != out_len) throw TException("corrupted file");
 
-    m_imp->m_is = new istringstream(std::string(out, out_len));
+    // The decompressed document is parsed directly from the buffer
+    m_imp->setBuffer(out_len);
+  } else {
+    // Load the whole document at once
+    char block[1 << 16];
+    do {
+      is.read(block, sizeof block);
+      m_imp->m_strbuffer.append(block, is.gcount());
+    } while (is);
+
+    m_imp->setBuffer(m_imp->m_strbuffer.size());
   }
-
-  m_imp->m_chanOwner = true;
 }
 
 //---------------------------------------------------------------
 
-/*
-TIStream::TIStream(istream &is)
-         : m_imp(new Imp)
-{
-  m_imp->m_is = &is;
-}
-*/
-
-//---------------------------------------------------------------
-
-TIStream::~TIStream() {
-  if (m_imp->m_chanOwner) delete m_imp->m_is;
-}
+TIStream::~TIStream() {}
 
 //---------------------------------------------------------------
 
 TIStream &TIStream::operator>>(int &v) {
-  *(m_imp->m_is) >> v;
+  m_imp->readInt(v);
   return *this;
 }
 
 //---------------------------------------------------------------
 
 TIStream &TIStream::operator>>(double &v) {
-  *(m_imp->m_is) >> v;
+  m_imp->readDouble(v);
   return *this;
 }
 //---------------------------------------------------------------
@@ -944,94 +1110,30 @@ TIStream &TIStream::operator>>(std::wstring &v) {
 //---------------------------------------------------------------
 
 TIStream &TIStream::operator>>(string &v) {
-  istream &is = *(m_imp->m_is);
-  v           = "";
-  m_imp->skipBlanks();
-  char c;
-  is.get(c);
-  if (c == '\"') {
-    is.get(c);
-    while (is && c != '"') {
-      if (c == '\\') {
-        is.get(c);
-        if (!is) throw TException("unexpected EOF");
-        if (c == '"')
-          v.append(1, '"');
-        else if (c == '\\')
-          v.append(1, '\\');
-        else if (c == '\'')
-          v.append(1, '\'');
-        else {
-          v.append(1, '\\');
-          v.append(1, c);
-        }
-      } else
-        v.append(1, c);
-      is.get(c);
-    }
-  } else {
-    v.append(1, c);
-    while (c = is.peek(), isalnum(c) || c == '_' || c == '&' || c == '#' ||
-                              c == ';' || c == '%') {
-      is.get(c);
-      v.append(1, c);
-    }
-  }
-
+  m_imp->readString(v);
   return *this;
 }
 
 //---------------------------------------------------------------
 
 TIStream &TIStream::operator>>(QString &v) {
-  istream &is = *(m_imp->m_is);
-  v           = "";
-  m_imp->skipBlanks();
-  char c;
-  is.get(c);
-  if (c == '\"') {
-    is.get(c);
-    while (is && c != '"') {
-      if (c == '\\') {
-        is.get(c);
-        if (!is) throw TException("unexpected EOF");
-        if (c == '"')
-          v.append('"');
-        else if (c == '\\')
-          v.append('\\');
-        else if (c == '\'')
-          v.append('\'');
-        else {
-          v.append('\\');
-          v.append(c);
-        }
-      } else
-        v.append(c);
-      is.get(c);
-    }
-  } else {
-    v.append(c);
-    while (c = is.peek(), isalnum(c) || c == '_' || c == '&' || c == '#' ||
-                              c == ';' || c == '%') {
-      is.get(c);
-      v.append(c);
-    }
-  }
-
+  // characters are taken one by one, as Latin-1
+  string s;
+  m_imp->readString(s);
+  v = QString::fromLatin1(s.data(), (int)s.size());
   return *this;
 }
 
 //---------------------------------------------------------------
 
 string TIStream::getString() {
-  istream &is = *(m_imp->m_is);
-  string v    = "";
+  string v = "";
   m_imp->skipBlanks();
-  char c = is.peek();
+  char c = m_imp->peek();
   while (c != '<') {
-    is.get(c);
-    c = is.peek();
-    if (!is) throw TException("unexpected EOF");
+    m_imp->get(c);
+    c = m_imp->peek();
+    if (m_imp->m_fail) throw TException("unexpected EOF");
     v.append(1, c);
   }
   return v;
@@ -1040,12 +1142,11 @@ string TIStream::getString() {
 //---------------------------------------------------------------
 
 TIStream &TIStream::operator>>(TPixel32 &v) {
-  istream &is = *(m_imp->m_is);
   int r, g, b, m;
-  is >> r;
-  is >> g;
-  is >> b;
-  is >> m;
+  m_imp->readInt(r);
+  m_imp->readInt(g);
+  m_imp->readInt(b);
+  m_imp->readInt(m);
   v.r = r;
   v.g = g;
   v.b = b;
@@ -1055,12 +1156,11 @@ TIStream &TIStream::operator>>(TPixel32 &v) {
 //---------------------------------------------------------------
 
 TIStream &TIStream::operator>>(TPixel64 &v) {
-  istream &is = *(m_imp->m_is);
   int r, g, b, m;
-  is >> r;
-  is >> g;
-  is >> b;
-  is >> m;
+  m_imp->readInt(r);
+  m_imp->readInt(g);
+  m_imp->readInt(b);
+  m_imp->readInt(m);
   v.r = r;
   v.g = g;
   v.b = b;
@@ -1071,35 +1171,36 @@ TIStream &TIStream::operator>>(TPixel64 &v) {
 //---------------------------------------------------------------
 
 TIStream &TIStream::operator>>(TFilePath &v) {
-  istream &is = *(m_imp->m_is);
+  Imp &imp = *m_imp;
   string s;
   char c;
-  m_imp->skipBlanks();
-  is.get(c);
+  imp.skipBlanks();
+  if (!imp.get(c)) {
+    v = TFilePath();
+    return *this;
+  }
   if (c == '"') {
-    is.get(c);
-    bool escapeChar = false;
+    const char *begin = imp.m_pos;
+    bool escapeChar   = false;
     // If processing double-quote ("), if it's escaped, keep reading.
-    while (is && (c != '"' || escapeChar)) {
-      // if(c=='\\')
-      //   is.get(c);
-      if (c == '\\' && !escapeChar)
-        escapeChar = true;
-      else
-        escapeChar = false;
-      s.append(1, c);
-      is.get(c);
-    }
+    for (; imp.m_pos != imp.m_end && (*imp.m_pos != '"' || escapeChar);
+         ++imp.m_pos)
+      escapeChar = (*imp.m_pos == '\\' && !escapeChar);
+    s.assign(begin, imp.m_pos);
+    if (imp.m_pos == imp.m_end)
+      imp.m_eof = imp.m_fail = true;
+    else
+      ++imp.m_pos;
   } else {
     // il filepath non e' fra virgolette:
     // puo' contenere solo caratteri alfanumerici, % e _
-    s.append(1, c);
-    while (is) {
-      c = is.peek();
-      if (!isalnum(c) && c != '%' && c != '_') break;
-      is.get(c);
-      s.append(1, c);
-    }
+    const char *begin = imp.m_pos - 1;
+    while (imp.m_pos != imp.m_end &&
+           (isalnum((unsigned char)*imp.m_pos) || *imp.m_pos == '%' ||
+            *imp.m_pos == '_'))
+      ++imp.m_pos;
+    if (imp.m_pos == imp.m_end) imp.m_eof = true;
+    s.assign(begin, imp.m_pos);
   }
 
   v = TFilePath(s);
@@ -1170,7 +1271,7 @@ bool TIStream::eos() {
   if (m_imp->matchTag())
     return m_imp->m_currentTag.m_type == StreamTag::EndTag;
   else
-    return !(*m_imp->m_is);
+    return m_imp->m_fail;
 }
 
 //---------------------------------------------------------------
@@ -1254,15 +1355,14 @@ void TIStream::closeChild() {
 
 bool TIStream::match(char c) const {
   m_imp->skipBlanks();
-  if (m_imp->m_is->peek() != c) return false;
-  m_imp->m_is->get(c);
-  if (c == '\r') m_imp->m_line++;
+  if (m_imp->peek() != c) return false;
+  m_imp->getNextChar();
   return true;
 }
 
 //---------------------------------------------------------------
 
-TIStream::operator bool() const { return (m_imp->m_is && *m_imp->m_is); }
+TIStream::operator bool() const { return !m_imp->m_fail; }
 
 //---------------------------------------------------------------
 
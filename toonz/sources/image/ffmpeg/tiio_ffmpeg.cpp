@@ -7,10 +7,16 @@
 #include <QDir>
 #include <QtGui/QImage>
 #include <QRegExp>
+#include <QThread>
+#include <QMutexLocker>
+#include <QWaitCondition>
 #include "toonz/preferences.h"
 #include "toonz/toonzfolders.h"
 #include "tmsgcore.h"
 
+#include <deque>
+#include <list>
+
 Ffmpeg::Ffmpeg() {
   m_ffmpegPath         = Preferences::instance()->getFfmpegPath();
   m_ffmpegTimeout      = Preferences::instance()->getFfmpegTimeout() * 1000;
@@ -495,4 +501,380 @@ void Ffmpeg::cleanUpFiles() {
 
 void Ffmpeg::disablePrecompute() {
   Preferences::instance()->setPrecompute(false);
-}
\ No newline at end of file
+}
+
+//===========================================================
+//
+//  FfmpegDecoder::Session
+//
+//===========================================================
+
+namespace {
+
+// Frames ahead of a session position that are decoded rather than sought
+const int maxSkippedFrames = 48;
+// Memory used by the frames each session decodes in advance
+const int readAheadBytes = 16 << 20;
+// Milliseconds without requests after which a session stops its process
+const int sessionIdleTimeout = 10000;
+// Milliseconds without new readers after which a decoder is released
+const qint64 decoderIdleTimeout = 60000;
+
+}  // namespace
+
+//-----------------------------------------------------------
+
+/*!
+  A session runs an ffmpeg process outputting raw frames from a given
+  position, and reads them on its own thread - the only one the process is
+  accessed from - into a small read-ahead buffer.
+*/
+class FfmpegDecoder::Session final : public QThread {
+  const FfmpegDecoder *m_decoder;
+
+  QMutex m_mutex;
+  QWaitCondition m_changed;
+
+  std::deque<TRasterImageP> m_frames;  //!< Decoded frames, not yet requested
+  int m_firstFrame;  //!< Index of m_frames.front(), -1 before the first seek
+  int m_nextFrame;   //!< Index of the next frame output by the process
+  int m_seekFrame;   //!< Position to restart the process from, -1 if none
+  int m_maxFrames;
+  bool m_ended, m_stop;
+
+  //! Serializes requests to the session
+  QMutex m_requestMutex;
+
+public:
+  unsigned int m_lastRequest;
+
+public:
+  Session(const FfmpegDecoder *decoder)
+      : m_decoder(decoder)
+      , m_firstFrame(-1)
+      , m_nextFrame(-1)
+      , m_seekFrame(-1)
+      , m_ended(false)
+      , m_stop(false)
+      , m_lastRequest(0) {
+    const ffmpegFileInfo &info = decoder->m_info;
+    m_maxFrames =
+        std::max(2, readAheadBytes / std::max(1, info.m_lx * info.m_ly * 4));
+  }
+
+  ~Session() {
+    {
+      QMutexLocker locker(&m_mutex);
+      m_stop = true;
+      m_changed.wakeAll();
+    }
+    wait();
+  }
+
+  //! Returns whether the frame can be reached without seeking
+  bool isNear(int frame) {
+    QMutexLocker locker(&m_mutex);
+    return m_firstFrame >= 0 && m_firstFrame <= frame &&
+           frame <= m_nextFrame + maxSkippedFrames;
+  }
+
+  TRasterImageP getFrame(int frame);
+
+protected:
+  void run() override;
+
+private:
+  bool isInterrupted() {
+    QMutexLocker locker(&m_mutex);
+    return m_stop || m_seekFrame >= 0;
+  }
+
+  bool startProcess(QProcess &process, int frame);
+  bool readFrame(QProcess &process, const TRaster32P &ras, bool &ended);
+
+  //! Drops the session position, so that the next request restarts the
+  //! process. Requires m_mutex.
+  void reset() {
+    m_frames.clear();
+    m_firstFrame = m_nextFrame = -1;
+    m_changed.wakeAll();
+  }
+};
+
+//-----------------------------------------------------------
+
+TRasterImageP FfmpegDecoder::Session::getFrame(int frame) {
+  QMutexLocker requestLocker(&m_requestMutex);
+  QMutexLocker locker(&m_mutex);
+
+  if (m_firstFrame < 0 || frame < m_firstFrame ||
+      frame > m_nextFrame + maxSkippedFrames) {
+    m_frames.clear();
+    m_firstFrame = m_nextFrame = m_seekFrame = frame;
+    m_ended                                  = false;
+    m_changed.wakeAll();
+  }
+
+  for (;;) {
+    // Frames before the requested one are not needed anymore
+    while (!m_frames.empty() && m_firstFrame < frame) {
+      m_frames.pop_front();
+      ++m_firstFrame;
+      m_changed.wakeAll();
+    }
+
+    if (!m_frames.empty()) {
+      TRasterImageP img = m_frames.front();
+      m_frames.pop_front();
+      ++m_firstFrame;
+      m_changed.wakeAll();
+      return img;
+    }
+
+    // The process ended, or failed and must be restarted on next request
+    if (m_ended || m_stop || m_firstFrame < 0) return TRasterImageP();
+
+    m_changed.wait(&m_mutex);
+  }
+}
+
+//-----------------------------------------------------------
+
+bool FfmpegDecoder::Session::startProcess(QProcess &process, int frame) {
+  const ffmpegFileInfo &info = m_decoder->m_info;
+
+  QStringList args;
+  args << "-v"
+       << "quiet"
+       << "-nostdin";
+  if (frame > 1 && info.m_frameRate > 0) {
+    // Seeks to the keyframe before the position, then decodes up to it
+    args << "-ss" << QString::number((frame - 1) / info.m_frameRate, 'f', 6);
+  }
+  args << "-i" << m_decoder->m_path.getQString();
+  args << "-an";
+  if (info.m_frameRate > 0)
+    args << "-r" << QString::number(info.m_frameRate, 'g', 10);
+  args << "-s" << QString("%1x%2").arg(info.m_lx).arg(info.m_ly);
+  args << "-f"
+       << "rawvideo"
+       << "-pix_fmt"
+       << "bgra"
+       << "-";
+
+  // Unread diagnostics would eventually stall the process
+  process.setStandardErrorFile(QProcess::nullDevice());
+  process.start(m_decoder->m_ffmpegPath + "/ffmpeg", args);
+
+  return process.waitForStarted(m_decoder->m_ffmpegTimeout);
+}
+
+//-----------------------------------------------------------
+
+bool FfmpegDecoder::Session::readFrame(QProcess &process,
+                                       const TRaster32P &ras, bool &ended) {
+  ras->lock();
+  char *buffer = (char *)ras->getRawData();
+  qint64 size  = (qint64)ras->getLx() * ras->getLy() * 4, read = 0;
+
+  const int waitSlice = 100;
+  int waited          = 0;
+  while (read < size) {
+    qint64 count = process.read(buffer + read, size - read);
+    if (count < 0) break;
+    if (count > 0) {
+      read += count, waited = 0;
+      continue;
+    }
+
+    // Wait in slices, so that seeks and stops are not delayed
+    if (isInterrupted() || waited >= m_decoder->m_ffmpegTimeout) break;
+    if (!process.waitForReadyRead(waitSlice)) {
+      if (process.state() == QProcess::NotRunning &&
+          process.bytesAvailable() == 0)
+        break;
+      waited += waitSlice;
+    }
+  }
+  ras->unlock();
+
+  // Only a clean exit at a frame boundary is the end of the movie; timeouts
+  // and crashes are failures
+  ended = read == 0 && process.state() == QProcess::NotRunning &&
+          process.bytesAvailable() == 0 &&
+          process.exitStatus() == QProcess::NormalExit &&
+          process.exitCode() == 0;
+
+  return read == size;
+}
+
+//-----------------------------------------------------------
+
+void FfmpegDecoder::Session::run() {
+  const ffmpegFileInfo &info = m_decoder->m_info;
+  QProcess process;
+
+  for (;;) {
+    int startFrame;
+    {
+      QMutexLocker locker(&m_mutex);
+      while (m_seekFrame < 0 && !m_stop) m_changed.wait(&m_mutex);
+      if (m_stop) break;
+
+      startFrame  = m_seekFrame;
+      m_seekFrame = -1;
+    }
+
+    if (!startProcess(process, startFrame)) {
+      QMutexLocker locker(&m_mutex);
+      if (m_seekFrame < 0 && !m_stop) reset();
+      continue;
+    }
+
+    for (;;) {
+      {
+        QMutexLocker locker(&m_mutex);
+        bool idle = false;
+        while ((int)m_frames.size() >= m_maxFrames && m_seekFrame < 0 &&
+               !m_stop)
+          if (!m_changed.wait(&m_mutex, sessionIdleTimeout)) {
+            idle = true;
+            break;
+          }
+        if (m_seekFrame >= 0 || m_stop) break;
+        if (idle) {
+          // Nobody is reading: release the process and its buffered frames
+          reset();
+          break;
+        }
+      }
+
+      TRaster32P ras(info.m_lx, info.m_ly);
+      bool ended = false, ok = readFrame(process, ras, ended);
+
+      QMutexLocker locker(&m_mutex);
+      if (m_seekFrame >= 0 || m_stop) break;  // the frame is not wanted
+      if (!ok) {
+        if (ended) {
+          m_ended = true;
+          m_changed.wakeAll();
+        } else
+          reset();
+        break;
+      }
+
+      ras->yMirror();
+      m_frames.push_back(TRasterImageP(ras));
+      ++m_nextFrame;
+      m_changed.wakeAll();
+    }
+
+    process.kill();
+    process.waitForFinished();
+  }
+}
+
+//===========================================================
+//
+//  FfmpegDecoder
+//
+//===========================================================
+
+FfmpegDecoder::FfmpegDecoder(const TFilePath &path, const ffmpegFileInfo &info)
+    : m_path(path), m_info(info), m_requestsCount(0) {
+  m_ffmpegPath    = Preferences::instance()->getFfmpegPath();
+  m_ffmpegTimeout = Preferences::instance()->getFfmpegTimeout() * 1000;
+
+  // ffmpeg decoders are multithreaded on their own
+  m_maxSessionsCount =
+      std::min(4, std::max(1, QThread::idealThreadCount() / 2));
+}
+
+//-----------------------------------------------------------
+
+FfmpegDecoder::~FfmpegDecoder() {
+  for (Session *session : m_sessions) delete session;
+}
+
+//-----------------------------------------------------------
+
+std::shared_ptr<FfmpegDecoder> FfmpegDecoder::instance(
+    const TFilePath &path, const ffmpegFileInfo &info) {
+  struct Entry {
+    TFilePath m_path;
+    QDateTime m_modified;
+    std::shared_ptr<FfmpegDecoder> m_decoder;
+    qint64 m_lastUse;
+  };
+
+  // Most recently used first. Never destroyed, as the sessions' threads
+  // must not be joined during static destruction.
+  static QMutex mutex;
+  static std::list<Entry> &decoders = *new std::list<Entry>;
+  static const int maxDecodersCount = 4;
+
+  QDateTime modified = TFileStatus(path).getLastModificationTime();
+  qint64 now         = QDateTime::currentMSecsSinceEpoch();
+
+  QMutexLocker locker(&mutex);
+
+  // Release the decoders no reader asked for lately; readers still holding
+  // them keep them alive
+  while (!decoders.empty() &&
+         now - decoders.back().m_lastUse > decoderIdleTimeout)
+    decoders.pop_back();
+
+  std::list<Entry>::iterator it;
+  for (it = decoders.begin(); it != decoders.end(); ++it)
+    if (it->m_path == path) break;
+
+  if (it != decoders.end() && it->m_modified == modified) {
+    it->m_lastUse = now;
+    decoders.splice(decoders.begin(), decoders, it);
+    return it->m_decoder;
+  }
+  if (it != decoders.end()) decoders.erase(it);  // the movie was rewritten
+
+  Entry entry = {path, modified, std::make_shared<FfmpegDecoder>(path, info),
+                 now};
+  decoders.push_front(entry);
+  if ((int)decoders.size() > maxDecodersCount) decoders.pop_back();
+
+  return entry.m_decoder;
+}
+
+//-----------------------------------------------------------
+
+TRasterImageP FfmpegDecoder::getImage(int frameIndex) {
+  if (m_info.m_lx <= 0 || m_info.m_ly <= 0 || frameIndex < 1)
+    return TRasterImageP();
+
+  Session *session = 0;
+  {
+    QMutexLocker locker(&m_mutex);
+
+    // Prefer a session that can reach the frame without seeking
+    for (Session *s : m_sessions)
+      if (s->isNear(frameIndex)) {
+        session = s;
+        break;
+      }
+
+    if (!session) {
+      if ((int)m_sessions.size() < m_maxSessionsCount) {
+        session = new Session(this);
+        session->start();
+        m_sessions.push_back(session);
+      } else
+        session = *std::min_element(
+            m_sessions.begin(), m_sessions.end(),
+            [](const Session *a, const Session *b) {
+              return a->m_lastRequest < b->m_lastRequest;
+            });
+    }
+
+    session->m_lastRequest = ++m_requestsCount;
+  }
+
+  return session->getFrame(frameIndex);
+}
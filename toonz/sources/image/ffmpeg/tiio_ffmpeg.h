@@ -8,6 +8,10 @@
 #include "trasterimage.h"
 #include <QVector>
 #include <QStringList>
+#include <QMutex>
+
+#include <vector>
+#include <memory>
 
 struct ffmpegFileInfo {
   int m_lx, m_ly, m_frameCount;
@@ -56,4 +60,39 @@ private:
   QString cleanPathSymbols();
 };
 
+//===========================================================
+
+//! Decodes the frames of a movie on demand, streaming them from ffmpeg
+//! processes which are kept running between requests. Each decode session
+//! reads sequentially, and seeks only when the requested frame is behind or
+//! far ahead of its position; multiple sessions let concurrent requests
+//! decode different parts of the movie in parallel.
+class FfmpegDecoder {
+public:
+  FfmpegDecoder(const TFilePath &path, const ffmpegFileInfo &info);
+  ~FfmpegDecoder();
+
+  //! Returns the decoder shared by the readers of the specified movie, so
+  //! that sessions survive the (typically short-lived) level readers.
+  static std::shared_ptr<FfmpegDecoder> instance(const TFilePath &path,
+                                                 const ffmpegFileInfo &info);
+
+  //! Returns the frame at the specified 1-based index, or an empty image
+  //! if it could not be decoded. Thread-safe.
+  TRasterImageP getImage(int frameIndex);
+
+private:
+  class Session;
+
+  TFilePath m_path;
+  ffmpegFileInfo m_info;
+  QString m_ffmpegPath;
+  int m_ffmpegTimeout;
+
+  QMutex m_mutex;
+  std::vector<Session *> m_sessions;
+  int m_maxSessionsCount;
+  unsigned int m_requestsCount;
+};
+
 #endif
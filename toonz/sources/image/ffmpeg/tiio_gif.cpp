@@ -188,6 +188,7 @@ TLevelReaderGif::TLevelReaderGif(const TFilePath &path)
   ffmpegReader->setPath(m_path);
   ffmpegReader->disablePrecompute();
   ffmpegFileInfo tempInfo = ffmpegReader->getInfo();
+  ffmpegDecoder           = FfmpegDecoder::instance(m_path, tempInfo);
   double fps              = tempInfo.m_frameRate;
   m_frameCount            = tempInfo.m_frameCount;
   m_size                  = TDimension(tempInfo.m_lx, tempInfo.m_ly);
@@ -237,11 +238,8 @@ TDimension TLevelReaderGif::getSize() { return m_size; }
 //------------------------------------------------
 
 TImageP TLevelReaderGif::load(int frameIndex) {
-  if (!ffmpegFramesCreated) {
-    ffmpegReader->getFramesFromMovie();
-    ffmpegFramesCreated = true;
-  }
-  return ffmpegReader->getImage(frameIndex);
+  // Frames are streamed from ffmpeg rather than extracted to disk first
+  return ffmpegDecoder->getImage(frameIndex);
 }
 
 Tiio::GifWriterProperties::GifWriterProperties()
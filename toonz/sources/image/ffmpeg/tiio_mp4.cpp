@@ -167,6 +167,7 @@ TLevelReaderMp4::TLevelReaderMp4(const TFilePath &path) : TLevelReader(path) {
   ffmpegReader->setPath(m_path);
   ffmpegReader->disablePrecompute();
   ffmpegFileInfo tempInfo = ffmpegReader->getInfo();
+  ffmpegDecoder           = FfmpegDecoder::instance(m_path, tempInfo);
   double fps              = tempInfo.m_frameRate;
   m_frameCount            = tempInfo.m_frameCount;
   m_size                  = TDimension(tempInfo.m_lx, tempInfo.m_ly);
@@ -217,11 +218,8 @@ TDimension TLevelReaderMp4::getSize() { return m_size; }
 //------------------------------------------------
 
 TImageP TLevelReaderMp4::load(int frameIndex) {
-  if (!ffmpegFramesCreated) {
-    ffmpegReader->getFramesFromMovie();
-    ffmpegFramesCreated = true;
-  }
-  return ffmpegReader->getImage(frameIndex);
+  // Frames are streamed from ffmpeg rather than extracted to disk first
+  return ffmpegDecoder->getImage(frameIndex);
 }
 
 Tiio::Mp4WriterProperties::Mp4WriterProperties()
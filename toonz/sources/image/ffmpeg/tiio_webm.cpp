@@ -168,6 +168,7 @@ TLevelReaderWebm::TLevelReaderWebm(const TFilePath &path) : TLevelReader(path) {
   ffmpegReader->setPath(m_path);
   ffmpegReader->disablePrecompute();
   ffmpegFileInfo tempInfo = ffmpegReader->getInfo();
+  ffmpegDecoder           = FfmpegDecoder::instance(m_path, tempInfo);
   double fps              = tempInfo.m_frameRate;
   m_frameCount            = tempInfo.m_frameCount;
   m_size                  = TDimension(tempInfo.m_lx, tempInfo.m_ly);
@@ -218,11 +219,8 @@ TDimension TLevelReaderWebm::getSize() { return m_size; }
 //------------------------------------------------
 
 TImageP TLevelReaderWebm::load(int frameIndex) {
-  if (!ffmpegFramesCreated) {
-    ffmpegReader->getFramesFromMovie();
-    ffmpegFramesCreated = true;
-  }
-  return ffmpegReader->getImage(frameIndex);
+  // Frames are streamed from ffmpeg rather than extracted to disk first
+  return ffmpegDecoder->getImage(frameIndex);
 }
 
 Tiio::WebmWriterProperties::WebmWriterProperties()
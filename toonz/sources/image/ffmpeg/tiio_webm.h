@@ -60,7 +60,7 @@ public:
   // void *m_decompressedBuffer;
 private:
   Ffmpeg *ffmpegReader;
-  bool ffmpegFramesCreated = false;
+  std::shared_ptr<FfmpegDecoder> ffmpegDecoder;
   TDimension m_size;
   int m_frameCount, m_lx, m_ly;
 };
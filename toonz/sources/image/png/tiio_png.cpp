@@ -3,6 +3,11 @@
 #endif
 
 #include <memory>
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <cstdlib>
+#include <atomic>
 
 #include "tmachine.h"
 #include "texception.h"
@@ -12,9 +17,11 @@
 #include "../compatibility/tfile_io.h"
 
 #include "png.h"
+#include "zlib.h"
 
 #include "tpixel.h"
 #include "tpixelutils.h"
+#include "tthread.h"
 
 using namespace std;
 //------------------------------------------------------------
@@ -728,16 +735,157 @@ public:
 //=========================================================
 
 Tiio::PngWriterProperties::PngWriterProperties()
-    : m_matte("Alpha Channel", true)
+    : m_matte("Alpha Channel", true), m_compression("Compression")
 
 {
+  // "Fast" is meant for intermediate outputs, trading size for speed
+  m_compression.addValue(L"Default");
+  m_compression.addValue(L"Fast");
+
   bind(m_matte);
+  bind(m_compression);
 }
 
 void Tiio::PngWriterProperties::updateTranslation() {
   m_matte.setQStringName(tr("Alpha Channel"));
+  m_compression.setQStringName(tr("Compression"));
+  m_compression.setItemUIName(L"Default", tr("Default"));
+  m_compression.setItemUIName(L"Fast", tr("Fast"));
 }
 
+//=========================================================
+//    Concurrent IDAT encoding
+//=========================================================
+
+namespace {
+
+const int blockSize  = 128 << 10;  // Filtered bytes per deflate block
+const int windowSize = 32 << 10;   // Deflate's dictionary size
+
+//---------------------------------------------------------
+
+// Reorders the channels of a row in machine order like libpng's write
+// transforms set in PngWriter::open() do.
+void toPngOrder(UCHAR *row, int lx, int channels, int sampleSize) {
+#if defined(TNZ_MACHINE_CHANNEL_ORDER_MBGR) ||                                 \
+    defined(TNZ_MACHINE_CHANNEL_ORDER_MRGB)
+  if (channels == 4) {
+    UCHAR m[2];
+    for (UCHAR *pix = row, *end = row + lx * 4 * sampleSize; pix != end;
+         pix += 4 * sampleSize) {
+      memcpy(m, pix, sampleSize);
+      memmove(pix, pix + sampleSize, 3 * sampleSize);
+      memcpy(pix + 3 * sampleSize, m, sampleSize);
+    }
+  }
+#endif
+
+#if defined(TNZ_MACHINE_CHANNEL_ORDER_MBGR) ||                                 \
+    defined(TNZ_MACHINE_CHANNEL_ORDER_BGRM)
+  if (channels >= 3) {
+    int pixelSize = channels * sampleSize;
+    for (UCHAR *pix = row, *end = row + lx * pixelSize; pix != end;
+         pix += pixelSize)
+      for (int i = 0; i < sampleSize; ++i)
+        std::swap(pix[i], pix[2 * sampleSize + i]);
+  }
+#endif
+}
+
+//---------------------------------------------------------
+
+inline int paeth(int a, int b, int c) {
+  int p = a + b - c, pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+  return (pa <= pb && pa <= pc) ? a : (pb <= pc) ? b : c;
+}
+
+//---------------------------------------------------------
+
+// Applies the specified png filter to a row. The first row of the image has
+// no previous row.
+void applyFilter(int filter, const UCHAR *row, const UCHAR *prevRow,
+                 int rowBytes, int bpp, UCHAR *out) {
+  out[0] = filter;
+  ++out;
+
+  for (int i = 0; i < rowBytes; ++i) {
+    int a = (i >= bpp) ? row[i - bpp] : 0;
+    int b = prevRow ? prevRow[i] : 0;
+    int c = (prevRow && i >= bpp) ? prevRow[i - bpp] : 0;
+
+    switch (filter) {
+    case PNG_FILTER_VALUE_NONE:
+      out[i] = row[i];
+      break;
+    case PNG_FILTER_VALUE_SUB:
+      out[i] = row[i] - a;
+      break;
+    case PNG_FILTER_VALUE_UP:
+      out[i] = row[i] - b;
+      break;
+    case PNG_FILTER_VALUE_AVG:
+      out[i] = row[i] - ((a + b) >> 1);
+      break;
+    case PNG_FILTER_VALUE_PAETH:
+      out[i] = row[i] - paeth(a, b, c);
+      break;
+    }
+  }
+}
+
+//---------------------------------------------------------
+
+// Filters a row choosing the filter with the minimum sum of absolute
+// differences, the same heuristic libpng uses.
+void filterRow(const UCHAR *row, const UCHAR *prevRow, int rowBytes, int bpp,
+               std::vector<UCHAR> &candidate, UCHAR *out) {
+  unsigned int bestSum = (std::numeric_limits<unsigned int>::max)();
+
+  candidate.resize(rowBytes + 1);
+  for (int filter = PNG_FILTER_VALUE_NONE; filter < PNG_FILTER_VALUE_LAST;
+       ++filter) {
+    applyFilter(filter, row, prevRow, rowBytes, bpp, &candidate[0]);
+
+    unsigned int sum = 0;
+    for (int i = 1; i <= rowBytes; ++i)
+      sum += abs((int)(signed char)candidate[i]);
+
+    if (sum < bestSum) {
+      bestSum = sum;
+      memcpy(out, &candidate[0], rowBytes + 1);
+    }
+  }
+}
+
+}  // namespace
+
+//=========================================================
+
+// Processes the blocks of an image concurrently, see TThread::forEachBand().
+class PngBlockJob {
+  int m_count;
+
+public:
+  PngBlockJob(int count) : m_count(count) {}
+  virtual ~PngBlockJob() {}
+
+  //! Processes all the blocks. Returns false in case of failures.
+  bool run() {
+    std::atomic<bool> ok(true);
+    bool done =
+        TThread::forEachBand(m_count, 1, [this, &ok](int b0, int b1) {
+          for (int block = b0; block < b1; ++block)
+            if (!processBlock(block)) ok = false;
+        });
+
+    return done && ok;
+  }
+
+protected:
+  //! Processes the specified block. Returns false in case of failure.
+  virtual bool processBlock(int block) = 0;
+};
+
 //=========================================================
 
 class PngWriter final : public Tiio::Writer {
@@ -746,6 +894,21 @@ class PngWriter final : public Tiio::Writer {
   FILE *m_chan;
   bool m_matte;
   std::vector<TPixel> *m_colormap;
+  int m_compressionLevel;
+  bool m_fastFilter;
+  int m_row;
+  bool m_idatWritten;
+
+  friend class PngFilterJob;
+
+  void convertLine(char *buffer, UCHAR *row) const;
+  void convertLine(short *buffer, UCHAR *row) const;
+
+  int getChannels() const { return m_matte ? 4 : 3; }
+  int getSampleSize() const { return (m_info.m_bitsPerSample == 16) ? 2 : 1; }
+
+  bool writeIdat(char *buffer, int lineCount, ptrdiff_t lineStride,
+                 bool is64Buffer);
 
 public:
   PngWriter();
@@ -755,6 +918,10 @@ public:
   void writeLine(char *buffer) override;
   void writeLine(short *buffer) override;
 
+  bool writeLines(char *buffer, int lineCount, ptrdiff_t lineStride) override;
+  bool writeLines(short *buffer, int lineCount,
+                  ptrdiff_t lineStride) override;
+
   Tiio::RowOrder getRowOrder() const override { return Tiio::TOP2BOTTOM; }
 
   void flush() override;
@@ -764,10 +931,186 @@ public:
   bool writeAlphaSupported() const override { return m_matte; };
 };
 
+//=========================================================
+
+// Converts and filters the rows of a block of a PngWriter's image.
+class PngFilterJob final : public PngBlockJob {
+  const PngWriter *m_writer;
+  char *m_buffer;
+  ptrdiff_t m_lineStride;
+  bool m_is64;
+  int m_rowsPerBlock, m_rowBytes;
+  UCHAR *m_filtered;
+
+public:
+  PngFilterJob(const PngWriter *writer, char *buffer, ptrdiff_t lineStride,
+               bool is64, int rowsPerBlock, int blocksCount, UCHAR *filtered)
+      : PngBlockJob(blocksCount)
+      , m_writer(writer)
+      , m_buffer(buffer)
+      , m_lineStride(lineStride)
+      , m_is64(is64)
+      , m_rowsPerBlock(rowsPerBlock)
+      , m_rowBytes(writer->m_info.m_lx * writer->getChannels() *
+                   writer->getSampleSize())
+      , m_filtered(filtered) {}
+
+protected:
+  bool processBlock(int block) override;
+
+private:
+  void convertRow(int y, UCHAR *row) const {
+    char *line = m_buffer + y * m_lineStride;
+    if (m_is64)
+      m_writer->convertLine((short *)line, row);
+    else
+      m_writer->convertLine(line, row);
+
+    toPngOrder(row, m_writer->m_info.m_lx, m_writer->getChannels(),
+               m_writer->getSampleSize());
+  }
+};
+
+//---------------------------------------------------------
+
+bool PngFilterJob::processBlock(int block) {
+  int y0 = block * m_rowsPerBlock,
+      y1 = std::min(y0 + m_rowsPerBlock, m_writer->m_info.m_ly);
+
+  // Conversions may write past the png row
+  int rowSize = (m_writer->m_info.m_lx + 1) * 8;
+  std::vector<UCHAR> row(rowSize), prevRow(rowSize), candidate;
+
+  int bpp = m_writer->getChannels() * m_writer->getSampleSize();
+
+  if (y0 > 0) convertRow(y0 - 1, &prevRow[0]);
+
+  for (int y = y0; y < y1; ++y) {
+    convertRow(y, &row[0]);
+
+    const UCHAR *prev = (y > 0) ? &prevRow[0] : 0;
+    UCHAR *out        = m_filtered + (size_t)y * (m_rowBytes + 1);
+
+    if (m_writer->m_fastFilter)
+      applyFilter(PNG_FILTER_VALUE_UP, &row[0], prev, m_rowBytes, bpp, out);
+    else
+      filterRow(&row[0], prev, m_rowBytes, bpp, candidate, out);
+
+    row.swap(prevRow);
+  }
+
+  return true;
+}
+
+//=========================================================
+
+// Deflates the blocks of filtered image data independently. Each block is
+// primed with the data preceding it and terminated with a sync flush, so
+// their concatenation is a single valid deflate stream (the same scheme as
+// pigz).
+class PngDeflateJob final : public PngBlockJob {
+  const UCHAR *m_data;
+  size_t m_dataSize, m_blockBytes;
+  int m_level;
+
+  std::vector<std::vector<UCHAR>> m_blocks;
+  std::vector<uLong> m_adlers;
+
+public:
+  PngDeflateJob(const UCHAR *data, size_t dataSize, size_t blockBytes,
+                int blocksCount, int level)
+      : PngBlockJob(blocksCount)
+      , m_data(data)
+      , m_dataSize(dataSize)
+      , m_blockBytes(blockBytes)
+      , m_level(level)
+      , m_blocks(blocksCount)
+      , m_adlers(blocksCount) {}
+
+  //! Returns the zlib stream, ready to be stored in IDAT chunks.
+  void getStream(std::vector<UCHAR> &stream);
+
+protected:
+  bool processBlock(int block) override;
+};
+
+//---------------------------------------------------------
+
+bool PngDeflateJob::processBlock(int block) {
+  size_t begin = block * m_blockBytes,
+         end   = std::min(begin + m_blockBytes, m_dataSize);
+  bool last    = (end == m_dataSize);
+
+  m_adlers[block] =
+      adler32(adler32(0L, Z_NULL, 0), m_data + begin, (uInt)(end - begin));
+
+  z_stream zs;
+  memset(&zs, 0, sizeof(z_stream));
+  if (deflateInit2(&zs, m_level, Z_DEFLATED, -MAX_WBITS, 8, Z_FILTERED) !=
+      Z_OK)
+    return false;
+
+  if (begin > 0) {
+    size_t dictSize = std::min<size_t>(begin, windowSize);
+    deflateSetDictionary(&zs, m_data + begin - dictSize, (uInt)dictSize);
+  }
+
+  std::vector<UCHAR> &out = m_blocks[block];
+  out.resize(deflateBound(&zs, (uLong)(end - begin)) + 16);
+
+  zs.next_in   = (Bytef *)(m_data + begin);
+  zs.avail_in  = (uInt)(end - begin);
+  zs.next_out  = &out[0];
+  zs.avail_out = (uInt)out.size();
+
+  int ret = deflate(&zs, last ? Z_FINISH : Z_SYNC_FLUSH);
+  bool ok = last ? (ret == Z_STREAM_END)
+                 : (ret == Z_OK && zs.avail_in == 0 && zs.avail_out > 0);
+
+  out.resize(zs.total_out);
+  deflateEnd(&zs);
+
+  return ok;
+}
+
 //---------------------------------------------------------
 
+void PngDeflateJob::getStream(std::vector<UCHAR> &stream) {
+  // zlib header
+  int level      = (m_level == Z_DEFAULT_COMPRESSION) ? 6 : m_level;
+  int levelFlags = (level < 2) ? 0 : (level < 6) ? 1 : (level == 6) ? 2 : 3;
+  UCHAR cmf = 0x78, flg = levelFlags << 6;
+  flg += 31 - ((cmf << 8) + flg) % 31;
+
+  stream.push_back(cmf);
+  stream.push_back(flg);
+
+  uLong adler = adler32(0L, Z_NULL, 0);
+  for (int i = 0; i < (int)m_blocks.size(); ++i) {
+    stream.insert(stream.end(), m_blocks[i].begin(), m_blocks[i].end());
+
+    size_t begin = i * m_blockBytes,
+           end   = std::min(begin + m_blockBytes, m_dataSize);
+    adler = adler32_combine(adler, m_adlers[i], (z_off_t)(end - begin));
+  }
+
+  // zlib trailer
+  for (int shift = 24; shift >= 0; shift -= 8)
+    stream.push_back((UCHAR)(adler >> shift));
+}
+
+//=========================================================
+
 PngWriter::PngWriter()
-    : m_png_ptr(0), m_info_ptr(0), m_matte(true), m_colormap(0) {}
+    : m_png_ptr(0)
+    , m_info_ptr(0)
+    , m_chan(0)
+    , m_matte(true)
+    , m_colormap(0)
+    , m_compressionLevel(Z_DEFAULT_COMPRESSION)
+    , m_fastFilter(false)
+    , m_row(0)
+    , m_idatWritten(false) {}
 
 //---------------------------------------------------------
 
@@ -808,9 +1151,18 @@ void PngWriter::open(FILE *file, const TImageInfo &info) {
       (TBoolProperty *)(m_properties->getProperty("Alpha Channel"));
   TPointerProperty *colormap =
       (TPointerProperty *)(m_properties->getProperty("Colormap"));
+  TEnumProperty *compressionProp =
+      (TEnumProperty *)(m_properties->getProperty("Compression"));
   m_matte = (alphaProp && alphaProp->getValue()) ? true : false;
   if (colormap) m_colormap = (vector<TPixel> *)colormap->getValue();
 
+  m_fastFilter = compressionProp && compressionProp->getValue() == L"Fast";
+  if (m_fastFilter) {
+    m_compressionLevel = 1;
+    png_set_compression_level(m_png_ptr, m_compressionLevel);
+    png_set_filter(m_png_ptr, PNG_FILTER_TYPE_BASE, PNG_FILTER_UP);
+  }
+
   TUINT32 x_pixels_per_meter = tround(m_info.m_dpix / 0.0254);
   TUINT32 y_pixels_per_meter = tround(m_info.m_dpiy / 0.0254);
 
@@ -870,19 +1222,21 @@ void PngWriter::open(FILE *file, const TImageInfo &info) {
 //---------------------------------------------------------
 
 void PngWriter::flush() {
-  png_write_end(m_png_ptr, m_info_ptr);
+  // libpng refuses to end images whose IDATs it did not write itself
+  if (m_idatWritten)
+    png_write_chunk(m_png_ptr, (png_bytep) "IEND", 0, 0);
+  else
+    png_write_end(m_png_ptr, m_info_ptr);
   fflush(m_chan);
 }
 
 //---------------------------------------------------------
 
-void PngWriter::writeLine(short *buffer) {
+void PngWriter::convertLine(short *buffer, UCHAR *row) const {
   {
-    TPixel64 *pix = (TPixel64 *)buffer;
-    unsigned short *tmp;
-    tmp = (unsigned short *)malloc((m_info.m_lx + 1) * 3);
-    // unsigned short tmp[10000];
-    int k = 0;
+    TPixel64 *pix       = (TPixel64 *)buffer;
+    unsigned short *tmp = (unsigned short *)row;
+    int k               = 0;
     for (int j = 0; j < m_info.m_lx; j++, pix++) {
       // depremultiply here
       TPixel64 depremult_pix(*pix);
@@ -904,17 +1258,25 @@ void PngWriter::writeLine(short *buffer) {
       if (m_matte)
         tmp[k++] = mySwap(pix->m);  // ?? does it take care MRGB or MBGR case?
     }
-    png_write_row(m_png_ptr, (unsigned char *)tmp);
   }
 }
 
+//---------------------------------------------------------
+
+void PngWriter::writeLine(short *buffer) {
+  std::vector<UCHAR> row((m_info.m_lx + 1) * 8);
+  convertLine(buffer, &row[0]);
+  png_write_row(m_png_ptr, &row[0]);
+  ++m_row;
+}
+
 //=========================================================
 
-void PngWriter::writeLine(char *buffer) {
+void PngWriter::convertLine(char *buffer, UCHAR *row) const {
   // TBoolProperty* alphaProp =
   // (TBoolProperty*)(m_properties->getProperty("Alpha Channel"));
   if (m_matte || m_colormap) {
-    unsigned char *tmp = new unsigned char[(m_info.m_lx + 1) * 4];
+    unsigned char *tmp = row;
     TPixel32 *pix      = (TPixel32 *)buffer;
     int k              = 0;
     for (int j = 0; j < m_info.m_lx; j++, pix++) {
@@ -945,11 +1307,9 @@ void PngWriter::writeLine(char *buffer) {
 #error "unknown channel order"
 #endif
     }
-    png_write_row(m_png_ptr, tmp);
-    delete[] tmp;
   } else {
     TPixel32 *pix      = (TPixel32 *)buffer;
-    unsigned char *tmp = new unsigned char[(m_info.m_lx + 1) * 3];
+    unsigned char *tmp = row;
 
     int k = 0;
     for (int j = 0; j < m_info.m_lx; j++) {
@@ -971,11 +1331,70 @@ void PngWriter::writeLine(char *buffer) {
 
       ++pix;
     }
-    png_write_row(m_png_ptr, tmp);
-    delete[] tmp;
   }
 }
 
+//---------------------------------------------------------
+
+void PngWriter::writeLine(char *buffer) {
+  std::vector<UCHAR> row((m_info.m_lx + 1) * 4);
+  convertLine(buffer, &row[0]);
+  png_write_row(m_png_ptr, &row[0]);
+  ++m_row;
+}
+
+//---------------------------------------------------------
+
+bool PngWriter::writeLines(char *buffer, int lineCount, ptrdiff_t lineStride) {
+  return writeIdat(buffer, lineCount, lineStride, false);
+}
+
+//---------------------------------------------------------
+
+bool PngWriter::writeLines(short *buffer, int lineCount,
+                           ptrdiff_t lineStride) {
+  return writeIdat((char *)buffer, lineCount, lineStride, true);
+}
+
+//---------------------------------------------------------
+
+// Filters and deflates blocks of rows concurrently, then stores the stitched
+// zlib stream in IDAT chunks - bypassing libpng's row-by-row compression.
+bool PngWriter::writeIdat(char *buffer, int lineCount, ptrdiff_t lineStride,
+                          bool is64Buffer) {
+  if (!m_png_ptr || m_colormap || m_row != 0 || lineCount != m_info.m_ly)
+    return false;
+
+  int rowBytes     = m_info.m_lx * getChannels() * getSampleSize();
+  int rowsPerBlock = std::max(blockSize / (rowBytes + 1), 1);
+  int blocksCount  = (lineCount + rowsPerBlock - 1) / rowsPerBlock;
+  if (blocksCount < 2) return false;
+
+  std::vector<UCHAR> filtered((size_t)lineCount * (rowBytes + 1));
+
+  PngFilterJob filterJob(this, buffer, lineStride, is64Buffer, rowsPerBlock,
+                         blocksCount, &filtered[0]);
+  if (!filterJob.run()) return false;
+
+  PngDeflateJob deflateJob(&filtered[0], filtered.size(),
+                           (size_t)rowsPerBlock * (rowBytes + 1), blocksCount,
+                           m_compressionLevel);
+  if (!deflateJob.run()) return false;
+
+  std::vector<UCHAR> stream;
+  deflateJob.getStream(stream);
+
+  // Split the stream in chunks of reasonable size
+  const size_t chunkSize = 1 << 20;
+  for (size_t pos = 0; pos < stream.size(); pos += chunkSize)
+    png_write_chunk(m_png_ptr, (png_bytep) "IDAT", &stream[pos],
+                    std::min(chunkSize, stream.size() - pos));
+
+  m_row         = lineCount;
+  m_idatWritten = true;
+  return true;
+}
+
 //=========================================================
 
 Tiio::Reader *Tiio::makePngReader() { return new PngReader(); }
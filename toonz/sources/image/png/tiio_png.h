@@ -19,6 +19,7 @@ class PngWriterProperties final : public TPropertyGroup {
 public:
   // TEnumProperty m_pixelSize;
   TBoolProperty m_matte;
+  TEnumProperty m_compression;
 
   PngWriterProperties();
   void updateTranslation() override;
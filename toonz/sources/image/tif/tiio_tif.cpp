@@ -10,6 +10,10 @@
 #endif
 
 #include <memory>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <atomic>
 
 #include "tiio.h"
 #include "tpixel.h"
@@ -18,6 +22,7 @@
 #include "tconvert.h"
 #include "tpixelutils.h"
 #include "traster.h"
+#include "tthread.h"
 
 extern "C" {
 #include "tiffio.h"
@@ -33,6 +38,106 @@ extern "C" {
 #include "windows.h"
 #endif
 
+//**************************************************************************
+//    Concurrent strips processing
+//**************************************************************************
+
+namespace {
+
+// In-memory file for libtiff client handles. Each stream has its own
+// position, so several handles may access the same data concurrently.
+struct TifMemoryStream {
+  std::vector<char> *m_data;
+  toff_t m_pos;
+
+  TifMemoryStream(std::vector<char> *data) : m_data(data), m_pos(0) {}
+};
+
+//------------------------------------------------------------
+
+tmsize_t tifStreamRead(thandle_t handle, void *buf, tmsize_t size) {
+  TifMemoryStream *stream = (TifMemoryStream *)handle;
+  if (stream->m_pos >= stream->m_data->size()) return 0;
+
+  tmsize_t count =
+      std::min<tmsize_t>(size, stream->m_data->size() - stream->m_pos);
+  memcpy(buf, &(*stream->m_data)[stream->m_pos], count);
+  stream->m_pos += count;
+
+  return count;
+}
+
+//------------------------------------------------------------
+
+tmsize_t tifStreamWrite(thandle_t handle, void *buf, tmsize_t size) {
+  TifMemoryStream *stream = (TifMemoryStream *)handle;
+  if (stream->m_pos + size > stream->m_data->size())
+    stream->m_data->resize(stream->m_pos + size);
+
+  memcpy(&(*stream->m_data)[stream->m_pos], buf, size);
+  stream->m_pos += size;
+
+  return size;
+}
+
+//------------------------------------------------------------
+
+toff_t tifStreamSeek(thandle_t handle, toff_t offset, int whence) {
+  TifMemoryStream *stream = (TifMemoryStream *)handle;
+  switch (whence) {
+  case SEEK_SET:
+    stream->m_pos = offset;
+    break;
+  case SEEK_CUR:
+    stream->m_pos += offset;
+    break;
+  case SEEK_END:
+    stream->m_pos = stream->m_data->size() + offset;
+    break;
+  }
+
+  return stream->m_pos;
+}
+
+//------------------------------------------------------------
+
+int tifStreamClose(thandle_t) { return 0; }
+
+toff_t tifStreamSize(thandle_t handle) {
+  return ((TifMemoryStream *)handle)->m_data->size();
+}
+
+int tifStreamMap(thandle_t, void **, toff_t *) { return 0; }
+
+void tifStreamUnmap(thandle_t, void *, toff_t) {}
+
+//------------------------------------------------------------
+
+TIFF *openTifStream(const char *mode, TifMemoryStream &stream) {
+  return TIFFClientOpen("", mode, (thandle_t)&stream, tifStreamRead,
+                        tifStreamWrite, tifStreamSeek, tifStreamClose,
+                        tifStreamSize, tifStreamMap, tifStreamUnmap);
+}
+
+//------------------------------------------------------------
+
+// Copies the whole file accessed by the passed handle in memory.
+bool readTifData(TIFF *tiff, std::vector<char> &data) {
+  thandle_t handle = TIFFClientdata(tiff);
+
+  toff_t size = TIFFGetSizeProc(tiff)(handle);
+  if (size == 0) return false;
+
+  data.resize(size);
+  TIFFGetSeekProc(tiff)(handle, 0, SEEK_SET);
+
+  return TIFFGetReadProc(tiff)(handle, &data[0], size) == (tmsize_t)size;
+}
+
+}  // namespace
+
+//============================================================
+
 //**************************************************************************
 //    TifReader  implementation
 //**************************************************************************
@@ -50,6 +155,9 @@ class TifReader final : public Tiio::Reader {
   bool is16bitEnabled;
   bool m_isTzi;
   TRasterGR8P m_tmpRas;
+  std::shared_ptr<std::vector<char>> m_fileData;
+
+  friend class TifReadJob;
 
 public:
   TifReader(bool isTzi);
@@ -66,6 +174,75 @@ public:
   int skipLines(int lineCount) override;
   void readLine(char *buffer, int x0, int x1, int shrink) override;
   void readLine(short *buffer, int x0, int x1, int shrink) override;
+
+  bool readLines(char *buffer, int lineCount, int x0, int x1,
+                 ptrdiff_t lineStride) override;
+  bool readLines(short *buffer, int lineCount, int x0, int x1,
+                 ptrdiff_t lineStride) override;
+
+  bool readRegion(char *buffer, ptrdiff_t lineStride, int x0, int y0, int x1,
+                  int y1, int shrink) override;
+  bool readRegion(short *buffer, ptrdiff_t lineStride, int x0, int y0, int x1,
+                  int y1, int shrink) override;
+
+private:
+  void decodeStrip(TIFF *tiff, int stripIndex, UCHAR *stripBuffer, bool is64,
+                   int x0, int x1) const;
+  int getStripRow(int row) const;
+
+  void copyRow(const UCHAR *stripBuffer, int row, short *buffer, int x0,
+               int x1, int shrink) const;
+  void copyRow(const UCHAR *stripBuffer, int row, char *buffer, int x0,
+               int x1, int shrink) const;
+
+  bool readStrips(char *buffer, int lineCount, int x0, int x1,
+                  ptrdiff_t lineStride, bool is64Buffer);
+  bool readRegionStrips(char *buffer, ptrdiff_t lineStride, int x0, int y0,
+                        int x1, int y1, int shrink, bool is64Buffer);
+
+  bool loadFileData();
+  bool decodeAs64() const {
+    return m_info.m_bitsPerSample == 16 && m_info.m_samplePerPixel >= 3;
+  }
+};
+
+//============================================================
+
+// Decodes a set of strips of a TifReader's file concurrently. In case of
+// tiled files, only the tiles intersecting the [x0, x1] columns are decoded.
+class TifReadJob {
+  const TifReader *m_reader;
+  std::shared_ptr<std::vector<char>> m_fileData;
+  std::vector<int> m_stripIndices;
+  int m_x0, m_x1;
+  bool m_is64;
+
+  std::map<int, std::vector<UCHAR>> m_strips;
+
+public:
+  TifReadJob(const TifReader *reader,
+             const std::shared_ptr<std::vector<char>> &fileData,
+             const std::vector<int> &stripIndices, int x0, int x1, bool is64)
+      : m_reader(reader)
+      , m_fileData(fileData)
+      , m_stripIndices(stripIndices)
+      , m_x0(x0)
+      , m_x1(x1)
+      , m_is64(is64) {
+    for (int i = 0; i < (int)stripIndices.size(); ++i)
+      m_strips[stripIndices[i]].resize(
+          reader->m_rowsPerStrip * reader->m_rowLength * (is64 ? 8 : 4));
+  }
+
+  const UCHAR *getStrip(int stripIndex) const {
+    return &m_strips.find(stripIndex)->second[0];
+  }
+
+  //! Decodes all the strips. Returns false in case of failures.
+  bool run();
+
+private:
+  bool decodeStrips(int s0, int s1);
 };
 
 //------------------------------------------------------------
@@ -422,70 +599,66 @@ int TifReader::skipLines(int lineCount) {
 
 #include "timage_io.h"
 
-void TifReader::readLine(short *buffer, int x0, int x1, int shrink) {
-  assert(shrink > 0);
+//------------------------------------------------------------
 
-  const int pixelSize = 8;
-  int stripRowSize    = m_rowLength * pixelSize;
+// Decodes the specified strip (or tiles row) of the passed tiff in the
+// BOTTOM-UP orientation, no matter the internal tif's orientation storage.
+void TifReader::decodeStrip(TIFF *tiff, int stripIndex, UCHAR *stripBuffer,
+                            bool is64, int x0, int x1) const {
+  const int pixelSize = is64 ? 8 : 4;
+
+  if (TIFFIsTiled(tiff)) {
+    // Retrieve tiles size
+    uint32 tileWidth = 0, tileHeight = 0;
+    TIFFGetField(tiff, TIFFTAG_TILEWIDTH, &tileWidth);
+    TIFFGetField(tiff, TIFFTAG_TILELENGTH, &tileHeight);
+    assert(tileWidth > 0 && tileHeight > 0);
+
+    // Allocate a sufficient buffer to store a single tile
+    int tileSize = tileWidth * tileHeight;
+    std::unique_ptr<uint64[]> tile(new uint64[tileSize]);
+
+    int x = x0 - x0 % tileWidth;
+    int y = tileHeight * stripIndex;
+
+    // In case it's the last tiles row, the tile size might exceed the image
+    // bounds
+    int lastTy = std::min((int)tileHeight, m_info.m_ly - y);
+
+    // Traverse the tiles row
+    while (x <= x1 && x < m_info.m_lx) {
+      int ret = is64 ? TIFFReadRGBATile_64(tiff, x, y, tile.get())
+                     : TIFFReadRGBATile(tiff, x, y, (uint32 *)tile.get());
+      assert(ret);
+
+      int tileRowSize = std::min((int)tileWidth, m_info.m_lx - x) * pixelSize;
+
+      // Copy the tile rows in the corresponding output strip rows
+      for (int ty = 0; ty < lastTy; ++ty) {
+        memcpy(stripBuffer + (ty * m_rowLength + x) * pixelSize,
+               (UCHAR *)tile.get() + ty * tileWidth * pixelSize, tileRowSize);
+      }
 
-  if (m_row < m_info.m_y0 || m_row > m_info.m_y1) {
-    memset(buffer, 0, (x1 - x0 + 1) * pixelSize);
-    m_row++;
-    return;
+      x += tileWidth;
+    }
+  } else {
+    int y  = m_rowsPerStrip * stripIndex;
+    int ok = is64 ? TIFFReadRGBAStrip_64(tiff, y, (uint64 *)stripBuffer)
+                  : TIFFReadRGBAStrip(tiff, y, (uint32 *)stripBuffer);
+    assert(ok);
   }
+}
 
-  int stripIndex = m_row / m_rowsPerStrip;
-  if (m_stripIndex != stripIndex) {
-    // Retrieve the strip holding current row. Please, observe that
-    // TIFF functions will return the strip buffer in the BOTTOM-UP orientation,
-    // no matter the internal tif's orientation storage
-
-    m_stripIndex = stripIndex;
-
-    if (TIFFIsTiled(m_tiff)) {
-      // Retrieve tiles size
-      uint32 tileWidth = 0, tileHeight = 0;
-      TIFFGetField(m_tiff, TIFFTAG_TILEWIDTH, &tileWidth);
-      TIFFGetField(m_tiff, TIFFTAG_TILELENGTH, &tileHeight);
-      assert(tileWidth > 0 && tileHeight > 0);
-
-      // Allocate a sufficient buffer to store a single tile
-      int tileSize = tileWidth * tileHeight;
-      std::unique_ptr<uint64[]> tile(new uint64[tileSize]);
-
-      int x = 0;
-      int y = tileHeight * m_stripIndex;
-
-      // In case it's the last tiles row, the tile size might exceed the image
-      // bounds
-      int lastTy = std::min((int)tileHeight, m_info.m_ly - y);
-
-      // Traverse the tiles row
-      while (x < m_info.m_lx) {
-        int ret = TIFFReadRGBATile_64(m_tiff, x, y, tile.get());
-        assert(ret);
-
-        int tileRowSize = std::min((int)tileWidth, m_info.m_lx - x) * pixelSize;
-
-        // Copy the tile rows in the corresponding output strip rows
-        for (int ty = 0; ty < lastTy; ++ty) {
-          memcpy(m_stripBuffer + (ty * m_rowLength + x) * pixelSize,
-                 (UCHAR *)tile.get() + ty * tileWidth * pixelSize, tileRowSize);
-        }
+//------------------------------------------------------------
 
-        x += tileWidth;
-      }
-    } else {
-      int y  = m_rowsPerStrip * m_stripIndex;
-      int ok = TIFFReadRGBAStrip_64(m_tiff, y, (uint64 *)m_stripBuffer);
-      assert(ok);
-    }
-  }
+// Returns the index of the passed row inside the decoded strip buffer.
+int TifReader::getStripRow(int row) const {
+  int stripIndex = row / m_rowsPerStrip;
 
   uint16 orient = ORIENTATION_TOPLEFT;
   TIFFGetField(m_tiff, TIFFTAG_ORIENTATION, &orient);
 
-  int r = m_rowsPerStrip - 1 - (m_row % m_rowsPerStrip);
+  int r = m_rowsPerStrip - 1 - (row % m_rowsPerStrip);
   switch (orient)  // Pretty weak check for top/bottom orientation
   {
   case ORIENTATION_TOPLEFT:
@@ -500,21 +673,32 @@ void TifReader::readLine(short *buffer, int x0, int x1, int shrink) {
     // necessarily at
     // m_rowsPerStrip multiples). So, we must adjust for that.
 
-    r = std::min(m_rowsPerStrip, m_info.m_ly - m_rowsPerStrip * m_stripIndex) -
-        1 - (m_row % m_rowsPerStrip);
+    r = std::min(m_rowsPerStrip, m_info.m_ly - m_rowsPerStrip * stripIndex) -
+        1 - (row % m_rowsPerStrip);
     break;
 
   case ORIENTATION_BOTRIGHT:
   case ORIENTATION_BOTLEFT:
   case ORIENTATION_RIGHTBOT:
   case ORIENTATION_LEFTBOT:
-    r = m_row % m_rowsPerStrip;
+    r = row % m_rowsPerStrip;
     break;
   }
 
+  return r;
+}
+
+//------------------------------------------------------------
+
+void TifReader::copyRow(const UCHAR *stripBuffer, int row, short *buffer,
+                        int x0, int x1, int shrink) const {
+  const int pixelSize = 8;
+  int stripRowSize    = m_rowLength * pixelSize;
+
   // Finally, copy the strip row to the output row buffer
-  TPixel64 *pix = (TPixel64 *)buffer;
-  USHORT *v     = (USHORT *)(m_stripBuffer + r * stripRowSize);
+  TPixel64 *pix   = (TPixel64 *)buffer;
+  const USHORT *v =
+      (const USHORT *)(stripBuffer + getStripRow(row) * stripRowSize);
 
   pix += x0;
   v += 4 * x0;
@@ -535,6 +719,59 @@ void TifReader::readLine(short *buffer, int x0, int x1, int shrink) {
     pix += shrink;
     v += 4 * (shrink - 1);
   }
+}
+
+//------------------------------------------------------------
+
+void TifReader::copyRow(const UCHAR *stripBuffer, int row, char *buffer,
+                        int x0, int x1, int shrink) const {
+  const int pixelSize = 4;
+  int stripRowSize    = m_rowLength * pixelSize;
+
+  TPixel32 *pix   = (TPixel32 *)buffer;
+  const uint32 *v =
+      (const uint32 *)(stripBuffer + getStripRow(row) * stripRowSize);
+
+  pix += x0;
+  v += x0;
+
+  int width =
+      (x1 < x0) ? (m_info.m_lx - 1) / shrink + 1 : (x1 - x0) / shrink + 1;
+
+  for (int i = 0; i < width; i++) {
+    uint32 c = *v;
+    pix->r   = (UCHAR)TIFFGetR(c);
+    pix->g   = (UCHAR)TIFFGetG(c);
+    pix->b   = (UCHAR)TIFFGetB(c);
+    pix->m   = (UCHAR)TIFFGetA(c);
+
+    v += shrink;
+    pix += shrink;
+  }
+}
+
+//------------------------------------------------------------
+
+void TifReader::readLine(short *buffer, int x0, int x1, int shrink) {
+  assert(shrink > 0);
+
+  const int pixelSize = 8;
+
+  if (m_row < m_info.m_y0 || m_row > m_info.m_y1) {
+    memset(buffer, 0, (x1 - x0 + 1) * pixelSize);
+    m_row++;
+    return;
+  }
+
+  int stripIndex = m_row / m_rowsPerStrip;
+  if (m_stripIndex != stripIndex) {
+    // Retrieve the strip holding current row
+    m_stripIndex = stripIndex;
+    decodeStrip(m_tiff, m_stripIndex, m_stripBuffer, true, 0,
+                m_info.m_lx - 1);
+  }
+
+  copyRow(m_stripBuffer, m_row, buffer, x0, x1, shrink);
 
   m_row++;
 }
@@ -564,7 +801,6 @@ void TifReader::readLine(char *buffer, int x0, int x1, int shrink) {
   assert(shrink > 0);
 
   const int pixelSize = 4;
-  int stripRowSize    = m_rowLength * pixelSize;
 
   if (m_row < m_info.m_y0 || m_row > m_info.m_y1) {
     memset(buffer, 0, (x1 - x0 + 1) * pixelSize);
@@ -575,93 +811,219 @@ void TifReader::readLine(char *buffer, int x0, int x1, int shrink) {
   int stripIndex = m_row / m_rowsPerStrip;
   if (m_stripIndex != stripIndex) {
     m_stripIndex = stripIndex;
+    decodeStrip(m_tiff, m_stripIndex, m_stripBuffer, false, 0,
+                m_info.m_lx - 1);
+  }
+
+  copyRow(m_stripBuffer, m_row, buffer, x0, x1, shrink);
+
+  m_row++;
+}
+
+//------------------------------------------------------------
 
-    if (TIFFIsTiled(m_tiff)) {
-      uint32 tileWidth = 0, tileHeight = 0;
-      TIFFGetField(m_tiff, TIFFTAG_TILEWIDTH, &tileWidth);
-      TIFFGetField(m_tiff, TIFFTAG_TILELENGTH, &tileHeight);
-      assert(tileWidth > 0 && tileHeight > 0);
+bool TifReader::readLines(short *buffer, int lineCount, int x0, int x1,
+                          ptrdiff_t lineStride) {
+  return readStrips((char *)buffer, lineCount, x0, x1, lineStride, true);
+}
 
-      int tileSize = tileWidth * tileHeight;
-      std::unique_ptr<uint32[]> tile(new uint32[tileSize]);
+//------------------------------------------------------------
 
-      int x = 0;
-      int y = tileHeight * m_stripIndex;
+bool TifReader::readLines(char *buffer, int lineCount, int x0, int x1,
+                          ptrdiff_t lineStride) {
+  return readStrips(buffer, lineCount, x0, x1, lineStride, false);
+}
 
-      int lastTy = std::min((int)tileHeight, m_info.m_ly - y);
+//------------------------------------------------------------
 
-      while (x < m_info.m_lx) {
-        int ret = TIFFReadRGBATile(m_tiff, x, y, tile.get());
-        assert(ret);
+bool TifReader::readRegion(char *buffer, ptrdiff_t lineStride, int x0, int y0,
+                           int x1, int y1, int shrink) {
+  return readRegionStrips(buffer, lineStride, x0, y0, x1, y1, shrink, false);
+}
 
-        int tileRowSize =
-            std::min((int)tileWidth, (int)(m_info.m_lx - x)) * pixelSize;
+//------------------------------------------------------------
 
-        for (int ty = 0; ty < lastTy; ++ty) {
-          memcpy(m_stripBuffer + (ty * m_rowLength + x) * pixelSize,
-                 (UCHAR *)tile.get() + ty * tileWidth * pixelSize, tileRowSize);
-        }
+bool TifReader::readRegion(short *buffer, ptrdiff_t lineStride, int x0,
+                           int y0, int x1, int y1, int shrink) {
+  return readRegionStrips((char *)buffer, lineStride, x0, y0, x1, y1, shrink,
+                          true);
+}
 
-        x += tileWidth;
-      }
-    } else {
-      int y  = m_rowsPerStrip * m_stripIndex;
-      int ok = TIFFReadRGBAStrip(m_tiff, y, (uint32 *)m_stripBuffer);
-      assert(ok);
+//------------------------------------------------------------
+
+// Copies the whole file in memory, for concurrent strips decoding.
+bool TifReader::loadFileData() {
+  if (!m_fileData) {
+    std::shared_ptr<std::vector<char>> fileData(new std::vector<char>);
+    if (!::readTifData(m_tiff, *fileData)) return false;
+
+    m_fileData = fileData;
+  }
+
+  return true;
+}
+
+//------------------------------------------------------------
+
+// Libtiff handles can't be shared among threads. Strips are independent,
+// though: each thread taking part opens its own handle on an in-memory copy
+// of the file, and decodes a part of them.
+bool TifReader::readStrips(char *buffer, int lineCount, int x0, int x1,
+                           ptrdiff_t lineStride, bool is64Buffer) {
+  int firstRow = std::max(m_row, m_info.m_y0),
+      lastRow  = std::min(m_row + lineCount - 1, m_info.m_y1);
+  if (firstRow > lastRow) return false;
+
+  int firstStrip = firstRow / m_rowsPerStrip,
+      lastStrip  = lastRow / m_rowsPerStrip;
+  if (lastStrip - firstStrip < 1) return false;
+
+  if (!loadFileData()) return false;
+
+  std::vector<int> stripIndices;
+  for (int i = firstStrip; i <= lastStrip; ++i) stripIndices.push_back(i);
+
+  bool is64 = is64Buffer || decodeAs64();
+
+  TifReadJob job(this, m_fileData, stripIndices, 0, m_info.m_lx - 1, is64);
+  if (!job.run()) return false;
+
+  std::vector<short> app;
+  if (is64 && !is64Buffer) app.resize(4 * m_info.m_lx);
+
+  const int pixelSize = is64Buffer ? 8 : 4;
+
+  for (int i = 0; i < lineCount; ++i, buffer += lineStride) {
+    int row = m_row + i;
+
+    if (row < m_info.m_y0 || row > m_info.m_y1) {
+      memset(buffer + x0 * pixelSize, 0, (x1 - x0 + 1) * pixelSize);
+      continue;
     }
+
+    const UCHAR *stripBuffer = job.getStrip(row / m_rowsPerStrip);
+
+    if (is64Buffer)
+      copyRow(stripBuffer, row, (short *)buffer, x0, x1, 1);
+    else if (is64) {
+      copyRow(stripBuffer, row, &app[0], x0, x1, 1);
+
+      TPixel64 *pixin  = (TPixel64 *)&app[0] + x0;
+      TPixel32 *pixout = (TPixel32 *)buffer + x0;
+      for (int j = 0; j < (x1 - x0) + 1; j++)
+        *pixout++ = PixelConverter<TPixel32>::from(*pixin++);
+    } else
+      copyRow(stripBuffer, row, buffer, x0, x1, 1);
   }
 
-  uint16 orient = ORIENTATION_TOPLEFT;
-  TIFFGetField(m_tiff, TIFFTAG_ORIENTATION, &orient);
+  m_row += lineCount;
+  return true;
+}
 
-  int r = m_rowsPerStrip - 1 - (m_row % m_rowsPerStrip);
-  switch (orient)  // Pretty weak check for top/bottom orientation
-  {
-  case ORIENTATION_TOPLEFT:
-  case ORIENTATION_TOPRIGHT:
-  case ORIENTATION_LEFTTOP:
-  case ORIENTATION_RIGHTTOP:
-    // We have to invert the fixed BOTTOM-UP returned by TIFF functions - since
-    // this function is
-    // supposed to ignore orientation issues (which are managed outside).
+//------------------------------------------------------------
 
-    // The last tiles row will actually start at the END OF THE IMAGE (not
-    // necessarily at
-    // m_rowsPerStrip multiples). So, we must adjust for that.
+// Decodes just the strips holding the region's sampled rows and, in tiled
+// files, just the tiles intersecting the region's columns.
+bool TifReader::readRegionStrips(char *buffer, ptrdiff_t lineStride, int x0,
+                                 int y0, int x1, int y1, int shrink,
+                                 bool is64Buffer) {
+  if (m_row != 0) return false;
 
-    r = std::min(m_rowsPerStrip, m_info.m_ly - m_rowsPerStrip * m_stripIndex) -
-        1 - (m_row % m_rowsPerStrip);
-    break;
+  int lx = (x1 - x0) / shrink + 1, ly = (y1 - y0) / shrink + 1;
 
-  case ORIENTATION_BOTRIGHT:
-  case ORIENTATION_BOTLEFT:
-  case ORIENTATION_RIGHTBOT:
-  case ORIENTATION_LEFTBOT:
-    r = m_row % m_rowsPerStrip;
-    break;
+  // Collect the file rows to be read, and the strips holding them
+  std::vector<int> rows(ly), stripIndices;
+  for (int j = 0; j < ly; ++j) {
+    int y = y0 + j * shrink;
+
+    int row = rows[j] =
+        (m_rowOrder == Tiio::BOTTOM2TOP) ? y : m_info.m_ly - 1 - y;
+    if (row >= m_info.m_y0 && row <= m_info.m_y1)
+      stripIndices.push_back(row / m_rowsPerStrip);
   }
 
-  TPixel32 *pix = (TPixel32 *)buffer;
-  uint32 *v     = (uint32 *)(m_stripBuffer + r * stripRowSize);
+  stripIndices.erase(std::unique(stripIndices.begin(), stripIndices.end()),
+                     stripIndices.end());
 
-  pix += x0;
-  v += x0;
+  // Sequential reads are just as good in this case
+  if (stripIndices.size() < 2 && !TIFFIsTiled(m_tiff)) return false;
 
-  int width =
-      (x1 < x0) ? (m_info.m_lx - 1) / shrink + 1 : (x1 - x0) / shrink + 1;
+  if (!loadFileData()) return false;
 
-  for (int i = 0; i < width; i++) {
-    uint32 c = *v;
-    pix->r   = (UCHAR)TIFFGetR(c);
-    pix->g   = (UCHAR)TIFFGetG(c);
-    pix->b   = (UCHAR)TIFFGetB(c);
-    pix->m   = (UCHAR)TIFFGetA(c);
+  bool is64 = is64Buffer || decodeAs64();
 
-    v += shrink;
-    pix += shrink;
+  TifReadJob job(this, m_fileData, stripIndices, x0, x1, is64);
+  if (!job.run()) return false;
+
+  std::vector<UCHAR> line(m_info.m_lx * (is64 ? 8 : 4));
+
+  const int pixelSize = is64Buffer ? 8 : 4;
+
+  for (int j = 0; j < ly; ++j, buffer += lineStride) {
+    int row = rows[j];
+
+    if (row < m_info.m_y0 || row > m_info.m_y1) {
+      memset(buffer, 0, lx * pixelSize);
+      continue;
+    }
+
+    const UCHAR *stripBuffer = job.getStrip(row / m_rowsPerStrip);
+
+    // copyRow() stores the sampled pixels at their original positions
+    if (is64) {
+      copyRow(stripBuffer, row, (short *)&line[0], x0, x1, shrink);
+
+      const TPixel64 *pixin = (const TPixel64 *)&line[0] + x0;
+      if (is64Buffer) {
+        TPixel64 *pixout = (TPixel64 *)buffer;
+        for (int i = 0; i < lx; ++i, pixin += shrink) *pixout++ = *pixin;
+      } else {
+        TPixel32 *pixout = (TPixel32 *)buffer;
+        for (int i = 0; i < lx; ++i, pixin += shrink)
+          *pixout++ = PixelConverter<TPixel32>::from(*pixin);
+      }
+    } else {
+      copyRow(stripBuffer, row, (char *)&line[0], x0, x1, shrink);
+
+      const TPixel32 *pixin = (const TPixel32 *)&line[0] + x0;
+      TPixel32 *pixout      = (TPixel32 *)buffer;
+      for (int i = 0; i < lx; ++i, pixin += shrink) *pixout++ = *pixin;
+    }
   }
 
-  m_row++;
+  m_row = m_info.m_ly;
+  return true;
+}
+
+//------------------------------------------------------------
+
+bool TifReadJob::run() {
+  std::atomic<bool> ok(true);
+  bool done = TThread::forEachBand(
+      m_stripIndices.size(), 1, [this, &ok](int s0, int s1) {
+        if (!decodeStrips(s0, s1)) ok = false;
+      });
+
+  return done && ok;
+}
+
+//------------------------------------------------------------
+
+// Each band of strips is decoded through a private libtiff handle.
+bool TifReadJob::decodeStrips(int s0, int s1) {
+  TifMemoryStream stream(m_fileData.get());
+  TIFF *tiff = ::openTifStream("rm", stream);
+  if (!tiff) return false;
+
+  for (int strip = s0; strip < s1; ++strip) {
+    int stripIndex = m_stripIndices[strip];
+    m_reader->decodeStrip(tiff, stripIndex,
+                          &m_strips.find(stripIndex)->second[0], m_is64, m_x0,
+                          m_x1);
+  }
+
+  TIFFClose(tiff);
+  return true;
 }
 
 //============================================================
@@ -757,7 +1119,19 @@ class TifWriter final : public Tiio::Writer {
   Tiio::RowOrder m_rowOrder;
   int m_bpp;
   int m_RightToLeft;
-  void fillBits(UCHAR *bufout, UCHAR *bufin, int lx, int incr);
+  std::string m_mode;
+  uint16 m_compression;
+
+  friend class TifWriteJob;
+
+  void fillBits(UCHAR *bufout, UCHAR *bufin, int lx, int incr) const;
+
+  void convertLine(char *buffer, UCHAR *lineBuffer) const;
+  void convertLine(short *buffer, UCHAR *lineBuffer) const;
+
+  bool canWriteStrips() const;
+  bool writeStrips(char *buffer, int lineCount, ptrdiff_t lineStride,
+                   bool is64Buffer);
 
 public:
   TifWriter();
@@ -767,6 +1141,10 @@ public:
   void writeLine(char *buffer) override;
   void writeLine(short *buffer) override;
 
+  bool writeLines(char *buffer, int lineCount, ptrdiff_t lineStride) override;
+  bool writeLines(short *buffer, int lineCount,
+                  ptrdiff_t lineStride) override;
+
   void flush() override;
 
   Tiio::RowOrder getRowOrder() const override { return m_rowOrder; }
@@ -777,10 +1155,56 @@ public:
   }
 };
 
+//============================================================
+
+// Encodes the strips of a TifWriter's image concurrently.
+class TifWriteJob {
+  const TifWriter *m_writer;
+  char *m_buffer;
+  ptrdiff_t m_lineStride;
+  int m_rowsPerStrip;
+  bool m_is64;
+
+  tmsize_t m_scanlineSize;
+  uint16 m_bitsPerSample, m_samplesPerPixel, m_photometric;
+
+  std::vector<std::vector<char>> m_strips;
+
+public:
+  TifWriteJob(const TifWriter *writer, char *buffer, ptrdiff_t lineStride,
+              int rowsPerStrip, int stripsCount, bool is64)
+      : m_writer(writer)
+      , m_buffer(buffer)
+      , m_lineStride(lineStride)
+      , m_rowsPerStrip(rowsPerStrip)
+      , m_is64(is64)
+      , m_scanlineSize(TIFFScanlineSize(writer->m_tiff))
+      , m_bitsPerSample(0)
+      , m_samplesPerPixel(0)
+      , m_photometric(0)
+      , m_strips(stripsCount) {
+    TIFFGetField(writer->m_tiff, TIFFTAG_BITSPERSAMPLE, &m_bitsPerSample);
+    TIFFGetField(writer->m_tiff, TIFFTAG_SAMPLESPERPIXEL, &m_samplesPerPixel);
+    TIFFGetField(writer->m_tiff, TIFFTAG_PHOTOMETRIC, &m_photometric);
+  }
+
+  std::vector<char> &getStrip(int strip) { return m_strips[strip]; }
+
+  //! Encodes all the strips. Returns false in case of failures.
+  bool run();
+
+private:
+  bool encodeStrip(int strip, std::vector<UCHAR> &stripBuffer);
+};
+
 //------------------------------------------------------------
 
 TifWriter::TifWriter()
-    : m_tiff(0), m_row(-1), m_lineBuffer(0), m_RightToLeft(false) {
+    : m_tiff(0)
+    , m_row(-1)
+    , m_lineBuffer(0)
+    , m_RightToLeft(false)
+    , m_compression(COMPRESSION_NONE) {
   TIFFSetWarningHandler(0);
 }
 
@@ -827,6 +1251,8 @@ void TifWriter::open(FILE *file, const TImageInfo &info) {
 #endif
   if (!m_tiff) return;
 
+  m_mode = mode;
+
   std::wstring worientation =
       ((TEnumProperty *)(m_properties->getProperty("Orientation")))->getValue();
 
@@ -934,7 +1360,18 @@ void TifWriter::open(FILE *file, const TImageInfo &info) {
   TIFFSetField(m_tiff, TIFFTAG_XRESOLUTION, m_info.m_dpix);
   TIFFSetField(m_tiff, TIFFTAG_YRESOLUTION, m_info.m_dpiy);
   TIFFSetField(m_tiff, TIFFTAG_RESOLUTIONUNIT, RESUNIT_INCH);
-  TIFFSetField(m_tiff, TIFFTAG_ROWSPERSTRIP, TIFFDefaultStripSize(m_tiff, 0));
+
+  TIFFGetField(m_tiff, TIFFTAG_COMPRESSION, &m_compression);
+
+  uint32 rowsPerStrip = 0;
+  if (canWriteStrips()) {
+    // Strips larger than the default ones (8 KB) are encoded concurrently by
+    // writeLines()
+    tmsize_t scanlineSize = std::max<tmsize_t>(TIFFScanlineSize(m_tiff), 1);
+    rowsPerStrip          = std::max<tmsize_t>((256 << 10) / scanlineSize, 1);
+  }
+  TIFFSetField(m_tiff, TIFFTAG_ROWSPERSTRIP,
+               TIFFDefaultStripSize(m_tiff, rowsPerStrip));
 
   m_row = 0;
   if (m_bpp == 1)
@@ -950,7 +1387,7 @@ void TifWriter::flush() { TIFFFlush(m_tiff); }
 
 //------------------------------------------------------------
 
-void TifWriter::writeLine(short *buffer) {
+void TifWriter::convertLine(short *buffer, UCHAR *lineBuffer) const {
   int delta = 1;
   int start = 0;
   if (m_RightToLeft) {
@@ -960,7 +1397,7 @@ void TifWriter::writeLine(short *buffer) {
   if (m_bpp == 16) {
     unsigned short *pix = ((unsigned short *)buffer) + start;
     for (int i = 0; i < m_info.m_lx; i++) {
-      unsigned short *b = (unsigned short *)m_lineBuffer + i * 2;
+      unsigned short *b = (unsigned short *)lineBuffer + i * 2;
       b[0]              = pix[0];
       b[1]              = pix[1];
       pix               = pix + delta;
@@ -971,7 +1408,7 @@ void TifWriter::writeLine(short *buffer) {
 
     if (m_bpp == 64)
       for (int i = 0; i < m_info.m_lx; i++) {
-        unsigned short *b = (unsigned short *)m_lineBuffer + i * 4;
+        unsigned short *b = (unsigned short *)lineBuffer + i * 4;
         b[0]              = pix->r;
         b[1]              = pix->g;
         b[2]              = pix->b;
@@ -980,19 +1417,26 @@ void TifWriter::writeLine(short *buffer) {
       }
     else if (m_bpp == 48)
       for (int i = 0; i < m_info.m_lx; i++) {
-        unsigned short *b = (unsigned short *)m_lineBuffer + i * 3;
+        unsigned short *b = (unsigned short *)lineBuffer + i * 3;
         b[0]              = pix->r;
         b[1]              = pix->g;
         b[2]              = pix->b;
         pix               = pix + delta;
       }
   }
+}
+
+//------------------------------------------------------------
+
+void TifWriter::writeLine(short *buffer) {
+  convertLine(buffer, m_lineBuffer);
   TIFFWriteScanline(m_tiff, m_lineBuffer, m_row++, 0);
 }
 
 //------------------------------------------------------------
 
-void TifWriter::fillBits(UCHAR *bufout, UCHAR *bufin, int lx, int incr) {
+void TifWriter::fillBits(UCHAR *bufout, UCHAR *bufin, int lx,
+                         int incr) const {
   int lx1 = lx / 8 + ((lx % 8) ? 1 : 0);
 
   for (int i = 0; i < lx1; i++, bufout++) {
@@ -1005,7 +1449,7 @@ void TifWriter::fillBits(UCHAR *bufout, UCHAR *bufin, int lx, int incr) {
 
 //------------------------------------------------------
 
-void TifWriter::writeLine(char *buffer) {
+void TifWriter::convertLine(char *buffer, UCHAR *lineBuffer) const {
   int delta = 1;
   int start = 0;
   if (m_RightToLeft) {
@@ -1013,12 +1457,12 @@ void TifWriter::writeLine(char *buffer) {
     start = m_info.m_lx - 1;
   }
   if (m_bpp == 1)
-    fillBits(m_lineBuffer, ((unsigned char *)buffer) + start, m_info.m_lx,
+    fillBits(lineBuffer, ((unsigned char *)buffer) + start, m_info.m_lx,
              delta);
   else if (m_bpp == 8) {
     unsigned char *pix = ((unsigned char *)buffer) + start;
     for (int i = 0; i < m_info.m_lx; i++) {
-      unsigned char *b = m_lineBuffer + i;
+      unsigned char *b = lineBuffer + i;
       b[0]             = pix[0];
       pix              = pix + delta;
     }
@@ -1028,7 +1472,7 @@ void TifWriter::writeLine(char *buffer) {
 
     if (m_bpp == 32)
       for (int i = 0; i < m_info.m_lx; i++) {
-        unsigned char *b = m_lineBuffer + i * 4;
+        unsigned char *b = lineBuffer + i * 4;
         b[0]             = pix->r;
         b[1]             = pix->g;
         b[2]             = pix->b;
@@ -1037,16 +1481,145 @@ void TifWriter::writeLine(char *buffer) {
       }
     else if (m_bpp == 24)
       for (int i = 0; i < m_info.m_lx; i++) {
-        unsigned char *b = m_lineBuffer + i * 3;
+        unsigned char *b = lineBuffer + i * 3;
         b[0]             = pix->r;
         b[1]             = pix->g;
         b[2]             = pix->b;
         pix              = pix + delta;
       }
   }
+}
+
+//------------------------------------------------------------
+
+void TifWriter::writeLine(char *buffer) {
+  convertLine(buffer, m_lineBuffer);
   TIFFWriteScanline(m_tiff, m_lineBuffer, m_row++, 0);
 }
 
+//------------------------------------------------------------
+
+// Strips compressed with these schemes only depend on their own data, so
+// they can be encoded separately.
+bool TifWriter::canWriteStrips() const {
+  if (m_bpp == 1) return false;
+
+  switch (m_compression) {
+  case COMPRESSION_LZW:
+  case COMPRESSION_PACKBITS:
+  case COMPRESSION_ADOBE_DEFLATE:
+  case COMPRESSION_DEFLATE:
+    return true;
+  }
+
+  return false;
+}
+
+//------------------------------------------------------------
+
+bool TifWriter::writeLines(char *buffer, int lineCount, ptrdiff_t lineStride) {
+  return writeStrips(buffer, lineCount, lineStride, false);
+}
+
+//------------------------------------------------------------
+
+bool TifWriter::writeLines(short *buffer, int lineCount,
+                           ptrdiff_t lineStride) {
+  return writeStrips((char *)buffer, lineCount, lineStride, true);
+}
+
+//------------------------------------------------------------
+
+// Each strip is encoded by a private libtiff handle on an in-memory file,
+// and its compressed data is then appended to the output as raw strip.
+bool TifWriter::writeStrips(char *buffer, int lineCount, ptrdiff_t lineStride,
+                            bool is64Buffer) {
+  if (!m_tiff || m_row != 0 || lineCount != m_info.m_ly || !canWriteStrips())
+    return false;
+
+  uint32 rowsPerStrip = 0;
+  TIFFGetField(m_tiff, TIFFTAG_ROWSPERSTRIP, &rowsPerStrip);
+
+  int stripsCount = TIFFNumberOfStrips(m_tiff);
+  if (rowsPerStrip == 0 || stripsCount < 2) return false;
+
+  TifWriteJob job(this, buffer, lineStride, rowsPerStrip, stripsCount,
+                  is64Buffer);
+  if (!job.run()) return false;
+
+  // Past this point the lines can't be written again one by one
+  for (int i = 0; i < stripsCount; ++i) {
+    std::vector<char> &strip = job.getStrip(i);
+    if (TIFFWriteRawStrip(m_tiff, i, strip.data(), strip.size()) !=
+        (tmsize_t)strip.size())
+      throw TImageException(TFilePath(), "Can't write tif strip " +
+                                             std::to_string(i));
+  }
+
+  m_row = lineCount;
+  return true;
+}
+
+//------------------------------------------------------------
+
+bool TifWriteJob::run() {
+  std::atomic<bool> ok(true);
+  bool done = TThread::forEachBand(
+      m_strips.size(), 1, [this, &ok](int s0, int s1) {
+        std::vector<UCHAR> stripBuffer;
+        for (int strip = s0; strip < s1; ++strip)
+          if (!encodeStrip(strip, stripBuffer)) ok = false;
+      });
+
+  return done && ok;
+}
+
+//------------------------------------------------------------
+
+bool TifWriteJob::encodeStrip(int strip, std::vector<UCHAR> &stripBuffer) {
+  int y0   = strip * m_rowsPerStrip;
+  int rows = std::min(m_rowsPerStrip, m_writer->m_info.m_ly - y0);
+
+  stripBuffer.resize(rows * m_scanlineSize);
+  for (int r = 0; r < rows; ++r) {
+    char *line = m_buffer + (y0 + r) * m_lineStride;
+    if (m_is64)
+      m_writer->convertLine((short *)line, &stripBuffer[r * m_scanlineSize]);
+    else
+      m_writer->convertLine(line, &stripBuffer[r * m_scanlineSize]);
+  }
+
+  std::vector<char> data;
+  TifMemoryStream stream(&data);
+
+  TIFF *tiff = ::openTifStream(m_writer->m_mode.c_str(), stream);
+  if (!tiff) return false;
+
+  TIFFSetField(tiff, TIFFTAG_IMAGEWIDTH, m_writer->m_info.m_lx);
+  TIFFSetField(tiff, TIFFTAG_IMAGELENGTH, rows);
+  TIFFSetField(tiff, TIFFTAG_BITSPERSAMPLE, m_bitsPerSample);
+  TIFFSetField(tiff, TIFFTAG_SAMPLESPERPIXEL, m_samplesPerPixel);
+  TIFFSetField(tiff, TIFFTAG_COMPRESSION, m_writer->m_compression);
+  TIFFSetField(tiff, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+  TIFFSetField(tiff, TIFFTAG_PHOTOMETRIC, m_photometric);
+  TIFFSetField(tiff, TIFFTAG_ROWSPERSTRIP, rows);
+
+  bool ok = TIFFWriteEncodedStrip(tiff, 0, &stripBuffer[0],
+                                  stripBuffer.size()) >= 0;
+
+  uint64 *offsets = 0, *byteCounts = 0;
+  ok = ok && TIFFGetField(tiff, TIFFTAG_STRIPOFFSETS, &offsets) &&
+       TIFFGetField(tiff, TIFFTAG_STRIPBYTECOUNTS, &byteCounts) &&
+       offsets[0] + byteCounts[0] <= data.size();
+
+  if (ok)
+    m_strips[strip].assign(data.begin() + offsets[0],
+                           data.begin() + offsets[0] + byteCounts[0]);
+
+  TIFFClose(tiff);
+  return ok;
+}
+
 //============================================================
 #ifdef _DEBUG
 /* Error & Waring Handler per debug */
@@ -179,6 +179,9 @@ public:
 
   void save(const TFilePath &fp);
 
+  bool publish(const TFilePath &fp);
+  bool retrieve(const TFilePath &fp);
+
 private:
   bool checkRasterType(const TRasterP &ras, int &rasType) const;
   bool checkTile(const TTile &tile) const;
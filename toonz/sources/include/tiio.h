@@ -5,6 +5,7 @@
 
 #include "tcommon.h"
 #include <string>
+#include <cstddef>
 #include <QStringList>
 #include "timageinfo.h"
 
@@ -58,6 +59,36 @@ public:
   // If not implemented returns 0;
   virtual int skipLines(int lineCount) = 0;
 
+  // Reads lineCount lines at once, the same way as many readLine() calls
+  // would. Each line is stored lineStride bytes after the previous one.
+  // Readers whose format is made of independent blocks (eg tif strips) may
+  // decode them concurrently. Returns false if not supported - in that case
+  // nothing is read, and lines must be read one by one.
+  virtual bool readLines(char *buffer, int lineCount, int x0, int x1,
+                         ptrdiff_t lineStride) {
+    return false;
+  }
+  virtual bool readLines(short *buffer, int lineCount, int x0, int x1,
+                         ptrdiff_t lineStride) {
+    return false;
+  }
+
+  // Reads the [x0, x1] x [y0, y1] region of the image (y growing upwards),
+  // taking one pixel every shrink in both directions, right after open().
+  // Line j of the result, starting from the bottom one, is stored
+  // j * lineStride bytes after buffer. Readers able to decode just what the
+  // region needs (eg the intersecting tiles of a tif, or a jpeg at reduced
+  // DCT scale - which filters the pixels instead of sampling them) implement
+  // it. Returns false if not supported - in that case nothing is read.
+  virtual bool readRegion(char *buffer, ptrdiff_t lineStride, int x0, int y0,
+                          int x1, int y1, int shrink) {
+    return false;
+  }
+  virtual bool readRegion(short *buffer, ptrdiff_t lineStride, int x0, int y0,
+                          int x1, int y1, int shrink) {
+    return false;
+  }
+
   virtual RowOrder getRowOrder() const { return BOTTOM2TOP; }
   virtual bool read16BitIsEnabled() const { return false; }
 
@@ -102,6 +133,18 @@ public:
   virtual void writeLine(char *buffer) = 0;
   virtual void writeLine(short *) { assert(false); }
 
+  // Writes the whole image at once, the same way as many writeLine() calls
+  // would. Each line is stored lineStride bytes after the previous one.
+  // Returns false if not supported - in that case nothing is written, and
+  // lines must be written one by one.
+  virtual bool writeLines(char *buffer, int lineCount, ptrdiff_t lineStride) {
+    return false;
+  }
+  virtual bool writeLines(short *buffer, int lineCount,
+                          ptrdiff_t lineStride) {
+    return false;
+  }
+
   virtual void flush() {}
 
   virtual RowOrder getRowOrder() const { return BOTTOM2TOP; }
@@ -34,6 +34,7 @@ class DVAPI JpgReader final : public Tiio::Reader {
   FILE *m_chan;
   JSAMPARRAY m_buffer;
   bool m_isOpen;
+  long m_dataOffset;
 
 public:
   JpgReader();
@@ -45,6 +46,12 @@ public:
 
   void readLine(char *buffer, int x0, int x1, int shrink) override;
   int skipLines(int lineCount) override;
+
+  bool readRegion(char *buffer, ptrdiff_t lineStride, int x0, int y0, int x1,
+                  int y1, int shrink) override;
+
+private:
+  bool restart(int scale);
 };
 
 DVAPI Tiio::ReaderMaker makeJpgReader;
@@ -133,6 +133,8 @@ public:
 
   //! Returns the RAM memory size (KB) of the image associated to passed id.
   UINT getMemUsage(const std::string &id) const;
+  //! Returns the swap file size of the image associated to passed id, or 0 if
+  //! the image is in RAM.
   UINT getDiskUsage(const std::string &id) const;
 
   void dump(std::ostream &os) const;  // per debug
@@ -152,7 +154,8 @@ public:
   TImageP get(const QString &id, bool toBeModified) const;
 #endif
 
-  // compress id (in memory)
+  // compress id (in memory). The codec pass does not hold the cache lock, so
+  // other threads can keep using the cache meanwhile.
   void compress(const std::string &id);
 
 private:
@@ -7,6 +7,8 @@
 #include "timage_io.h"
 #include "tproperty.h"
 
+#include <memory>
+
 #ifdef _MSC_VER
 
 #pragma warning(disable : 4290)
@@ -116,6 +118,37 @@ public:
 
 //===========================================================
 
+/*!
+  The TLevelDirectoryIndex caches the content of the folders holding image
+  sequences, with the folder's files grouped by level name in a single pass.
+  It is shared by all level readers, so that the sequences of a folder are
+  discovered with one directory listing. A folder is listed again as soon as
+  its modification time changes.
+*/
+
+class DVAPI TLevelDirectoryIndex {
+  class Imp;
+  std::unique_ptr<Imp> m_imp;
+
+  TLevelDirectoryIndex();
+  ~TLevelDirectoryIndex();
+
+public:
+  static TLevelDirectoryIndex *instance();
+
+  //! Returns the files of the sequence with the specified level path (like
+  //! "folder/name..png"), in the folder listing order. Throws if the folder
+  //! could not be read.
+  std::vector<TFilePath> getLevelFiles(const TFilePath &levelPath);
+
+  //! Forgets the listing of the specified folder, e.g. after writing into it
+  void invalidate(const TFilePath &folder);
+  //! Forgets all the listings
+  void clear();
+};
+
+//===========================================================
+
 class TLevelWriter;
 class TPropertyGroup;
 
@@ -5,6 +5,12 @@
 
 #include <cmath>
 #include <cassert>
+#include <algorithm>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define MYPAINTHELPERS_SSE
+#endif
 
 #include "mypaint.h"
 
@@ -65,6 +71,162 @@ namespace mypaint {
         { }
 
     private:
+      struct Mask {
+        float opaque;
+        float hardness, ka0, ka1, kb1, kc1, kc2;
+        float aa, aa2, aaSqr, ddySqrMin, aspectRatioSqr;
+      };
+
+      // opacity of the dab at the specified normalized coordinates,
+      // zero outside the dab
+      template< bool enableAspect,
+                bool enableAntialiasing,
+                bool enableHardnessOne,
+                bool enableHardnessHalf >
+      static inline float calcOpacity(float ddx, float ddy, const Mask &m) {
+        if (enableAntialiasing) {
+          float dd, dr;
+          if (enableAspect) {
+            float ddxSqr = ddx*ddx;
+            float ddySqr = std::max(m.ddySqrMin, ddy*ddy);
+            dd = ddxSqr + ddySqr;
+            float k = m.aa*sqrtf(ddxSqr + ddySqr*m.aspectRatioSqr);
+            dr = k*(2.f + k/dd);
+          } else {
+            dd = ddx*ddx + ddy*ddy;
+            dr = m.aa2*sqrtf(dd) + m.aaSqr;
+          }
+
+          float dd0 = dd - dr;
+          if (dd0 > 1.f)
+            return 0.f;
+          float dd1 = dd + dr;
+
+          float o0, o1;
+          if (enableHardnessOne) {
+            o0 = dd0 < -1.f        ?  -0.5f
+               :                       0.5f*dd0;
+            o1 = dd1 <  1.f        ?   0.5f*dd1
+               :                       0.5f;
+          } else
+          if (enableHardnessHalf) {
+            o0 = dd0 < -1.f        ?  -0.25f
+               : dd0 <  0.f        ? ( 0.25f*dd0 + 0.5f )*dd0
+               :                     (-0.25f*dd0 + 0.5f )*dd0;
+            o1 = dd1 <  1.f        ? (-0.25f*dd1 + 0.5f )*dd1
+               :                       0.25f;
+          } else {
+            o0 = dd0 < -1.f        ?  -m.kc2
+               : dd0 < -m.hardness ? (-m.ka1*dd0 + m.kb1)*dd0 - m.kc1
+               : dd0 <  0.f        ? (-m.ka0*dd0 + 0.5f )*dd0
+               : dd0 <  m.hardness ? ( m.ka0*dd0 + 0.5f )*dd0
+               :                     ( m.ka1*dd0 + m.kb1)*dd0 + m.kc1;
+            o1 = dd1 <  m.hardness ? ( m.ka0*dd1 + 0.5f )*dd1
+               : dd1 <  1.f        ? ( m.ka1*dd1 + m.kb1)*dd1 + m.kc1
+               :                       m.kc2;
+          }
+          return m.opaque*(o1 - o0)/dr;
+        } else {
+          float dd = ddx*ddx + ddy*ddy;
+          if (dd > 1.f)
+            return 0.f;
+          if (enableHardnessOne)
+            return m.opaque;
+          if (enableHardnessHalf)
+            return m.opaque*(1.f - dd);
+          return m.opaque*(dd < m.hardness ? m.ka0*dd + 1.f : m.ka1*dd + m.kb1);
+        }
+      }
+
+#ifdef MYPAINTHELPERS_SSE
+      static inline __m128 select4(__m128 condition, __m128 a, __m128 b)
+        { return _mm_or_ps(_mm_and_ps(condition, a), _mm_andnot_ps(condition, b)); }
+
+      static inline __m128 poly4(__m128 x, float a, float b)
+        { return _mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(a), x), _mm_set1_ps(b)), x); }
+
+      // antialiased calcOpacity() for four pixels, with the same operations
+      // in the same order, so that the results are identical
+      template< bool enableAspect,
+                bool enableHardnessOne,
+                bool enableHardnessHalf >
+      static inline __m128 calcOpacity4(__m128 ddx, __m128 ddy, const Mask &m) {
+        const __m128 one = _mm_set1_ps(1.f);
+        const __m128 minusOne = _mm_set1_ps(-1.f);
+        const __m128 zero = _mm_setzero_ps();
+
+        __m128 dd, dr;
+        if (enableAspect) {
+          __m128 ddxSqr = _mm_mul_ps(ddx, ddx);
+          __m128 ddySqr = _mm_max_ps(_mm_set1_ps(m.ddySqrMin), _mm_mul_ps(ddy, ddy));
+          dd = _mm_add_ps(ddxSqr, ddySqr);
+          __m128 k = _mm_mul_ps(_mm_set1_ps(m.aa),
+            _mm_sqrt_ps(_mm_add_ps(ddxSqr, _mm_mul_ps(ddySqr, _mm_set1_ps(m.aspectRatioSqr)))));
+          dr = _mm_mul_ps(k, _mm_add_ps(_mm_set1_ps(2.f), _mm_div_ps(k, dd)));
+        } else {
+          dd = _mm_add_ps(_mm_mul_ps(ddx, ddx), _mm_mul_ps(ddy, ddy));
+          dr = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(m.aa2), _mm_sqrt_ps(dd)), _mm_set1_ps(m.aaSqr));
+        }
+
+        __m128 dd0 = _mm_sub_ps(dd, dr);
+        __m128 dd1 = _mm_add_ps(dd, dr);
+
+        // the ranges are tested from the last one, so that the first
+        // matching one wins, like in calcOpacity()
+        __m128 o0, o1;
+        if (enableHardnessOne) {
+          o0 = select4(_mm_cmplt_ps(dd0, minusOne), _mm_set1_ps(-0.5f),
+                       _mm_mul_ps(_mm_set1_ps(0.5f), dd0));
+          o1 = select4(_mm_cmplt_ps(dd1, one), _mm_mul_ps(_mm_set1_ps(0.5f), dd1),
+                       _mm_set1_ps(0.5f));
+        } else
+        if (enableHardnessHalf) {
+          o0 = poly4(dd0, -0.25f, 0.5f);
+          o0 = select4(_mm_cmplt_ps(dd0, zero), poly4(dd0, 0.25f, 0.5f), o0);
+          o0 = select4(_mm_cmplt_ps(dd0, minusOne), _mm_set1_ps(-0.25f), o0);
+          o1 = select4(_mm_cmplt_ps(dd1, one), poly4(dd1, -0.25f, 0.5f),
+                       _mm_set1_ps(0.25f));
+        } else {
+          __m128 hardness = _mm_set1_ps(m.hardness);
+          __m128 kc1 = _mm_set1_ps(m.kc1);
+          __m128 kc2 = _mm_set1_ps(m.kc2);
+          o0 = _mm_add_ps(poly4(dd0, m.ka1, m.kb1), kc1);
+          o0 = select4(_mm_cmplt_ps(dd0, hardness), poly4(dd0, m.ka0, 0.5f), o0);
+          o0 = select4(_mm_cmplt_ps(dd0, zero), poly4(dd0, -m.ka0, 0.5f), o0);
+          o0 = select4(_mm_cmplt_ps(dd0, _mm_sub_ps(zero, hardness)),
+                       _mm_sub_ps(poly4(dd0, -m.ka1, m.kb1), kc1), o0);
+          o0 = select4(_mm_cmplt_ps(dd0, minusOne), _mm_sub_ps(zero, kc2), o0);
+          o1 = select4(_mm_cmplt_ps(dd1, one), _mm_add_ps(poly4(dd1, m.ka1, m.kb1), kc1), kc2);
+          o1 = select4(_mm_cmplt_ps(dd1, hardness), poly4(dd1, m.ka0, 0.5f), o1);
+        }
+
+        __m128 o = _mm_div_ps(_mm_mul_ps(_mm_set1_ps(m.opaque), _mm_sub_ps(o1, o0)), dr);
+        return _mm_and_ps(_mm_cmple_ps(dd0, one), o);
+      }
+#endif
+
+      // antialiased opacities of count pixels at the specified normalized
+      // coordinates
+      template< bool enableAspect,
+                bool enableHardnessOne,
+                bool enableHardnessHalf >
+      static inline void calcOpacities(
+          float *opacity, const float *ddx, const float *ddy, int count,
+          const Mask &m )
+      {
+        int i = 0;
+#ifdef MYPAINTHELPERS_SSE
+        for(; i + 4 <= count; i += 4)
+          _mm_storeu_ps(opacity + i,
+            calcOpacity4<enableAspect, enableHardnessOne, enableHardnessHalf>(
+              _mm_loadu_ps(ddx + i), _mm_loadu_ps(ddy + i), m ));
+#endif
+        for(; i < count; ++i)
+          opacity[i] =
+            calcOpacity<enableAspect, true, enableHardnessOne, enableHardnessHalf>(
+              ddx[i], ddy[i], m );
+      }
+
       template< bool enableAspect,         // 2 variants
                 bool enableAntialiasing,   // 1 variants (true)
                 bool enableHardnessOne,    // 3 variants
@@ -116,9 +278,7 @@ namespace mypaint {
         // prepare pixel iterator
         int w = x1 - x0 + 1;
         int h = y1 - y0 + 1;
-        char *pixel = (char*)pointer + rowSize*y0 + pixelSize*x0;
-        int pixelNextCol = pixelSize;
-        int pixelNextRow = rowSize - w*pixelSize;
+        char *row = (char*)pointer + rowSize*y0 + pixelSize*x0;
 
         // prepare geometry iterators
         float radiusInv = 1.f/dab.radius;
@@ -151,48 +311,47 @@ namespace mypaint {
         }
 
         // prepare antialiasing
-        float hardness, ka0, ka1, kb1, kc1, kc2;
-        float aa, aa2, aaSqr, ddySqrMin, aspectRatioSqr;
+        Mask m;
+        m.opaque = dab.opaque;
         if (enableAntialiasing) {
           if (enableHardnessOne) {
           } else
           if (enableHardnessHalf) {
-            ka0 = 0.25f;
-            kc2 = 0.75f;
+            m.ka0 = 0.25f;
+            m.kc2 = 0.75f;
           } else {
-            hardness = std::min(dab.hardness, 1.f - precision);
-            float hk = hardness/(hardness - 1.f);
-            ka0 = 0.25f/hk;
-            ka1 = 0.25f*hk;
-            kb1 = -0.5f*hk;
-            kc1 = ((ka0 - ka1)*hardness + 0.5f - kb1)*hardness;
-            kc2 = ka1 + kb1 + kc1;
+            m.hardness = std::min(dab.hardness, 1.f - precision);
+            float hk = m.hardness/(m.hardness - 1.f);
+            m.ka0 = 0.25f/hk;
+            m.ka1 = 0.25f*hk;
+            m.kb1 = -0.5f*hk;
+            m.kc1 = ((m.ka0 - m.ka1)*m.hardness + 0.5f - m.kb1)*m.hardness;
+            m.kc2 = m.ka1 + m.kb1 + m.kc1;
           }
 
-          aa = antialiasing*radiusInv;
+          m.aa = antialiasing*radiusInv;
           if (enableAspect) {
-            ddySqrMin = 0.5f*aa*dab.aspectRatio;
-            ddySqrMin *= ddySqrMin;
-            aspectRatioSqr = dab.aspectRatio*dab.aspectRatio;
+            m.ddySqrMin = 0.5f*m.aa*dab.aspectRatio;
+            m.ddySqrMin *= m.ddySqrMin;
+            m.aspectRatioSqr = dab.aspectRatio*dab.aspectRatio;
           } else {
-            aa2 = aa + aa;
-            aaSqr = aa*aa;
+            m.aa2 = m.aa + m.aa;
+            m.aaSqr = m.aa*m.aa;
           }
         } else {
           if (enableHardnessOne) {
           } else
           if (enableHardnessHalf) {
           } else {
-            hardness = std::min(dab.hardness, 1.f - precision);
-            float hk = hardness/(hardness - 1.f);
-            ka0 = 1.f/hk;
-            ka1 = hk;
-            kb1 = -hk;
+            m.hardness = std::min(dab.hardness, 1.f - precision);
+            float hk = m.hardness/(m.hardness - 1.f);
+            m.ka0 = 1.f/hk;
+            m.ka1 = hk;
+            m.kb1 = -hk;
           }
         }
 
         // prepare blend
-        float opaque = dab.opaque;
         float colorR, colorG, colorB;
         if (enableBlendNormal || enableBlendLockAlpha || enableBlendColorize) {
           colorR = dab.colorR;
@@ -215,68 +374,7 @@ namespace mypaint {
         }
 
         // process
-        for(int iy = h; iy; --iy, ddx += ddxNextRow, ddy += ddyNextRow, pixel += pixelNextRow)
-        for(int ix = w; ix; --ix, ddx += ddxNextCol, ddy += ddyNextCol, pixel += pixelNextCol) {
-          float o;
-          if (enableAntialiasing) {
-            float dd, dr;
-            if (enableAspect) {
-              float ddxSqr = ddx*ddx;
-              float ddySqr = std::max(ddySqrMin, ddy*ddy);
-              dd = ddxSqr + ddySqr;
-              float k = aa*sqrtf(ddxSqr + ddySqr*aspectRatioSqr);
-              dr = k*(2.f + k/dd);
-            } else {
-              dd = ddx*ddx + ddy*ddy;
-              dr = aa2*sqrtf(dd) + aaSqr;
-            }
-
-            float dd0 = dd - dr;
-            if (dd0 > 1.f)
-              continue;
-            float dd1 = dd + dr;
-
-            float o0, o1;
-            if (enableHardnessOne) {
-              o0 = dd0 < -1.f      ?  -0.5f
-                 :                     0.5f*dd0;
-              o1 = dd1 <  1.f      ?   0.5f*dd1
-                 :                     0.5f;
-            } else
-            if (enableHardnessHalf) {
-              o0 = dd0 < -1.f      ?  -0.25f
-                 : dd0 <  0.f      ? ( 0.25f*dd0 + 0.5f )*dd0
-                 :                   (-0.25f*dd0 + 0.5f )*dd0;
-              o1 = dd1 <  1.f      ? (-0.25f*dd1 + 0.5f )*dd1
-                 :                     0.25f;
-            } else {
-              o0 = dd0 < -1.f      ?  -kc2
-                 : dd0 < -hardness ? (-ka1*dd0   + kb1  )*dd0 - kc1
-                 : dd0 <  0.f      ? (-ka0*dd0   + 0.5f )*dd0
-                 : dd0 <  hardness ? ( ka0*dd0   + 0.5f )*dd0
-                 :                   ( ka1*dd0   + kb1  )*dd0 + kc1;
-              o1 = dd1 <  hardness ? ( ka0*dd1   + 0.5f )*dd1
-                 : dd1 <  1.f      ? ( ka1*dd1   + kb1  )*dd1 + kc1
-                 :                     kc2;
-            }
-            o = opaque*(o1 - o0)/dr;
-          } else {
-            float dd = ddx*ddx + ddy*ddy;
-            if (dd > 1.f)
-              continue;
-            if (enableHardnessOne) {
-              o = opaque;
-            } else
-            if (enableHardnessHalf) {
-              o = opaque*(1.f - dd);
-            } else {
-              o = opaque*(dd <  hardness ? ka0*dd + 1.f : ka1*dd + kb1);
-            }
-          }
-
-          if (o <= precision)
-            continue;
-
+        auto blend = [&](char *pixel, float o) {
           // read pixel
           float destR, destG, destB, destA;
           read(pixel, destR, destG, destB, destA);
@@ -296,7 +394,7 @@ namespace mypaint {
           }
 
           if (!enableBlendNormal && !enableBlendLockAlpha && !enableBlendColorize)
-            continue;
+            return;
 
           if (enableBlendNormal) {
             float oa = blendNormal*o;
@@ -362,6 +460,40 @@ namespace mypaint {
           destA = std::min(std::max(destA, 0.f), 1.f);
 
           write(pixel, destR, destG, destB, destA);
+        };
+
+        if (enableAntialiasing) {
+          // the opacities of a chunk of the row are computed first, several
+          // pixels at a time, then the covered pixels are blended. The
+          // coordinates are stepped pixel by pixel as before, so that the
+          // dab shape does not change.
+          const int chunkSize = 64;
+          float chunkDdx[chunkSize], chunkDdy[chunkSize], opacity[chunkSize];
+          for(int iy = h; iy; --iy, ddx += ddxNextRow, ddy += ddyNextRow, row += rowSize)
+          for(int i0 = 0; i0 < w; i0 += chunkSize) {
+            int count = std::min(chunkSize, w - i0);
+            for(int i = 0; i < count; ++i, ddx += ddxNextCol, ddy += ddyNextCol) {
+              chunkDdx[i] = ddx;
+              chunkDdy[i] = ddy;
+            }
+            calcOpacities<enableAspect, enableHardnessOne, enableHardnessHalf>(
+              opacity, chunkDdx, chunkDdy, count, m );
+
+            char *pixel = row + i0*pixelSize;
+            for(int i = 0; i < count; ++i, pixel += pixelSize)
+              if (opacity[i] > precision)
+                blend(pixel, opacity[i]);
+          }
+        } else {
+          // the opacity is cheap enough to be computed along with the blend
+          for(int iy = h; iy; --iy, ddx += ddxNextRow, ddy += ddyNextRow, row += rowSize) {
+            char *pixel = row;
+            for(int ix = w; ix; --ix, ddx += ddxNextCol, ddy += ddyNextCol, pixel += pixelSize) {
+              float o = calcOpacity<enableAspect, false, enableHardnessOne, enableHardnessHalf>(ddx, ddy, m);
+              if (o > precision)
+                blend(pixel, o);
+            }
+          }
         }
 
         if (enableSummary) {
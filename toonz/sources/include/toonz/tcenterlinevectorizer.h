@@ -9,6 +9,7 @@
 #include <list>
 
 #include <QObject>
+#include <QAtomicInt>
 
 #undef DVAPI
 #undef DVVAR
@@ -37,7 +38,7 @@ user cancels.
 class DVAPI VectorizerCore final : public QObject {
   Q_OBJECT
 
-  int m_currPartial;
+  QAtomicInt m_currPartial;  //!< Partials may be notified by multiple threads
   int m_totalPartials;
 
   bool m_isCanceled;
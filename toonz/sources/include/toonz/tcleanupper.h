@@ -52,21 +52,41 @@ public:
 };
 
 //****************************************************************************************
-//    TCleanupper singleton declaration
+//    TCleanupper declaration
 //****************************************************************************************
 
+/*!
+  TCleanupper performs the cleanup of raster images according to a set of
+  CleanupParameters.
+
+  The application-wide instance() is the one used by the GUI. Further
+  instances can be built as independent cleanup contexts: as long as each
+  one is given its own parameters, they can process different frames
+  concurrently. Independent contexts do not notify warnings through DVGui -
+  callers are supposed to inspect the returned CleanupPreprocessedImage.
+
+\warning The auto-adjust pre-processing keeps a reference histogram in
+global state, and must not be used concurrently.
+*/
+
 class DVAPI TCleanupper {
   CleanupParameters *m_parameters;
   TPointD m_sourceDpi;
+  bool m_notifyWarnings;
 
 private:
-  TCleanupper()
-      : m_parameters(0) {
-  }  // singleton class - will not be externally constructed
+  explicit TCleanupper(bool notifyWarnings)
+      : m_parameters(0), m_notifyWarnings(notifyWarnings) {}
 
 public:
+  TCleanupper() : m_parameters(0), m_notifyWarnings(false) {}
+
   static TCleanupper *instance();
 
+  //! Returns whether frames cleanupped with the current parameters can be
+  //! processed by concurrent contexts.
+  bool isReentrant() const;
+
   void setParameters(CleanupParameters *parameters);
   const CleanupParameters *getParameters() const { return m_parameters; }
 
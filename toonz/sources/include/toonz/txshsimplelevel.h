@@ -193,8 +193,12 @@ table) it returns the proper insertion index
     return getFrame(
         fid, toBeModified ? ImageManager::toBeModified : ImageManager::none, 0);
   }
-  TImageP getFullsampledFrame(const TFrameId &fid,
-                              UCHAR imgManagerParamsMask) const;
+  //! Returns the full resolution image at the specified fid. A non-empty
+  //! region may be specified for images not to be cached, in which case just
+  //! that part of the image is loaded - but only if the image is not already
+  //! available in full.
+  TImageP getFullsampledFrame(const TFrameId &fid, UCHAR imgManagerParamsMask,
+                              const TRect &region = TRect()) const;
 
   TImageInfo *getFrameInfo(const TFrameId &fid, bool toBeModified);
   TImageP getFrameIcon(const TFrameId &fid) const;
@@ -272,6 +276,11 @@ Editable range is contained in \b m_editableRange.
   void load() override;
   void load(const std::vector<TFrameId> &fIds);
 
+  //! Performs the file accesses of load() in advance - that is, reads the
+  //! level files' infos. No file is left open. Different levels may be
+  //! preloaded concurrently; the next load() call picks the results up.
+  void preload();
+
   //! Saves the level to disk, with the same path deduction from load()
   void save() override;
 
@@ -355,6 +364,8 @@ public Q_SLOTS:
 private:
   typedef boost::container::flat_set<TFrameId> FramesSet;
 
+  struct PreloadData;
+
 private:
   std::unique_ptr<LevelProperties> m_properties;
   std::unique_ptr<TContentHistory> m_contentHistory;
@@ -376,6 +387,8 @@ private:
 
   TFilePath m_path, m_scannedPath;
 
+  std::unique_ptr<PreloadData> m_preloadData;  //!< Data read by preload()
+
   std::string m_idBase;
   std::wstring m_editableRangeUserInfo;
 
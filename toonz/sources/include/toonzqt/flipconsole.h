@@ -19,6 +19,12 @@
 #include "toonz/imagepainter.h"
 #include "tstopwatch.h"
 #include <QThread>
+#include <QThreadPool>
+#include <QMutex>
+#include <QWaitCondition>
+
+#include <set>
+#include <memory>
 
 #undef DVAPI
 #undef DVVAR
@@ -52,20 +58,71 @@ class PlaybackExecutor final : public QThread {
 
   int m_fps;
   bool m_abort;
+  bool m_dropFrames;
 
 public:
   PlaybackExecutor();
 
   void resetFps(int fps);
+  void enableFrameDropping(bool enable) { m_dropFrames = enable; }
 
   void run() override;
   void abort() { m_abort = true; }
 
-  void emitNextFrame(int fps) { emit nextFrame(fps); }
+  void emitNextFrame(int fps, int droppedFrames) {
+    emit nextFrame(fps, droppedFrames);
+  }
 
 signals:
-  void nextFrame(int fps);  // Must be connect with Qt::BlockingQueuedConnection
-                            // connection type.
+  // Must be connect with Qt::BlockingQueuedConnection connection type.
+  // droppedFrames is the number of frames to be skipped before showing the
+  // next one, in case the playback could not keep the required pace.
+  void nextFrame(int fps, int droppedFrames);
+};
+
+//-----------------------------------------------------------------------------
+
+/*!
+  The PlaybackPrefetcher decodes the frames about to be played on a pool of
+  worker threads, running the jobs returned by
+  FlipConsoleOwner::getPrefetchJob() when the frames are requested.
+
+  The number of frames decoded ahead adapts to the measured decoding time.
+  Requests are identified by a generation number, so that a cancel() makes
+  all the pending ones stale at once.
+*/
+
+class PlaybackPrefetcher {
+  class Task;
+
+  FlipConsoleOwner *m_owner;
+  QThreadPool m_pool;
+
+  QMutex m_mutex;
+  QWaitCondition m_frameDecoded;
+
+  int m_generation;
+  std::set<int> m_requestedFrames, m_decodingFrames;
+  double m_decodeTime;  //!< Mean frame decoding time, in msecs
+
+public:
+  PlaybackPrefetcher(FlipConsoleOwner *owner);
+  ~PlaybackPrefetcher();
+
+  //! Returns the number of frames to be decoded ahead at the specified fps.
+  int getLookAhead(int fps);
+
+  //! Requests the specified frames, sorted by decreasing priority. Requested
+  //! frames not included in the list are dropped if not yet started.
+  void prefetch(const std::vector<int> &frames,
+                const ImagePainter::VisualSettings &settings);
+
+  //! Waits until the specified frame is no longer being decoded.
+  void waitForFrame(int frame);
+
+  //! Drops all pending requests. If waitRunning is true, waits for the ones
+  //! already started, too.
+  void cancel(bool waitRunning = false);
 };
 
 //-----------------------------------------------------------------------------
@@ -241,6 +298,13 @@ public:
               bool enableBlanks = false);
   void enableBlanks(bool state);
 
+  // Enables decoding ahead of the frames to be played, through
+  // FlipConsoleOwner::getPrefetchJob(). Frames the playback is late on are
+  // dropped to keep the required fps.
+  void enablePrefetch(bool enable);
+  void cancelPrefetch();
+  int getDroppedFramesCount() const { return m_droppedFramesCount; }
+
   void setFrameRange(
       int from, int to, int step,
       int current = -1);  // if current==-1, current position will be ==from
@@ -293,7 +357,7 @@ public:
   }
 
   bool isLinkable() const { return m_isLinkable; }
-  void playNextFrame();
+  void playNextFrame(int droppedFrames = 0);
   void updateCurrentFPS(int val);
 
   bool hasButton(std::vector<int> buttonMask, FlipConsole::EGadget buttonId) {
@@ -314,6 +378,8 @@ private:
   QString m_customizeId;
   QAction *m_customAction;
   PlaybackExecutor m_playbackExecutor;
+  std::unique_ptr<PlaybackPrefetcher> m_prefetcher;
+  int m_droppedFramesCount;
 
   QAction *m_customSep, *m_rateSep, *m_histoSep, *m_bgSep, *m_vcrSep,
       *m_compareSep, *m_saveSep, *m_colorFilterSep, *m_soundSep, *m_subcamSep,
@@ -374,6 +440,7 @@ private:
   static void pressLinkedConsoleButton(UINT button, FlipConsole *skipIt);
   void applyCustomizeMask();
   void onLoadBox(bool isDefine);
+  void prefetchNextFrames();
 
   QPushButton *m_enableBlankFrameButton;
 
@@ -393,7 +460,7 @@ protected slots:
   }
   void onButtonPressed(int button);
   void incrementCurrentFrame(int delta);
-  void onNextFrame(int fps);
+  void onNextFrame(int fps, int droppedFrames);
   void onCustomizeButtonPressed(QAction *);
   bool drawBlanks(int from, int to);
   void onSliderRelease();
@@ -11,6 +11,8 @@
 
 #include "toonzqt/flipconsole.h"
 
+#include <functional>
+
 class FlipConsole;
 
 class FlipConsoleOwner {
@@ -18,6 +20,15 @@ public:
   virtual void onDrawFrame(int frame,
                            const ImagePainter::VisualSettings &settings) = 0;
 
+  // Returns the decoding of the image of the specified frame ahead of its
+  // drawing, or an empty function. Called on the main thread, and only when
+  // prefetching is enabled on the console; the returned function runs on a
+  // worker thread instead, so it must hold copies of all the data it needs.
+  virtual std::function<void()> getPrefetchJob(
+      int frame, const ImagePainter::VisualSettings &settings) {
+    return std::function<void()>();
+  };
+
   virtual void swapBuffers(){};
   virtual void changeSwapBehavior(bool enable){};
 };
@@ -0,0 +1,76 @@
+#pragma once
+
+#ifndef TSHAREDCACHEMANAGER_H
+#define TSHAREDCACHEMANAGER_H
+
+#include <memory>
+
+#include "tfxcachemanager.h"
+
+#include "tfilepath.h"
+#include "tfx.h"
+
+#undef DVAPI
+#undef DVVAR
+#ifdef TFX_EXPORTS
+#define DVAPI DV_EXPORT_API
+#define DVVAR DV_EXPORT_VAR
+#else
+#define DVAPI DV_IMPORT_API
+#define DVVAR DV_IMPORT_VAR
+#endif
+
+//=========================================================================
+
+//======================================
+//    TSharedCacheManager class
+//--------------------------------------
+
+/*!
+The TSharedCacheManager is the TFxCacheManagerDelegate used to share fx
+render results among different processes - typically, the nodes of a render
+farm - through a common folder.
+
+Resources are stored in the shared folder under a content key, which is
+a hash of the resource alias (which in turn describes the fx subtree and
+the parameters of all its nodes at the rendered frame), of the render
+settings and of a user-specified key prefix. The latter should describe
+whatever the aliases do not - like the modification dates of the scene's
+level files.
+
+Resources computed during the render of a frame are published at the end of
+the frame. Publication is atomic, meaning that a process either finds an
+entry complete, or does not find it at all.
+
+The manager is inactive until a shared folder is specified through the
+setRootPath() method.
+*/
+
+class DVAPI TSharedCacheManager final : public TFxCacheManagerDelegate {
+  T_RENDER_RESOURCE_MANAGER
+
+  class Imp;
+  std::unique_ptr<Imp> m_imp;
+
+public:
+  TSharedCacheManager();
+  ~TSharedCacheManager();
+
+  static TSharedCacheManager *instance();
+
+  static void setRootPath(const TFilePath &rootPath);
+  static TFilePath getRootPath();
+
+  static void setKeyPrefix(const std::string &keyPrefix);
+  static std::string getKeyPrefix();
+
+  void getResource(TCacheResourceP &resource, const std::string &alias,
+                   const TFxP &fx, double frame, const TRenderSettings &rs,
+                   ResourceDeclaration *resData) override;
+
+  void onRenderStatusStart(int renderStatus) override;
+  void onRenderFrameEnd(double frame) override;
+  void onRenderInstanceEnd(unsigned long renderId) override;
+};
+
+#endif  // TSHAREDCACHEMANAGER_H
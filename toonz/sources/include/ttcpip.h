@@ -48,6 +48,15 @@ public:
 
   int getExitCode() const;
 
+  // Drops the connections that send nothing for msecs (0, the default,
+  // waits forever). Must be called before start().
+  void setReceiveTimeout(int msecs);
+
+  // By default onReceive() handles one request at a time; servers guarding
+  // their own state may let requests overlap, e.g. to accept a cancel while
+  // a long request is still running.
+  void setSerializedReceive(bool serialized);
+
 private:
   std::shared_ptr<TTcpIpServerImp> m_imp;
 };
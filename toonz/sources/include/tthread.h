@@ -7,6 +7,8 @@
 
 #include <QThread>
 
+#include <functional>
+
 #undef DVAPI
 #undef DVVAR
 #ifdef TNZCORE_EXPORTS
@@ -238,6 +240,19 @@ private:
   Executor(const Executor &);
 };
 
+//------------------------------------------------------------------------------
+
+/*!
+  Splits [0, count) in contiguous bands of at least \b grain indices (typically
+  rows of an image), and calls func(begin, end) on each of them - on the
+  calling thread and on the idle threads of the global QThreadPool.
+
+  The calling thread processes bands too, so the call completes even when it
+  is made from inside pool threads. Returns false if any call threw.
+*/
+DVAPI bool forEachBand(int count, int grain,
+                       const std::function<void(int, int)> &func);
+
 }  // namespace TThread
 
 #endif  // TTHREAD_H
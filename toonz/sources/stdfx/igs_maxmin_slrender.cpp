@@ -100,6 +100,152 @@ void set_begin_ptr_(const std::vector<std::vector<double>> &tracks,
                            : 0;
   }
 }
+/*
+        van Herk/Gil-Werman法で、track[offset + xx]から幅sizeの範囲の
+        最大値(min_swなら最小値)を、幅に関係なく一画素あたり一定の手間で求める
+        window.at(xx) = max(track[offset + xx] ... track[offset + xx + size - 1])
+        xx = 0 ... window.size() - 1
+        workは、size毎に区切った区間の、後ろ端までの最大値の一時置き場
+*/
+template <class FUNC>
+void window_maxmin_(const std::vector<double> &track, const int offset,
+                    const int size, FUNC func, std::vector<double> &work,
+                    std::vector<double> &window) {
+  const double *tt = &track.at(offset);
+  const int count  = static_cast<int>(window.size()) + size - 1;
+  /* 区間の後ろ端から前に向かって */
+  for (int xx = count - 1; 0 <= xx; --xx) {
+    work.at(xx) = ((xx + 1) % size == 0 || xx == count - 1)
+                      ? tt[xx]
+                      : func(tt[xx], work.at(xx + 1));
+  }
+  /* 区間の前端から後ろに向かって、前の区間の残りと合わせる */
+  double head = 0.0;
+  for (int xx = 0; xx < count; ++xx) {
+    head = (xx % size == 0) ? tt[xx] : func(head, tt[xx]);
+    if (size - 1 <= xx) {
+      window.at(xx - size + 1) = func(work.at(xx - size + 1), head);
+    }
+  }
+}
+double max_(const double a, const double b) { return (a < b) ? b : a; }
+double min_(const double a, const double b) { return (b < a) ? b : a; }
+/*
+        レンズの形が全画素で同じ場合の処理
+        比重が1の範囲(各行で連続している)は、その範囲の最大値(最小値)だけが
+        結果に効くので、行毎にwindow_maxmin_()で求めてからまとめる
+        比重が1未満の外縁の画素はmaxmin_()と同じく一つずつ処理する
+*/
+void render_fixed_lens_(const bool min_sw, const std::vector<int> &lens_offsets,
+                        const std::vector<int> &lens_sizes,
+                        const std::vector<std::vector<double>> &lens_ratio,
+                        const std::vector<std::vector<double>> &tracks,
+                        std::vector<double> &result) {
+  const int width = static_cast<int>(result.size());
+
+  /* 比重1の範囲の最大値(min_swなら最小値)、無ければsrc以下の値 */
+  std::vector<double> inner(width, min_sw ? 1.0 : 0.0);
+  std::vector<double> window(width);
+  std::vector<double> work;
+
+  /* 比重1未満の外縁の画素 */
+  std::vector<int> ring_yy;
+  std::vector<int> ring_xx;
+  std::vector<double> ring_ratio;
+
+  for (unsigned yy = 0; yy < lens_offsets.size(); ++yy) {
+    const int sz = lens_sizes.at(yy);
+    if (lens_offsets.at(yy) < 0 || sz <= 0) {
+      continue;
+    }
+    const std::vector<double> &ratio = lens_ratio.at(yy);
+
+    /* 比重1の範囲 */
+    int xb = 0;
+    while (xb < sz && ratio.at(xb) < 1.0) {
+      ++xb;
+    }
+    int xe = xb;
+    while (xe < sz && 1.0 <= ratio.at(xe)) {
+      ++xe;
+    }
+    for (int xx = 0; xx < sz; ++xx) {
+      if (xb <= xx && xx < xe) {
+        continue;
+      }
+      ring_yy.push_back(yy);
+      ring_xx.push_back(lens_offsets.at(yy) + xx);
+      ring_ratio.push_back(ratio.at(xx));
+    }
+    if (xe <= xb) {
+      continue;
+    }
+
+    work.resize(width + xe - xb - 1);
+    if (min_sw) {
+      window_maxmin_(tracks.at(yy), lens_offsets.at(yy) + xb, xe - xb, min_,
+                     work, window);
+      for (int xx = 0; xx < width; ++xx) {
+        inner.at(xx) = min_(inner.at(xx), window.at(xx));
+      }
+    } else {
+      window_maxmin_(tracks.at(yy), lens_offsets.at(yy) + xb, xe - xb, max_,
+                     work, window);
+      for (int xx = 0; xx < width; ++xx) {
+        inner.at(xx) = max_(inner.at(xx), window.at(xx));
+      }
+    }
+  }
+
+  /*
+  maxmin_()と同じ計算で結果を出す、最大(最小)を取るだけなので順序は問わない
+  暗を広げる場合、反転して判断し、結果は反転して戻す
+  */
+  std::vector<double> base(result); /* 元値(min_swなら反転した値) */
+  if (min_sw) {
+    for (int xx = 0; xx < width; ++xx) {
+      base.at(xx) = 1.0 - base.at(xx);
+    }
+  }
+  const double *bb = &base.at(0);
+  const double *in = &inner.at(0);
+  double *res      = &result.at(0);
+  for (int xx = 0; xx < width; ++xx) {
+    const double crnt = min_sw ? 1.0 - in[xx] : in[xx];
+    res[xx] = (bb[xx] < crnt) ? bb[xx] + (crnt - bb[xx]) * 1.0 : bb[xx];
+  }
+  for (unsigned ii = 0; ii < ring_yy.size(); ++ii) {
+    const double *xptr = &tracks.at(ring_yy.at(ii)).at(ring_xx.at(ii));
+    const double rr    = ring_ratio.at(ii);
+    /* 元値以下の画素は元値(res以下)になるので、分岐せずに並べて計算する */
+    if (min_sw) {
+      for (int xx = 0; xx < width; ++xx) {
+        const double diff = (1.0 - xptr[xx]) - bb[xx];
+        const double crnt = bb[xx] + ((0.0 < diff) ? diff : 0.0) * rr;
+        res[xx]           = (res[xx] < crnt) ? crnt : res[xx];
+      }
+    } else {
+      for (int xx = 0; xx < width; ++xx) {
+        const double diff = xptr[xx] - bb[xx];
+        const double crnt = bb[xx] + ((0.0 < diff) ? diff : 0.0) * rr;
+        res[xx]           = (res[xx] < crnt) ? crnt : res[xx];
+      }
+    }
+  }
+  if (min_sw) {
+    for (int xx = 0; xx < width; ++xx) {
+      res[xx] = 1.0 - res[xx];
+    }
+  }
+}
+bool is_fixed_ratio_(const std::vector<double> &alpha_ref) {
+  for (unsigned xx = 0; xx < alpha_ref.size(); ++xx) {
+    if (alpha_ref.at(xx) != 1.0) {
+      return false;
+    }
+  }
+  return true;
+}
 }
 /* --- tracksをレンダリングする --------------------------------------*/
 void igs::maxmin::slrender::render(
@@ -125,7 +271,7 @@ void igs::maxmin::slrender::render(
   set_begin_ptr_(tracks, lens_offsets, 0, begin_ptr);
 
   /* 効果半径に変化がある場合 */
-  if (0 < alpha_ref.size()) {
+  if (0 < alpha_ref.size() && !is_fixed_ratio_(alpha_ref)) {
     double before_radius = 0.0;
     for (unsigned xx = 0; xx < result.size(); ++xx) {
       /* 次の処理の半径 */
@@ -162,17 +308,15 @@ void igs::maxmin::slrender::render(
   }
   /* 効果半径が変わらない場合 */
   else {
-    for (unsigned xx = 0; xx < result.size(); ++xx) {
-      /* 各ピクセルの処理 */
-      result.at(xx) =
-          maxmin_(result.at(xx), min_sw, begin_ptr, lens_sizes, lens_ratio);
-
-      /* 次の位置へ移動 */
-      for (unsigned ii = 0; ii < begin_ptr.size(); ++ii) {
-        if (begin_ptr.at(ii) != 0) {
-          ++begin_ptr.at(ii);
-        }
-      }
+    if (0 < alpha_ref.size()) {
+      /* 前のscanlineで変えたlensの形を元に戻す */
+      igs::maxmin::reshape_lens_matrix(
+          radius, igs::maxmin::outer_radius_from_radius(radius,
+                                                        smooth_outer_range),
+          igs::maxmin::diameter_from_outer_radius(radius + smooth_outer_range),
+          polygon_number, roll_degree, lens_offsets, lens_sizes, lens_ratio);
     }
+    render_fixed_lens_(min_sw, lens_offsets, lens_sizes, lens_ratio, tracks,
+                       result);
   }
 }
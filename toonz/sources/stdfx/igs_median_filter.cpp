@@ -1,9 +1,9 @@
 #include <cmath>
 #include <vector>
-#include <algorithm>  // std::sort()
-#include <stdexcept>  /* std::domain_error(-) */
-#include <limits>     /* std::numeric_limits */
+#include <stdexcept> /* std::domain_error(-) */
+#include <limits>    /* std::numeric_limits */
 #include "igs_ifx_common.h"
+#include "igs_median_histogram.h"
 
 namespace igs {
 namespace median_filter {
@@ -15,12 +15,8 @@ enum out_of_image {
 };
 class pixrender {
 public:
-  pixrender(double radius, igs::median_filter::out_of_image type);
-  std::vector<int> xp;
-  std::vector<int> yp;
-  std::vector<int> around;
+  pixrender(igs::median_filter::out_of_image type);
   void position(const int ww, const int hh, int &xx, int &yy);
-  void clear(void);
 
 private:
   pixrender();
@@ -30,59 +26,8 @@ private:
 }
 //------------------------------------------------------------
 igs::median_filter::pixrender::pixrender(
-    const double radius, const igs::median_filter::out_of_image type)
-    : type_(type) {
-  const int radius_int = (int)ceil(radius);
-  int size             = 0;
-
-  for (int yy = -radius_int; yy <= radius_int; ++yy) {
-    for (int xx = -radius_int; xx <= radius_int; ++xx) {
-      /***
-const double xr = xx / radius;
-const double yr = yy / radius;
-if ( sqrt(xr * xr + yr * yr) <= (1.0 + 1e-6) ){
-++size;
-}
-***/
-      const double xr = static_cast<double>(xx);
-      const double yr = static_cast<double>(yy);
-      if ((xr * xr + yr * yr) <= (radius * radius + 1e-6)) {
-        ++size;
-      }
-    }
-  }
-
-  this->xp.resize(size);
-  this->yp.resize(size);
-  this->around.resize(size);
-
-  int ii = 0;
-  for (int yy = -radius_int; yy <= radius_int; ++yy) {
-    for (int xx = -radius_int; xx <= radius_int; ++xx) {
-      /***
-const double xr = xx / radius;
-const double yr = yy / radius;
-if ( sqrt(xr * xr + yr * yr) <= (1.0 + 1e-6) ){
-this->xp.at(ii) = xx;
-this->yp.at(ii) = yy;
-++ii;
-}
-***/
-      const double xr = static_cast<double>(xx);
-      const double yr = static_cast<double>(yy);
-      if ((xr * xr + yr * yr) <= (radius * radius + 1e-6)) {
-        this->xp.at(ii) = xx;
-        this->yp.at(ii) = yy;
-        ++ii;
-      }
-    }
-  }
-}
-void igs::median_filter::pixrender::clear(void) {
-  this->around.clear();
-  this->yp.clear();
-  this->xp.clear();
-}
+    const igs::median_filter::out_of_image type)
+    : type_(type) {}
 
 void igs::median_filter::pixrender::position(const int ww, const int hh,
                                              int &xx, int &yy) {
@@ -152,27 +97,19 @@ T getter_(igs::median_filter::pixrender &pixr, const T *image, const int hh,
   }
   return *(image + (ww * ch * yy + ch * xx + zz));
 }
+/* 画像の外への参照を済ませた、上下左右にmarginの余白を付けた
+ひとつのチャンネルの画像 */
 template <class T>
-T median_filter_(igs::median_filter::pixrender &pixr, const T *image,
-                 const int hh, const int ww, const int ch, const int xx,
-                 const int yy, const int zz) {
-  for (unsigned int ii = 0; ii < pixr.around.size(); ++ii) {
-    pixr.around.at(ii) = static_cast<int>(getter_(
-        pixr, image, hh, ww, ch, xx + pixr.xp.at(ii), yy + pixr.yp.at(ii), zz));
+void make_plane_(igs::median_filter::pixrender &pixr, const T *image,
+                 const int hh, const int ww, const int ch, const int zz,
+                 const int margin, std::vector<T> &plane) {
+  plane.resize((ww + margin * 2) * (hh + margin * 2));
+  T *plane_pix = &plane.at(0);
+  for (int yy = -margin; yy < hh + margin; ++yy) {
+    for (int xx = -margin; xx < ww + margin; ++xx, ++plane_pix) {
+      *plane_pix = getter_(pixr, image, hh, ww, ch, xx, yy, zz);
+    }
   }
-
-  std::sort(pixr.around.begin(), pixr.around.end());
-
-  /*	中央値(median)計算は、厳密な定義(wikipediaより)によると
-                  奇数(odd)のときは中央値
-                  偶数(even)のときは中央の二つの値の平均
-          となるが、
-          元のPixel値を変えないポリシーにより、
-          偶数の場合も奇数の計算をそのまま流用する。
-          よって偶数の場合は中央の二つの値の大きいほうとなる。
-          2009-03-24
-  */
-  return static_cast<T>(pixr.around.at(pixr.around.size() / 2));
 }
 }
 //------------------------------------------------------------
@@ -181,6 +118,64 @@ double refchk_(const int src, const int tgt, const double refv) {
   return (src < tgt) ? (tgt - src + 0.999999) * refv + src
                      : (src - tgt + 0.999999) * (1.0 - refv) + tgt;
 }
+/* 中央値(median)を受け取って出力画像に入れる */
+template <class IT, class RT>
+class put_pixel_ {
+public:
+  put_pixel_(const IT *in, IT *out, const int ww, const int ch,
+             const RT *ref /* 求める画像(out)と同じ高さ、幅、チャンネル数 */
+             ,
+             const int ref_mode  // R,G,B,A,luminance
+             ,
+             const int zz, const bool all_channels_sw)
+      : in_(in)
+      , out_(out)
+      , ww_(ww)
+      , ch_(ch)
+      , ref_(ref)
+      , ref_mode_(ref_mode)
+      , r_max_(std::numeric_limits<RT>::max())
+      , zz_(zz)
+      , all_channels_sw_(all_channels_sw) {}
+  void operator()(const int xx, const int yy, const double value) {
+    const int offset = (this->ww_ * yy + xx) * this->ch_;
+    double refv      = 1.0;
+    if (this->ref_ != 0) {
+      refv *= igs::color::ref_value(this->ref_ + offset, this->ch_,
+                                    this->r_max_, this->ref_mode_);
+    }
+    /*	中央値(median)計算は、厳密な定義(wikipediaより)によると
+                    奇数(odd)のときは中央値
+                    偶数(even)のときは中央の二つの値の平均
+            となるが、
+            元のPixel値を変えないポリシーにより、
+            偶数の場合も奇数の計算をそのまま流用する。
+            よって偶数の場合は中央の二つの値の大きいほうとなる。
+            2009-03-24
+    */
+    const IT v1 = static_cast<IT>(value);
+    const IT v2 =
+        static_cast<IT>(refchk_(this->in_[offset + this->zz_], v1, refv));
+    if (!this->all_channels_sw_) {
+      this->out_[offset + this->zz_] = v2;
+      return;
+    }
+    for (int zz = 0; zz < this->ch_; ++zz) {
+      this->out_[offset + zz] = v2;
+    }
+  }
+
+private:
+  const IT *in_;
+  IT *out_;
+  const int ww_;
+  const int ch_;
+  const RT *ref_;
+  const int ref_mode_;
+  const int r_max_;
+  const int zz_;
+  const bool all_channels_sw_;
+};
 template <class IT, class RT>
 void convert_each_to_all_channels_template_(
     const IT *in, IT *out, const int hh, const int ww, const int ch
@@ -192,26 +187,14 @@ void convert_each_to_all_channels_template_(
 
     ,
     const int zz, const double radius,
-    const igs::median_filter::out_of_image type) {
-  igs::median_filter::pixrender pixr(radius, type);
-  const IT *in_pix = in;
-  IT *out_pix      = out;
-  const int r_max  = std::numeric_limits<RT>::max();
-  for (int yy = 0; yy < hh; ++yy) {
-    for (int xx = 0; xx < ww; ++xx, in_pix += ch, out_pix += ch) {
-      double refv = 1.0;
-      if (ref != 0) {
-        refv *= igs::color::ref_value(ref, ch, r_max, ref_mode);
-        ref += ch;
-      }
-      const IT v1 = median_filter_(pixr, in, hh, ww, ch, xx, yy, zz);
-      const IT v2 = static_cast<IT>(refchk_(in_pix[zz], v1, refv));
-      for (int zz = 0; zz < ch; ++zz) {
-        out_pix[zz] = v2;
-      }
-    }
-  }
-  pixr.clear();
+    const igs::median_filter::out_of_image type, const int number_of_thread) {
+  igs::median_filter::pixrender pixr(type);
+  igs::median_histogram::circle cir(radius, false);
+  std::vector<IT> plane;
+  make_plane_(pixr, in, hh, ww, ch, zz, cir.radius_int, plane);
+  put_pixel_<IT, RT> put(in, out, ww, ch, ref, ref_mode, zz, true);
+  igs::median_histogram::convert(&plane.at(0), hh, ww, cir, put,
+                                 number_of_thread);
 }
 template <class IT, class RT>
 void convert_each_to_each_channel_template_(
@@ -223,25 +206,17 @@ void convert_each_to_each_channel_template_(
     const int ref_mode  // R,G,B,A,luminance
 
     ,
-    const double radius, const igs::median_filter::out_of_image type) {
-  igs::median_filter::pixrender pixr(radius, type);
-  const IT *in_pix = in;
-  IT *out_pix      = out;
-  const int r_max  = std::numeric_limits<RT>::max();
-  for (int yy = 0; yy < hh; ++yy) {
-    for (int xx = 0; xx < ww; ++xx, in_pix += ch, out_pix += ch) {
-      double refv = 1.0;
-      if (ref != 0) {
-        refv *= igs::color::ref_value(ref, ch, r_max, ref_mode);
-        ref += ch;
-      }
-      for (int zz = 0; zz < ch; ++zz) {
-        const IT v1 = median_filter_(pixr, in, hh, ww, ch, xx, yy, zz);
-        out_pix[zz] = static_cast<IT>(refchk_(in_pix[zz], v1, refv));
-      }
-    }
+    const double radius, const igs::median_filter::out_of_image type,
+    const int number_of_thread) {
+  igs::median_filter::pixrender pixr(type);
+  igs::median_histogram::circle cir(radius, false);
+  std::vector<IT> plane;
+  for (int zz = 0; zz < ch; ++zz) {
+    make_plane_(pixr, in, hh, ww, ch, zz, cir.radius_int, plane);
+    put_pixel_<IT, RT> put(in, out, ww, ch, ref, ref_mode, zz, false);
+    igs::median_histogram::convert(&plane.at(0), hh, ww, cir, put,
+                                   number_of_thread);
   }
-  pixr.clear();
 }
 }
 //------------------------------------------------------------
@@ -266,6 +241,8 @@ void igs::median_filter::convert(
     const double radius  // 0...
     ,
     const int out_side_type  // 0(Spread),1(Flip),2(bk),3(Repeat)
+    ,
+    const int number_of_thread  // 1...INT_MAX
     ) {
   /*--- 指定(zz)から、実際に処理すべき色チャンネル(z2)を得る ---*/
   int z2 = zz;
@@ -329,13 +306,13 @@ void igs::median_filter::convert(
       ((std::numeric_limits<unsigned char>::digits == ref_bits) ||
        (0 == ref_bits))) {
     if ((0 <= z2) && (z2 < channels)) {
-      convert_each_to_all_channels_template_(in_image, out_image, height, width,
-                                             channels, ref, ref_mode, z2,
-                                             radius, type);
+      convert_each_to_all_channels_template_(
+          in_image, out_image, height, width, channels, ref, ref_mode, z2,
+          radius, type, number_of_thread);
     } else {
-      convert_each_to_each_channel_template_(in_image, out_image, height, width,
-                                             channels, ref, ref_mode, radius,
-                                             type);
+      convert_each_to_each_channel_template_(
+          in_image, out_image, height, width, channels, ref, ref_mode, radius,
+          type, number_of_thread);
     }
   } else if ((std::numeric_limits<unsigned short>::digits == bits) &&
              ((std::numeric_limits<unsigned char>::digits == ref_bits) ||
@@ -344,12 +321,12 @@ void igs::median_filter::convert(
       convert_each_to_all_channels_template_(
           reinterpret_cast<const unsigned short *>(in_image),
           reinterpret_cast<unsigned short *>(out_image), height, width,
-          channels, ref, ref_mode, z2, radius, type);
+          channels, ref, ref_mode, z2, radius, type, number_of_thread);
     } else {
       convert_each_to_each_channel_template_(
           reinterpret_cast<const unsigned short *>(in_image),
           reinterpret_cast<unsigned short *>(out_image), height, width,
-          channels, ref, ref_mode, radius, type);
+          channels, ref, ref_mode, radius, type, number_of_thread);
     }
   } else if ((std::numeric_limits<unsigned short>::digits == bits) &&
              (std::numeric_limits<unsigned short>::digits == ref_bits)) {
@@ -358,13 +335,13 @@ void igs::median_filter::convert(
           reinterpret_cast<const unsigned short *>(in_image),
           reinterpret_cast<unsigned short *>(out_image), height, width,
           channels, reinterpret_cast<const unsigned short *>(ref), ref_mode, z2,
-          radius, type);
+          radius, type, number_of_thread);
     } else {
       convert_each_to_each_channel_template_(
           reinterpret_cast<const unsigned short *>(in_image),
           reinterpret_cast<unsigned short *>(out_image), height, width,
           channels, reinterpret_cast<const unsigned short *>(ref), ref_mode,
-          radius, type);
+          radius, type, number_of_thread);
     }
   } else if ((std::numeric_limits<unsigned char>::digits == bits) &&
              (std::numeric_limits<unsigned short>::digits == ref_bits)) {
@@ -372,12 +349,12 @@ void igs::median_filter::convert(
       convert_each_to_all_channels_template_(
           in_image, out_image, height, width, channels,
           reinterpret_cast<const unsigned short *>(ref), ref_mode, z2, radius,
-          type);
+          type, number_of_thread);
     } else {
       convert_each_to_each_channel_template_(
           in_image, out_image, height, width, channels,
           reinterpret_cast<const unsigned short *>(ref), ref_mode, radius,
-          type);
+          type, number_of_thread);
     }
   } else {
     throw std::domain_error("Bad bits,Not uchar/ushort");
@@ -1,6 +1,6 @@
-#include <cmath> /* sqrt() */
 #include <vector>
 #include "igs_ifx_common.h"
+#include "igs_median_histogram.h"
 
 namespace {
 /* 画像の外への参照が必要なときどう拾うか */
@@ -11,41 +11,10 @@ enum outside_of_image_ {
   is_black_,
   is_repeat_
 };
-/* 影響範囲(radius)の各ピクセルのgeometry情報 */
+/* 画像の外のピクセルの位置 */
 class pixel_geometry_ {
 public:
-  pixel_geometry_(const double radius, const outside_of_image_ type)
-      : type_(type), ratio_total(0.0) {
-    /* 辿るためピクセル整数位置 */
-    const int radius_int = static_cast<int>(ceil(radius));
-
-    /* 任意半径(double値)の中のピクセル数を数える */
-    const double rxr = radius * radius + 1e-6;
-    for (int yy = -radius_int; yy <= radius_int; ++yy) {
-      const double yxy = static_cast<double>(yy) * yy;
-      for (int xx = -radius_int; xx <= radius_int; ++xx) {
-        const double xxx_plus_yxy = static_cast<double>(xx) * xx + yxy;
-        if (xxx_plus_yxy <= rxr) { /* 円の内部なら */
-          /* 円の中心位置を原点(0,0)とした座標 */
-          this->xp.push_back(xx);
-          this->yp.push_back(yy);
-
-          /* 中心からpixelまでの距離(半径) */
-          const double pixel_radius = sqrt(xxx_plus_yxy);
-
-          /* 影響力を現す値
-円縁から0...1の距離ならそのまま、
-1以上離れて中心までは1とする */
-          double ratio = radius - pixel_radius;
-          if (1.0 < ratio) {
-            ratio = 1.0;
-          }
-          this->in_out_ratio.push_back(ratio);
-          this->ratio_total += ratio;
-        }
-      }
-    }
-  }
+  pixel_geometry_(const outside_of_image_ type) : type_(type) {}
   void re_position(const int ww, const int hh, int &xx, int &yy) {
     switch (this->type_) {
     case is_spread_edge_: /* 外枠のピクセル値を広げる */
@@ -118,17 +87,6 @@ public:
       break;
     }
   }
-  void clear(void) {
-    this->yp.clear();
-    this->xp.clear();
-    this->in_out_ratio.clear();
-  }
-
-  std::vector<int> xp;
-  std::vector<int> yp;
-  std::vector<double> in_out_ratio;
-  double ratio_total;
-
 private:
   pixel_geometry_();
 
@@ -144,12 +102,24 @@ T get_pixel_value_(pixel_geometry_ &pixg, const T *image_top, const int hh,
   }
   return *(image_top + (ww * ch * yy + ch * xx + zz));
 }
+/* 画像の外への参照を済ませた、上下左右にmarginの余白を付けた
+ひとつのチャンネルの画像 */
+template <class T>
+void make_plane_(pixel_geometry_ &pixg, const T *image_top, const int hh,
+                 const int ww, const int ch, const int zz, const int margin,
+                 std::vector<T> &plane) {
+  plane.resize((ww + margin * 2) * (hh + margin * 2));
+  T *plane_pix = &plane.at(0);
+  for (int yy = -margin; yy < hh + margin; ++yy) {
+    for (int xx = -margin; xx < ww + margin; ++xx, ++plane_pix) {
+      *plane_pix = get_pixel_value_(pixg, image_top, hh, ww, ch, xx, yy, zz);
+    }
+  }
+}
 }
 //------------------------------------------------------------
-// #include <algorithm> // std::sort()
 #include <stdexcept> /* std::domain_error(-) */
 #include <limits>    /* std::numeric_limits */
-#include <map>       /* std::multimap */
 namespace {
 /*
         Median Filter...
@@ -161,71 +131,65 @@ namespace {
         | 3 | 4 | 5 |		  |		| 3 | 4 | 5 |
         +---+---+---+		median		+---+---+---+
         --> ...Smoothing...
-*/
-template <class T>
-double median_filter_smooth_(pixel_geometry_ &pixg, const T *image_top,
-                             const int hh, const int ww, const int ch,
-                             const int xx, const int yy, const int zz) {
-  /* ピクセル値と影響値のペアにして、ソートしたリストを作成 */
-  std::multimap<double, double> pixels;
-  for (unsigned int ii = 0; ii < pixg.xp.size(); ++ii) {
-    const double value = static_cast<double>(
-        get_pixel_value_(pixg, image_top, hh, ww, ch, xx + pixg.xp.at(ii),
-                         yy + pixg.yp.at(ii), zz));
-    pixels.insert(std::pair<double, double>(value, pixg.in_out_ratio.at(ii)));
-  }
-
-  /* 取り出しやすいようにvectorに移し変える */
-  /*
-          +---+---+---+---+---+
-          | 0 | 1 | 2 | 3 | 4 |	<-- pixel value
-          +---+---+---+---+---+
-          ^-^---^---^---^---^-^
-           0  1   2   3   4  5	<-- len_each
-          +>0-->1-->2-->3-->4>5	<-- len_accum
-  */
-  /* 中央(median)位置の前後ピクセル位置を得
-  中央値を求める */
-  double len_median = pixg.ratio_total / 2.0; /* 並べたときの中間位置 */
-  double accum      = 0.0;
-  double before_value = 0.0;
-  double before_ratio = 0.0;
-  double before_accum = 0.0;
-  for (std::multimap<double, double>::iterator it = pixels.begin();
-       it != pixels.end();
-       ++it, before_value = (*it).first, before_ratio = (*it).second,
-                                               before_accum = accum) {
-    /* ピクセル間の距離 */
-    const double pixw = (*it).second / 2.0 + before_ratio / 2.0;
 
-    /* 開始端からの(ピクセル単位の)距離 */
-    accum += pixw; /* Pixelの中央の位置 */
-
-    if (len_median <= accum) {
-      /* 開始端から始めのピクセルの半分位置までの間 */
-      if (it == pixels.begin()) {
-        return (*it).first;
-      }
-
-      if (before_value < (*it).first) {
-        return ((*it).first - before_value) * (len_median - before_accum) /
-                   pixw +
-               before_value;
-      }
-      return (before_value - (*it).first) * (accum - len_median) / pixw +
-             (*it).first;
-    }
-  }
-  return before_value;
-}
-}
-//------------------------------------------------------------
-namespace {
+        ピクセル値と影響値(円縁から0...1)のペアを値の順に並べ、
+        影響値の合計の半分(と最小値のピクセルの影響値の半分)の
+        位置のピクセル値を中央値とする
+        (igs::median_histogram::histogram::smooth_value(-))
+*/
 double refchk_(const double src, const double tgt, const double refv) {
   return ((src < tgt) ? (tgt - src) * refv + src
                       : (src - tgt) * (1.0 - refv) + tgt) +
          0.999999;
 }
+/* 中央値を受け取って出力画像に入れる */
+template <class IT, class RT>
+class put_pixel_ {
+public:
+  put_pixel_(const IT *in, IT *out, const int ww, const int ch,
+             const RT *ref /* 求める画像(out)と同じ高さ、幅、チャンネル数 */
+             ,
+             const int ref_mode  // R,G,B,A,luminance
+             ,
+             const int zz, const bool all_channels_sw)
+      : in_(in)
+      , out_(out)
+      , ww_(ww)
+      , ch_(ch)
+      , ref_(ref)
+      , ref_mode_(ref_mode)
+      , r_max_(std::numeric_limits<RT>::max())
+      , zz_(zz)
+      , all_channels_sw_(all_channels_sw) {}
+  void operator()(const int xx, const int yy, const double value) {
+    const int offset = (this->ww_ * yy + xx) * this->ch_;
+    double refv      = 1.0;
+    if (this->ref_ != 0) {
+      refv *= igs::color::ref_value(this->ref_ + offset, this->ch_,
+                                    this->r_max_, this->ref_mode_);
+    }
+    const IT v2 =
+        static_cast<IT>(refchk_(this->in_[offset + this->zz_], value, refv));
+    if (!this->all_channels_sw_) {
+      this->out_[offset + this->zz_] = v2;
+      return;
+    }
+    for (int zz = 0; zz < this->ch_; ++zz) {
+      this->out_[offset + zz] = v2;
+    }
+  }
+
+private:
+  const IT *in_;
+  IT *out_;
+  const int ww_;
+  const int ch_;
+  const RT *ref_;
+  const int ref_mode_;
+  const int r_max_;
+  const int zz_;
+  const bool all_channels_sw_;
+};
 template <class IT, class RT>
 void convert_each_to_all_channels_template_(
     const IT *in, IT *out, const int hh, const int ww, const int ch
@@ -236,26 +200,15 @@ void convert_each_to_all_channels_template_(
     const int ref_mode  // R,G,B,A,luminance
 
     ,
-    const int zz, const double radius, const outside_of_image_ type) {
-  pixel_geometry_ pixg(radius, type);
-  const IT *in_pix = in;
-  IT *out_pix      = out;
-  const int r_max  = std::numeric_limits<RT>::max();
-  for (int yy = 0; yy < hh; ++yy) {
-    for (int xx = 0; xx < ww; ++xx, in_pix += ch, out_pix += ch) {
-      double refv = 1.0;
-      if (ref != 0) {
-        refv *= igs::color::ref_value(ref, ch, r_max, ref_mode);
-        ref += ch;
-      }
-      const double v1 = median_filter_smooth_(pixg, in, hh, ww, ch, xx, yy, zz);
-      const IT v2     = static_cast<IT>(refchk_(in_pix[zz], v1, refv));
-      for (int zz = 0; zz < ch; ++zz) {
-        out_pix[zz] = v2;
-      }
-    }
-  }
-  pixg.clear();
+    const int zz, const double radius, const outside_of_image_ type,
+    const int number_of_thread) {
+  pixel_geometry_ pixg(type);
+  igs::median_histogram::circle cir(radius, true);
+  std::vector<IT> plane;
+  make_plane_(pixg, in, hh, ww, ch, zz, cir.radius_int, plane);
+  put_pixel_<IT, RT> put(in, out, ww, ch, ref, ref_mode, zz, true);
+  igs::median_histogram::convert(&plane.at(0), hh, ww, cir, put,
+                                 number_of_thread);
 }
 template <class IT, class RT>
 void convert_each_to_each_channel_template_(
@@ -267,26 +220,17 @@ void convert_each_to_each_channel_template_(
     const int ref_mode  // R,G,B,A,luminance
 
     ,
-    const double radius, const outside_of_image_ type) {
-  pixel_geometry_ pixg(radius, type);
-  const IT *in_pix = in;
-  IT *out_pix      = out;
-  const int r_max  = std::numeric_limits<RT>::max();
-  for (int yy = 0; yy < hh; ++yy) {
-    for (int xx = 0; xx < ww; ++xx, in_pix += ch, out_pix += ch) {
-      double refv = 1.0;
-      if (ref != 0) {
-        refv *= igs::color::ref_value(ref, ch, r_max, ref_mode);
-        ref += ch;
-      }
-      for (int zz = 0; zz < ch; ++zz) {
-        const double v1 =
-            median_filter_smooth_(pixg, in, hh, ww, ch, xx, yy, zz);
-        out_pix[zz] = static_cast<IT>(refchk_(in_pix[zz], v1, refv));
-      }
-    }
+    const double radius, const outside_of_image_ type,
+    const int number_of_thread) {
+  pixel_geometry_ pixg(type);
+  igs::median_histogram::circle cir(radius, true);
+  std::vector<IT> plane;
+  for (int zz = 0; zz < ch; ++zz) {
+    make_plane_(pixg, in, hh, ww, ch, zz, cir.radius_int, plane);
+    put_pixel_<IT, RT> put(in, out, ww, ch, ref, ref_mode, zz, false);
+    igs::median_histogram::convert(&plane.at(0), hh, ww, cir, put,
+                                   number_of_thread);
   }
-  pixg.clear();
 }
 }
 //------------------------------------------------------------
@@ -311,6 +255,8 @@ void igs::median_filter_smooth::convert(
     const double radius  // 0...
     ,
     const int out_side_type  // 0(Spread),1(Flip),2(bk),3(Repeat)
+    ,
+    const int number_of_thread  // 1...INT_MAX
     ) {
   /*--- 指定(zz)から、実際に処理すべき色チャンネル(z2)を得る ---*/
   int z2 = zz;
@@ -375,13 +321,13 @@ void igs::median_filter_smooth::convert(
       ((std::numeric_limits<unsigned char>::digits == ref_bits) ||
        (0 == ref_bits))) {
     if ((0 <= z2) && (z2 < channels)) {
-      convert_each_to_all_channels_template_(in_image, out_image, height, width,
-                                             channels, ref, ref_mode, z2,
-                                             radius, type);
+      convert_each_to_all_channels_template_(
+          in_image, out_image, height, width, channels, ref, ref_mode, z2,
+          radius, type, number_of_thread);
     } else {
-      convert_each_to_each_channel_template_(in_image, out_image, height, width,
-                                             channels, ref, ref_mode, radius,
-                                             type);
+      convert_each_to_each_channel_template_(
+          in_image, out_image, height, width, channels, ref, ref_mode, radius,
+          type, number_of_thread);
     }
   } else if ((std::numeric_limits<unsigned short>::digits == bits) &&
              ((std::numeric_limits<unsigned char>::digits == ref_bits) ||
@@ -390,12 +336,12 @@ void igs::median_filter_smooth::convert(
       convert_each_to_all_channels_template_(
           reinterpret_cast<const unsigned short *>(in_image),
           reinterpret_cast<unsigned short *>(out_image), height, width,
-          channels, ref, ref_mode, z2, radius, type);
+          channels, ref, ref_mode, z2, radius, type, number_of_thread);
     } else {
       convert_each_to_each_channel_template_(
           reinterpret_cast<const unsigned short *>(in_image),
           reinterpret_cast<unsigned short *>(out_image), height, width,
-          channels, ref, ref_mode, radius, type);
+          channels, ref, ref_mode, radius, type, number_of_thread);
     }
   } else if ((std::numeric_limits<unsigned short>::digits == bits) &&
              (std::numeric_limits<unsigned short>::digits == ref_bits)) {
@@ -404,13 +350,13 @@ void igs::median_filter_smooth::convert(
           reinterpret_cast<const unsigned short *>(in_image),
           reinterpret_cast<unsigned short *>(out_image), height, width,
           channels, reinterpret_cast<const unsigned short *>(ref), ref_mode, z2,
-          radius, type);
+          radius, type, number_of_thread);
     } else {
       convert_each_to_each_channel_template_(
           reinterpret_cast<const unsigned short *>(in_image),
           reinterpret_cast<unsigned short *>(out_image), height, width,
           channels, reinterpret_cast<const unsigned short *>(ref), ref_mode,
-          radius, type);
+          radius, type, number_of_thread);
     }
   } else if ((std::numeric_limits<unsigned char>::digits == bits) &&
              (std::numeric_limits<unsigned short>::digits == ref_bits)) {
@@ -418,12 +364,12 @@ void igs::median_filter_smooth::convert(
       convert_each_to_all_channels_template_(
           in_image, out_image, height, width, channels,
           reinterpret_cast<const unsigned short *>(ref), ref_mode, z2, radius,
-          type);
+          type, number_of_thread);
     } else {
       convert_each_to_each_channel_template_(
           in_image, out_image, height, width, channels,
           reinterpret_cast<const unsigned short *>(ref), ref_mode, radius,
-          type);
+          type, number_of_thread);
     }
   } else {
     throw std::domain_error("Bad bits,Not uchar/ushort");
@@ -29,10 +29,9 @@ IGS_MEDIAN_FILTER_SMOOTH_EXPORT void convert(
     ,
     const int out_side_type /* =0	0(Spread),1(Flip),2(bk),3(Repeat) */
     /* 2013-11-11現在0(Spread)のみ使用 */
+    ,
+    const int number_of_thread /* =1	1...INT_MAX */
     );
-/*
-        2013-11-13 igs::median_filter::convert(-)に比べて11倍遅い
-  */
 }
 }
 
@@ -0,0 +1,359 @@
+#pragma once
+
+#ifndef igs_median_histogram_h
+#define igs_median_histogram_h
+
+#include <cmath> /* sqrt() */
+#include <vector>
+#include <algorithm> /* std::fill() */
+#include <limits>    /* std::numeric_limits */
+#include "igs_resource_multithread.h"
+
+/*
+        Histogram based median(rank) filter engine
+        used by igs::median_filter and igs::median_filter_smooth.
+
+        The circular window is kept as a histogram while it slides
+        along the scanline, so that moving it by one pixel only removes
+        and adds the pixels at both ends of each of its rows.
+        The rank is then found through a two level (coarse/fine) histogram.
+        The cost per pixel is proportional to the radius, instead of
+        sorting the whole window (radius squared) at every pixel.
+*/
+namespace igs {
+namespace median_histogram {
+/* 影響範囲(radius)の円の形状 */
+class circle {
+public:
+  circle(const double radius, const bool smooth_sw)
+      : radius_int(static_cast<int>(ceil(radius)))
+      , smooth_sw(smooth_sw)
+      , size(0)
+      , ratio_total(0) {
+    const double rxr = radius * radius + 1e-6;
+    for (int yy = -this->radius_int; yy <= this->radius_int; ++yy) {
+      const double yxy = static_cast<double>(yy) * yy;
+      /* 各行の比重1の範囲の半幅、無ければ-1 */
+      int span = -1;
+      for (int xx = -this->radius_int; xx <= this->radius_int; ++xx) {
+        const double xxx_plus_yxy = static_cast<double>(xx) * xx + yxy;
+        if (rxr < xxx_plus_yxy) { /* 円の外部 */
+          continue;
+        }
+        ++this->size;
+
+        /* 円縁から0...1の距離の比重、smoothでなければ全て1 */
+        double ratio = 1.0;
+        if (smooth_sw) {
+          ratio = radius - sqrt(xxx_plus_yxy);
+          if (1.0 < ratio) {
+            ratio = 1.0;
+          }
+        }
+        const long long ratio_fixed =
+            static_cast<long long>(ratio * ratio_one + 0.5);
+        this->ratio_total += ratio_fixed;
+
+        if (ratio_fixed == ratio_one) {
+          span = (xx < 0) ? -xx : xx;
+        } else {
+          this->ring_xp.push_back(xx);
+          this->ring_yp.push_back(yy);
+          this->ring_ratio.push_back(ratio_fixed);
+        }
+      }
+      this->spans.push_back(span);
+    }
+  }
+
+  /* 比重1を固定小数点で表す値 */
+  static const long long ratio_one = 1 << 16;
+
+  const int radius_int;
+  const bool smooth_sw;
+  int size; /* 円の中のピクセル数 */
+  long long ratio_total;
+
+  /* 各行(yy=-radius_int...radius_int)の比重1の範囲の半幅 */
+  std::vector<int> spans;
+  /* 円縁の比重1未満のピクセル(smoothのときのみ) */
+  std::vector<int> ring_xp;
+  std::vector<int> ring_yp;
+  std::vector<long long> ring_ratio;
+
+private:
+  circle();
+};
+
+/* 粗い段と細かい段の二段のhistogram */
+class histogram {
+public:
+  histogram(const int bits, const bool weighted_sw)
+      : shift_(bits / 2)
+      , weighted_sw_(weighted_sw)
+      , counts_(1 << bits, 0)
+      , coarse_counts_(1 << (bits - bits / 2), 0) {
+    if (weighted_sw) {
+      this->ratios_.resize(this->counts_.size(), 0);
+      this->coarse_ratios_.resize(this->coarse_counts_.size(), 0);
+    }
+  }
+  void clear(void) {
+    std::fill(this->counts_.begin(), this->counts_.end(), 0);
+    std::fill(this->coarse_counts_.begin(), this->coarse_counts_.end(), 0);
+    std::fill(this->ratios_.begin(), this->ratios_.end(), 0);
+    std::fill(this->coarse_ratios_.begin(), this->coarse_ratios_.end(), 0);
+  }
+  void add(const int value, const long long ratio) {
+    ++this->counts_[value];
+    ++this->coarse_counts_[value >> this->shift_];
+    if (this->weighted_sw_) {
+      this->ratios_[value] += ratio;
+      this->coarse_ratios_[value >> this->shift_] += ratio;
+    }
+  }
+  void remove(const int value, const long long ratio) {
+    --this->counts_[value];
+    --this->coarse_counts_[value >> this->shift_];
+    if (this->weighted_sw_) {
+      this->ratios_[value] -= ratio;
+      this->coarse_ratios_[value >> this->shift_] -= ratio;
+    }
+  }
+
+  /* 小さい方から数えてrank番目(0...)の値 */
+  int rank_value(const int rank) const {
+    int accum = 0;
+    int cc    = 0;
+    while (accum + this->coarse_counts_[cc] <= rank) {
+      accum += this->coarse_counts_[cc++];
+    }
+    int vv = cc << this->shift_;
+    while (accum + this->counts_[vv] <= rank) {
+      accum += this->counts_[vv++];
+    }
+    return vv;
+  }
+
+  /* 最小値 */
+  int min_value(void) const {
+    int cc = 0;
+    while (this->coarse_counts_[cc] <= 0) {
+      ++cc;
+    }
+    int vv = cc << this->shift_;
+    while (this->counts_[vv] <= 0) {
+      ++vv;
+    }
+    return vv;
+  }
+  /* 値valueのピクセル数 */
+  int count(const int value) const { return this->counts_[value]; }
+
+  /*
+  比重付きで小さい方から並べ、比重の合計の半分に、最小値で最初に並んだ
+  ピクセルの比重(min_ratio)の半分を足した位置にあるピクセルの値
+  (igs::median_filter_smooth参照)
+  */
+  double smooth_value(const long long ratio_total,
+                      const long long min_ratio) const {
+    const double len_median = static_cast<double>(ratio_total) / 2.0 +
+                              static_cast<double>(min_ratio) / 2.0;
+
+    /* 中央位置に届かない範囲は粗い段で飛ばす */
+    long long accum = 0;
+    const int coarse_size = static_cast<int>(this->coarse_ratios_.size());
+    int cc                = 0;
+    for (; cc < coarse_size - 1; ++cc) {
+      if (len_median <= accum + this->coarse_ratios_[cc]) {
+        break;
+      }
+      accum += this->coarse_ratios_[cc];
+    }
+
+    int last_value = 0;
+    for (int vv = cc << this->shift_;
+         vv < static_cast<int>(this->counts_.size()); ++vv) {
+      if (this->counts_[vv] <= 0) {
+        continue;
+      }
+      accum += this->ratios_[vv];
+      if (len_median <= accum) {
+        return vv;
+      }
+      last_value = vv;
+    }
+    return last_value;
+  }
+
+private:
+  histogram();
+
+  const int shift_;
+  const bool weighted_sw_;
+  std::vector<int> counts_;
+  std::vector<int> coarse_counts_;
+  std::vector<long long> ratios_;
+  std::vector<long long> coarse_ratios_;
+};
+
+/*
+        thread単位の実行
+        plane は上下左右にradius_intの余白を付けたひとつのチャンネルの画像
+        PUT は put(xx, yy, value) で結果を受け取る
+*/
+template <class T, class PUT>
+class thread final : public igs::resource::thread_execute_interface {
+public:
+  thread() {}
+  void setup(const T *plane, const int width, const circle *cir,
+             const int y_begin, const int y_end, PUT *put) {
+    this->plane_   = plane;
+    this->width_   = width;
+    this->cir_     = cir;
+    this->y_begin_ = y_begin;
+    this->y_end_   = y_end;
+    this->put_     = put;
+  }
+  void run(void) override {
+    const circle &cir     = *this->cir_;
+    const int rr          = cir.radius_int;
+    const int plane_width = this->width_ + rr * 2;
+    const int median_rank = cir.size / 2;
+    const long long one   = circle::ratio_one;
+    histogram hist(std::numeric_limits<T>::digits, cir.smooth_sw);
+
+    for (int yy = this->y_begin_; yy < this->y_end_; ++yy) {
+      /* 行の始めの影響範囲 */
+      hist.clear();
+      for (int dy = -rr; dy <= rr; ++dy) {
+        const int span = cir.spans.at(dy + rr);
+        const T *row   = this->plane_ + (yy + dy + rr) * plane_width + rr;
+        for (int dx = -span; dx <= span; ++dx) {
+          hist.add(row[dx], one);
+        }
+      }
+
+      for (int xx = 0; xx < this->width_; ++xx) {
+        /* 影響範囲を一つ右に動かす */
+        if (0 < xx) {
+          for (int dy = -rr; dy <= rr; ++dy) {
+            const int span = cir.spans.at(dy + rr);
+            if (span < 0) {
+              continue;
+            }
+            const T *row =
+                this->plane_ + (yy + dy + rr) * plane_width + rr + xx;
+            hist.remove(row[-span - 1], one);
+            hist.add(row[span], one);
+          }
+        }
+
+        if (!cir.smooth_sw) {
+          /* 偶数の場合は中央の二つの値の大きいほう */
+          (*this->put_)(xx, yy, hist.rank_value(median_rank));
+          continue;
+        }
+
+        /* 円縁のピクセルは比重がそれぞれ違うのでその都度足す */
+        const T *center = this->plane_ + (yy + rr) * plane_width + rr + xx;
+        for (unsigned int ii = 0; ii < cir.ring_xp.size(); ++ii) {
+          hist.add(center[cir.ring_yp[ii] * plane_width + cir.ring_xp[ii]],
+                   cir.ring_ratio[ii]);
+        }
+        const int min_value = hist.min_value();
+        (*this->put_)(
+            xx, yy,
+            hist.smooth_value(
+                cir.ratio_total,
+                this->min_ratio_(center, plane_width, min_value,
+                                 hist.count(min_value))));
+        for (unsigned int ii = 0; ii < cir.ring_xp.size(); ++ii) {
+          hist.remove(center[cir.ring_yp[ii] * plane_width + cir.ring_xp[ii]],
+                      cir.ring_ratio[ii]);
+        }
+      }
+    }
+  }
+
+private:
+  /*
+  影響範囲を(yy,xx)の順に辿ったとき、最初に値valueとなるピクセルの比重
+  円縁のピクセルはその順に並んでいるので、それより前の比重1の範囲に
+  valueがあるかだけ調べればよい
+  */
+  long long min_ratio_(const T *center, const int plane_width,
+                       const int value, const int count) const {
+    const circle &cir = *this->cir_;
+    const int rr      = cir.radius_int;
+    int ring_count    = 0;
+    int first         = -1;
+    for (unsigned int ii = 0; ii < cir.ring_xp.size(); ++ii) {
+      if (center[cir.ring_yp[ii] * plane_width + cir.ring_xp[ii]] == value) {
+        if (first < 0) {
+          first = static_cast<int>(ii);
+        }
+        ++ring_count;
+      }
+    }
+    if (first < 0) { /* 全て比重1の範囲 */
+      return circle::ratio_one;
+    }
+    if (ring_count < count) {
+      const int ring_y = cir.ring_yp[first];
+      const int ring_x = cir.ring_xp[first];
+      for (int dy = -rr; dy <= ring_y; ++dy) {
+        const int span = cir.spans.at(dy + rr);
+        const T *row   = center + dy * plane_width;
+        for (int dx = -span; dx <= span; ++dx) {
+          if (dy == ring_y && ring_x <= dx) {
+            break;
+          }
+          if (row[dx] == value) {
+            return circle::ratio_one;
+          }
+        }
+      }
+    }
+    return cir.ring_ratio[first];
+  }
+
+  const T *plane_;
+  int width_;
+  const circle *cir_;
+  int y_begin_;
+  int y_end_;
+  PUT *put_;
+};
+
+/* 余白付きのplaneの各ピクセルを処理し、結果をput(xx, yy, value)に渡す */
+template <class T, class PUT>
+void convert(const T *plane, const int height, const int width,
+             const circle &cir, PUT &put,
+             const int number_of_thread /* =1    1...INT_MAX */
+             ) {
+  int thread_num = number_of_thread;
+  if (thread_num < 1) {
+    thread_num = 1;
+  }
+  if (height < thread_num) {
+    thread_num = height;
+  }
+  if (thread_num < 1) {
+    return;
+  }
+
+  std::vector<igs::median_histogram::thread<T, PUT>> threads(thread_num);
+  igs::resource::multithread mthread;
+  for (int ii = 0; ii < thread_num; ++ii) {
+    threads.at(ii).setup(plane, width, &cir, height * ii / thread_num,
+                         height * (ii + 1) / thread_num, &put);
+    mthread.add(&(threads.at(ii)));
+  }
+  mthread.run();
+  mthread.clear();
+}
+}
+}
+
+#endif /* !igs_median_histogram_h */
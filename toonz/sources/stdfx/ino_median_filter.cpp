@@ -1,6 +1,7 @@
 #include <sstream> /* std::ostringstream */
 #include "tfxparam.h"
 #include "stdfx.h"
+#include "tsystem.h"
 
 #include "ino_common.h"
 //------------------------------------------------------------
@@ -100,7 +101,8 @@ void fx_(const TRasterP in_ras  // with margin
 
       ,
       channel, radius, 0 /* 0=Spread:外は淵のピクセル値が続いているとする */
-      );
+      ,
+      TSystem::getProcessorCount());
 
   ino::arr_to_ras(out_gr8->getRawData(), ino::channels(), out_ras, margin);
   out_gr8->unlock();
@@ -4,18 +4,32 @@
 #include "tdoubleparam.h"
 #include "trasterfx.h"
 #include "trasterimage.h"
+#include "tthread.h"
 
 #include "kiss_fft.h"
 
 #include <QPair>
 #include <QVector>
-#include <QReadWriteLock>
 #include <QMutexLocker>
 #include <QMap>
 
+#include <functional>
+#include <list>
+#include <new>
+#include <vector>
+
 namespace {
-QReadWriteLock lock;
-QMutex mutex, fx_mutex;
+QMutex fx_mutex;
+
+enum Channel { Red = 0, Green, Blue };
+
+// Runs the jobs in parallel, the calling thread taking part. Returns false
+// if any of them failed.
+bool runJobs(const std::vector<std::function<void()>>& jobs) {
+  return TThread::forEachBand((int)jobs.size(), 1, [&](int begin, int end) {
+    for (int j = begin; j < end; j++) jobs[j]();
+  });
+}
 
 bool isFurtherLayer(const QPair<int, float> val1,
                     const QPair<int, float> val2) {
@@ -41,120 +55,151 @@ inline float valueToExposure(float value, float filmGamma) {
 inline float exposureToValue(float exposure, float filmGamma) {
   return log10(exposure) * filmGamma + 0.5;
 }
+
+// Returns the smallest size not less than n which has no factors other than
+// 2, 3 or 5. The size is also even, as required by real-to-complex FFTs.
+int getFftSize(int n) {
+  n = kiss_fft_next_fast_size(n);
+  while (n % 2 != 0) n = kiss_fft_next_fast_size(n + 1);
+  return n;
+}
+
+//--------------------------------------------
+// Real-to-complex FFT plans for a padded size.
+// kissfft plans embed their own work buffer, so a plan can be used by a
+// single thread at a time.
+//--------------------------------------------
+
+class FftPlan {
+public:
+  TDimensionI m_dim;
+  kiss_fftndr_cfg m_fwd, m_bkwd;
+
+  FftPlan(const TDimensionI& dim) : m_dim(dim) {
+    int dims[2] = {dim.ly, dim.lx};
+    m_fwd       = kiss_fftndr_alloc(dims, 2, false, 0, 0);
+    m_bkwd      = kiss_fftndr_alloc(dims, 2, true, 0, 0);
+  }
+  ~FftPlan() {
+    if (m_fwd) kiss_fftr_free(m_fwd);
+    if (m_bkwd) kiss_fftr_free(m_bkwd);
+  }
+
+  bool isValid() const { return m_fwd && m_bkwd; }
 };
 
 //--------------------------------------------
-// Threads used for FFT computation for each RGB channel
+// Idle plans, kept for reuse by the next layers and frames. Only plans of the
+// most recently requested size are kept.
 //--------------------------------------------
 
-MyThread::MyThread(Channel channel, TRasterP layerTileRas, TRasterP outTileRas,
-                   TRasterP tmpAlphaRas, kiss_fft_cpx* kissfft_comp_iris,
-                   float filmGamma,
-                   bool doLightenComp)  // not used for now
-    : m_channel(channel),
-      m_layerTileRas(layerTileRas),
-      m_outTileRas(outTileRas),
-      m_tmpAlphaRas(tmpAlphaRas),
-      m_kissfft_comp_iris(kissfft_comp_iris),
-      m_filmGamma(filmGamma),
-      m_finished(false),
-      m_kissfft_comp_in(0),
-      m_kissfft_comp_out(0),
-      m_isTerminated(false),
-      m_doLightenComp(doLightenComp)  // not used for now
-{}
-
-bool MyThread::init() {
-  // get the source size
-  int lx, ly;
-  lx = m_layerTileRas->getSize().lx;
-  ly = m_layerTileRas->getSize().ly;
+class FftPlanCache {
+  QMutex m_mutex;
+  std::list<FftPlan*> m_plans;
 
-  // memory allocation for input
-  m_kissfft_comp_in_ras = TRasterGR8P(lx * sizeof(kiss_fft_cpx), ly);
-  m_kissfft_comp_in_ras->lock();
-  m_kissfft_comp_in = (kiss_fft_cpx*)m_kissfft_comp_in_ras->getRawData();
+  // Enough for the alpha and RGB channels of a layer
+  static const int MaxIdlePlans = 4;
 
-  // allocation check
-  if (m_kissfft_comp_in == 0) return false;
+public:
+  static FftPlanCache* instance() {
+    static FftPlanCache theInstance;
+    return &theInstance;
+  }
 
-  // cancel check
-  if (m_isTerminated) {
-    m_kissfft_comp_in_ras->unlock();
-    return false;
+  ~FftPlanCache() {
+    for (FftPlan* plan : m_plans) delete plan;
   }
 
-  // memory allocation for output
-  m_kissfft_comp_out_ras = TRasterGR8P(lx * sizeof(kiss_fft_cpx), ly);
-  m_kissfft_comp_out_ras->lock();
-  m_kissfft_comp_out = (kiss_fft_cpx*)m_kissfft_comp_out_ras->getRawData();
+  // Returns a plan of the specified size, to be released after use. Throws
+  // std::bad_alloc if the plan could not be allocated.
+  FftPlan* acquire(const TDimensionI& dim) {
+    {
+      QMutexLocker locker(&m_mutex);
+      for (auto it = m_plans.begin(); it != m_plans.end(); ++it) {
+        if ((*it)->m_dim != dim) continue;
+        FftPlan* plan = *it;
+        m_plans.erase(it);
+        return plan;
+      }
+    }
 
-  // allocation check
-  if (m_kissfft_comp_out == 0) {
-    m_kissfft_comp_in_ras->unlock();
-    m_kissfft_comp_in = 0;
-    return false;
+    FftPlan* plan = new FftPlan(dim);
+    if (!plan->isValid()) {
+      delete plan;
+      throw std::bad_alloc();
+    }
+    return plan;
   }
 
-  // cancel check
-  if (m_isTerminated) {
-    m_kissfft_comp_in_ras->unlock();
-    m_kissfft_comp_in = 0;
-    m_kissfft_comp_out_ras->unlock();
-    m_kissfft_comp_out = 0;
-    return false;
-  }
+  void release(FftPlan* plan) {
+    QMutexLocker locker(&m_mutex);
+    for (auto it = m_plans.begin(); it != m_plans.end();) {
+      if ((*it)->m_dim != plan->m_dim) {
+        delete *it;
+        it = m_plans.erase(it);
+      } else
+        ++it;
+    }
 
-  // create the forward FFT plan
-  int dims[2]        = {ly, lx};
-  int ndims          = 2;
-  m_kissfft_plan_fwd = kiss_fftnd_alloc(dims, ndims, false, 0, 0);
-  // allocation and cancel check
-  if (m_kissfft_plan_fwd == NULL || m_isTerminated) {
-    m_kissfft_comp_in_ras->unlock();
-    m_kissfft_comp_in = 0;
-    m_kissfft_comp_out_ras->unlock();
-    m_kissfft_comp_out = 0;
-    return false;
+    if ((int)m_plans.size() < MaxIdlePlans)
+      m_plans.push_back(plan);
+    else
+      delete plan;
   }
+};
+
+//--------------------------------------------
+// Filters the real data with the iris, through the frequency domain.
+// Forward FFT -> Multiply by the iris FFT data -> Backward FFT
+// The result is not normalized, and replaces the input data.
+//--------------------------------------------
 
-  // create the backward FFT plan
-  m_kissfft_plan_bkwd = kiss_fftnd_alloc(dims, ndims, true, 0, 0);
-  // allocation and cancel check
-  if (m_kissfft_plan_bkwd == NULL || m_isTerminated) {
-    m_kissfft_comp_in_ras->unlock();
-    m_kissfft_comp_in = 0;
-    m_kissfft_comp_out_ras->unlock();
-    m_kissfft_comp_out = 0;
-    kiss_fft_free(m_kissfft_plan_fwd);
-    m_kissfft_plan_fwd = NULL;
-    return false;
+void filterWithIris(kiss_fft_scalar* data, const kiss_fft_cpx* irisSpectrum,
+                    const TDimensionI& dim) {
+  int spectrumSize = (dim.lx / 2 + 1) * dim.ly;
+
+  TRasterGR8P spectrumRas(spectrumSize * sizeof(kiss_fft_cpx), 1);
+  spectrumRas->lock();
+  kiss_fft_cpx* spectrum = (kiss_fft_cpx*)spectrumRas->getRawData();
+
+  FftPlan* plan = FftPlanCache::instance()->acquire(dim);
+
+  kiss_fftndr(plan->m_fwd, data, spectrum);
+
+  for (int i = 0; i < spectrumSize; i++) {
+    float re, im;
+    re = spectrum[i].r * irisSpectrum[i].r - spectrum[i].i * irisSpectrum[i].i;
+    im = spectrum[i].r * irisSpectrum[i].i + irisSpectrum[i].r * spectrum[i].i;
+    spectrum[i].r = re;
+    spectrum[i].i = im;
   }
 
-  // return true if all the initializations are done
-  return true;
+  kiss_fftndri(plan->m_bkwd, spectrum, data);
+
+  FftPlanCache::instance()->release(plan);
+  spectrumRas->unlock();
 }
 
 //------------------------------------------------------------
 // Convert the pixels from RGB values to exposures and multiply it by alpha
 // channel value.
-// Store the results in the real part of kiss_fft_cpx.
 //------------------------------------------------------------
 template <typename RASTER, typename PIXEL>
-void MyThread::setLayerRaster(const RASTER srcRas, kiss_fft_cpx* dstMem,
-                              TDimensionI dim) {
+void setLayerRaster(const RASTER srcRas, kiss_fft_scalar* dstMem,
+                    TDimensionI dim, Channel channel, float filmGamma) {
   for (int j = 0; j < dim.ly; j++) {
     PIXEL* pix = srcRas->pixels(j);
     for (int i = 0; i < dim.lx; i++, pix++) {
       if (pix->m != 0) {
-        float val = (m_channel == Red)
+        float val = (channel == Red)
                         ? (float)pix->r
-                        : (m_channel == Green) ? (float)pix->g : (float)pix->b;
+                        : (channel == Green) ? (float)pix->g : (float)pix->b;
         // multiply the exposure by alpha channel value
-        dstMem[j * dim.lx + i].r =
-            valueToExposure(val / (float)PIXEL::maxChannelValue) *
+        dstMem[j * dim.lx + i] =
+            valueToExposure(val / (float)PIXEL::maxChannelValue, filmGamma) *
             ((float)pix->m / (float)PIXEL::maxChannelValue);
-      }
+      } else
+        dstMem[j * dim.lx + i] = 0.0f;
     }
   }
 }
@@ -163,10 +208,10 @@ void MyThread::setLayerRaster(const RASTER srcRas, kiss_fft_cpx* dstMem,
 // Composite the bokeh layer to the result
 //------------------------------------------------------------
 template <typename RASTER, typename PIXEL, typename A_RASTER, typename A_PIXEL>
-void MyThread::compositLayerToTile(const RASTER layerRas,
-                                   const RASTER outTileRas,
-                                   const A_RASTER alphaRas, TDimensionI dim,
-                                   int2 margin) {
+void compositLayerToTile(const kiss_fft_scalar* exposures,
+                         const RASTER outTileRas, const A_RASTER alphaRas,
+                         TDimensionI dim, int2 margin, Channel channel,
+                         float filmGamma) {
   int j = margin.y;
   for (int out_j = 0; out_j < outTileRas->getLy(); j++, out_j++) {
     PIXEL* outPix     = outTileRas->pixels(out_j);
@@ -186,25 +231,19 @@ void MyThread::compositLayerToTile(const RASTER layerRas,
       // Composite the upper layer exposure with the bottom layers. Then,
       // convert the exposure to RGB values.
       typename PIXEL::Channel dnVal =
-          (m_channel == Red) ? outPix->r
-                             : (m_channel == Green) ? outPix->g : outPix->b;
-
-      float exposure;
-      double val;
-      if (alpha == 1.0 || dnVal == 0.0) {
-        exposure = (m_kissfft_comp_in[getCoord(i, j, dim.lx, dim.ly)].r /
-                    (dim.lx * dim.ly));
-        val = exposureToValue(exposure) * (float)PIXEL::maxChannelValue + 0.5f;
-      } else {
-        exposure =
-            (m_kissfft_comp_in[getCoord(i, j, dim.lx, dim.ly)].r /
-             (dim.lx * dim.ly)) +
-            valueToExposure((float)dnVal / (float)PIXEL::maxChannelValue) *
-                (1 - alpha);
-        val = exposureToValue(exposure) * (float)PIXEL::maxChannelValue + 0.5f;
-        // not used for now
-        if (m_doLightenComp) val = std::max(val, (double)dnVal);
-      }
+          (channel == Red) ? outPix->r
+                           : (channel == Green) ? outPix->g : outPix->b;
+
+      float exposure =
+          exposures[getCoord(i, j, dim.lx, dim.ly)] / (dim.lx * dim.ly);
+      if (alpha != 1.0 && dnVal != 0.0)
+        exposure += valueToExposure(
+                        (float)dnVal / (float)PIXEL::maxChannelValue,
+                        filmGamma) *
+                    (1 - alpha);
+      double val = exposureToValue(exposure, filmGamma) *
+                       (float)PIXEL::maxChannelValue +
+                   0.5f;
 
       // clamp
       if (val < 0.0)
@@ -212,7 +251,7 @@ void MyThread::compositLayerToTile(const RASTER layerRas,
       else if (val > (float)PIXEL::maxChannelValue)
         val = (float)PIXEL::maxChannelValue;
 
-      switch (m_channel) {
+      switch (channel) {
       case Red:
         outPix->r = (typename PIXEL::Channel)val;
         //"over" composite the alpha channel here
@@ -243,123 +282,30 @@ void MyThread::compositLayerToTile(const RASTER layerRas,
 }
 
 //------------------------------------------------------------
+// What is done for each RGB channel:
+// - Convert channel value -> Exposure
+// - Multiply by alpha channel
+// - Filter with the iris
+//------------------------------------------------------------
+void calcChannelBokeh(Channel channel, const kiss_fft_cpx* irisSpectrum,
+                      const TRasterP& layerRas, kiss_fft_scalar* exposures,
+                      float filmGamma) {
+  TDimensionI dim = layerRas->getSize();
+
+  TRaster32P ras32 = (TRaster32P)layerRas;
+  TRaster64P ras64 = (TRaster64P)layerRas;
+  if (ras32)
+    setLayerRaster<TRaster32P, TPixel32>(ras32, exposures, dim, channel,
+                                         filmGamma);
+  else if (ras64)
+    setLayerRaster<TRaster64P, TPixel64>(ras64, exposures, dim, channel,
+                                         filmGamma);
+  else
+    return;
 
-void MyThread::run() {
-  // get the source image size
-  TDimensionI dim = m_layerTileRas->getSize();
-
-  int2 margin = {(dim.lx - m_outTileRas->getSize().lx) / 2,
-                 (dim.ly - m_outTileRas->getSize().ly) / 2};
-
-  // initialize
-  for (int i = 0; i < dim.lx * dim.ly; i++) {
-    m_kissfft_comp_in[i].r = 0.0;  // real part
-    m_kissfft_comp_in[i].i = 0.0;  // imaginary part
-  }
-
-  TRaster32P ras32 = (TRaster32P)m_layerTileRas;
-  TRaster64P ras64 = (TRaster64P)m_layerTileRas;
-  // Prepare data for FFT.
-  // Convert the RGB values to the exposure, then multiply it by the alpha
-  // channel value
-  {
-    lock.lockForRead();
-    if (ras32)
-      setLayerRaster<TRaster32P, TPixel32>(ras32, m_kissfft_comp_in, dim);
-    else if (ras64)
-      setLayerRaster<TRaster64P, TPixel64>(ras64, m_kissfft_comp_in, dim);
-    else {
-      lock.unlock();
-      return;
-    }
-
-    lock.unlock();
-  }
-
-  if (checkTerminationAndCleanupThread()) return;
-
-  kiss_fftnd(m_kissfft_plan_fwd, m_kissfft_comp_in, m_kissfft_comp_out);
-  kiss_fft_free(m_kissfft_plan_fwd);  // we don't need this plan anymore
-  m_kissfft_plan_fwd = NULL;
-
-  if (checkTerminationAndCleanupThread()) return;
-
-  // Filtering. Multiply by the iris FFT data
-  {
-    for (int i = 0; i < dim.lx * dim.ly; i++) {
-      float re, im;
-      re = m_kissfft_comp_out[i].r * m_kissfft_comp_iris[i].r -
-           m_kissfft_comp_out[i].i * m_kissfft_comp_iris[i].i;
-      im = m_kissfft_comp_out[i].r * m_kissfft_comp_iris[i].i +
-           m_kissfft_comp_iris[i].r * m_kissfft_comp_out[i].i;
-      m_kissfft_comp_out[i].r = re;
-      m_kissfft_comp_out[i].i = im;
-    }
-  }
-
-  if (checkTerminationAndCleanupThread()) return;
-
-  kiss_fftnd(m_kissfft_plan_bkwd, m_kissfft_comp_out,
-             m_kissfft_comp_in);       // Backward FFT
-  kiss_fft_free(m_kissfft_plan_bkwd);  // we don't need this plan anymore
-  m_kissfft_plan_bkwd = NULL;
-
-  // In the backward FFT above, "m_kissfft_comp_out" is used as input and
-  // "m_kissfft_comp_in" as output.
-  // So we don't need "m_kissfft_comp_out" anymore.
-  m_kissfft_comp_out_ras->unlock();
-  m_kissfft_comp_out = 0;
-
-  if (checkTerminationAndCleanupThread()) return;
-
-  {
-    QMutexLocker locker(&mutex);
-
-    TRaster32P ras32 = (TRaster32P)m_layerTileRas;
-    TRaster64P ras64 = (TRaster64P)m_layerTileRas;
-
-    if (ras32) {
-      compositLayerToTile<TRaster32P, TPixel32, TRasterGR8P, TPixelGR8>(
-          ras32, (TRaster32P)m_outTileRas, (TRasterGR8P)m_tmpAlphaRas, dim,
-          margin);
-    } else if (ras64) {
-      compositLayerToTile<TRaster64P, TPixel64, TRasterGR16P, TPixelGR16>(
-          ras64, (TRaster64P)m_outTileRas, (TRasterGR16P)m_tmpAlphaRas, dim,
-          margin);
-    } else {
-      lock.unlock();
-      return;
-    }
-  }
-
-  // Now we don't need "m_kissfft_comp_in" anymore.
-  m_kissfft_comp_in_ras->unlock();
-  m_kissfft_comp_in = 0;
-
-  m_finished = true;
-}
-
-// RGB value <--> Exposure
-inline float MyThread::valueToExposure(float value) {
-  float logVal = (value - 0.5) / m_filmGamma;
-  return pow(10, logVal);
-}
-inline float MyThread::exposureToValue(float exposure) {
-  return log10(exposure) * m_filmGamma + 0.5;
-}
-
-// Release the raster memory and FFT plans on cancel rendering.
-bool MyThread::checkTerminationAndCleanupThread() {
-  if (!m_isTerminated) return false;
-
-  if (m_kissfft_comp_in) m_kissfft_comp_in_ras->unlock();
-  if (m_kissfft_comp_out) m_kissfft_comp_out_ras->unlock();
-  if (m_kissfft_plan_fwd) kiss_fft_free(m_kissfft_plan_fwd);
-  if (m_kissfft_plan_bkwd) kiss_fft_free(m_kissfft_plan_bkwd);
-
-  m_finished = true;
-  return true;
+  filterWithIris(exposures, irisSpectrum, dim);
 }
+}  // namespace
 
 //--------------------------------------------
 // Iwa_BokehFx
@@ -442,10 +388,14 @@ void Iwa_BokehFx::doCompute(TTile& tile, double frame,
                      static_cast<int>(_rectOut.getLy() + 0.5));
 
   // Enlarge the size to the "fast size" for kissfft which has no factors other
-  // than 2,3, or 5.
-  if (dimOut.lx < 10000 && dimOut.ly < 10000) {
-    int new_x = kiss_fft_next_fast_size(dimOut.lx);
-    int new_y = kiss_fft_next_fast_size(dimOut.ly);
+  // than 2,3, or 5. The width must be even for the real-to-complex FFT.
+  {
+    int new_x = dimOut.lx + dimOut.lx % 2;
+    int new_y = dimOut.ly;
+    if (dimOut.lx < 10000 && dimOut.ly < 10000) {
+      new_x = getFftSize(dimOut.lx);
+      new_y = kiss_fft_next_fast_size(dimOut.ly);
+    }
 
     _rectOut = _rectOut.enlarge(static_cast<double>(new_x - dimOut.lx) / 2.0,
                                 static_cast<double>(new_y - dimOut.ly) / 2.0);
@@ -494,13 +444,6 @@ void Iwa_BokehFx::doCompute(TTile& tile, double frame,
   // same time.
   QMutexLocker fx_locker(&fx_mutex);
 
-  kiss_fft_cpx* kissfft_comp_iris;
-  // create the iris data for FFT (in the same size as the source tile)
-  TRasterGR8P kissfft_comp_iris_ras(dimOut.lx * sizeof(kiss_fft_cpx),
-                                    dimOut.ly);
-  kissfft_comp_iris_ras->lock();
-  kissfft_comp_iris = (kiss_fft_cpx*)kissfft_comp_iris_ras->getRawData();
-
   // obtain the film gamma
   double filmGamma = m_hardness->getValue(frame);
 
@@ -516,21 +459,24 @@ void Iwa_BokehFx::doCompute(TTile& tile, double frame,
 
   // cancel check
   if (settings.m_isCanceled && *settings.m_isCanceled) {
-    kissfft_comp_iris_ras->unlock();
+    qDeleteAll(sourceTiles);
     tile.getRaster()->clear();
     return;
   }
 
+  // The FFT-ed iris data of the layers to be off-focused are created in
+  // parallel, a few layers at a time so that the memory usage does not grow
+  // with the layer count. The spectrum of real data is stored in
+  // (lx / 2 + 1) x ly points.
+  static const int MaxIrisSpectraInFlight = 4;
+
+  int spectrumSize = (dimOut.lx / 2 + 1) * dimOut.ly;
+  QMap<int, TRasterGR8P> irisSpectrumRasters;
+
   // Compute from from the most distant layer
   for (int i = 0; i < sourceIndices.size(); i++) {
-    // cancel check
-    if (settings.m_isCanceled && *settings.m_isCanceled) {
-      kissfft_comp_iris_ras->unlock();
-      tile.getRaster()->clear();
-      return;
-    }
-
-    int index = sourceIndices.at(i);
+    int index        = sourceIndices.at(i);
+    TTile* layerTile = sourceTiles.take(index);
 
     // The iris size of the current layer
     float irisSize = irisSizes.at(i);
@@ -539,62 +485,66 @@ void Iwa_BokehFx::doCompute(TTile& tile, double frame,
     // composite the layer as-is.
     if (-1.0 <= irisSize && 1.0 >= irisSize) {
       //"Over" composite the layer to the output raster.
-      TTile* layerTile = sourceTiles.value(index);
       compositLayerAsIs(tile, *layerTile, frame, settings, index);
-      sourceTiles.remove(index);
+      delete layerTile;
       // Continue to the next layer
       continue;
     }
 
-    {
-      // Create the Iris image for FFT
-      kiss_fft_cpx* kissfft_comp_iris_before;
-      TRasterGR8P kissfft_comp_iris_before_ras(dimOut.lx * sizeof(kiss_fft_cpx),
-                                               dimOut.ly);
-      kissfft_comp_iris_before_ras->lock();
-      kissfft_comp_iris_before =
-          (kiss_fft_cpx*)kissfft_comp_iris_before_ras->getRawData();
-      // Resize / flip the iris image according to the size ratio.
-      // Normalize the brightness of the iris image.
-      // Enlarge the iris to the output size.
-      convertIris(irisSize, kissfft_comp_iris_before, dimOut, irisBBox,
-                  irisTile);
-
-      if (settings.m_isCanceled && *settings.m_isCanceled) {
-        kissfft_comp_iris_ras->unlock();
-        kissfft_comp_iris_before_ras->unlock();
-        tile.getRaster()->clear();
-        return;
+    // Create the iris data of this layer and of the next off-focused ones
+    if (!irisSpectrumRasters.contains(index)) {
+      std::vector<std::function<void()>> jobs;
+      for (int j = i; j < sourceIndices.size(); j++) {
+        if ((int)jobs.size() == MaxIrisSpectraInFlight) break;
+
+        float layerIrisSize = irisSizes.at(j);
+        if (-1.0 <= layerIrisSize && 1.0 >= layerIrisSize) continue;
+
+        TRasterGR8P irisSpectrumRas(spectrumSize * sizeof(kiss_fft_cpx), 1);
+        irisSpectrumRas->lock();
+        irisSpectrumRasters[sourceIndices.at(j)] = irisSpectrumRas;
+
+        kiss_fft_cpx* irisSpectrum =
+            (kiss_fft_cpx*)irisSpectrumRas->getRawData();
+        jobs.push_back([=, &irisTile]() {
+          TRasterGR8P irisBeforeRas(dimOut.lx * sizeof(kiss_fft_scalar),
+                                    dimOut.ly);
+          irisBeforeRas->lock();
+          kiss_fft_scalar* irisBefore =
+              (kiss_fft_scalar*)irisBeforeRas->getRawData();
+          // Resize / flip the iris image according to the size ratio.
+          // Normalize the brightness of the iris image.
+          // Enlarge the iris to the output size.
+          convertIris(layerIrisSize, irisBefore, dimOut, irisBBox, irisTile);
+
+          FftPlan* plan = FftPlanCache::instance()->acquire(dimOut);
+          kiss_fftndr(plan->m_fwd, irisBefore, irisSpectrum);
+          FftPlanCache::instance()->release(plan);
+
+          irisBeforeRas->unlock();
+        });
       }
 
-      // Create the FFT plan for the iris image.
-      kiss_fftnd_cfg iris_kissfft_plan;
-      while (1) {
-        int dims[2]       = {dimOut.ly, dimOut.lx};
-        int ndims         = 2;
-        iris_kissfft_plan = kiss_fftnd_alloc(dims, ndims, false, 0, 0);
-        if (iris_kissfft_plan != NULL) break;
+      bool done = runJobs(jobs);
+      if (!done || (settings.m_isCanceled && *settings.m_isCanceled)) {
+        for (TRasterGR8P& ras : irisSpectrumRasters) ras->unlock();
+        delete layerTile;
+        qDeleteAll(sourceTiles);
+        tile.getRaster()->clear();
+        return;
       }
-      // Do FFT the iris image.
-      kiss_fftnd(iris_kissfft_plan, kissfft_comp_iris_before,
-                 kissfft_comp_iris);
-      kiss_fft_free(iris_kissfft_plan);
-      kissfft_comp_iris_before_ras->unlock();
     }
 
-    // Up to here, FFT-ed iris data is stored in kissfft_comp_iris
+    // Taken out of the map, the spectrum is released after this layer
+    TRasterGR8P irisSpectrumRas = irisSpectrumRasters.take(index);
+    const kiss_fft_cpx* irisSpectrum =
+        (const kiss_fft_cpx*)irisSpectrumRas->getRawData();
 
-    // cancel check
-    if (settings.m_isCanceled && *settings.m_isCanceled) {
-      kissfft_comp_iris_ras->unlock();
-      tile.getRaster()->clear();
-      return;
-    }
     // Prepare the layer rasters
-    TTile* layerTile = sourceTiles.value(index);
+    TRasterP layerRas = layerTile->getRaster();
     // Unpremultiply the source if needed
     if (!m_layerParams[index].m_premultiply->getValue())
-      TRop::depremultiply(layerTile->getRaster());
+      TRop::depremultiply(layerRas);
     // Create the raster memory for storing alpha channel
     TRasterP tmpAlphaRas;
     {
@@ -607,145 +557,68 @@ void Iwa_BokehFx::doCompute(TTile& tile, double frame,
     }
     tmpAlphaRas->lock();
 
-    // Do FFT the alpha channel.
-    // Forward FFT -> Multiply by the iris data -> Backward FFT
-    calcAlfaChannelBokeh(kissfft_comp_iris, *layerTile, tmpAlphaRas);
-
-    if (settings.m_isCanceled && *settings.m_isCanceled) {
-      kissfft_comp_iris_ras->unlock();
-      tile.getRaster()->clear();
-      tmpAlphaRas->unlock();
-      return;
+    // Create the raster memory for storing the filtered RGB exposures
+    TRasterGR8P exposuresRas[3];
+    for (int c = 0; c < 3; c++) {
+      exposuresRas[c] =
+          TRasterGR8P(dimOut.lx * sizeof(kiss_fft_scalar), dimOut.ly);
+      exposuresRas[c]->lock();
     }
 
-    // Create the threads for RGB channels
-    MyThread threadR(MyThread::Red, layerTile->getRaster(), tile.getRaster(),
-                     tmpAlphaRas, kissfft_comp_iris, filmGamma);
-    MyThread threadG(MyThread::Green, layerTile->getRaster(), tile.getRaster(),
-                     tmpAlphaRas, kissfft_comp_iris, filmGamma);
-    MyThread threadB(MyThread::Blue, layerTile->getRaster(), tile.getRaster(),
-                     tmpAlphaRas, kissfft_comp_iris, filmGamma);
-
-    // If you set this flag to true, the fx will be forced to compute in single
-    // thread.
-    // Under some specific condition (such as calling from single-threaded
-    // tcomposer)
-    // we may need to use this flag... For now, I'll keep this option unused.
-    // TODO: investigate this.
-    bool renderInSingleThread = false;
-
-    // Start the thread when the initialization is done.
-    // Red channel
-    int waitCount = 0;
-    while (1) {
-      // cancel & timeout check
-      if ((settings.m_isCanceled && *settings.m_isCanceled) ||
-          waitCount >= 20)  // 10 second timeout
-      {
-        kissfft_comp_iris_ras->unlock();
-        tile.getRaster()->clear();
-        tmpAlphaRas->unlock();
-        return;
-      }
-      if (threadR.init()) {
-        if (renderInSingleThread)
-          threadR.run();
-        else
-          threadR.start();
-        break;
-      }
-      QThread::msleep(500);
-      waitCount++;
-    }
-    // Green channel
-    waitCount = 0;
-    while (1) {
-      // cancel & timeout check
-      if ((settings.m_isCanceled && *settings.m_isCanceled) ||
-          waitCount >= 20)  // 10 second timeout
-      {
-        if (!threadR.isFinished()) threadR.terminateThread();
-        while (!threadR.isFinished()) {
-        }
-        kissfft_comp_iris_ras->unlock();
-        tile.getRaster()->clear();
-        tmpAlphaRas->unlock();
-        return;
-      }
-      if (threadG.init()) {
-        if (renderInSingleThread)
-          threadG.run();
-        else
-          threadG.start();
-        break;
+    // Filter the alpha and RGB channels in parallel
+    bool done;
+    {
+      std::vector<std::function<void()>> jobs;
+      jobs.push_back([=]() {
+        calcAlfaChannelBokeh(irisSpectrum, *layerTile, tmpAlphaRas);
+      });
+      for (int c = 0; c < 3; c++) {
+        kiss_fft_scalar* exposures =
+            (kiss_fft_scalar*)exposuresRas[c]->getRawData();
+        jobs.push_back([=]() {
+          calcChannelBokeh((Channel)c, irisSpectrum, layerRas, exposures,
+                           filmGamma);
+        });
       }
-      QThread::msleep(500);
-      waitCount++;
+      done = runJobs(jobs);
     }
-    // Blue channel
-    waitCount = 0;
-    while (1) {
-      // cancel & timeout check
-      if ((settings.m_isCanceled && *settings.m_isCanceled) ||
-          waitCount >= 20)  // 10 second timeout
-      {
-        if (!threadR.isFinished()) threadR.terminateThread();
-        if (!threadG.isFinished()) threadG.terminateThread();
-        while (!threadR.isFinished() || !threadG.isFinished()) {
-        }
-        kissfft_comp_iris_ras->unlock();
-        tile.getRaster()->clear();
-        tmpAlphaRas->unlock();
-        return;
-      }
-      if (threadB.init()) {
-        if (renderInSingleThread)
-          threadB.run();
-        else
-          threadB.start();
-        break;
-      }
-      QThread::msleep(500);
-      waitCount++;
+
+    irisSpectrumRas->unlock();
+    delete layerTile;
+
+    if (!done || (settings.m_isCanceled && *settings.m_isCanceled)) {
+      for (int c = 0; c < 3; c++) exposuresRas[c]->unlock();
+      tmpAlphaRas->unlock();
+      for (TRasterGR8P& ras : irisSpectrumRasters) ras->unlock();
+      qDeleteAll(sourceTiles);
+      tile.getRaster()->clear();
+      return;
     }
 
-    /*
-    * What is done in the thread for each RGB channel:
-    * - Convert channel value -> Exposure
-    * - Multiply by alpha channel
-    * - Forward FFT
-    * - Multiply by the iris FFT data
-    * - Backward FFT
-    * - Convert Exposure -> channel value
-    */
-
-    waitCount = 0;
-    while (1) {
-      // cancel & timeout check
-      if ((settings.m_isCanceled && *settings.m_isCanceled) ||
-          waitCount >= 2000)  // 100 second timeout
-      {
-        if (!threadR.isFinished()) threadR.terminateThread();
-        if (!threadG.isFinished()) threadG.terminateThread();
-        if (!threadB.isFinished()) threadB.terminateThread();
-        while (!threadR.isFinished() || !threadG.isFinished() ||
-               !threadB.isFinished()) {
-        }
-        kissfft_comp_iris_ras->unlock();
-        tile.getRaster()->clear();
-        tmpAlphaRas->unlock();
-        return;
-      }
-      if (threadR.isFinished() && threadG.isFinished() && threadB.isFinished())
-        break;
-      QThread::msleep(50);
-      waitCount++;
+    // Convert the exposures back to RGB values, and composite the layer to
+    // the result
+    int2 margin = {(dimOut.lx - tile.getRaster()->getLx()) / 2,
+                   (dimOut.ly - tile.getRaster()->getLy()) / 2};
+    for (int c = 0; c < 3; c++) {
+      const kiss_fft_scalar* exposures =
+          (const kiss_fft_scalar*)exposuresRas[c]->getRawData();
+
+      TRaster32P ras32 = (TRaster32P)tile.getRaster();
+      TRaster64P ras64 = (TRaster64P)tile.getRaster();
+      if (ras32)
+        compositLayerToTile<TRaster32P, TPixel32, TRasterGR8P, TPixelGR8>(
+            exposures, ras32, (TRasterGR8P)tmpAlphaRas, dimOut, margin,
+            (Channel)c, filmGamma);
+      else if (ras64)
+        compositLayerToTile<TRaster64P, TPixel64, TRasterGR16P, TPixelGR16>(
+            exposures, ras64, (TRasterGR16P)tmpAlphaRas, dimOut, margin,
+            (Channel)c, filmGamma);
+
+      exposuresRas[c]->unlock();
     }
+
     tmpAlphaRas->unlock();
-    sourceTiles.remove(index);
   }
-
-  kissfft_comp_iris_ras->unlock();
 }
 
 bool Iwa_BokehFx::doGetBBox(double frame, TRectD& bBox,
@@ -840,7 +713,7 @@ void Iwa_BokehFx::compositLayerAsIs(TTile& tile, TTile& layerTile,
 // Normalize the brightness of the iris image.
 // Enlarge the iris to the output size.
 void Iwa_BokehFx::convertIris(const float irisSize,
-                              kiss_fft_cpx* kissfft_comp_iris_before,
+                              kiss_fft_scalar* kissfft_comp_iris_before,
                               const TDimensionI& dimOut, const TRectD& irisBBox,
                               const TTile& irisTile) {
   // the original size of iris image
@@ -899,10 +772,8 @@ void Iwa_BokehFx::convertIris(const float irisSize,
 
   int iris_j = 0;
   // Initialize
-  for (int i = 0; i < dimOut.lx * dimOut.ly; i++) {
-    kissfft_comp_iris_before[i].r = 0.0;
-    kissfft_comp_iris_before[i].i = 0.0;
-  }
+  for (int i = 0; i < dimOut.lx * dimOut.ly; i++)
+    kissfft_comp_iris_before[i] = 0.0;
   for (int j = (dimOut.ly - filterSize.y) / 2; iris_j < filterSize.y;
        j++, iris_j++) {
     TPixel64* pix = resizedIris->pixels(iris_j);
@@ -910,24 +781,24 @@ void Iwa_BokehFx::convertIris(const float irisSize,
     for (int i = (dimOut.lx - filterSize.x) / 2; iris_i < filterSize.x;
          i++, iris_i++) {
       // Value = 0.3R 0.59G 0.11B
-      kissfft_comp_iris_before[j * dimOut.lx + i].r =
+      kissfft_comp_iris_before[j * dimOut.lx + i] =
           ((float)pix->r * 0.3f + (float)pix->g * 0.59f +
            (float)pix->b * 0.11f) /
           (float)USHRT_MAX;
-      irisValAmount += kissfft_comp_iris_before[j * dimOut.lx + i].r;
+      irisValAmount += kissfft_comp_iris_before[j * dimOut.lx + i];
       pix++;
     }
   }
 
   // Normalize value
   for (int i = 0; i < dimOut.lx * dimOut.ly; i++) {
-    kissfft_comp_iris_before[i].r /= irisValAmount;
+    kissfft_comp_iris_before[i] /= irisValAmount;
   }
 }
 
 // Do FFT the alpha channel.
 // Forward FFT -> Multiply by the iris data -> Backward FFT
-void Iwa_BokehFx::calcAlfaChannelBokeh(kiss_fft_cpx* kissfft_comp_iris,
+void Iwa_BokehFx::calcAlfaChannelBokeh(const kiss_fft_cpx* irisSpectrum,
                                        TTile& layerTile, TRasterP tmpAlphaRas) {
   // Obtain the source size
   int lx, ly;
@@ -935,20 +806,9 @@ void Iwa_BokehFx::calcAlfaChannelBokeh(kiss_fft_cpx* kissfft_comp_iris,
   ly = layerTile.getRaster()->getSize().ly;
 
   // Allocate the FFT data
-  kiss_fft_cpx *kissfft_comp_in, *kissfft_comp_out;
-
-  TRasterGR8P kissfft_comp_in_ras(lx * sizeof(kiss_fft_cpx), ly);
-  kissfft_comp_in_ras->lock();
-  kissfft_comp_in = (kiss_fft_cpx*)kissfft_comp_in_ras->getRawData();
-  TRasterGR8P kissfft_comp_out_ras(lx * sizeof(kiss_fft_cpx), ly);
-  kissfft_comp_out_ras->lock();
-  kissfft_comp_out = (kiss_fft_cpx*)kissfft_comp_out_ras->getRawData();
-
-  // Initialize the FFT data
-  for (int i = 0; i < lx * ly; i++) {
-    kissfft_comp_in[i].r = 0.0;  // real part
-    kissfft_comp_in[i].i = 0.0;  // imaginary part
-  }
+  TRasterGR8P alphaRas(lx * sizeof(kiss_fft_scalar), ly);
+  alphaRas->lock();
+  kiss_fft_scalar* alpha = (kiss_fft_scalar*)alphaRas->getRawData();
 
   TRaster32P ras32 = (TRaster32P)layerTile.getRaster();
   TRaster64P ras64 = (TRaster64P)layerTile.getRaster();
@@ -956,7 +816,7 @@ void Iwa_BokehFx::calcAlfaChannelBokeh(kiss_fft_cpx* kissfft_comp_iris,
     for (int j = 0; j < ly; j++) {
       TPixel32* pix = ras32->pixels(j);
       for (int i = 0; i < lx; i++) {
-        kissfft_comp_in[j * lx + i].r = (float)pix->m / (float)UCHAR_MAX;
+        alpha[j * lx + i] = (float)pix->m / (float)UCHAR_MAX;
         pix++;
       }
     }
@@ -964,38 +824,16 @@ void Iwa_BokehFx::calcAlfaChannelBokeh(kiss_fft_cpx* kissfft_comp_iris,
     for (int j = 0; j < ly; j++) {
       TPixel64* pix = ras64->pixels(j);
       for (int i = 0; i < lx; i++) {
-        kissfft_comp_in[j * lx + i].r = (float)pix->m / (float)USHRT_MAX;
+        alpha[j * lx + i] = (float)pix->m / (float)USHRT_MAX;
         pix++;
       }
     }
-  } else
+  } else {
+    alphaRas->unlock();
     return;
-
-  int dims[2]             = {ly, lx};
-  int ndims               = 2;
-  kiss_fftnd_cfg plan_fwd = kiss_fftnd_alloc(dims, ndims, false, 0, 0);
-  kiss_fftnd(plan_fwd, kissfft_comp_in, kissfft_comp_out);
-  kiss_fft_free(plan_fwd);  // we don't need this plan anymore
-
-  // Filtering. Multiply by the iris FFT data
-  for (int i = 0; i < lx * ly; i++) {
-    float re, im;
-    re = kissfft_comp_out[i].r * kissfft_comp_iris[i].r -
-         kissfft_comp_out[i].i * kissfft_comp_iris[i].i;
-    im = kissfft_comp_out[i].r * kissfft_comp_iris[i].i +
-         kissfft_comp_iris[i].r * kissfft_comp_out[i].i;
-    kissfft_comp_out[i].r = re;
-    kissfft_comp_out[i].i = im;
   }
 
-  kiss_fftnd_cfg plan_bkwd = kiss_fftnd_alloc(dims, ndims, true, 0, 0);
-  kiss_fftnd(plan_bkwd, kissfft_comp_out, kissfft_comp_in);  // Backward FFT
-  kiss_fft_free(plan_bkwd);  // we don't need this plan anymore
-
-  // In the backward FFT above, "kissfft_comp_out" is used as input and
-  // "kissfft_comp_in" as output.
-  // So we don't need "kissfft_comp_out" anymore.
-  kissfft_comp_out_ras->unlock();
+  filterWithIris(alpha, irisSpectrum, TDimensionI(lx, ly));
 
   // Store the result into the alpha channel of layer tile
   if (ras32) {
@@ -1003,8 +841,7 @@ void Iwa_BokehFx::calcAlfaChannelBokeh(kiss_fft_cpx* kissfft_comp_iris,
     for (int j = 0; j < ly; j++) {
       TPixelGR8* pix = alphaRas8->pixels(j);
       for (int i = 0; i < lx; i++) {
-        float val =
-            kissfft_comp_in[getCoord(i, j, lx, ly)].r / (lx * ly) * 256.0;
+        float val = alpha[getCoord(i, j, lx, ly)] / (lx * ly) * 256.0;
         if (val < 0.0)
           val = 0.0;
         else if (val > 255.0)
@@ -1020,8 +857,7 @@ void Iwa_BokehFx::calcAlfaChannelBokeh(kiss_fft_cpx* kissfft_comp_iris,
     for (int j = 0; j < ly; j++) {
       TPixelGR16* pix = alphaRas16->pixels(j);
       for (int i = 0; i < lx; i++) {
-        float val =
-            kissfft_comp_in[getCoord(i, j, lx, ly)].r / (lx * ly) * 65536.0;
+        float val = alpha[getCoord(i, j, lx, ly)] / (lx * ly) * 65536.0;
         if (val < 0.0)
           val = 0.0;
         else if (val > 65535.0)
@@ -1032,10 +868,7 @@ void Iwa_BokehFx::calcAlfaChannelBokeh(kiss_fft_cpx* kissfft_comp_iris,
         pix++;
       }
     }
-  } else
-    return;
+  }
 
-  kissfft_comp_in_ras->unlock();
+  alphaRas->unlock();
 }
-
-FX_PLUGIN_IDENTIFIER(Iwa_BokehFx, "iwa_BokehFx")
\ No newline at end of file
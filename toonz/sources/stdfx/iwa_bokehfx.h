@@ -18,9 +18,8 @@ distributed with a 3-clause BSD-style license.
 #include "traster.h"
 
 #include <QList>
-#include <QThread>
 
-#include "tools/kiss_fftnd.h"
+#include "tools/kiss_fftndr.h"
 
 const int LAYER_NUM = 5;
 
@@ -31,68 +30,6 @@ struct int2 {
   int x, y;
 };
 
-class MyThread : public QThread {
-public:
-  enum Channel { Red = 0, Green, Blue };
-
-private:
-  Channel m_channel;
-
-  volatile bool m_finished;
-
-  TRasterP m_layerTileRas;
-  TRasterP m_outTileRas;
-  TRasterP m_tmpAlphaRas;
-
-  kiss_fft_cpx *m_kissfft_comp_iris;
-
-  float m_filmGamma;  // keep the film gamma in each thread as it is refered so
-                      // often
-
-  TRasterGR8P m_kissfft_comp_in_ras, m_kissfft_comp_out_ras;
-  kiss_fft_cpx *m_kissfft_comp_in, *m_kissfft_comp_out;
-  kiss_fftnd_cfg m_kissfft_plan_fwd, m_kissfft_plan_bkwd;
-
-  bool m_isTerminated;
-
-  // not used for now
-  bool m_doLightenComp;
-
-public:
-  MyThread(Channel channel, TRasterP layerTileRas, TRasterP outTileRas,
-           TRasterP tmpAlphaRas, kiss_fft_cpx *kissfft_comp_iris,
-           float m_filmGamma,
-           bool doLightenComp = false);  // not used for now
-
-  // Convert the pixels from RGB values to exposures and multiply it by alpha
-  // channel value.
-  // Store the results in the real part of kiss_fft_cpx.
-  template <typename RASTER, typename PIXEL>
-  void setLayerRaster(const RASTER srcRas, kiss_fft_cpx *dstMem,
-                      TDimensionI dim);
-
-  // Composite the bokeh layer to the result
-  template <typename RASTER, typename PIXEL, typename A_RASTER,
-            typename A_PIXEL>
-  void compositLayerToTile(const RASTER layerRas, const RASTER outTileRas,
-                           const A_RASTER alphaRas, TDimensionI dim,
-                           int2 margin);
-  void run();
-
-  bool isFinished() { return m_finished; }
-
-  // RGB value <--> Exposure
-  float valueToExposure(float value);
-  float exposureToValue(float exposure);
-
-  // memory allocation
-  bool init();
-
-  void terminateThread() { m_isTerminated = true; }
-
-  bool checkTerminationAndCleanupThread();
-};
-
 class Iwa_BokehFx : public TStandardRasterFx {
   FX_PLUGIN_DECLARATION(Iwa_BokehFx)
 
@@ -127,14 +64,15 @@ protected:
   // Resize / flip the iris image according to the size ratio.
   // Normalize the brightness of the iris image.
   // Enlarge the iris to the output size.
-  void convertIris(const float irisSize, kiss_fft_cpx *kissfft_comp_iris_before,
+  void convertIris(const float irisSize,
+                   kiss_fft_scalar *kissfft_comp_iris_before,
                    const TDimensionI &dimOut, const TRectD &irisBBox,
                    const TTile &irisTile);
 
   // Do FFT the alpha channel.
   // Forward FFT -> Multiply by the iris data -> Backward FFT
-  void calcAlfaChannelBokeh(kiss_fft_cpx *kissfft_comp_iris, TTile &layerTile,
-                            TRasterP tmpAlphaRas);
+  void calcAlfaChannelBokeh(const kiss_fft_cpx *irisSpectrum,
+                            TTile &layerTile, TRasterP tmpAlphaRas);
 
 public:
   Iwa_BokehFx();
@@ -6,9 +6,192 @@
 #include "iwa_directionalblurfx.h"
 
 #include "tparamuiconcept.h"
+#include "tthread.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
 
 enum FILTER_TYPE { Linear = 0, Gaussian, Flat };
 
+namespace {
+
+struct double4 {
+  double x, y, z, w;
+};
+
+/*- フィルタの値が０でない画素 -*/
+struct FilterTap {
+  int x, y;    /*- フィルタ上の座標 -*/
+  int offset;  /*- サンプル点のインデックスのずれ -*/
+  float value;
+};
+
+inline void accumulate(double4 &dst, const float4 &src, double ratio) {
+  dst.x += src.x * ratio;
+  dst.y += src.y * ratio;
+  dst.z += src.z * ratio;
+  dst.w += src.w * ratio;
+}
+
+inline void accumulate(float4 &dst, const float4 &src, float ratio) {
+  dst.x += src.x * ratio;
+  dst.y += src.y * ratio;
+  dst.z += src.z * ratio;
+  dst.w += src.w * ratio;
+}
+
+/*------------------------------------------------------------
+ Blur with the Flat or Linear filter along a straight line, at a cost per
+ pixel which does not depend on the blur length.
+ The samples are taken along the "scanlines" parallel to the blur vector
+ which cross the integer coordinates of the minor axis, interpolating the two
+ nearest pixels. The weighted sum over the blur segment is then obtained from
+ the prefix sums of the samples and of the samples multiplied by their index,
+ since the weights are (piecewise) linear in the sample index.
+ Each output pixel finally interpolates the two scanlines surrounding it.
+ Returns false if the computation failed.
+------------------------------------------------------------*/
+
+bool blurAlongLine(const float4 *in, float4 *out, const TDimensionI &dim,
+                   const TDimensionI &dimOut, const int2 &outOrigin,
+                   const TPointD &blur, bool bidirectional, bool linear) {
+  /*- Work on the (u, v) coordinates, u being the axis closer to the blur -*/
+  bool xMajor = std::abs(blur.x) >= std::abs(blur.y);
+  int sizeU   = (xMajor) ? dim.lx : dim.ly;
+  int sizeV   = (xMajor) ? dim.ly : dim.lx;
+  int strideU = (xMajor) ? 1 : dim.lx;
+  int strideV = (xMajor) ? dim.lx : 1;
+  int u0      = (xMajor) ? outOrigin.x : outOrigin.y;
+  int v0      = (xMajor) ? outOrigin.y : outOrigin.x;
+  int nu      = (xMajor) ? dimOut.lx : dimOut.ly;
+  int nv      = (xMajor) ? dimOut.ly : dimOut.lx;
+  double bu   = (xMajor) ? blur.x : blur.y;
+  double bv   = (xMajor) ? blur.y : blur.x;
+
+  /*- The k-th sample of the output pixel (u, v) is at
+      (u - dir * k, v - dir * k * slope) -*/
+  int dir      = (bu > 0.0) ? 1 : -1;
+  double slope = bv / bu;
+  double len   = std::abs(bu);
+  int n        = (int)std::floor(len);
+  double frac  = len - (double)n;
+
+  /*- The weight of the k-th sample is 1 - |k| / len with the Linear filter,
+      and 1 with the Flat one - plus the partial samples past its ends -*/
+  double slopeWeight = (linear) ? 1.0 / len : 0.0;
+  double weightSum   = 0.0;
+  for (int k = (bidirectional) ? -n : 0; k <= n; k++)
+    weightSum += 1.0 - std::abs(k) * slopeWeight;
+  if (!linear) weightSum += (bidirectional) ? 2.0 * frac : frac;
+
+  /*- The scanlines below each output column -*/
+  std::vector<int> baseLine(nu);
+  std::vector<float> baseRatio(nu);
+  for (int i = 0; i < nu; i++) {
+    double c     = (double)v0 - slope * (double)(u0 + i);
+    baseLine[i]  = (int)std::floor(c);
+    baseRatio[i] = (float)(c - (double)baseLine[i]);
+  }
+  int firstLine = std::min(baseLine.front(), baseLine.back());
+  int lastLine  = std::max(baseLine.front(), baseLine.back()) + nv;
+
+  /*- The blurred scanlines, stored per output column -*/
+  int columnLength = nv + 1;
+  TRasterGR8P lines_ras(sizeof(float4) * columnLength, nu);
+  lines_ras->lock();
+  float4 *lines = (float4 *)lines_ras->getRawData();
+
+  int reach = n + 1;
+  bool ret  = TThread::forEachBand(
+      lastLine - firstLine + 1, 16, [&](int begin, int end) {
+        std::vector<double4> sum0(sizeU + 1), sum1(sizeU + 1);
+
+        for (int r = firstLine + begin; r < firstLine + end; r++) {
+          /*- The output columns reading this scanline -*/
+          int first = 0, last = nu - 1;
+          while (first < nu &&
+                 (r < baseLine[first] || r - baseLine[first] > nv))
+            first++;
+          if (first == nu) continue;
+          while (r < baseLine[last] || r - baseLine[last] > nv) last--;
+
+          /*- Prefix sums of the samples -*/
+          int ja     = std::max(0, u0 + first - reach);
+          int jb     = std::min(sizeU - 1, u0 + last + reach);
+          double4 s0 = {0.0, 0.0, 0.0, 0.0};
+          double4 s1 = {0.0, 0.0, 0.0, 0.0};
+          sum0[0]    = s0;
+          sum1[0]    = s1;
+          for (int j = ja; j <= jb; j++) {
+            double v = (double)r + slope * (double)j;
+            int vi   = (int)std::floor(v);
+            float t  = (float)(v - (double)vi);
+            float4 g = {0.0f, 0.0f, 0.0f, 0.0f};
+            if (vi >= 0 && vi < sizeV)
+              accumulate(g, in[j * strideU + vi * strideV], 1.0f - t);
+            if (vi + 1 >= 0 && vi + 1 < sizeV)
+              accumulate(g, in[j * strideU + (vi + 1) * strideV], t);
+            accumulate(s0, g, 1.0);
+            accumulate(s1, g, (double)(j - ja));
+            sum0[j - ja + 1] = s0;
+            sum1[j - ja + 1] = s1;
+          }
+
+          for (int i = first; i <= last; i++) {
+            int lu        = u0 + i - ja;
+            double4 value = {0.0, 0.0, 0.0, 0.0};
+            /*- Add the samples k0 <= k <= k1, weighted by a + b * k -*/
+            auto addSegment = [&](int k0, int k1, double a, double b) {
+              int lLo = std::max(0, lu - ((dir > 0) ? k1 : -k0));
+              int lHi = std::min(jb - ja, lu - ((dir > 0) ? k0 : -k1));
+              if (lLo > lHi) return;
+              const double4 &p0 = sum0[lLo], &p1 = sum0[lHi + 1];
+              const double4 &q0 = sum1[lLo], &q1 = sum1[lHi + 1];
+              double c0 = a + b * dir * lu, c1 = -b * dir;
+              value.x += c0 * (p1.x - p0.x) + c1 * (q1.x - q0.x);
+              value.y += c0 * (p1.y - p0.y) + c1 * (q1.y - q0.y);
+              value.z += c0 * (p1.z - p0.z) + c1 * (q1.z - q0.z);
+              value.w += c0 * (p1.w - p0.w) + c1 * (q1.w - q0.w);
+            };
+            addSegment(0, n, 1.0, -slopeWeight);
+            if (bidirectional && n > 0) addSegment(-n, -1, 1.0, slopeWeight);
+            if (!linear && frac > 0.0) {
+              addSegment(reach, reach, frac, 0.0);
+              if (bidirectional) addSegment(-reach, -reach, frac, 0.0);
+            }
+
+            float4 &dst = lines[i * columnLength + r - baseLine[i]];
+            dst.x       = (float)(value.x / weightSum);
+            dst.y       = (float)(value.y / weightSum);
+            dst.z       = (float)(value.z / weightSum);
+            dst.w       = (float)(value.w / weightSum);
+          }
+        }
+      });
+
+  /*- Interpolate the scanlines surrounding each output pixel -*/
+  if (ret)
+    ret = TThread::forEachBand(nu, 16, [&](int begin, int end) {
+      for (int i = begin; i < end; i++) {
+        const float4 *line_p = lines + i * columnLength;
+        float4 *out_p        = out + (u0 + i) * strideU + v0 * strideV;
+        float ratio          = baseRatio[i];
+        for (int m = 0; m < nv; m++, line_p++, out_p += strideV) {
+          float4 value = {0.0f, 0.0f, 0.0f, 0.0f};
+          accumulate(value, line_p[0], 1.0f - ratio);
+          accumulate(value, line_p[1], ratio);
+          (*out_p) = value;
+        }
+      }
+    });
+
+  lines_ras->unlock();
+  return ret;
+}
+
+}  // namespace
+
 /*------------------------------------------------------------
  参照画像の輝度を０〜１に正規化してホストメモリに読み込む
 ------------------------------------------------------------*/
@@ -241,10 +424,6 @@ void Iwa_DirectionalBlurFx::doCompute_CPU(
   out_ras->lock();
   float4 *out = (float4 *)out_ras->getRawData();
 
-  TRasterGR8P filter_ras(sizeof(float) * filterDim.lx, filterDim.ly);
-  filter_ras->lock();
-  float *filter = (float *)filter_ras->getRawData();
-
   /*- ソース画像を０〜１に正規化してホストメモリに読み込む -*/
   TRaster32P ras32 = (TRaster32P)enlarge_tile.getRaster();
   TRaster64P ras64 = (TRaster64P)enlarge_tile.getRaster();
@@ -253,135 +432,89 @@ void Iwa_DirectionalBlurFx::doCompute_CPU(
   else if (ras64)
     setSourceRaster<TRaster64P, TPixel64>(ras64, in, enlargedDimIn);
 
-  /*- フィルタ作る -*/
-  makeDirectionalBlurFilter_CPU(filter, blur, bidirectional, marginLeft,
-                                marginRight, marginTop, marginBottom,
-                                filterDim);
-
-  if (reference_host) /*- 参照画像がある場合 -*/
-  {
-    float4 *out_p = out + marginTop * enlargedDimIn.lx;
-    float *ref_p  = reference_host + marginTop * enlargedDimIn.lx;
-    /*- フィルタリング -*/
-    for (int y = marginTop; y < dimOut.ly + marginTop; y++) {
-      out_p += marginRight;
-      ref_p += marginRight;
-      for (int x = marginRight; x < dimOut.lx + marginRight;
-           x++, out_p++, ref_p++) {
-        /*- 参照画像が黒ならソースをそのまま返す -*/
-        if ((*ref_p) == 0.0f) {
-          (*out_p) = in[y * enlargedDimIn.lx + x];
-          continue;
-        }
-
-        /*- 値を積算する入れ物を用意 -*/
-        float4 value = {0.0f, 0.0f, 0.0f, 0.0f};
-
-        float *filter_p = filter;
-
-        if ((*ref_p) == 1.0f) {
-          /*- フィルタのサイズでループ
-             ただし、フィルタはサンプル点の画像を収集するように
-                  用いるため、上下左右反転してサンプルする -*/
-          for (int fily = -marginBottom; fily < filterDim.ly - marginBottom;
-               fily++) {
-            /*- サンプル座標 と インデックス の このスキャンラインのうしろ -*/
-            int2 samplePos  = {x + marginLeft, y - fily};
-            int sampleIndex = samplePos.y * enlargedDimIn.lx + samplePos.x;
-
-            for (int filx = -marginLeft; filx < filterDim.lx - marginLeft;
-                 filx++, filter_p++, sampleIndex--) {
-              /*- フィルター値が０またはサンプルピクセルが透明ならcontinue -*/
-              if ((*filter_p) == 0.0f || in[sampleIndex].w == 0.0f) continue;
-              /*- サンプル点の値にフィルタ値を掛けて積算する -*/
-              value.x += in[sampleIndex].x * (*filter_p);
-              value.y += in[sampleIndex].y * (*filter_p);
-              value.z += in[sampleIndex].z * (*filter_p);
-              value.w += in[sampleIndex].w * (*filter_p);
-            }
-          }
-        } else {
-          for (int fily = -marginBottom; fily < filterDim.ly - marginBottom;
-               fily++) {
-            for (int filx = -marginLeft; filx < filterDim.lx - marginLeft;
-                 filx++, filter_p++) {
-              /*- フィルター値が０ならcontinue -*/
-              if ((*filter_p) == 0.0f) continue;
-              /*- サンプル座標 -*/
-              int2 samplePos = {tround((float)x - (float)filx * (*ref_p)),
-                                tround((float)y - (float)fily * (*ref_p))};
-              int sampleIndex = samplePos.y * enlargedDimIn.lx + samplePos.x;
-
-              /*- サンプルピクセルが透明ならcontinue -*/
-              if (in[sampleIndex].w == 0.0f) continue;
-
-              /*- サンプル点の値にフィルタ値を掛けて積算する -*/
-              value.x += in[sampleIndex].x * (*filter_p);
-              value.y += in[sampleIndex].y * (*filter_p);
-              value.z += in[sampleIndex].z * (*filter_p);
-              value.w += in[sampleIndex].w * (*filter_p);
-            }
-          }
-        }
-
-        /*- 値を格納 -*/
-        (*out_p) = value;
+  FILTER_TYPE filterType = (FILTER_TYPE)m_filterType->getValue();
+  int2 margin            = {marginRight, marginTop};
+  bool done;
+
+  if (!reference_host && filterType != Gaussian) {
+    /*- 参照画像が無く、ボケ足が一様か線形なら
+       ブラー方向の累積和で計算する -*/
+    done = blurAlongLine(in, out, enlargedDimIn, dimOut, margin, blur,
+                         bidirectional, filterType == Linear);
+  } else {
+    /*- フィルタ作る -*/
+    TRasterGR8P filter_ras(sizeof(float) * filterDim.lx, filterDim.ly);
+    filter_ras->lock();
+    float *filter = (float *)filter_ras->getRawData();
+    makeDirectionalBlurFilter_CPU(filter, blur, bidirectional, marginLeft,
+                                  marginRight, marginTop, marginBottom,
+                                  filterDim);
+
+    /*- フィルタは細い線なので、値が０でない画素だけを集めておく
+       ただし、フィルタはサンプル点の画像を収集するように
+       用いるため、上下左右反転してサンプルする -*/
+    std::vector<FilterTap> taps;
+    float *fil_p = filter;
+    for (int fy = -marginBottom; fy <= marginTop; fy++) {
+      for (int fx = -marginLeft; fx <= marginRight; fx++, fil_p++) {
+        if ((*fil_p) == 0.0f) continue;
+        FilterTap tap = {fx, fy, -(fy * enlargedDimIn.lx + fx), *fil_p};
+        taps.push_back(tap);
       }
-      out_p += marginLeft;
-      ref_p += marginLeft;
     }
+    filter_ras->unlock();
+
+    /*- フィルタリング。スキャンラインごとに並列に処理する -*/
+    done = TThread::forEachBand(dimOut.ly, 16, [&](int begin, int end) {
+      for (int y = marginTop + begin; y < marginTop + end; y++) {
+        int index = y * enlargedDimIn.lx + marginRight;
+        for (int x = marginRight; x < dimOut.lx + marginRight; x++, index++) {
+          float ref = (reference_host) ? reference_host[index] : 1.0f;
+          /*- 参照画像が黒ならソースをそのまま返す -*/
+          if (ref == 0.0f) {
+            out[index] = in[index];
+            continue;
+          }
 
-  } else /*- 参照画像が無い場合 -*/
-  {
-    float4 *out_p = out + marginTop * enlargedDimIn.lx;
-    /*- フィルタリング -*/
-    for (int y = marginTop; y < dimOut.ly + marginTop; y++) {
-      out_p += marginRight;
-      for (int x = marginRight; x < dimOut.lx + marginRight; x++, out_p++) {
-        /*- 値を積算する入れ物を用意 -*/
-        float4 value = {0.0f, 0.0f, 0.0f, 0.0f};
-        /*- フィルタのサイズでループ
-           ただし、フィルタはサンプル点の画像を収集するように
-                用いるため、上下左右反転してサンプルする -*/
-        int filterIndex = 0;
-        for (int fily = -marginBottom; fily < filterDim.ly - marginBottom;
-             fily++) {
-          /*- サンプル座標 と インデックス の このスキャンラインのうしろ -*/
-          int2 samplePos  = {x + marginLeft, y - fily};
-          int sampleIndex = samplePos.y * enlargedDimIn.lx + samplePos.x;
-
-          for (int filx = -marginLeft; filx < filterDim.lx - marginLeft;
-               filx++, filterIndex++, sampleIndex--) {
-            /*- フィルター値が０またはサンプルピクセルが透明ならcontinue -*/
-            if (filter[filterIndex] == 0.0f || in[sampleIndex].w == 0.0f)
-              continue;
+          /*- 値を積算する入れ物を用意 -*/
+          float4 value = {0.0f, 0.0f, 0.0f, 0.0f};
+          for (const FilterTap &tap : taps) {
+            int sampleIndex;
+            if (ref == 1.0f)
+              sampleIndex = index + tap.offset;
+            else {
+              /*- サンプル座標 -*/
+              int2 samplePos = {tround((float)x - (float)tap.x * ref),
+                                tround((float)y - (float)tap.y * ref)};
+              sampleIndex = samplePos.y * enlargedDimIn.lx + samplePos.x;
+            }
+            /*- サンプルピクセルが透明ならcontinue -*/
+            if (in[sampleIndex].w == 0.0f) continue;
             /*- サンプル点の値にフィルタ値を掛けて積算する -*/
-            value.x += in[sampleIndex].x * filter[filterIndex];
-            value.y += in[sampleIndex].y * filter[filterIndex];
-            value.z += in[sampleIndex].z * filter[filterIndex];
-            value.w += in[sampleIndex].w * filter[filterIndex];
+            accumulate(value, in[sampleIndex], tap.value);
           }
-        }
 
-        /*- 値を格納 -*/
-        (*out_p) = value;
+          /*- 値を格納 -*/
+          out[index] = value;
+        }
       }
-      out_p += marginLeft;
-    }
+    });
   }
 
   in_ras->unlock();
-  filter_ras->unlock();
 
   /*- ラスタのクリア -*/
   tile.getRaster()->clear();
-  TRaster32P outRas32 = (TRaster32P)tile.getRaster();
-  TRaster64P outRas64 = (TRaster64P)tile.getRaster();
-  int2 margin         = {marginRight, marginTop};
-  if (outRas32)
-    setOutputRaster<TRaster32P, TPixel32>(out, outRas32, enlargedDimIn, margin);
-  else if (outRas64)
-    setOutputRaster<TRaster64P, TPixel64>(out, outRas64, enlargedDimIn, margin);
+  if (done) {
+    TRaster32P outRas32 = (TRaster32P)tile.getRaster();
+    TRaster64P outRas64 = (TRaster64P)tile.getRaster();
+    if (outRas32)
+      setOutputRaster<TRaster32P, TPixel32>(out, outRas32, enlargedDimIn,
+                                            margin);
+    else if (outRas64)
+      setOutputRaster<TRaster64P, TPixel64>(out, outRas64, enlargedDimIn,
+                                            margin);
+  }
 
   out_ras->unlock();
 }
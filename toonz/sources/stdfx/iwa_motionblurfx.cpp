@@ -11,6 +11,10 @@ Available to composite exposure value with background.
 
 #include "trop.h"
 
+#include "tthread.h"
+
+#include <vector>
+
 /* Normalize the source image to 0 - 1 and read it into the host memory.
  * Check if the source image is premultiped or not here, if it is not specified
  * in the combo box. */
@@ -412,50 +416,55 @@ void Iwa_MotionBlurCompFx::convertRGBtoExposure_CPU(
 /*------------------------------------------------------------
  Filter and blur exposure values
  Loop for the range of 'outDim'.
+ Since the filter is a thin trajectory, only its non-zero values are
+ visited, and the scanlines are processed in parallel.
+ Returns false if the filtering failed.
 ------------------------------------------------------------*/
 
-void Iwa_MotionBlurCompFx::applyBlurFilter_CPU(
+bool Iwa_MotionBlurCompFx::applyBlurFilter_CPU(
     float4 *in_tile_p, float4 *out_tile_p, TDimensionI &enlargedDim,
     float *filter_p, TDimensionI &filterDim, int marginLeft, int marginBottom,
     int marginRight, int marginTop, TDimensionI &outDim) {
-  for (int i = 0; i < outDim.lx * outDim.ly; i++) {
-    /* in_tile_dev and out_tile_dev contain data with dimensions lx * ly.
-     * So, convert i to coordinates for output. */
-    int2 outPos  = {i % outDim.lx + marginRight, i / outDim.lx + marginTop};
-    int outIndex = outPos.y * enlargedDim.lx + outPos.x;
-    /* put the result in out_tile_dev [outIndex] */
-
-    /* Prepare a container to accumulate values ​​- */
-    float4 value = {0.0f, 0.0f, 0.0f, 0.0f};
-
-    /* Loop by filter size.
-     * Note that the filter is used to 'collect' pixels at sample points
-     * so flip the filter vertically and horizontally and sample it */
-    int filterIndex = 0;
-    for (int fily = -marginBottom; fily < filterDim.ly - marginBottom; fily++) {
-      /* Sample coordinates and index of the end of this scan line */
-      int2 samplePos  = {outPos.x + marginLeft, outPos.y - fily};
-      int sampleIndex = samplePos.y * enlargedDim.lx + samplePos.x;
-
-      for (int filx = -marginLeft; filx < filterDim.lx - marginLeft;
-           filx++, filterIndex++, sampleIndex--) {
-        /* If the filter value is 0 or the sample pixel is transparent, continue
-         */
-        if (filter_p[filterIndex] == 0.0f || in_tile_p[sampleIndex].w == 0.0f)
-          continue;
-        /* multiply the sample point value by the filter value and integrate */
-        value.x += in_tile_p[sampleIndex].x * filter_p[filterIndex];
-        value.y += in_tile_p[sampleIndex].y * filter_p[filterIndex];
-        value.z += in_tile_p[sampleIndex].z * filter_p[filterIndex];
-        value.w += in_tile_p[sampleIndex].w * filter_p[filterIndex];
-      }
+  /* Collect the non-zero filter values, along with the offsets of the
+   * corresponding sample indices.
+   * Note that the filter is used to 'collect' pixels at sample points
+   * so flip the filter vertically and horizontally and sample it */
+  std::vector<std::pair<int, float>> taps;
+  float *cur_fil_p = filter_p;
+  for (int fily = -marginBottom; fily < filterDim.ly - marginBottom; fily++) {
+    for (int filx = -marginLeft; filx < filterDim.lx - marginLeft;
+         filx++, cur_fil_p++) {
+      if (*cur_fil_p == 0.0f) continue;
+      taps.push_back(
+          std::make_pair(-(fily * enlargedDim.lx + filx), *cur_fil_p));
     }
-
-    out_tile_p[outIndex].x = value.x;
-    out_tile_p[outIndex].y = value.y;
-    out_tile_p[outIndex].z = value.z;
-    out_tile_p[outIndex].w = value.w;
   }
+
+  return TThread::forEachBand(outDim.ly, 16, [&](int begin, int end) {
+    for (int y = begin; y < end; y++) {
+      /* in_tile_dev and out_tile_dev contain data with dimensions lx * ly.
+       * So, convert to coordinates for output. */
+      int outIndex = (y + marginTop) * enlargedDim.lx + marginRight;
+      for (int x = 0; x < outDim.lx; x++, outIndex++) {
+        /* Prepare a container to accumulate values */
+        float4 value = {0.0f, 0.0f, 0.0f, 0.0f};
+
+        for (const std::pair<int, float> &tap : taps) {
+          const float4 &sample = in_tile_p[outIndex + tap.first];
+          /* If the sample pixel is transparent, continue */
+          if (sample.w == 0.0f) continue;
+          /* multiply the sample point value by the filter value and
+           * integrate */
+          value.x += sample.x * tap.second;
+          value.y += sample.y * tap.second;
+          value.z += sample.z * tap.second;
+          value.w += sample.w * tap.second;
+        }
+
+        out_tile_p[outIndex] = value;
+      }
+    }
+  });
 }
 
 /*------------------------------------------------------------
@@ -828,12 +837,19 @@ void Iwa_MotionBlurCompFx::doCompute_CPU(
                            sourceIsPremultiplied);
 
   /* Filter and blur exposure value */
-  applyBlurFilter_CPU(in_tile_p, out_tile_p, enlargedDimIn, filter_p, filterDim,
-                      marginLeft, marginBottom, marginRight, marginTop, dimOut);
+  bool done = applyBlurFilter_CPU(in_tile_p, out_tile_p, enlargedDimIn,
+                                  filter_p, filterDim, marginLeft, marginBottom,
+                                  marginRight, marginTop, dimOut);
   /* Memory release */
   in_tile_ras->unlock();
   filter_ras->unlock();
 
+  if (!done) {
+    out_tile_ras->unlock();
+    tile.getRaster()->clear();
+    return;
+  }
+
   /* If there is a background, do Exposure multiplication */
   if (m_background.isConnected()) {
     composeBackgroundExposure_CPU(out_tile_p, enlargedDimIn, marginRight,
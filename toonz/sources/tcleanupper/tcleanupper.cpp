@@ -43,6 +43,13 @@
 
 // Qt includes
 #include <QApplication>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QSemaphore>
+
+// STD includes
+#include <map>
+#include <memory>
 
 using namespace TCli;
 using namespace std;
@@ -370,6 +377,108 @@ static void addCleanupDefaultPalette(TXshSimpleLevel *sl) {
   delete defaultPalette;
 }
 
+//========================================================================
+//
+// cleanupFrame
+//
+// effettua il cleanup di un singolo frame con il contesto specificato.
+// Se non e' richiesto il line processing restituisce l'immagine
+// (eventualmente) autocentrata
+//
+//------------------------------------------------------------------------
+
+static TImageP cleanupFrame(TCleanupper *cl, TRasterImageP original,
+                            bool firstImage, bool &autocenterFailed) {
+  const CleanupParameters *params = cl->getParameters();
+  autocenterFailed                = false;
+
+  if (params->m_lineProcessingMode == lpNone) {
+    if (params->m_autocenterType == CleanupTypes::AUTOCENTER_NONE)
+      return original;
+
+    bool autocentered;
+    TRasterImageP ri = cl->autocenterOnly(original, false, autocentered);
+    autocenterFailed = !autocentered;
+    return ri;
+  }
+
+  TRasterImageP resampledImage;
+  CleanupPreprocessedImage *cpi =
+      cl->process(original, firstImage, resampledImage);
+  if (!cpi) return TImageP();
+
+  autocenterFailed =
+      (params->m_autocenterType != CleanupTypes::AUTOCENTER_NONE &&
+       !cpi->m_autocentered);
+
+  TToonzImageP timage = cl->finalize(cpi, true);
+  delete cpi;
+
+  return timage;
+}
+
+//========================================================================
+//
+// CleanupFrameTask
+//
+// cleanuppa un frame in un thread del pool. Ogni task usa un proprio
+// contesto TCleanupper e una propria copia dei parametri, in modo da
+// poter girare in parallelo con gli altri.
+//
+//------------------------------------------------------------------------
+
+namespace {
+
+class CleanupFrameTask final : public QRunnable {
+  CleanupParameters m_params;
+  TPointD m_sourceDpi;
+  TRasterImageP m_original;
+
+  TImageP m_result;
+  bool m_autocenterFailed;
+  std::string m_error;
+
+  QSemaphore m_done;
+
+public:
+  CleanupFrameTask(const CleanupParameters *params, const TPointD &sourceDpi,
+                   const TRasterImageP &original)
+      : m_params(*params)
+      , m_sourceDpi(sourceDpi)
+      , m_original(original)
+      , m_autocenterFailed(false) {
+    setAutoDelete(false);
+  }
+
+  void run() override {
+    try {
+      TCleanupper cl;
+      cl.setParameters(&m_params);
+      cl.setSourceDpi(m_sourceDpi);
+
+      TRasterImageP original = m_original;
+      m_original             = TRasterImageP();  // released as soon as possible
+
+      m_result = cleanupFrame(&cl, original, false, m_autocenterFailed);
+      if (!m_result) m_error = "    *error* cleanup failed";
+    } catch (...) {
+      m_error = "    *error* cleanup failed";
+    }
+
+    m_done.release();
+  }
+
+  //! Waits for the task to complete, and returns its result.
+  TImageP waitResult(bool &autocenterFailed, std::string &error) {
+    m_done.acquire();
+    autocenterFailed = m_autocenterFailed;
+    error            = m_error;
+    return m_result;
+  }
+};
+
+}  // namespace
+
 //========================================================================
 //
 // cleanupLevel
@@ -379,10 +488,14 @@ static void addCleanupDefaultPalette(TXshSimpleLevel *sl) {
 //
 // se overwrite == false non fa il cleanup dei frames gia' cleanuppati
 //
+// Il primo frame viene elaborato nel thread principale; i successivi
+// vengono distribuiti su threadCount thread, mentre lettura dei frames e
+// scrittura dei risultati restano sequenziali e nell'ordine originale.
+//
 //------------------------------------------------------------------------
 
 static void cleanupLevel(TXshSimpleLevel *xl, std::set<TFrameId> fidsInXsheet,
-                         ToonzScene *scene, bool overwrite,
+                         ToonzScene *scene, bool overwrite, int threadCount,
                          TUserLogAppend &m_userLog) {
   prepareToCleanup(xl, scene->getProperties()
                            ->getCleanupParameters()
@@ -397,66 +510,115 @@ static void cleanupLevel(TXshSimpleLevel *xl, std::set<TFrameId> fidsInXsheet,
   LevelUpdater updater(xl);
   m_userLog.info(info);
   DVGui::info(QString::fromStdString(info));
-  bool firstImage = true;
+
+  CleanupParameters *params = scene->getProperties()->getCleanupParameters();
+  if (!cl->isReentrant()) threadCount = 1;
+
+  // Frames to be processed, with their status before the cleanup
+  std::vector<std::pair<TFrameId, int>> frames;
   for (auto const &fid : fidsInXsheet) {
-    cout << "  " << fid << endl;
-    info = "  " + fid.expand();
-    m_userLog.info(info);
     int status = xl->getFrameStatus(fid);
 
     if (0 != (status & TXshSimpleLevel::Cleanupped) && !overwrite) {
+      cout << "  " << fid << endl;
+      m_userLog.info("  " + fid.expand());
       cout << "  skipped" << endl;
       m_userLog.info("  skipped");
       DVGui::info(QString("--skipped frame ") +
                   QString::fromStdString(fid.expand()));
       continue;
     }
-    TRasterImageP original = xl->getFrameToCleanup(fid);
-    if (!original) {
-      string err = "    *error* missed frame";
-      m_userLog.error(err);
-      cout << err << endl;
-      continue;
-    }
 
-    CleanupParameters *params = scene->getProperties()->getCleanupParameters();
+    frames.push_back(std::make_pair(fid, status));
+  }
 
-    if (params->m_lineProcessingMode == lpNone) {
-      TRasterImageP ri;
-      if (params->m_autocenterType == CleanupTypes::AUTOCENTER_NONE)
-        ri = original;
+  // Frames are loaded up to this count ahead of the one being stored, which
+  // bounds the number of full-size scans held in memory
+  const int maxQueued = 2 * threadCount;
+
+  // NOTE: The pool is declared last, so that its destruction waits for any
+  // running task before the tasks themselves are released
+  std::map<int, std::unique_ptr<CleanupFrameTask>> tasks;
+
+  QThreadPool pool;
+  pool.setMaxThreadCount(threadCount);
+
+  int queued      = 0;
+  bool firstImage = true;
+
+  for (int f = 0; f != (int)frames.size(); ++f) {
+    const TFrameId &fid = frames[f].first;
+    int status          = frames[f].second;
+
+    cout << "  " << fid << endl;
+    m_userLog.info("  " + fid.expand());
+
+    TImageP result;
+    bool autocenterFailed = false;
+    std::string error;
+
+    auto tt = tasks.find(f);
+    if (tt != tasks.end()) {
+      result = tt->second->waitResult(autocenterFailed, error);
+      tasks.erase(tt);
+    } else {
+      TRasterImageP original = xl->getFrameToCleanup(fid);
+      if (!original)
+        error = "    *error* missed frame";
       else {
-        bool autocentered;
-        ri = cl->autocenterOnly(original, false, autocentered);
-        if (!autocentered) {
-          m_userLog.error("The autocentering failed on the current drawing.");
-          cout << "The autocentering failed on the current drawing." << endl;
+        // Obtain the source dpi. Changed it to be done once at the first frame
+        // of each level in order to avoid the following problem:
+        // If the original raster level has no dpi (such as TGA images),
+        // obtaining dpi in every frame causes dpi mismatch between the first
+        // frame and the following frames, since the value
+        // TXshSimpleLevel::m_properties->getDpi() will be changed to the
+        // dpi of cleanup camera (= TLV's dpi) after finishing the first frame.
+        if (firstImage && params->m_lineProcessingMode != lpNone) {
+          TPointD dpi;
+          original->getDpi(dpi.x, dpi.y);
+          if (dpi.x == 0 && dpi.y == 0) dpi = xl->getProperties()->getDpi();
+          cl->setSourceDpi(dpi);
         }
+
+        result = cleanupFrame(cl, original, firstImage, autocenterFailed);
+        if (!result) error = "    *error* cleanup failed";
+      }
+    }
+
+    // Once the first image has fixed the source dpi, the following frames
+    // can be handed over to the pool
+    if (!firstImage || result) {
+      for (queued = std::max(queued, f + 1);
+           threadCount > 1 && queued < (int)frames.size() &&
+           queued <= f + maxQueued;
+           ++queued) {
+        TRasterImageP original = xl->getFrameToCleanup(frames[queued].first);
+        if (!original) continue;  // reported as a missed frame when reached
+
+        CleanupFrameTask *task =
+            new CleanupFrameTask(params, cl->getSourceDpi(), original);
+        tasks[queued].reset(task);
+        pool.start(task);
       }
-      updater.update(fid, ri);
-      continue;
     }
-    // Obtain the source dpi. Changed it to be done once at the first frame of
-    // each level in order to avoid the following problem:
-    // If the original raster level has no dpi (such as TGA images), obtaining
-    // dpi in every frame causes dpi mismatch between the first frame and the
-    // following frames, since the value
-    // TXshSimpleLevel::m_properties->getDpi() will be changed to the
-    // dpi of cleanup camera (= TLV's dpi) after finishing the first frame.
-    if (firstImage) {
-      TPointD dpi;
-      original->getDpi(dpi.x, dpi.y);
-      if (dpi.x == 0 && dpi.y == 0) dpi = xl->getProperties()->getDpi();
-      cl->setSourceDpi(dpi);
+
+    if (autocenterFailed) {
+      m_userLog.error("The autocentering failed on the current drawing.");
+      cout << "The autocentering failed on the current drawing." << endl;
     }
 
-    CleanupPreprocessedImage *cpi;
-    {
-      TRasterImageP resampledImage;
-      cpi = cl->process(original, firstImage, resampledImage);
+    if (!result) {
+      m_userLog.error(error);
+      cout << error << endl;
+      continue;
     }
 
-    TToonzImageP timage = cl->finalize(cpi, true);
+    if (params->m_lineProcessingMode == lpNone) {
+      updater.update(fid, result);
+      continue;
+    }
+
+    TToonzImageP timage(result);
     TPointD dpi(0, 0);
     timage->getDpi(dpi.x, dpi.y);
     if (dpi.x != 0 && dpi.y != 0) xl->getProperties()->setDpi(dpi);
@@ -472,9 +634,9 @@ static void cleanupLevel(TXshSimpleLevel *xl, std::set<TFrameId> fidsInXsheet,
 
     /*- 1フレーム終わったら、そのフレームのキャッシュは消す -*/
     xl->invalidateFrame(fid);
-
-    delete cpi;
   }
+
+  pool.waitForDone();
 }
 
 //========================================================================
@@ -549,11 +711,31 @@ int main(int argc, char *argv[]) {
   StringQualifier farmData("-farm data", "TFarm Controller");
   StringQualifier idq("-id n", "id");
   StringQualifier tmsg("-tmsg n", "Internal use only");
+  StringQualifier nthreads("-nthreads n", "Number of cleanup threads");
   Usage usage(argv[0]);
   usage.add(srcName + selectedOnlyOption + overwriteAllOption +
-            overwriteNoPaintOption + farmData + idq + tmsg);
+            overwriteNoPaintOption + farmData + idq + nthreads + tmsg);
   if (!usage.parse(argc, argv)) exit(1);
 
+  // Retrieve Thread count
+  const int procCount = TSystem::getProcessorCount();
+  int threadCount     = procCount;
+  if (nthreads.isSelected()) {
+    QString threadCountStr = QString::fromStdString(nthreads.getValue());
+    threadCount            = (threadCountStr == "single")
+                      ? 1
+                      : (threadCountStr == "half")
+                            ? std::max(1, procCount / 2)
+                            : (threadCountStr == "all")
+                                  ? procCount
+                                  : threadCountStr.toInt();
+
+    if (threadCount <= 0) {
+      cout << "Qualifier 'nthreads': bad input" << endl;
+      exit(1);
+    }
+  }
+
   TaskId       = idq.getValue();
   string fdata = farmData.getValue();
   if (fdata.empty())
@@ -761,7 +943,7 @@ int main(int argc, char *argv[]) {
     assert(fidsInXsheet.size() > 0);
 
     xl->load();
-    cleanupLevel(xl, fidsInXsheet, scene, overwrite, m_userLog);
+    cleanupLevel(xl, fidsInXsheet, scene, overwrite, threadCount, m_userLog);
 
     /*- Cleanup完了後、Nopaintをnopaintフォルダに保存する -*/
     if (Preferences::instance()->isSaveUnpaintedInCleanupEnable() &&
@@ -8,6 +8,7 @@
 
 // TFarmController includes
 #include "tfarmcontroller.h"
+#include "tfarmexecutor.h"
 
 // TnzStdfx includes
 #include "stdfx/shaderfx.h"
@@ -20,6 +21,8 @@
 #include "toonz/preferences.h"
 #include "toonz/tproject.h"
 #include "toonz/toonzscene.h"
+#include "toonz/levelset.h"
+#include "toonz/txshsimplelevel.h"
 #include "toonz/sceneproperties.h"
 #include "toonz/txshsoundlevel.h"
 #include "toonz/txshsoundcolumn.h"
@@ -47,6 +50,7 @@
 #include "tunit.h"
 #include "tenv.h"
 #include "tpassivecachemanager.h"
+#include "tsharedcachemanager.h"
 //#include "tcacheresourcepool.h"
 
 // TnzCore includes
@@ -72,8 +76,16 @@
 // Qt includes
 #include <QApplication>
 #include <QWaitCondition>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QStringList>
+#include <QDateTime>
+#include <QFileInfo>
 #include <QMessageBox>
 
+// STD includes
+#include <sstream>
+
 
 #ifdef _WIN32
 #ifndef x64
@@ -215,6 +227,64 @@ TFarmController *FarmController = 0;
 TUserLogAppend *m_userLog;
 QString TaskId;
 
+// The render in progress, which the daemon's "cancel" requests stop from
+// the receiving threads
+QMutex RenderMutex;
+MovieRenderer *RunningMovieRenderer           = 0;
+MultimediaRenderer *RunningMultimediaRenderer = 0;
+QString RunningTaskId, CanceledTaskId;
+
+//-------------------------------------------------------------------------------
+
+//! Publishes a renderer to cancelRender() for the scope of the render.
+class RenderRegistration {
+  bool m_canceled;
+
+public:
+  RenderRegistration(MovieRenderer *movieRenderer,
+                     MultimediaRenderer *multimediaRenderer) {
+    QMutexLocker sl(&RenderMutex);
+    RunningMovieRenderer      = movieRenderer;
+    RunningMultimediaRenderer = multimediaRenderer;
+    RunningTaskId             = TaskId;
+
+    // the job could have been canceled while its scene was loading
+    m_canceled = !TaskId.isEmpty() && TaskId == CanceledTaskId;
+    CanceledTaskId.clear();
+  }
+
+  ~RenderRegistration() {
+    QMutexLocker sl(&RenderMutex);
+    RunningMovieRenderer      = 0;
+    RunningMultimediaRenderer = 0;
+    RunningTaskId.clear();
+  }
+
+  bool isCanceled() const { return m_canceled; }
+};
+
+//-------------------------------------------------------------------------------
+
+/*!
+  Stops the render of the task taskId, or the render in progress if taskId is
+  empty. A task which is not rendering yet is remembered, and canceled as soon
+  as its render starts.
+*/
+void cancelRender(const QString &taskId) {
+  QMutexLocker sl(&RenderMutex);
+  if (!taskId.isEmpty() && taskId != RunningTaskId) {
+    CanceledTaskId = taskId;
+    return;
+  }
+
+  // the movie renderer waits for its threads processing events: it has to be
+  // stopped from the main thread, which is running the render's event loop
+  if (RunningMovieRenderer)
+    QMetaObject::invokeMethod(RunningMovieRenderer, "onCanceled",
+                              Qt::QueuedConnection);
+  if (RunningMultimediaRenderer) RunningMultimediaRenderer->onCanceled();
+}
+
 //-------------------------------------------------------------------------------
 
 void tcomposerRunOutOfContMemHandler(unsigned long size) {
@@ -477,7 +547,8 @@ static std::pair<int, int> generateMovie(ToonzScene *scene, const TFilePath &fp,
                 multimediaRenderer.getColumnsCount());
     multimediaRenderer.addListener(listener);
 
-    multimediaRenderer.start();
+    RenderRegistration registration(0, &multimediaRenderer);
+    if (!registration.isCanceled()) multimediaRenderer.start();
 
     //----------------- main thread remains above until render is done
     //----------------
@@ -537,10 +608,13 @@ static std::pair<int, int> generateMovie(ToonzScene *scene, const TFilePath &fp,
       movieRenderer.addFrame(r, fx);
     }
 
-    movieRenderer.start();
+    RenderRegistration registration(&movieRenderer, 0);
+    if (!registration.isCanceled()) {
+      movieRenderer.start();
 
-    // Start main loop
-    QCoreApplication::instance()->exec();
+      // Start main loop
+      QCoreApplication::instance()->exec();
+    }
 
     //----------------- tcomposer's main thread loops here ----------------
 
@@ -553,6 +627,604 @@ static std::pair<int, int> generateMovie(ToonzScene *scene, const TFilePath &fp,
   }
 }
 
+//==================================================================================
+//
+// Render jobs
+//
+//----------------------------------------------------------------------------------
+
+namespace {
+
+#ifdef _WIN32
+#ifndef x64
+// Floating point control word stored at startup - see main()
+unsigned int FpWord = 0;
+#endif
+#endif
+
+// Set when tcomposer stays resident and receives its jobs from a socket
+bool DaemonMode = false;
+
+// Scene kept loaded between the jobs in daemon mode
+ToonzScene *CachedScene = 0;
+TFilePath CachedScenePath;
+QDateTime CachedSceneDate;
+int CachedSceneMultimedia = 0;
+
+//-------------------------------------------------------------------------------
+
+// Command line arguments of a render job. In daemon mode they are parsed
+// again for each job received.
+struct RenderJobArgs {
+  TCli::FilePathArgument srcName;
+  FilePathQualifier dstName;
+  RangeQualifier range;
+  IntQualifier stepOpt;
+  IntQualifier shrinkOpt;
+  IntQualifier multimedia;
+  StringQualifier farmData;
+  StringQualifier idq;
+  StringQualifier nthreads;
+  StringQualifier tileSize;
+  FilePathQualifier sharedCache;
+  StringQualifier tmsg;
+
+  RenderJobArgs()
+      : srcName("srcName", "Source file")
+      , dstName("-o dstName", "Target file")
+      , stepOpt("-step n", "Step")
+      , shrinkOpt("-shrink n", "Shrink")
+      , multimedia("-multimedia n", "Multimedia rendering mode")
+      , farmData("-farm data", "TFarm Controller")
+      , idq("-id n", "id")
+      , nthreads("-nthreads n", "Number of rendering threads")
+      , tileSize("-maxtilesize n", "Enable tile rendering of max n MB per tile")
+      , sharedCache("-sharedcache folder",
+                    "Share fx render results through the specified folder")
+      , tmsg("-tmsg val", "only internal use") {}
+
+  UsageLine getUsageLine() {
+    return srcName + dstName + range + stepOpt + shrinkOpt + multimedia +
+           farmData + idq + nthreads + tileSize + sharedCache + tmsg;
+  }
+};
+
+//-------------------------------------------------------------------------------
+
+void setupFarmController(const RenderJobArgs &args) {
+  // i controller restano aperti: in modalita' daemon ogni job li riusa
+  static std::map<string, TFarmController *> controllers;
+
+  TaskId         = QString::fromStdString(args.idq.getValue());
+  UseRenderFarm  = false;
+  FarmController = 0;
+
+  string fdata = args.farmData.getValue();
+  if (fdata.empty()) return;
+
+  string::size_type pos = fdata.find('@');
+  if (pos == string::npos) return;
+
+  UseRenderFarm      = true;
+  FarmControllerPort = std::stoi(fdata.substr(0, pos));
+  FarmControllerName = QString::fromStdString(fdata.substr(pos + 1));
+
+  TFarmController *&controller = controllers[fdata];
+  if (!controller) {
+    TFarmControllerFactory factory;
+    factory.create(FarmControllerName, FarmControllerPort, &controller);
+  }
+  FarmController = controller;
+}
+
+//-------------------------------------------------------------------------------
+
+// Loads the scene at srcFilePath. Returns 0 on failure, with the process exit
+// code stored in exitCode.
+ToonzScene *loadScene(const TFilePath &srcFilePath, int &exitCode) {
+  string msg = "Loading " + srcFilePath.getName();
+  cout << endl << msg << endl;
+  m_userLog->info(msg);
+  TProjectManager *pm = TProjectManager::instance();
+  // pm->enableTabMode(true);
+
+  TProjectP project = pm->loadSceneProject(srcFilePath);
+  if (!project) {
+    msg = "Couldn't find the project";  //+ project->getName().getName();
+    cerr << msg << endl;
+    m_userLog->error(msg);
+    exitCode = -2;
+    return 0;
+  }
+  msg = "project: " + project->getName().getName();
+  cout << msg << endl;
+  m_userLog->info(msg);
+  // pm->setCurrentProject(project, false); // false => temporaneamente
+
+  if (!TSystem::doesExistFileOrLevel(srcFilePath)) {
+    exitCode = 0;
+    return 0;
+  }
+  ToonzScene *scene = new ToonzScene();
+
+  TImageStyle::setCurrentScene(scene);
+
+  try {
+    Sw2.start();
+    scene->load(srcFilePath);
+    Sw2.stop();
+  } catch (TException &e) {
+    cout << ::to_string(e.getMessage()) << endl;
+    m_userLog->error(::to_string(e.getMessage()));
+    exitCode = -2;
+    return 0;
+  } catch (...) {
+    string msg;
+    msg = "There were problems loading the scene " + ::to_string(srcFilePath) +
+          ".\n Some files may be missing.";
+    cout << msg << endl;
+    m_userLog->error(msg);
+    // return false;
+  }
+
+  msg = "scene loaded";
+  cout << "scene loaded" << endl;
+  m_userLog->info(msg);
+
+  return scene;
+}
+
+//-------------------------------------------------------------------------------
+
+// In daemon mode the scene of the previous job is reused, along with its
+// loaded levels and cached images, as long as its file has not changed.
+ToonzScene *getScene(const TFilePath &srcFilePath, int &exitCode) {
+  if (!DaemonMode) return loadScene(srcFilePath, exitCode);
+
+  QDateTime date = TFileStatus(srcFilePath).getLastModificationTime();
+  if (CachedScene && CachedScenePath == srcFilePath &&
+      CachedSceneDate == date) {
+    string msg = "Reusing " + srcFilePath.getName();
+    cout << endl << msg << endl;
+    m_userLog->info(msg);
+
+    TImageStyle::setCurrentScene(CachedScene);
+    CachedScene->getProperties()->getOutputProperties()->setMultimediaRendering(
+        CachedSceneMultimedia);
+    return CachedScene;
+  }
+
+  if (CachedScene) {
+    delete CachedScene;
+    CachedScene = 0;
+    TImageCache::instance()->clearSceneImages();
+  }
+
+  ToonzScene *scene = loadScene(srcFilePath, exitCode);
+  if (scene) {
+    CachedScene     = scene;
+    CachedScenePath = srcFilePath;
+    CachedSceneDate = date;
+    CachedSceneMultimedia =
+        scene->getProperties()->getOutputProperties()->getMultimediaRendering();
+  }
+  return scene;
+}
+
+//-------------------------------------------------------------------------------
+
+// Le chiavi della cache condivisa dipendono dagli alias delle fx, che
+// contengono i path dei livelli ma non il loro contenuto: aggiungo le date di
+// modifica dei file.
+std::string getSharedCacheKeyPrefix(ToonzScene *scene) {
+  std::string prefix;
+
+  TLevelSet *levelSet = scene->getLevelSet();
+  for (int i = 0; i < levelSet->getLevelCount(); ++i) {
+    TXshSimpleLevel *sl = levelSet->getLevel(i)->getSimpleLevel();
+    if (!sl) continue;
+
+    TFilePath path = scene->decodeFilePath(sl->getPath());
+
+    qint64 lastModified = 0;
+    if (path.isLevelName())
+      for (const TFrameId &fid : sl->getFids())
+        lastModified =
+            std::max(lastModified, QFileInfo(path.withFrame(fid).getQString())
+                                       .lastModified()
+                                       .toMSecsSinceEpoch());
+    else
+      lastModified =
+          QFileInfo(path.getQString()).lastModified().toMSecsSinceEpoch();
+
+    if (sl->getType() == TZP_XSHLEVEL)
+      lastModified = std::max(
+          lastModified,
+          QFileInfo(path.withNoFrame().withType("tpl").getQString())
+              .lastModified()
+              .toMSecsSinceEpoch());
+
+    prefix +=
+        ::to_string(path.getWideString()) + ":" + std::to_string(lastModified);
+    prefix += ";";
+  }
+
+  return prefix;
+}
+
+//-------------------------------------------------------------------------------
+
+// Renders scene as specified by the job arguments. Returns the process exit
+// code.
+int renderScene(ToonzScene *scene, const RenderJobArgs &args) {
+  string msg;
+
+  TFilePath dstFilePath;
+  if (args.dstName.isSelected())
+    dstFilePath = args.dstName.getValue();
+  else {
+    dstFilePath = scene->getProperties()->getOutputProperties()->getPath();
+    if (dstFilePath == TFilePath())
+      dstFilePath = TFilePath("+outputs") + "$scenename.tif";
+    else if (dstFilePath.getName() == "")
+      dstFilePath = (dstFilePath.getParentDir() + scene->getSceneName())
+                        .withType(dstFilePath.getType());
+  }
+
+  dstFilePath = scene->decodeFilePath(dstFilePath);
+
+  //---------------------------------------------------------
+  msg = "Generating " + dstFilePath.getName();
+  cout << endl << "Generating " << dstFilePath << endl << endl;
+  m_userLog->info(msg);
+
+  TFilePath theDstFilePath = dstFilePath;
+  try {
+    theDstFilePath = TSystem::toLocalPath(dstFilePath);
+  } catch (...) {
+  }
+
+  int r0 = -1, r1 = -1, step = 1, shrink = 1;
+  TOutputProperties *outProp = scene->getProperties()->getOutputProperties();
+  int scene_from, scene_to, scene_step;
+
+  outProp->getRange(scene_from, scene_to, scene_step);
+  int scene_shrink = outProp->getRenderSettings().m_shrinkX;
+
+  if (scene_from == 0 && scene_to == -1) {
+    scene_from = 1;
+    scene_to   = scene->getFrameCount();
+  } else {
+    scene_from++;
+    scene_to++;
+  }
+  if (args.range.isSelected()) {
+    r0 = args.range.getFrom();
+    r1 = args.range.getTo();
+  } else {
+    r0 = scene_from;
+    r1 = scene_to;
+  }
+
+  if (args.stepOpt.isSelected())
+    step = args.stepOpt.getValue();
+  else
+    step = scene_step;
+  if (args.shrinkOpt.isSelected())
+    shrink = args.shrinkOpt.getValue();
+  else
+    shrink = scene_shrink;
+  if (args.multimedia.isSelected())
+    scene->getProperties()->getOutputProperties()->setMultimediaRendering(
+        args.multimedia.getValue());
+
+  // Retrieve Thread count
+  const int procCount = TSystem::getProcessorCount();
+  int threadCount;
+  const int threadCounts[3] = {1, procCount / 2, procCount};
+  if (args.nthreads.isSelected()) {
+    QString threadCountStr = QString::fromStdString(args.nthreads.getValue());
+    threadCount            = (threadCountStr == "single")
+                      ? threadCounts[0]
+                      : (threadCountStr == "half")
+                            ? threadCounts[1]
+                            : (threadCountStr == "all")
+                                  ? threadCounts[2]
+                                  : threadCountStr.toInt();
+
+    if (threadCount <= 0) {
+      cout << "Qualifier 'nthreads': bad input" << endl;
+      return 1;
+    }
+  } else {
+    int threadIndex = outProp->getThreadIndex();
+    threadCount     = threadCounts[threadIndex];
+  }
+
+  threadCount = tcrop(1, procCount, threadCount);
+
+  // Retrieve max tile size (raster granularity)
+  int maxTileSize;
+  const int maxTileSizes[4] = {
+      (std::numeric_limits<int>::max)(), TOutputProperties::LargeVal,
+      TOutputProperties::MediumVal, TOutputProperties::SmallVal};
+  if (args.tileSize.isSelected()) {
+    QString tileSizeStr = QString::fromStdString(args.tileSize.getValue());
+    maxTileSize         = (tileSizeStr == "none")
+                      ? maxTileSizes[0]
+                      : (tileSizeStr == "large")
+                            ? maxTileSizes[1]
+                            : (tileSizeStr == "medium")
+                                  ? maxTileSizes[2]
+                                  : (tileSizeStr == "small")
+                                        ? maxTileSizes[3]
+                                        : tileSizeStr.toInt();
+
+    if (maxTileSize <= 0) {
+      cout << "Qualifier 'maxtilesize': bad input" << endl;
+      return 1;
+    }
+  } else {
+    int maxTileSizeIndex = outProp->getMaxTileSizeIndex();
+    maxTileSize          = maxTileSizes[maxTileSizeIndex];
+  }
+
+  if (args.sharedCache.isSelected()) {
+    TSharedCacheManager::setRootPath(args.sharedCache.getValue());
+    TSharedCacheManager::setKeyPrefix(getSharedCacheKeyPrefix(scene));
+  } else
+    TSharedCacheManager::setRootPath(TFilePath());
+
+  m_userLog->info("Threads count: " + std::to_string(threadCount));
+  if (maxTileSize != (std::numeric_limits<int>::max)())
+    m_userLog->info("Render tile: " + std::to_string(maxTileSize));
+
+#ifdef _WIN32
+#ifndef x64
+  // On 32-bit architecture, there could be cases in which initialization
+  // could alter the
+  // FPU floating point control word. I've seen this happen when loading some
+  // AVI coded (VFAPI),
+  // where 80-bit internal precision was used instead of the standard 64-bit
+  // (much faster and
+  // sufficient - especially considering that x86 truncates to 64-bit
+  // representation anyway).
+  // IN ANY CASE, revert to the original control word.
+  // In the x64 case these precision changes simply should not take place up
+  // to _controlfp_s
+  // documentation.
+  _controlfp_s(0, FpWord, -1);
+#endif
+#endif
+
+  std::pair<int, int> framePair = generateMovie(
+      scene, theDstFilePath, r0, r1, step, shrink, threadCount, maxTileSize);
+
+  Sw1.stop();
+
+  m_userLog->info(
+      "Raster Allocation Peak: " +
+      std::to_string(TBigMemoryManager::instance()->getAllocationPeak()) +
+      " KB");
+  m_userLog->info(
+      "Raster Allocation Mean: " +
+      std::to_string(TBigMemoryManager::instance()->getAllocationMean()) +
+      " KB");
+
+  msg = "Compositing completed in " +
+        ::to_string(Sw1.getTotalTime() / 1000.0, 2) + " seconds";
+  string msg2 = "\n" + ::to_string(Sw2.getTotalTime() / 1000.0, 2) +
+                " seconds spent on loading" + "\n" +
+                ::to_string(TStopWatch::global(0).getTotalTime() / 1000.0, 2) +
+                " seconds spent on saving" + "\n" +
+                ::to_string(TStopWatch::global(8).getTotalTime() / 1000.0, 2) +
+                " seconds spent on rendering" + "\n";
+  cout << msg + msg2;
+  m_userLog->info(msg + msg2);
+  DVGui::info(QString::fromStdString(msg));
+
+  if (framePair.first != framePair.second) return -1;
+  return 0;
+}
+
+//-------------------------------------------------------------------------------
+
+// Runs the render job whose arguments have just been parsed. Returns the
+// process exit code.
+int runJob(const RenderJobArgs &args) {
+  setupFarmController(args);
+
+  int exitCode = -1;
+  try {
+    TFilePath srcFilePath = args.srcName.getValue();
+
+    try {
+      srcFilePath = TSystem::toLocalPath(srcFilePath);
+    } catch (...) {
+    }
+
+    Sw1.start(true);
+    Sw2.reset();
+    TStopWatch::global(0).reset();
+    TStopWatch::global(8).reset();
+
+    ToonzScene *scene = getScene(srcFilePath, exitCode);
+    if (!scene) return exitCode;
+
+    exitCode = renderScene(scene, args);
+  } catch (TException &e) {
+    string msg = "Untrapped exception: " + ::to_string(e.getMessage());
+    cout << msg << endl;
+    m_userLog->error(msg);
+    exitCode = -1;
+  } catch (...) {
+    cout << "Untrapped exception" << endl;
+    m_userLog->error("Untrapped exception");
+    exitCode = -1;
+  }
+
+  // in modalita' daemon la cache resta calda per i job successivi
+  if (!DaemonMode) TImageCache::instance()->clear(true);
+
+  return exitCode;
+}
+
+}  // namespace
+
+//==================================================================================
+//
+// Daemon mode
+//
+//----------------------------------------------------------------------------------
+
+namespace {
+
+/*!
+  In daemon mode tcomposer stays resident and renders the jobs it receives on
+  a socket, keeping the scene, its levels and the image cache loaded between
+  jobs on the same scene.
+
+  A job is the string "render," followed by an ordinary tcomposer command line;
+  the reply is the exit code the tcomposer process would have returned.
+  Connections are served by TFarmExecutor in threads of their own, while the
+  rendering must take place in the main thread: the receiving thread hands
+  the command line to the main loop and waits for its completion.
+
+  "cancel,<task id>" stops the render of that task (of the running job, if no
+  id is given). Requests are therefore received concurrently, the jobs being
+  serialized by the daemon itself.
+*/
+class ComposerDaemon final : public TFarmExecutor {
+public:
+  ComposerDaemon(int port)
+      : TFarmExecutor(port), m_hasJob(false), m_jobDone(false), m_exitCode(0) {
+    setReceiveTimeout(ReceiveTimeout);
+    setSerializedReceive(false);
+  }
+
+  // Called by the main thread: waits at most timeout msecs for a job
+  bool takeJob(QString &cmdline, unsigned long timeout);
+  void jobCompleted(int exitCode);
+
+protected:
+  QString execute(const std::vector<QString> &argv) override;
+
+private:
+  // msecs a client may stay silent while sending a request
+  static const int ReceiveTimeout = 30000;
+
+  QMutex m_jobMutex;  // serializes the clients
+  QMutex m_mutex;
+  QWaitCondition m_jobReceived, m_jobCompletedCond;
+
+  QString m_cmdline;
+  bool m_hasJob, m_jobDone;
+  int m_exitCode;
+};
+
+//-------------------------------------------------------------------------------
+
+QString ComposerDaemon::execute(const std::vector<QString> &argv) {
+  if (argv.size() >= 1 && argv[0] == "cancel") {
+    cancelRender(argv.size() > 1 ? argv[1] : QString());
+    return QString::number(0);
+  }
+
+  if (argv.size() < 2 || argv[0] != "render") return QString::number(1);
+
+  // TFarmExecutor splits the received data at commas
+  QStringList cmdline;
+  for (int i = 1; i < (int)argv.size(); ++i) cmdline << argv[i];
+
+  QMutexLocker jobLocker(&m_jobMutex);
+  QMutexLocker sl(&m_mutex);
+
+  m_cmdline = cmdline.join(",");
+  m_hasJob  = true;
+  m_jobDone = false;
+  m_jobReceived.wakeAll();
+
+  while (!m_jobDone) m_jobCompletedCond.wait(&m_mutex);
+
+  return QString::number(m_exitCode);
+}
+
+//-------------------------------------------------------------------------------
+
+bool ComposerDaemon::takeJob(QString &cmdline, unsigned long timeout) {
+  QMutexLocker sl(&m_mutex);
+  if (!m_hasJob) m_jobReceived.wait(&m_mutex, timeout);
+  if (!m_hasJob) return false;
+
+  cmdline  = m_cmdline;
+  m_hasJob = false;
+  return true;
+}
+
+//-------------------------------------------------------------------------------
+
+void ComposerDaemon::jobCompleted(int exitCode) {
+  QMutexLocker sl(&m_mutex);
+  m_exitCode = exitCode;
+  m_jobDone  = true;
+  m_jobCompletedCond.wakeAll();
+}
+
+//-------------------------------------------------------------------------------
+
+// Splits a command line into its arguments, honoring double quotes
+QStringList splitCommandLine(const QString &cmdline) {
+  QStringList args;
+  QString arg;
+  bool quoted = false, inArg = false;
+  for (int i = 0; i < cmdline.size(); ++i) {
+    QChar c = cmdline.at(i);
+    if (c == '"') {
+      quoted = !quoted;
+      inArg  = true;
+    } else if (c.isSpace() && !quoted) {
+      if (inArg) args << arg;
+      arg.clear();
+      inArg = false;
+    } else {
+      arg += c;
+      inArg = true;
+    }
+  }
+  if (inArg) args << arg;
+  return args;
+}
+
+//-------------------------------------------------------------------------------
+
+int runDaemonJob(Usage &usage, const RenderJobArgs &args,
+                 const QString &cmdline) {
+  string msg = "Job received: " + cmdline.toStdString();
+  cout << endl << msg << endl;
+  m_userLog->info(msg);
+
+  QStringList tokens = splitCommandLine(cmdline);
+  if (tokens.isEmpty()) return 1;
+
+  std::vector<string> strings;
+  for (int i = 0; i < tokens.size(); ++i)
+    strings.push_back(tokens.at(i).toStdString());
+
+  std::vector<char *> argv;
+  for (int i = 0; i < (int)strings.size(); ++i)
+    argv.push_back(&strings[i][0]);
+
+  std::ostringstream err;
+  if (!usage.parse(argv.size(), &argv[0], err) || !args.srcName.isSelected()) {
+    m_userLog->error("Bad job command line: " + err.str());
+    return 1;
+  }
+
+  return runJob(args);
+}
+
+}  // namespace
+
 //==================================================================================
 //
 // main()
@@ -571,20 +1243,13 @@ DV_IMPORT_API void initColorFx();
 int main(int argc, char *argv[]) {
   TCli::UsageLine usageLine;
   //  setCurrentModule("tcomposer");
-  TCli::FilePathArgument srcName("srcName", "Source file");
-  FilePathQualifier dstName("-o dstName", "Target file");
-  RangeQualifier range;
-  IntQualifier stepOpt("-step n", "Step");
-  IntQualifier shrinkOpt("-shrink n", "Shrink");
-  IntQualifier multimedia("-multimedia n", "Multimedia rendering mode");
-  StringQualifier farmData("-farm data", "TFarm Controller");
-  StringQualifier idq("-id n", "id");
-  StringQualifier nthreads("-nthreads n", "Number of rendering threads");
-  StringQualifier tileSize("-maxtilesize n",
-                           "Enable tile rendering of max n MB per tile");
-  StringQualifier tmsg("-tmsg val", "only internal use");
-  usageLine = srcName + dstName + range + stepOpt + shrinkOpt + multimedia +
-              farmData + idq + nthreads + tileSize + tmsg;
+  RenderJobArgs jobArgs;
+  usageLine = jobArgs.getUsageLine();
+
+  Switcher daemonSw("-daemon",
+                    "Stay resident and render the jobs received on -port");
+  IntQualifier portOpt("-port n", "Daemon port (default 8003)");
+  TCli::UsageLine daemonLine = daemonSw + portOpt + jobArgs.tmsg;
 
   // system path qualifiers
   std::map<QString, std::unique_ptr<TCli::QualifierT<TFilePath>>>
@@ -598,7 +1263,8 @@ int main(int argc, char *argv[]) {
           .arg(qualKey);
   systemPathQualMap[qualKey].reset(new TCli::QualifierT<TFilePath>(
       qualName.toStdString(), qualHelp.toStdString()));
-  usageLine = usageLine + *systemPathQualMap[qualKey];
+  usageLine  = usageLine + *systemPathQualMap[qualKey];
+  daemonLine = daemonLine + *systemPathQualMap[qualKey];
 
   const std::map<std::string, std::string> &spm = TEnv::getSystemPathMap();
   for (auto itr = spm.begin(); itr != spm.end(); ++itr) {
@@ -609,13 +1275,17 @@ int main(int argc, char *argv[]) {
     qualHelp = QString("%1 path.").arg(qualKey);
     systemPathQualMap[qualKey].reset(new TCli::QualifierT<TFilePath>(
         qualName.toStdString(), qualHelp.toStdString()));
-    usageLine = usageLine + *systemPathQualMap[qualKey];
+    usageLine  = usageLine + *systemPathQualMap[qualKey];
+    daemonLine = daemonLine + *systemPathQualMap[qualKey];
   }
 
   Usage usage(argv[0]);
   usage.add(usageLine);
+  usage.add(daemonLine);
   if (!usage.parse(argc, argv)) exit(1);
 
+  DaemonMode = daemonSw.isSelected();
+
   QHash<QString, QString> argumentPathValues;
   for (auto q_itr = systemPathQualMap.begin(); q_itr != systemPathQualMap.end();
        ++q_itr) {
@@ -636,8 +1306,7 @@ int main(int argc, char *argv[]) {
   // Store the floating point control word. It will be re-set before Toonz
   // initialization
   // has ended.
-  unsigned int fpWord = 0;
-  _controlfp_s(&fpWord, 0, 0);
+  _controlfp_s(&FpWord, 0, 0);
 #endif
 #endif
 
@@ -731,30 +1400,8 @@ int main(int argc, char *argv[]) {
   TImageCache::instance()->setRootDir(cacheRoot);
   // #endif
 
-  TaskId       = QString::fromStdString(idq.getValue());
-  string fdata = farmData.getValue();
-  if (fdata.empty())
-    UseRenderFarm = false;
-  else {
-    UseRenderFarm         = true;
-    string::size_type pos = fdata.find('@');
-    if (pos == string::npos)
-      UseRenderFarm = false;
-    else {
-      FarmControllerPort = std::stoi(fdata.substr(0, pos));
-      FarmControllerName = QString::fromStdString(fdata.substr(pos + 1));
-    }
-  }
-
-  if (UseRenderFarm) {
-    TFarmControllerFactory factory;
-    factory.create(FarmControllerName, FarmControllerPort, &FarmController);
-  }
-
   while (!PluginLoader::load_entries("")) app.processEvents();
 
-  std::pair<int, int> framePair(1, 0);
-
   try {
     Tiio::defineStd();
 
@@ -768,241 +1415,56 @@ int main(int argc, char *argv[]) {
                          TFilePath("shaders"));
 
     //#endif
-
-    //---------------------------------------------------------
-
-    TFilePath srcFilePath = srcName.getValue();
-
-    try {
-      srcFilePath = TSystem::toLocalPath(srcFilePath);
-    } catch (...) {
-    }
-
-    //---------------------------------------------------------
-    msg = "Loading " + srcFilePath.getName();
-    cout << endl << msg << endl;
-    m_userLog->info(msg);
-    TProjectManager *pm = TProjectManager::instance();
-    // pm->enableTabMode(true);
-
-    TProjectP project = pm->loadSceneProject(srcFilePath);
-    if (!project) {
-      msg = "Couldn't find the project";  //+ project->getName().getName();
-      cerr << msg << endl;
-      m_userLog->error(msg);
-      return -2;
-    }
-    msg = "project: " + project->getName().getName();
+  } catch (TException &e) {
+    msg = "Untrapped exception: " + ::to_string(e.getMessage()),
     cout << msg << endl;
-    m_userLog->info(msg);
-    // pm->setCurrentProject(project, false); // false => temporaneamente
-
-    Sw1.start();
-
-    if (!TSystem::doesExistFileOrLevel(srcFilePath)) return false;
-    ToonzScene *scene = new ToonzScene();
-
-    TImageStyle::setCurrentScene(scene);
-
-    try {
-      Sw2.start();
-      scene->load(srcFilePath);
-      Sw2.stop();
-    } catch (TException &e) {
-      cout << ::to_string(e.getMessage()) << endl;
-      m_userLog->error(::to_string(e.getMessage()));
-      return -2;
-    } catch (...) {
-      string msg;
-      msg = "There were problems loading the scene " +
-            ::to_string(srcFilePath) + ".\n Some files may be missing.";
-      cout << msg << endl;
-      m_userLog->error(msg);
-      // return false;
-    }
-
-    msg = "scene loaded";
-    cout << "scene loaded" << endl;
-    m_userLog->info(msg);
-
-    //---------------------------------------------------------
-
-    TFilePath dstFilePath;
-    if (dstName.isSelected())
-      dstFilePath = dstName.getValue();
-    else {
-      dstFilePath = scene->getProperties()->getOutputProperties()->getPath();
-      if (dstFilePath == TFilePath())
-        dstFilePath = TFilePath("+outputs") + "$scenename.tif";
-      else if (dstFilePath.getName() == "")
-        dstFilePath = (dstFilePath.getParentDir() + scene->getSceneName())
-                          .withType(dstFilePath.getType());
-    }
+    m_userLog->error(msg);
+    return -1;
+  } catch (...) {
+    cout << "Untrapped exception" << endl;
+    m_userLog->error("Untrapped exception");
+    return -1;
+  }
 
-    dstFilePath = scene->decodeFilePath(dstFilePath);
+  // Disable the Passive cache manager. It has no sense if it cannot write on
+  // disk...
+  // TCacheResourcePool::instance();   //Needs to be instanced before
+  // TPassiveCacheManager...
+  TPassiveCacheManager::instance()->setEnabled(false);
 
-    //---------------------------------------------------------
-    msg = "Generating " + dstFilePath.getName();
-    cout << endl << "Generating " << dstFilePath << endl << endl;
-    m_userLog->info(msg);
+  if (!DaemonMode) return runJob(jobArgs);
 
-    TFilePath theDstFilePath = dstFilePath;
-    try {
-      theDstFilePath = TSystem::toLocalPath(dstFilePath);
-    } catch (...) {
-    }
+  //---------------------------------------------------------
+  //    Daemon mode
+  //---------------------------------------------------------
 
-    int r0 = -1, r1 = -1, step = 1, shrink = 1;
-    TOutputProperties *outProp = scene->getProperties()->getOutputProperties();
-    int scene_from, scene_to, scene_step;
+  int port = portOpt.isSelected() ? portOpt.getValue() : 8003;
 
-    outProp->getRange(scene_from, scene_to, scene_step);
-    int scene_shrink = outProp->getRenderSettings().m_shrinkX;
+  ComposerDaemon daemon(port);
+  daemon.start();
 
-    if (scene_from == 0 && scene_to == -1) {
-      scene_from = 1;
-      scene_to   = scene->getFrameCount();
-    } else {
-      scene_from++;
-      scene_to++;
-    }
-    if (range.isSelected()) {
-      r0 = range.getFrom();
-      r1 = range.getTo();
-    } else {
-      r0 = scene_from;
-      r1 = scene_to;
-    }
+  msg = "Waiting for jobs on port " + std::to_string(port);
+  cout << msg << endl;
+  m_userLog->info(msg);
 
-    if (stepOpt.isSelected())
-      step = stepOpt.getValue();
-    else
-      step = scene_step;
-    if (shrinkOpt.isSelected())
-      shrink = shrinkOpt.getValue();
+  // the listening thread ends on a "shutdown" request (or if it could not
+  // bind the port)
+  while (!daemon.isFinished()) {
+    QString cmdline;
+    if (daemon.takeJob(cmdline, 100))
+      daemon.jobCompleted(runDaemonJob(usage, jobArgs, cmdline));
     else
-      shrink = scene_shrink;
-    if (multimedia.isSelected())
-      scene->getProperties()->getOutputProperties()->setMultimediaRendering(
-          multimedia.getValue());
-
-    // Retrieve Thread count
-    const int procCount = TSystem::getProcessorCount();
-    int threadCount;
-    const int threadCounts[3] = {1, procCount / 2, procCount};
-    if (nthreads.isSelected()) {
-      QString threadCountStr = QString::fromStdString(nthreads.getValue());
-      threadCount            = (threadCountStr == "single")
-                        ? threadCounts[0]
-                        : (threadCountStr == "half")
-                              ? threadCounts[1]
-                              : (threadCountStr == "all")
-                                    ? threadCounts[2]
-                                    : threadCountStr.toInt();
-
-      if (threadCount <= 0) {
-        cout << "Qualifier 'nthreads': bad input" << endl;
-        exit(1);
-      }
-    } else {
-      int threadIndex = outProp->getThreadIndex();
-      threadCount     = threadCounts[threadIndex];
-    }
-
-    threadCount = tcrop(1, procCount, threadCount);
-
-    // Retrieve max tile size (raster granularity)
-    int maxTileSize;
-    const int maxTileSizes[4] = {
-        (std::numeric_limits<int>::max)(), TOutputProperties::LargeVal,
-        TOutputProperties::MediumVal, TOutputProperties::SmallVal};
-    if (tileSize.isSelected()) {
-      QString tileSizeStr = QString::fromStdString(tileSize.getValue());
-      maxTileSize         = (tileSizeStr == "none")
-                        ? maxTileSizes[0]
-                        : (tileSizeStr == "large")
-                              ? maxTileSizes[1]
-                              : (tileSizeStr == "medium")
-                                    ? maxTileSizes[2]
-                                    : (tileSizeStr == "small")
-                                          ? maxTileSizes[3]
-                                          : tileSizeStr.toInt();
-
-      if (maxTileSize <= 0) {
-        cout << "Qualifier 'maxtilesize': bad input" << endl;
-        exit(1);
-      }
-    } else {
-      int maxTileSizeIndex = outProp->getMaxTileSizeIndex();
-      maxTileSize          = maxTileSizes[maxTileSizeIndex];
-    }
-
-    m_userLog->info("Threads count: " + std::to_string(threadCount));
-    if (maxTileSize != (std::numeric_limits<int>::max)())
-      m_userLog->info("Render tile: " + std::to_string(maxTileSize));
-
-    // Disable the Passive cache manager. It has no sense if it cannot write on
-    // disk...
-    // TCacheResourcePool::instance();   //Needs to be instanced before
-    // TPassiveCacheManager...
-    TPassiveCacheManager::instance()->setEnabled(false);
+      app.processEvents();
+  }
 
-#ifdef _WIN32
-#ifndef x64
-    // On 32-bit architecture, there could be cases in which initialization
-    // could alter the
-    // FPU floating point control word. I've seen this happen when loading some
-    // AVI coded (VFAPI),
-    // where 80-bit internal precision was used instead of the standard 64-bit
-    // (much faster and
-    // sufficient - especially considering that x86 truncates to 64-bit
-    // representation anyway).
-    // IN ANY CASE, revert to the original control word.
-    // In the x64 case these precision changes simply should not take place up
-    // to _controlfp_s
-    // documentation.
-    _controlfp_s(0, fpWord, -1);
-#endif
-#endif
+  TImageCache::instance()->clear(true);
 
-    framePair = generateMovie(scene, theDstFilePath, r0, r1, step, shrink,
-                              threadCount, maxTileSize);
-
-    Sw1.stop();
-
-    m_userLog->info(
-        "Raster Allocation Peak: " +
-        std::to_string(TBigMemoryManager::instance()->getAllocationPeak()) +
-        " KB");
-    m_userLog->info(
-        "Raster Allocation Mean: " +
-        std::to_string(TBigMemoryManager::instance()->getAllocationMean()) +
-        " KB");
-
-    msg = "Compositing completed in " +
-          ::to_string(Sw1.getTotalTime() / 1000.0, 2) + " seconds";
-    string msg2 =
-        "\n" + ::to_string(Sw2.getTotalTime() / 1000.0, 2) +
-        " seconds spent on loading" + "\n" +
-        ::to_string(TStopWatch::global(0).getTotalTime() / 1000.0, 2) +
-        " seconds spent on saving" + "\n" +
-        ::to_string(TStopWatch::global(8).getTotalTime() / 1000.0, 2) +
-        " seconds spent on rendering" + "\n";
-    cout << msg + msg2;
-    m_userLog->info(msg + msg2);
-    DVGui::info(QString::fromStdString(msg));
-    TImageCache::instance()->clear(true);
-  } catch (TException &e) {
-    msg = "Untrapped exception: " + ::to_string(e.getMessage()),
+  if (daemon.getExitCode() != 0) {
+    msg = "Daemon stopped with error code " +
+          std::to_string(daemon.getExitCode());
     cout << msg << endl;
     m_userLog->error(msg);
-    TImageCache::instance()->clear(true);
-  } catch (...) {
-    cout << "Untrapped exception" << endl;
-    m_userLog->error("Untrapped exception");
-    TImageCache::instance()->clear(true);
+    return -1;
   }
-
-  if (framePair.first != framePair.second) return -1;
   return 0;
 }
@@ -31,22 +31,29 @@ private:
   RasterController *controller;
   Internal *internal;
 
+  // These run for every pixel of every dab: the channel scaling uses a
+  // multiplication instead of a division, and since the surface clamps the
+  // colors to [0, 1] before writing, rounding needs no call to roundf().
+  // Channels falling very close to a rounding boundary may thus come out one
+  // unit off the exact conversion.
   inline static void readPixel(const void *pixelPtr, float &colorR,
                                float &colorG, float &colorB, float &colorA) {
+    const float k         = 1.f / (float)TPixel32::maxChannelValue;
     const TPixel32 &pixel = *(const TPixel32 *)pixelPtr;
-    colorR                = (float)pixel.r / (float)TPixel32::maxChannelValue;
-    colorG                = (float)pixel.g / (float)TPixel32::maxChannelValue;
-    colorB                = (float)pixel.b / (float)TPixel32::maxChannelValue;
-    colorA                = (float)pixel.m / (float)TPixel32::maxChannelValue;
+    colorR                = (float)pixel.r * k;
+    colorG                = (float)pixel.g * k;
+    colorB                = (float)pixel.b * k;
+    colorA                = (float)pixel.m * k;
   }
 
   inline static void writePixel(void *pixelPtr, float colorR, float colorG,
                                 float colorB, float colorA) {
+    const float k   = (float)TPixel32::maxChannelValue;
     TPixel32 &pixel = *(TPixel32 *)pixelPtr;
-    pixel.r = (TPixel32::Channel)roundf(colorR * TPixel32::maxChannelValue);
-    pixel.g = (TPixel32::Channel)roundf(colorG * TPixel32::maxChannelValue);
-    pixel.b = (TPixel32::Channel)roundf(colorB * TPixel32::maxChannelValue);
-    pixel.m = (TPixel32::Channel)roundf(colorA * TPixel32::maxChannelValue);
+    pixel.r         = (TPixel32::Channel)(colorR * k + 0.5f);
+    pixel.g         = (TPixel32::Channel)(colorG * k + 0.5f);
+    pixel.b         = (TPixel32::Channel)(colorB * k + 0.5f);
+    pixel.m         = (TPixel32::Channel)(colorA * k + 0.5f);
   }
 
   inline static bool askRead(void *surfaceController,
@@ -148,6 +148,7 @@ ComboViewerPanel::ComboViewerPanel(QWidget *parent, Qt::WFlags flags)
     m_flipConsole =
         new FlipConsole(mainLayout, buttonMask, false, m_keyFrameButton,
                         "SceneViewerConsole", this, true);
+    m_flipConsole->enablePrefetch(true);
   }
   setLayout(mainLayout);
 
@@ -328,7 +329,17 @@ void ComboViewerPanel::onDrawFrame(
 
 //-----------------------------------------------------------------------------
 
-ComboViewerPanel::~ComboViewerPanel() {}
+ComboViewerPanel::~ComboViewerPanel() {
+  // Prefetching threads access the scene viewer
+  m_flipConsole->enablePrefetch(false);
+}
+
+//-----------------------------------------------------------------------------
+
+std::function<void()> ComboViewerPanel::getPrefetchJob(
+    int frame, const ImagePainter::VisualSettings &settings) {
+  return m_sceneViewer->getPrefetchRowJob(frame - 1);
+}
 
 //-----------------------------------------------------------------------------
 
@@ -88,6 +88,8 @@ public:
 
   void onDrawFrame(int frame,
                    const ImagePainter::VisualSettings &settings) override;
+  std::function<void()> getPrefetchJob(
+      int frame, const ImagePainter::VisualSettings &settings) override;
 
   void onEnterPanel() {
     m_sceneViewer->setFocus(Qt::OtherFocusReason);
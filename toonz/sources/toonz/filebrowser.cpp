@@ -2124,6 +2124,8 @@ void FileBrowser::onDoubleClickedItem(int index) {
 //-----------------------------------------------------------------------------
 
 void FileBrowser::refreshFolder(const TFilePath &folderPath) {
+  TLevelDirectoryIndex::instance()->invalidate(folderPath);
+
   std::set<FileBrowser *>::iterator it;
   for (it = activeBrowsers.begin(); it != activeBrowsers.end(); ++it) {
     FileBrowser *browser = *it;
@@ -2164,6 +2166,9 @@ void FileBrowser::refresh() {
   TFilePath originalFolder(
       m_folder);  // setFolder is invoked by Qt throughout the following...
 
+  // Sequences are listed again from disk, too
+  TLevelDirectoryIndex::instance()->clear();
+
   int dx                   = m_folderTreeView->verticalScrollBar()->value();
   DvDirModelNode *rootNode = DvDirModel::instance()->getNode(QModelIndex());
 
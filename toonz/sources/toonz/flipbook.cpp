@@ -219,6 +219,9 @@ FlipBook::FlipBook(QWidget *parent, QString viewerTitle,
         mainLayout, flipConsoleButtonMask, true, 0,
         (viewerTitle == "") ? "FlipConsole" : viewerTitle, this, !isColorModel);
     mainLayout->addWidget(m_flipConsole);
+
+    // Decode frames ahead of the playback
+    m_flipConsole->enablePrefetch(!isColorModel);
   }
   setLayout(mainLayout);
 
@@ -586,6 +589,9 @@ void FlipBook::saveImages() {
 //=============================================================================
 
 FlipBook::~FlipBook() {
+  // Prefetching threads access the flipbook's data
+  m_flipConsole->enablePrefetch(false);
+
   if (m_loadPopup) delete m_loadPopup;
   if (m_savePopup) delete m_savePopup;
 }
@@ -1014,6 +1020,8 @@ bool FlipBook::isSavable() const {
 void FlipBook::setLevel(const TFilePath &fp, TPalette *palette, int from,
                         int to, int step, int shrink, TSoundTrack *snd,
                         bool append, bool isToonzOutput) {
+  m_flipConsole->cancelPrefetch();
+
   try {
     if (!append) {
       clearCache();
@@ -1246,6 +1254,8 @@ void FlipBook::setTitle(const QString &title) {
 //-----------------------------------------------------------------------------
 
 void FlipBook::setLevel(TXshSimpleLevel *xl) {
+  m_flipConsole->cancelPrefetch();
+
   try {
     clearCache();
 
@@ -1301,6 +1311,8 @@ void FlipBook::setLevel(TXshSimpleLevel *xl) {
 void FlipBook::setLevel(TFx *previewedFx, TXsheet *xsh, TLevel *level,
                         TPalette *palette, int from, int to, int step,
                         int currentFrame, TSoundTrack *snd) {
+  m_flipConsole->cancelPrefetch();
+
   m_xl          = 0;
   m_previewedFx = previewedFx;
   m_previewXsh  = xsh;
@@ -1498,21 +1510,14 @@ void FlipBook::playAudioFrame(int frame) {
 
 //-----------------------------------------------------------------------------
 
-TImageP FlipBook::getCurrentImage(int frame) {
-  std::string id = "";
-  TFrameId fid;
-  TFilePath fp;
+bool FlipBook::getFrameSource(int frame, std::string &id, TFilePath &fp,
+                              TFrameId &fid, bool &randomAccessRead,
+                              bool &premultiply) {
+  randomAccessRead = false;
+  premultiply      = false;
 
-  bool randomAccessRead    = false;
-  bool incrementalIndexing = false;
-  bool premultiply         = false;
-  if (m_xl)  // is an xsheet level
-  {
-    if (m_xl->getFrameCount() <= 0) return 0;
-    return m_xl->getFrame(m_xl->index2fid(frame - 1), false);
-  } else if (!m_levels.empty())  // is a viewfile or a previewFx
+  if (!m_levels.empty())  // is a viewfile or a previewFx
   {
-    TLevelP level;
     QString levelName;
     int from, to, step;
     m_flipConsole->getFrameRange(from, to, step);
@@ -1528,109 +1533,163 @@ TImageP FlipBook::getCurrentImage(int frame) {
       frameIndex -= frameIndexesCount;
     }
 
-    if (i == m_levels.size() || frame < 0) return 0;
+    if (i == m_levels.size() || frame < 0) return false;
 
     frame--;
 
     // Now, get the right frame from the level
 
-    level               = m_levels[i].m_level;
-    fp                  = m_levels[i].m_fp;  // fp=empty when previewing fx
-    randomAccessRead    = m_levels[i].m_randomAccessRead;
-    incrementalIndexing = m_levels[i].m_incrementalIndexing;
-    levelName           = m_levelNames[i];
-    fid                 = m_levels[i].flipbookIndexToLevelFrame(frameIndex);
-    premultiply         = m_levels[i].m_premultiply;
-    if (fid == TFrameId()) return 0;
+    fp               = m_levels[i].m_fp;  // fp=empty when previewing fx
+    randomAccessRead = m_levels[i].m_randomAccessRead;
+    levelName        = m_levelNames[i];
+    fid              = m_levels[i].flipbookIndexToLevelFrame(frameIndex);
+    premultiply      = m_levels[i].m_premultiply;
+    if (fid == TFrameId()) return false;
     id = levelName.toStdString() + fid.expand(TFrameId::NO_PAD) +
          ((m_isPreviewFx) ? "" : ::to_string(this));
-
-    if (!m_isPreviewFx)
-      m_title1 = m_viewerTitle + " :: " + fp.withoutParentDir().withFrame(fid);
-    else
-      m_title1 = "";
   } else if (m_levelNames.empty())
-    return 0;
+    return false;
   else  // is a render
     id = m_levelNames[0].toStdString() + std::to_string(frame);
 
-  bool showSub = m_flipConsole->isChecked(FlipConsole::eUseLoadBox);
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+
+/*! Returns the image cached with the specified id, if it was loaded with the
+    specified loadbox.
+*/
+TImageP FlipBook::getCachedImage(const std::string &id, const TRect &loadbox) {
+  if (!TImageCache::instance()->isCached(id)) return TImageP();
 
-  if (TImageCache::instance()->isCached(id)) {
-    TRect loadbox;
+  TRect cachedLoadbox;
+  {
+    QMutexLocker locker(&m_loadboxesMutex);
     std::map<std::string, TRect>::const_iterator it = m_loadboxes.find(id);
-    if (it != m_loadboxes.end()) loadbox = it->second;
-
-    // Resubmit the image to the cache as the 'last one' seen by the flipbook.
-    // TImageCache::instance()->add(toString(m_poolIndex) + "lastFlipFrame",
-    // img);
-    // m_lastViewedFrame = frame+1;
-    if ((showSub && m_loadbox == loadbox) || (!showSub && loadbox == TRect()))
-      return TImageCache::instance()->get(id, false);
+    if (it != m_loadboxes.end()) cachedLoadbox = it->second;
+  }
+
+  // Resubmit the image to the cache as the 'last one' seen by the flipbook.
+  // TImageCache::instance()->add(toString(m_poolIndex) + "lastFlipFrame",
+  // img);
+  // m_lastViewedFrame = frame+1;
+  if (cachedLoadbox == loadbox) return TImageCache::instance()->get(id, false);
+
+  TImageCache::instance()->remove(id);
+  return TImageP();
+}
+
+//-----------------------------------------------------------------------------
+
+/*! Loads the specified level frame through the supplied reader, and stores it
+    in the cache. This may be invoked by the playback prefetching threads, too:
+    the flipbook settings are passed for this reason.
+*/
+TImageP FlipBook::loadImage(const TLevelReaderP &lr, const std::string &id,
+                            const TFrameId &fid, bool premultiply,
+                            const TRect &loadbox, int shrink,
+                            TPalette *palette) {
+  const TFilePath &fp = lr->getFilePath();
+
+  int lx = 0, oriLx = 0;
+  // try to get image info only when loading tlv or pli as it is quite time
+  // consuming
+  if (fp.getType() == "tlv" || fp.getType() == "pli") {
+    if (lr->getImageInfo()) lx = oriLx = lr->getImageInfo()->m_lx;
+  }
+  TImageReaderP ir = lr->getFrameReader(fid);
+  ir->setShrink(shrink);
+  if (loadbox != TRect()) {
+    ir->setRegion(loadbox);
+    lx = loadbox.getLx();
+  }
+
+  TImageP img = ir->load();
+
+  if (img) {
+    TRasterImageP ri = ((TRasterImageP)img);
+    TToonzImageP ti  = ((TToonzImageP)img);
+    if (premultiply) {
+      if (ri)
+        TRop::premultiply(ri->getRaster());
+      else if (ti)
+        TRop::premultiply(ti->getRaster());
+    }
+
+    // se e' stata caricata una sottoimmagine alcuni formati in realta'
+    // caricano tutto il raster e fanno extract, non si ha quindi alcun
+    // risparmio di occupazione di memoria; alloco un raster grande
+    // giusto copio la region e butto quello originale.
+    if (ri && loadbox != TRect() &&
+        ri->getRaster()->getLx() == oriLx)  // questo serve perche' per avi e
+                                            // mov la setRegion e'
+                                            // completamente ignorata...
+      ri->setRaster(ri->getRaster()->extract(loadbox)->clone());
+    else if (ri && ri->getRaster()->getWrap() > ri->getRaster()->getLx())
+      ri->setRaster(ri->getRaster()->clone());
+    else if (ti && ti->getCMapped()->getWrap() > ti->getCMapped()->getLx())
+      ti->setCMapped(ti->getCMapped()->clone());
+
+    if ((fp.getType() == "tlv" || fp.getType() == "pli") && shrink > 1 &&
+        (lx == 0 || (ri && ri->getRaster()->getLx() == lx) ||
+         (ti && ti->getRaster()->getLx() == lx))) {
+      if (ri)
+        ri->setRaster(TRop::shrink(ri->getRaster(), shrink));
+      else if (ti)
+        ti->setCMapped(TRop::shrink(ti->getRaster(), shrink));
+    }
+
+    TPalette *imgPalette = img->getPalette();
+    if (palette && (!imgPalette || imgPalette != palette))
+      img->setPalette(palette);
+    TImageCache::instance()->add(id, img);
+
+    QMutexLocker locker(&m_loadboxesMutex);
+    m_loadboxes[id] = loadbox;
+  }
+
+  return img;
+}
+
+//-----------------------------------------------------------------------------
+
+TImageP FlipBook::getCurrentImage(int frame) {
+  if (m_xl)  // is an xsheet level
+  {
+    if (m_xl->getFrameCount() <= 0) return 0;
+    return m_xl->getFrame(m_xl->index2fid(frame - 1), false);
+  }
+
+  std::string id;
+  TFilePath fp;
+  TFrameId fid;
+  bool randomAccessRead, premultiply;
+  if (!getFrameSource(frame, id, fp, fid, randomAccessRead, premultiply))
+    return 0;
+
+  if (!m_levels.empty()) {
+    if (!m_isPreviewFx)
+      m_title1 = m_viewerTitle + " :: " + fp.withoutParentDir().withFrame(fid);
     else
-      TImageCache::instance()->remove(id);
+      m_title1 = "";
   }
+
+  bool showSub = m_flipConsole->isChecked(FlipConsole::eUseLoadBox);
+  TRect loadbox(showSub ? m_loadbox : TRect());
+
+  TImageP img = getCachedImage(id, loadbox);
+  if (img) return img;
+
   if (fp != TFilePath() && !m_isPreviewFx) {
-    int lx = 0, oriLx = 0;
     // TLevelReaderP lr(fp);
     if (!m_lr || (fp != m_lr->getFilePath())) {
       m_lr = TLevelReaderP(fp);
       m_lr->enableRandomAccessRead(randomAccessRead);
     }
     if (!m_lr) return 0;
-    // try to get image info only when loading tlv or pli as it is quite time
-    // consuming
-    if (fp.getType() == "tlv" || fp.getType() == "pli") {
-      if (m_lr->getImageInfo()) lx = oriLx = m_lr->getImageInfo()->m_lx;
-    }
-    TImageReaderP ir = m_lr->getFrameReader(fid);
-    ir->setShrink(m_shrink);
-    if (m_loadbox != TRect() && showSub) {
-      ir->setRegion(m_loadbox);
-      lx = m_loadbox.getLx();
-    }
-
-    TImageP img = ir->load();
 
-    if (img) {
-      TRasterImageP ri = ((TRasterImageP)img);
-      TToonzImageP ti  = ((TToonzImageP)img);
-      if (premultiply) {
-        if (ri)
-          TRop::premultiply(ri->getRaster());
-        else if (ti)
-          TRop::premultiply(ti->getRaster());
-      }
-
-      // se e' stata caricata una sottoimmagine alcuni formati in realta'
-      // caricano tutto il raster e fanno extract, non si ha quindi alcun
-      // risparmio di occupazione di memoria; alloco un raster grande
-      // giusto copio la region e butto quello originale.
-      if (ri && showSub && m_loadbox != TRect() &&
-          ri->getRaster()->getLx() == oriLx)  // questo serve perche' per avi e
-                                              // mov la setRegion e'
-                                              // completamente ignorata...
-        ri->setRaster(ri->getRaster()->extract(m_loadbox)->clone());
-      else if (ri && ri->getRaster()->getWrap() > ri->getRaster()->getLx())
-        ri->setRaster(ri->getRaster()->clone());
-      else if (ti && ti->getCMapped()->getWrap() > ti->getCMapped()->getLx())
-        ti->setCMapped(ti->getCMapped()->clone());
-
-      if ((fp.getType() == "tlv" || fp.getType() == "pli") && m_shrink > 1 &&
-          (lx == 0 || (ri && ri->getRaster()->getLx() == lx) ||
-           (ti && ti->getRaster()->getLx() == lx))) {
-        if (ri)
-          ri->setRaster(TRop::shrink(ri->getRaster(), m_shrink));
-        else if (ti)
-          ti->setCMapped(TRop::shrink(ti->getRaster(), m_shrink));
-      }
-
-      TPalette *palette = img->getPalette();
-      if (m_palette && (!palette || palette != m_palette))
-        img->setPalette(m_palette);
-      TImageCache::instance()->add(id, img);
-      m_loadboxes[id] = showSub ? m_loadbox : TRect();
-    }
+    img = loadImage(m_lr, id, fid, premultiply, loadbox, m_shrink, m_palette);
 
     // An old archived bug says that simulatenous open for read of the same tlv
     // are not allowed...
@@ -1654,6 +1713,54 @@ else*/
 
 //-----------------------------------------------------------------------------
 
+/*! Returns the decoding of the image of the specified frame ahead of the
+    playback. Only image sequences are decoded this way, since each of their
+    frames can be read independently through a dedicated reader; movie files
+    and multi-frame levels are left to the playback itself.
+
+    The frame source and the flipbook settings are copied here, in the main
+    thread, for the prefetching thread running the returned function.
+*/
+std::function<void()> FlipBook::getPrefetchJob(
+    int frame, const ImagePainter::VisualSettings &vs) {
+  if (m_xl) {
+    // Xsheet levels are loaded through the thread-safe ImageManager
+    if (m_xl->getFrameCount() <= 0) return std::function<void()>();
+
+    TXshSimpleLevelP xl(m_xl);
+    TFrameId fid(m_xl->index2fid(frame - 1));
+    return [xl, fid]() { xl->getFrame(fid, false); };
+  }
+
+  if (m_isPreviewFx) return std::function<void()>();
+
+  std::string id;
+  TFilePath fp;
+  TFrameId fid;
+  bool randomAccessRead, premultiply;
+  if (!getFrameSource(frame, id, fp, fid, randomAccessRead, premultiply) ||
+      fp == TFilePath() || isMovieType(fp) ||
+      TFileType::isLevelExtension(fp.getType()))
+    return std::function<void()>();
+
+  TRect loadbox(vs.m_useLoadbox ? m_loadbox : TRect());
+  if (getCachedImage(id, loadbox)) return std::function<void()>();
+
+  int shrink = m_shrink;
+  TPaletteP palette(m_palette);
+
+  return [this, fp, id, fid, randomAccessRead, premultiply, loadbox, shrink,
+          palette]() {
+    TLevelReaderP lr(fp);
+    if (!lr) return;
+
+    lr->enableRandomAccessRead(randomAccessRead);
+    loadImage(lr, id, fid, premultiply, loadbox, shrink, palette.getPointer());
+  };
+}
+
+//-----------------------------------------------------------------------------
+
 /*! Set current level frame to image viewer. Add the view image in cache.
 */
 void FlipBook::onDrawFrame(int frame, const ImagePainter::VisualSettings &vs) {
@@ -1849,6 +1956,8 @@ void FlipBook::dropEvent(QDropEvent *e) {
 //-------------------------------------------------------------------
 
 void FlipBook::reset() {
+  m_flipConsole->cancelPrefetch();
+
   if (!m_isPreviewFx)  // The cache is owned by the PreviewFxManager otherwise
     clearCache();
   else
@@ -15,6 +15,7 @@
 #include "toonz/txsheet.h"
 
 #include <QTimer>
+#include <QMutex>
 
 #include "toonzqt/flipconsoleowner.h"
 
@@ -124,6 +125,7 @@ protected:
   TDimension m_dim;
   std::map<std::string, TRect>
       m_loadboxes;  // id in the cash, rect loaded actually
+  QMutex m_loadboxesMutex;
   class Level {
   public:
     Level(const TLevelP &level, const TFilePath &fp, int fromIndex, int toIndex,
@@ -239,6 +241,8 @@ public:
   void reset();
 
   void onDrawFrame(int frame, const ImagePainter::VisualSettings &vs) override;
+  std::function<void()> getPrefetchJob(
+      int frame, const ImagePainter::VisualSettings &vs) override;
 
   void minimize(bool doMinimize);
 
@@ -268,6 +272,13 @@ protected:
   void playAudioFrame(int frame);
   TImageP getCurrentImage(int frame);
 
+  bool getFrameSource(int frame, std::string &id, TFilePath &fp, TFrameId &fid,
+                      bool &randomAccessRead, bool &premultiply);
+  TImageP getCachedImage(const std::string &id, const TRect &loadbox);
+  TImageP loadImage(const TLevelReaderP &lr, const std::string &id,
+                    const TFrameId &fid, bool premultiply,
+                    const TRect &loadbox, int shrink, TPalette *palette);
+
   void showEvent(QShowEvent *e) override;
   void hideEvent(QHideEvent *e) override;
   void focusInEvent(QFocusEvent *e) override;
@@ -820,6 +820,48 @@ void SceneViewer::setVisual(const ImagePainter::VisualSettings &settings) {
 
 //-----------------------------------------------------------------------------
 
+/*! Returns the loading of the raster images shown at the specified xsheet
+    row, so that they are already cached when the row is drawn. The levels
+    and frames are collected here, in the main thread, while the returned
+    function runs in the playback prefetching threads.
+*/
+std::function<void()> SceneViewer::getPrefetchRowJob(int row) {
+  typedef std::vector<std::pair<TXshSimpleLevelP, TFrameId>> Frames;
+
+  TApp *app = TApp::instance();
+  if (isPreviewEnabled() || app->getCurrentFrame()->isEditingLevel())
+    return std::function<void()>();
+
+  // Filled images are cached under different ids, see Stage::Player::image()
+  if (TXshSimpleLevel::m_fillFullColorRaster) return std::function<void()>();
+
+  TXsheet *xsh = app->getCurrentXsheet()->getXsheet();
+  Frames frames;
+
+  int c, columnCount = xsh->getColumnCount();
+  for (c = 0; c < columnCount; ++c) {
+    TXshColumn *column = xsh->getColumn(c);
+    if (!column || !column->isCamstandVisible()) continue;
+
+    TXshCell cell       = xsh->getCell(row, c);
+    TXshSimpleLevel *sl = cell.getSimpleLevel();
+
+    // Vector and mesh images are cheap to build - raster ones are not
+    if (!sl || !(sl->getType() & RASTER_TYPE)) continue;
+
+    frames.push_back(std::make_pair(TXshSimpleLevelP(sl), cell.m_frameId));
+  }
+
+  if (frames.empty()) return std::function<void()>();
+
+  return [frames]() {
+    for (const Frames::value_type &frame : frames)
+      frame.first->getFrame(frame.second, false);
+  };
+}
+
+//-----------------------------------------------------------------------------
+
 SceneViewer::~SceneViewer() {
   if (m_fbo) delete m_fbo;
 
@@ -23,6 +23,7 @@
 #include "previewer.h"
 
 #include <array>
+#include <functional>
 #include <QMatrix4x4>
 #include <QTouchDevice>
 
@@ -216,6 +217,7 @@ public:
   int getPreviewMode() const { return m_previewMode; }
 
   void setVisual(const ImagePainter::VisualSettings &settings);
+  std::function<void()> getPrefetchRowJob(int row);
 
   TRect getActualClipRect(const TAffine &aff);
 
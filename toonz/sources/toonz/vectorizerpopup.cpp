@@ -62,6 +62,13 @@
 #include <QAction>
 #include <QMainWindow>
 #include <QToolButton>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QSemaphore>
+
+// STD includes
+#include <deque>
+#include <memory>
 
 using namespace DVGui;
 
@@ -101,6 +108,48 @@ bool l_quitLoop = false;
 
 //=============================================================================
 
+//! Vectorizes a single frame in the global thread pool.
+class VectorizeFrameTask final : public QRunnable {
+public:
+  VectorizerCore m_vCore;
+  TImageP m_img;
+  TPalette *m_palette;
+
+  CenterlineConfiguration m_cConf;
+  NewOutlineConfiguration m_oConf;
+  bool m_isOutline;
+
+  TFrameId m_fid;
+  QString m_labelName;
+
+  TVectorImageP m_result;
+  QSemaphore m_done;
+
+public:
+  VectorizeFrameTask() : m_palette(0), m_isOutline(false) {
+    setAutoDelete(false);
+  }
+
+  VectorizerConfiguration &configuration() {
+    return m_isOutline ? static_cast<VectorizerConfiguration &>(m_oConf)
+                       : static_cast<VectorizerConfiguration &>(m_cConf);
+  }
+
+  void run() override {
+    try {
+      m_result = m_vCore.vectorize(m_img, configuration(), m_palette);
+    } catch (...) {
+    }
+
+    m_img = TImageP();  // Release the source as soon as possible
+    m_done.release();
+  }
+
+  void wait() { m_done.acquire(); }
+};
+
+//=============================================================================
+
 VectorizerParameters *getCurrentVectorizerParameters() {
   return TApp::instance()
       ->getCurrentScene()
@@ -220,20 +269,12 @@ Vectorizer::~Vectorizer() {
 
 //-----------------------------------------------------------------------------
 
-TVectorImageP Vectorizer::doVectorize(TImageP img, TPalette *palette,
-                                      const VectorizerConfiguration &conf) {
-  TToonzImageP ti  = img;
-  TRasterImageP ri = img;
-
-  if (!ti && !ri) return TVectorImageP();
-
-  VectorizerCore vCore;
-  connect(&vCore, SIGNAL(partialDone(int, int)), this,
+void Vectorizer::connectCore(VectorizerCore *vCore) {
+  connect(vCore, SIGNAL(partialDone(int, int)), this,
           SIGNAL(partialDone(int, int)));
-  connect(this, SIGNAL(transmitCancel()), &vCore, SLOT(onCancel()),
+  connect(this, SIGNAL(transmitCancel()), vCore, SLOT(onCancel()),
           Qt::DirectConnection);  // Direct connection *must* be
                                   // established for child cancels
-  return vCore.vectorize(img, conf, palette);
 }
 
 //-----------------------------------------------------------------------------
@@ -315,26 +356,6 @@ void Vectorizer::setLevel(const TXshSimpleLevelP &level) {
 //-----------------------------------------------------------------------------
 
 int Vectorizer::doVectorize() {
-  struct {
-    Vectorizer *m_this;
-
-    CenterlineConfiguration m_cConf;
-    NewOutlineConfiguration m_oConf;
-
-    void updateConfig(double weight) {
-      if (m_this->m_params.m_isOutline)
-        m_oConf = m_this->m_params.getOutlineConfiguration(weight);
-      else
-        m_cConf = m_this->m_params.getCenterlineConfiguration(weight);
-    }
-
-  } locals = {this};
-
-  VectorizerConfiguration &configuration =
-      m_params.m_isOutline
-          ? static_cast<VectorizerConfiguration &>(locals.m_oConf)
-          : static_cast<VectorizerConfiguration &>(locals.m_cConf);
-
   if (!m_vLevel) return 0;
 
   if (m_dialog->getChoice() == OverwriteDialog::KEEP_OLD && m_dialogShown)
@@ -351,60 +372,97 @@ int Vectorizer::doVectorize() {
 
   int count = 0;
 
-  std::vector<TFrameId>::const_iterator ft, fEnd = m_fids.end();
-  for (ft = m_fids.begin(); ft != fEnd; ++ft) {
-    // Retrieve the image to be vectorized
-    TImageP img;
-    if (sl->getType() == OVL_XSHLEVEL || sl->getType() == TZP_XSHLEVEL ||
-        sl->getType() == TZI_XSHLEVEL)
-      img = sl->getFullsampledFrame(*ft, ImageManager::dontPutInCache);
+  // Frames are loaded and stored here, in order, while their vectorization
+  // runs concurrently in the global thread pool. The number of frames in
+  // flight is bounded to limit memory usage.
+  QThreadPool *pool   = QThreadPool::globalInstance();
+  const int maxQueued = 2 * std::max(pool->maxThreadCount(), 1);
+
+  std::deque<std::unique_ptr<VectorizeFrameTask>> queue;
 
-    if (!img) continue;
+  std::vector<TFrameId>::const_iterator ft = m_fids.begin(),
+                                        fEnd = m_fids.end();
+  while (!m_isCanceled) {
+    while (ft != fEnd && (int)queue.size() < maxQueued) {
+      const TFrameId &fid = *ft++;
 
-    // Build image-toonz coordinate transformation
-    TAffine dpiAff = getDpiAffine(sl, *ft, true);
-    double factor  = norm(dpiAff * TPointD(1, 0));
+      // Retrieve the image to be vectorized
+      TImageP img;
+      if (sl->getType() == OVL_XSHLEVEL || sl->getType() == TZP_XSHLEVEL ||
+          sl->getType() == TZI_XSHLEVEL)
+        img = sl->getFullsampledFrame(fid, ImageManager::dontPutInCache);
 
-    TPointD center;
-    if (TToonzImageP ti = img)
-      center = ti->getRaster()->getCenterD();
-    else if (TRasterImageP ri = img)
-      center = ri->getRaster()->getCenterD();
+      TToonzImageP ti  = img;
+      TRasterImageP ri = img;
+      if (!ti && !ri) continue;
 
-    // Build vectorizer configuration
-    double weight = (ft->getNumber() - 1 - frameRange[0]) /
-                    std::max(frameRange[1] - frameRange[0], 1.0);
-    weight = tcrop(weight, 0.0, 1.0);
+      std::unique_ptr<VectorizeFrameTask> task(new VectorizeFrameTask);
 
-    locals.updateConfig(weight);  // TEMPORARY
+      // Build image-toonz coordinate transformation
+      TAffine dpiAff = getDpiAffine(sl, fid, true);
+      double factor  = norm(dpiAff * TPointD(1, 0));
 
-    configuration.m_affine     = dpiAff * TTranslation(-center);
-    configuration.m_thickScale = factor;
+      TPointD center;
+      if (ti)
+        center = ti->getRaster()->getCenterD();
+      else
+        center = ri->getRaster()->getCenterD();
 
-    // Build vectorization label to be displayed
-    QString labelName = QString::fromStdWString(sl->getShortName());
-    labelName.push_back(' ');
-    labelName.append(QString::fromStdString(ft->expand(TFrameId::NO_PAD)));
+      // Build vectorizer configuration
+      double weight = (fid.getNumber() - 1 - frameRange[0]) /
+                      std::max(frameRange[1] - frameRange[0], 1.0);
+      weight = tcrop(weight, 0.0, 1.0);
+
+      task->m_isOutline = m_params.m_isOutline;
+      if (task->m_isOutline)
+        task->m_oConf = m_params.getOutlineConfiguration(weight);
+      else
+        task->m_cConf = m_params.getCenterlineConfiguration(weight);
 
-    emit frameName(labelName);
+      VectorizerConfiguration &configuration = task->configuration();
+      configuration.m_affine     = dpiAff * TTranslation(-center);
+      configuration.m_thickScale = factor;
 
-    // Perform vectorization
-    if (TVectorImageP vi =
-            doVectorize(img, m_vLevel->getPalette(), configuration)) {
-      TFrameId fid = *ft;
+      // Build vectorization label to be displayed
+      QString labelName = QString::fromStdWString(sl->getShortName());
+      labelName.push_back(' ');
+      labelName.append(QString::fromStdString(fid.expand(TFrameId::NO_PAD)));
 
-      if (fid.getNumber() < 0) fid = TFrameId(1, ft->getLetter());
+      task->m_img       = img;
+      task->m_palette   = m_vLevel->getPalette();
+      task->m_fid       = fid;
+      task->m_labelName = labelName;
+
+      connectCore(&task->m_vCore);
+
+      pool->start(task.get());
+      queue.push_back(std::move(task));
+    }
+
+    if (queue.empty()) break;
+
+    // Store the oldest frame
+    std::unique_ptr<VectorizeFrameTask> task(std::move(queue.front()));
+    queue.pop_front();
+
+    emit frameName(task->m_labelName);
+    task->wait();
+
+    if (TVectorImageP vi = task->m_result) {
+      TFrameId fid = task->m_fid;
+
+      if (fid.getNumber() < 0) fid = TFrameId(1, task->m_fid.getLetter());
 
       m_vLevel->setFrame(fid, vi);
       vi->setPalette(m_vLevel->getPalette());
 
       emit frameDone(++count);
     }
-
-    // Stop if canceled
-    if (m_isCanceled) break;
   }
 
+  // Wait for the frames still in flight (they quit early on cancels)
+  for (auto &task : queue) task->wait();
+
   m_dialogShown = false;
 
   return count;
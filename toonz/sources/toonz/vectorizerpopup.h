@@ -32,6 +32,7 @@ class QHideEvent;
 class ProgressDialog;
 class TXshSimpleLevel;
 class Vectorizer;
+class VectorizerCore;
 class TSceneHandle;
 class OverwriteDialog;
 class VectorizerSwatchArea;
@@ -334,10 +335,9 @@ private:
 private:
   int doVectorize();  //!< Start vectorization of input frames.
 
-  //! Makes connections to low-level partial progress signals and cancel slots,
-  //! and invokes the low-level vectorization of \b img.
-  TVectorImageP doVectorize(TImageP img, TPalette *palette,
-                            const VectorizerConfiguration &conf);
+  //! Makes connections to low-level partial progress signals and cancel slots
+  //! of a vectorization core.
+  void connectCore(VectorizerCore *vCore);
 };
 
 #endif  // VECTORIZERPOPUP_H
@@ -126,6 +126,7 @@ SceneViewerPanel::SceneViewerPanel(QWidget *parent, Qt::WFlags flags)
   m_flipConsole =
       new FlipConsole(mainLayout, buttonMask, false, m_keyFrameButton,
                       "SceneViewerConsole", this, true);
+  m_flipConsole->enablePrefetch(true);
 
   m_flipConsole->enableButton(FlipConsole::eMatte, false, false);
   m_flipConsole->enableButton(FlipConsole::eSave, false, false);
@@ -224,7 +225,17 @@ void SceneViewerPanel::onDrawFrame(
 
 //-----------------------------------------------------------------------------
 
-SceneViewerPanel::~SceneViewerPanel() {}
+SceneViewerPanel::~SceneViewerPanel() {
+  // Prefetching threads access the scene viewer
+  m_flipConsole->enablePrefetch(false);
+}
+
+//-----------------------------------------------------------------------------
+
+std::function<void()> SceneViewerPanel::getPrefetchJob(
+    int frame, const ImagePainter::VisualSettings &settings) {
+  return m_sceneViewer->getPrefetchRowJob(frame - 1);
+}
 
 //-----------------------------------------------------------------------------
 
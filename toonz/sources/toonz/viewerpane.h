@@ -57,6 +57,8 @@ public:
 
   void onDrawFrame(int frame,
                    const ImagePainter::VisualSettings &settings) override;
+  std::function<void()> getPrefetchJob(
+      int frame, const ImagePainter::VisualSettings &settings) override;
   bool widgetInThisPanelIsFocused() override {
     return m_sceneViewer->hasFocus();
   }
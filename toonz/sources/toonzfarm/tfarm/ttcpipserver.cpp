@@ -11,6 +11,7 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <sys/types.h>
+#include <sys/time.h>
 #include <sys/socket.h>
 #include <sys/wait.h>
 #include <netinet/in.h>
@@ -41,7 +42,12 @@ bool Sthutdown = false;
 
 class TTcpIpServerImp {
 public:
-  TTcpIpServerImp(int port) : m_port(port), m_s(-1), m_server(0) {}
+  TTcpIpServerImp(int port)
+      : m_port(port)
+      , m_s(-1)
+      , m_server(0)
+      , m_receiveTimeout(0)
+      , m_serializedReceive(true) {}
 
   int readData(int sock, QString &data);
   void onReceive(int sock, const QString &data);
@@ -50,6 +56,9 @@ public:
   int m_port;
   TTcpIpServer *m_server;  // back pointer
 
+  int m_receiveTimeout;  // msecs, 0 = none
+  bool m_serializedReceive;
+
   TThread::Mutex m_mutex;
 };
 
@@ -60,6 +69,19 @@ int TTcpIpServerImp::readData(int sock, QString &data) {
   char buff[1025];
   memset(buff, 0, sizeof(buff));
 
+  if (m_receiveTimeout > 0) {
+    // a client that stops sending makes the reads below fail
+#ifdef _WIN32
+    DWORD timeout = m_receiveTimeout;
+#else
+    struct timeval timeout;
+    timeout.tv_sec  = m_receiveTimeout / 1000;
+    timeout.tv_usec = (m_receiveTimeout % 1000) * 1000;
+#endif
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, (const char *)&timeout,
+               sizeof(timeout));
+  }
+
 #ifdef _WIN32
   if ((cnt = recv(sock, buff, sizeof(buff) - 1, 0)) < 0) {
     int err = WSAGetLastError();
@@ -70,7 +92,6 @@ int TTcpIpServerImp::readData(int sock, QString &data) {
   if ((cnt = read(sock, buff, sizeof(buff) - 1)) < 0) {
     printf("socket read failure %d\n", errno);
     perror("network server");
-    close(sock);
     return -1;
   }
 #endif
@@ -108,7 +129,6 @@ int TTcpIpServerImp::readData(int sock, QString &data) {
     if ((cnt = read(sock, buff, sizeof(buff) - 1)) < 0) {
       printf("socket read failure %d\n", errno);
       perror("network server");
-      close(sock);
       return -1;
     }
 #endif
@@ -226,6 +246,11 @@ int TTcpIpServerImp::readData(int sock, string &data) {
 //---------------------------------------------------------------------
 
 void TTcpIpServerImp::onReceive(int sock, const QString &data) {
+  if (!m_serializedReceive) {
+    m_server->onReceive(sock, data);
+    return;
+  }
+
   QMutexLocker sl(&m_mutex);
   m_server->onReceive(sock, data);
 }
@@ -286,12 +311,12 @@ void DataReader::run() {
       Sthutdown = true;
     else
       m_serverImp->onReceive(m_clientSocket, data);
+  }
 #ifdef _WIN32
-    closesocket(m_clientSocket);
+  closesocket(m_clientSocket);
 #else
-    close(m_clientSocket);
+  close(m_clientSocket);
 #endif
-  }
 }
 
 //---------------------------------------------------------------------
@@ -341,19 +366,20 @@ void TTcpIpServer::run() {
           return;
         }
 
+        // The socket is closed here, unless handed over to a DataReceiver
         QString data;
         int ret = m_imp->readData(t, data);
-        if (ret != -1 && data != "") {
-          if (data == QString("shutdown")) {
+        if (ret != -1 && data != "" && data != QString("shutdown")) {
+          // creo un nuovo thread per la gestione dei dati ricevuti
+          TThread::Executor executor;
+          executor.addTask(new DataReceiver(t, data, m_imp));
+        } else {
+          if (ret != -1 && data == QString("shutdown")) {
             // DebugBreak();
             Sthutdown = true;
-          } else {
-            // creo un nuovo thread per la gestione dei dati ricevuti
-            TThread::Executor executor;
-            executor.addTask(new DataReceiver(t, data, m_imp));
           }
-        } else {
           ::shutdown(t, 1);
+          closesocket(t);
         }
       }
     } else {
@@ -411,6 +437,18 @@ int TTcpIpServer::getExitCode() const { return m_exitCode; }
 
 //---------------------------------------------------------------------
 
+void TTcpIpServer::setReceiveTimeout(int msecs) {
+  m_imp->m_receiveTimeout = msecs;
+}
+
+//---------------------------------------------------------------------
+
+void TTcpIpServer::setSerializedReceive(bool serialized) {
+  m_imp->m_serializedReceive = serialized;
+}
+
+//---------------------------------------------------------------------
+
 void TTcpIpServer::sendReply(int socket, const QString &reply) {
   string replyUtf8 = reply.toStdString();
 
@@ -9,6 +9,7 @@
 #include "service.h"
 #include "tcli.h"
 #include "tversion.h"
+#include "tlevel_io.h"
 using namespace TVER;
 
 #include "tthreadmessage.h"
@@ -24,6 +25,7 @@ using namespace TVER;
 
 #include <sstream>
 #include <string>
+#include <cmath>
 using namespace std;
 
 #ifndef _WIN32
@@ -194,6 +196,26 @@ bool isAScript(TFarmTask *task) {
 
 //==============================================================================
 
+//! Running average of a time measure (in seconds), biased toward the most
+//! recent samples so that it follows changes in the render load.
+class TimeEstimate {
+public:
+  TimeEstimate() : m_value(0.0), m_samples(0) {}
+
+  void add(double sample) {
+    ++m_samples;
+    double weight = std::max(1.0 / m_samples, 0.2);
+    m_value += weight * (sample - m_value);
+  }
+
+  bool isValid() const { return m_samples > 0; }
+
+  double m_value;
+  int m_samples;
+};
+
+//==============================================================================
+
 class CtrlFarmTask final : public TFarmTask {
 public:
   CtrlFarmTask() : m_toBeDeleted(false), m_failureCount(0) {}
@@ -226,6 +248,14 @@ public:
   int m_failureCount;
 
   vector<QString> m_failedOnServers;
+
+  // istante dell'ultimo frame notificato dal server (non valido finche' il
+  // task in esecuzione non ha completato il primo frame)
+  QDateTime m_lastProgressDate;
+
+  // per i task padre: tempo medio di un frame e tempo di avvio di un
+  // subtask (caricamento della scena, ecc.), misurati sui subtask completati
+  TimeEstimate m_frameTime, m_startupTime;
 };
 
 namespace {
@@ -417,6 +447,10 @@ public:
   int m_maxTaskCount;
   TFarmPlatform m_platform;
 
+  // costo relativo di un frame su questo server rispetto alla media della
+  // farm (< 1 per i server piu' veloci)
+  TimeEstimate m_frameCost;
+
   // vettore dei taskId assegnato al server
   vector<QString> m_tasks;
 
@@ -654,6 +688,15 @@ public:
 
   void startTask(CtrlFarmTask *task, FarmServerProxy *server);
 
+  // shrinks the waiting subtask about to be started on server so that the
+  // remaining frames of the parent task are shared by all the servers;
+  // the frames cut away are moved to a new waiting subtask
+  void adaptChunkSize(CtrlFarmTask *parentTask, CtrlFarmTask *subTask,
+                      FarmServerProxy *server);
+
+  // updates the frame time estimates after a frame of task has been rendered
+  void updateTimeEstimates(CtrlFarmTask *task, CtrlFarmTask *parentTask);
+
   CtrlFarmTask *getTaskToStart(FarmServerProxy *server = 0);
   CtrlFarmTask *getNextTaskToStart(CtrlFarmTask *task, FarmServerProxy *server);
 
@@ -1114,6 +1157,9 @@ void FarmController::startTask(CtrlFarmTask *task, FarmServerProxy *server) {
     }
   }
 
+  if (taskToBeSubmitted && taskToBeSubmittedParent)
+    adaptChunkSize(taskToBeSubmittedParent, taskToBeSubmitted, server);
+
   int rc = 0;
   try {
     server->addTask(taskToBeSubmitted);
@@ -1130,8 +1176,9 @@ void FarmController::startTask(CtrlFarmTask *task, FarmServerProxy *server) {
       taskToBeSubmittedParent->m_startDate = startDate;
     }
 
-    taskToBeSubmitted->m_status    = Running;
-    taskToBeSubmitted->m_startDate = startDate;
+    taskToBeSubmitted->m_status           = Running;
+    taskToBeSubmitted->m_startDate        = startDate;
+    taskToBeSubmitted->m_lastProgressDate = QDateTime();
 
     taskToBeSubmitted->m_serverId = server->getId();
 
@@ -1431,6 +1478,130 @@ void TaskStarter::run() {
 
 //------------------------------------------------------------------------------
 
+static int getFrameCount(const CtrlFarmTask *task) {
+  if (task->m_step <= 0 || task->m_to < task->m_from) return 0;
+  return (task->m_to - task->m_from) / task->m_step + 1;
+}
+
+//------------------------------------------------------------------------------
+
+void FarmController::adaptChunkSize(CtrlFarmTask *parentTask,
+                                    CtrlFarmTask *subTask,
+                                    FarmServerProxy *server) {
+  // un tcomposer gia' avviato non puo' restringere il proprio range, quindi
+  // si agisce solo sui subtask in attesa, al momento dell'assegnazione
+  if (!subTask->m_isComposerTask || subTask->m_status != Waiting ||
+      isMovieType(subTask->m_outputPath))
+    return;
+
+  int frameCount = getFrameCount(subTask);
+  if (frameCount <= 1) return;
+
+  int waitingFrames = 0;
+  std::vector<QString>::iterator itSubTaskId = parentTask->m_subTasks.begin();
+  for (; itSubTaskId != parentTask->m_subTasks.end(); ++itSubTaskId) {
+    map<TaskId, CtrlFarmTask *>::iterator itSubTask =
+        m_tasks.find(TaskId(*itSubTaskId));
+    if (itSubTask != m_tasks.end() && itSubTask->second->m_status == Waiting)
+      waitingFrames += getFrameCount(itSubTask->second);
+  }
+
+  int slotCount = 0;
+  map<QString, FarmServerProxy *>::iterator itServer = m_servers.begin();
+  for (; itServer != m_servers.end(); ++itServer) {
+    FarmServerProxy *proxy = itServer->second;
+    if (proxy->m_attached && !proxy->m_offline)
+      slotCount += std::max(proxy->m_maxTaskCount, 1);
+  }
+  slotCount = std::max(slotCount, 1);
+
+  // guided self-scheduling: ogni server prende la sua quota dei frame
+  // rimanenti, pesata sulla sua velocita' misurata; i chunk si accorciano
+  // verso la fine del task e i server lenti non ritardano la chiusura
+  double share = waitingFrames / (double)slotCount;
+  if (server->m_frameCost.isValid())
+    share /= std::max(server->m_frameCost.m_value, 0.1);
+
+  // non conviene un chunk che dura meno del tempo di avvio del tcomposer
+  int minFrames = 1;
+  if (parentTask->m_frameTime.isValid() &&
+      parentTask->m_startupTime.isValid() &&
+      parentTask->m_frameTime.m_value > 0.0)
+    minFrames = (int)std::ceil(parentTask->m_startupTime.m_value /
+                               parentTask->m_frameTime.m_value);
+
+  int chunkFrames = std::max((int)std::ceil(share), std::max(minFrames, 1));
+  if (chunkFrames >= frameCount) return;
+
+  TFarmTask tail(*subTask);
+  tail.m_from = subTask->m_from + chunkFrames * subTask->m_step;
+
+  subTask->m_to        = tail.m_from - subTask->m_step;
+  subTask->m_stepCount = chunkFrames;
+
+  QString tailId =
+      parentTask->m_id + "." + QString::number(parentTask->m_subTasks.size());
+  QString tailName = parentTask->m_name + " " + QString::number(tail.m_from) +
+                     "-" + QString::number(tail.m_to);
+
+  CtrlFarmTask *tailTask = doAddTask(
+      tailId, parentTask->m_id, tailName, tail.getCommandLine(),
+      subTask->m_user, subTask->m_hostName, false, frameCount - chunkFrames,
+      subTask->m_priority, subTask->m_platform);
+
+  if (subTask->m_dependencies)
+    tailTask->m_dependencies =
+        new TFarmTask::Dependencies(*subTask->m_dependencies);
+
+  itSubTaskId = find(parentTask->m_subTasks.begin(),
+                     parentTask->m_subTasks.end(), subTask->m_id);
+  if (itSubTaskId != parentTask->m_subTasks.end()) ++itSubTaskId;
+  parentTask->m_subTasks.insert(itSubTaskId, tailId);
+
+  QString msg = "Task " + subTask->m_id + " reduced to frames " +
+                QString::number(subTask->m_from) + "-" +
+                QString::number(subTask->m_to) + ", frames " +
+                QString::number(tail.m_from) + "-" +
+                QString::number(tail.m_to) + " moved to task " + tailId;
+  msg += "\n\n";
+  m_userLog->info(msg);
+
+  // il nuovo subtask puo' partire subito su un server libero
+  TThread::Executor executor;
+  executor.addTask(new TaskStarter(this, tailTask));
+}
+
+//------------------------------------------------------------------------------
+
+void FarmController::updateTimeEstimates(CtrlFarmTask *task,
+                                         CtrlFarmTask *parentTask) {
+  QDateTime now = QDateTime::currentDateTime();
+
+  if (!task->m_lastProgressDate.isValid()) {
+    // il primo frame comprende anche l'avvio del tcomposer
+    if (task->m_startDate.isValid() && parentTask->m_frameTime.isValid()) {
+      double elapsed = task->m_startDate.msecsTo(now) / 1000.0;
+      parentTask->m_startupTime.add(
+          std::max(elapsed - parentTask->m_frameTime.m_value, 0.0));
+    }
+  } else {
+    double elapsed = task->m_lastProgressDate.msecsTo(now) / 1000.0;
+
+    map<QString, FarmServerProxy *>::iterator itServer =
+        m_servers.find(task->m_serverId);
+    if (itServer != m_servers.end() && parentTask->m_frameTime.isValid() &&
+        parentTask->m_frameTime.m_value > 0.0)
+      itServer->second->m_frameCost.add(elapsed /
+                                        parentTask->m_frameTime.m_value);
+
+    parentTask->m_frameTime.add(elapsed);
+  }
+
+  task->m_lastProgressDate = now;
+}
+
+//------------------------------------------------------------------------------
+
 QString FarmController::addTask(const TFarmTask &task, bool suspended) {
   QString id = QString::number(NextTaskId++);
 
@@ -1816,6 +1987,8 @@ void FarmController::taskSubmissionError(const QString &taskId, int errCode) {
 void FarmController::taskProgress(const QString &taskId, int step,
                                   int stepCount, int frameNumber,
                                   FrameState state) {
+  QMutexLocker sl(&m_mutex);
+
   map<TaskId, CtrlFarmTask *>::iterator itTask = m_tasks.find(TaskId(taskId));
   if (itTask != m_tasks.end()) {
     CtrlFarmTask *task = itTask->second;
@@ -1827,11 +2000,14 @@ void FarmController::taskProgress(const QString &taskId, int step,
     if (task->m_parentId != "") {
       map<TaskId, CtrlFarmTask *>::iterator itParentTask =
           m_tasks.find(TaskId(task->m_parentId));
-      CtrlFarmTask *parentTask = itParentTask->second;
-      if (state == FrameDone)
-        ++parentTask->m_successfullSteps;
-      else
-        ++parentTask->m_failedSteps;
+      if (itParentTask != m_tasks.end()) {
+        CtrlFarmTask *parentTask = itParentTask->second;
+        if (state == FrameDone) {
+          ++parentTask->m_successfullSteps;
+          updateTimeEstimates(task, parentTask);
+        } else
+          ++parentTask->m_failedSteps;
+      }
     }
   }
 }
@@ -190,6 +190,69 @@ bool myDoesExists(const TFilePath &fp) {
 
 inline bool isBlank(char c) { return c == ' ' || c == '\t' || c == '\n'; }
 
+//-----------------------------------------------------------------------------
+
+// legge la porta del tcomposer residente (tcomposer -daemon -port n) dal file
+// config/tcomposer.txt della local root; 0 se non e' configurato
+int readComposerDaemonPort() {
+  int port     = 0;
+  TFilePath fp = getLocalRoot() + "config" + "tcomposer.txt";
+  if (myDoesExists(fp)) {
+    Tifstream is(fp);
+    if (is.good()) is >> port;
+  }
+  return port;
+}
+
+//-----------------------------------------------------------------------------
+
+// Chiede al tcomposer residente di interrompere il job del task; un job
+// che non e' ancora partito viene scartato all'avvio
+void cancelComposerDaemonJob(const QString &taskid) {
+  static const int port = readComposerDaemonPort();
+  if (port <= 0) return;
+
+  TTcpIpClient client;
+
+  int sock;
+  if (client.connect(TSystem::getHostName(), "", port, sock) != OK) return;
+
+  QString reply;
+  client.send(sock, "cancel," + taskid, reply);
+  client.disconnect(sock);
+}
+
+//-----------------------------------------------------------------------------
+
+// Passa il job al tcomposer residente, che tiene gia' caricati la scena e i
+// livelli. Ritorna false se il job deve essere eseguito da un nuovo processo,
+// cioe' solo se il tcomposer residente non e' raggiungibile: una volta
+// inviato, il job potrebbe essere in esecuzione, e senza risposta fallisce.
+bool runOnComposerDaemon(const QString &cmdline, const QString &taskid,
+                         int &exitCode) {
+  static const int port = readComposerDaemonPort();
+  if (port <= 0) return false;
+
+  TTcpIpClient client;
+
+  int sock;
+  int ret = client.connect(TSystem::getHostName(), "", port, sock);
+  if (ret != OK) return false;
+
+  QString reply;
+  ret = client.send(sock, "render," + cmdline, reply);
+  client.disconnect(sock);
+  if (ret != OK || reply.isEmpty()) {
+    // the job may still be running, or start later: stop it
+    cancelComposerDaemonJob(taskid);
+    exitCode = -1;
+    return true;
+  }
+
+  exitCode = reply.toInt();
+  return true;
+}
+
 }  // anonymous namespace
 
 //==============================================================================
@@ -468,14 +531,21 @@ void Task::run() {
   // cout << exename << endl;
   // cout << cmdline << endl;
 
-  QProcess process;
+  int exitCode  = 0;
+  int errorCode = QProcess::UnknownError;
+
+  if (!appName.contains("tcomposer") ||
+      !runOnComposerDaemon(cmdline, m_id, exitCode)) {
+    QProcess process;
 
-  process.start(cmdline);
-  process.waitForFinished(-1);
+    process.start(cmdline);
+    process.waitForFinished(-1);
 
-  int exitCode  = process.exitCode();
-  int errorCode = process.error();
-  bool ret      = (errorCode != QProcess::UnknownError) || exitCode;
+    exitCode  = process.exitCode();
+    errorCode = process.error();
+  }
+
+  bool ret = (errorCode != QProcess::UnknownError) || exitCode;
 
   // int ret=QProcess::execute(/*"C:\\depot\\vincenzo\\toonz\\main\\x86_debug\\"
   // +*/cmdline);
@@ -635,6 +705,9 @@ int FarmServer::terminateTask(const QString &taskid) {
   }
 #else
 #endif
+
+  // i job passati al tcomposer residente non hanno un processo proprio
+  cancelComposerDaemonJob(taskid);
   return 0;
 }
 
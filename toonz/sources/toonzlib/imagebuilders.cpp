@@ -114,6 +114,11 @@ TImageP ImageLoader::build(int imFlags, void *extData) {
       img = ir->loadIcon();  // TODO: Why just in the tlv case??
     else {
       ir->setShrink(subsampling);
+
+      // Partial images must never be cached
+      if ((imFlags & ImageManager::dontPutInCache) && !data->m_region.isEmpty())
+        ir->setRegion(data->m_region);
+
       img = ir->load();
     }
 
@@ -4,6 +4,7 @@
 #define IMAGE_BUILDERS_H
 
 #include "tfilepath.h"
+#include "tgeometry.h"
 
 #include "toonz/imagemanager.h"
 
@@ -39,6 +40,8 @@ public:
     //!< 'the currently stored one' if an image is already cached, or
     //!< m_sl's subsampling property otherwise)
     bool m_icon;  //!< Whether the icon (if any) should be loaded instead
+    TRect m_region;  //!< The image region to be loaded (empty meaning the
+                     //!< whole image). Used only for images not to be cached
 
   public:
     BuildExtData(const TXshSimpleLevel *sl, const TFrameId &fid, int subs = 0,
@@ -36,6 +36,9 @@
 
 #include "toonz/scenefx.h"
 
+// STD includes
+#include <map>
+
 /*
   TODO: Some parts of the following render-tree building procedure should be
   revised. In particular,
@@ -321,31 +324,6 @@ bool getColumnPlacement(TAffine &aff, TXsheet *xsh, double row, int col,
 
 //-------------------------------------------------------------------
 
-static bool getColumnPlacement(PlacedFx &pf, TXsheet *xsh, double row, int col,
-                               bool isPreview) {
-  if (col < 0) return false;
-  TStageObject *pegbar = xsh->getStageObject(TStageObjectId::ColumnId(col));
-  TAffine objAff       = pegbar->getPlacement(row);
-  pf.m_z               = pegbar->getZ(row);
-  pf.m_so              = pegbar->getSO(row);
-
-  TStageObjectId cameraId;
-  if (isPreview)
-    cameraId = xsh->getStageObjectTree()->getCurrentPreviewCameraId();
-  else
-    cameraId           = xsh->getStageObjectTree()->getCurrentCameraId();
-  TStageObject *camera = xsh->getStageObject(cameraId);
-  TAffine cameraAff    = camera->getPlacement(row);
-  double cameraZ       = camera->getZ(row);
-
-  bool isVisible =
-      TStageObject::perspective(pf.m_aff, cameraAff, cameraZ, objAff, pf.m_z,
-                                pegbar->getGlobalNoScaleZ());
-
-  return isVisible;
-}
-
-//-------------------------------------------------------------------
 /*-- Objectの位置を得る --*/
 static bool getStageObjectPlacement(TAffine &aff, TXsheet *xsh, double row,
                                     TStageObjectId &id, bool isPreview) {
@@ -540,6 +518,12 @@ public:
   // (at least) of a particle Fx
   int m_particleDescendentCount;
 
+  // PlacedFxs already built for this frame, keyed by fx and by whether they
+  // descend from a particle fx. Fxs reached through more than one path
+  // (typically the xsheet node, when several fxs take it as input) are so
+  // expanded only once, and their sub-render-tree is shared.
+  std::map<std::pair<TFx *, bool>, PlacedFx> m_placedFxs;
+
 public:
   FxBuilder(ToonzScene *scene, TXsheet *xsh, double frame, int whichLevels,
             bool isPreview = false, bool expandXSheet = true);
@@ -557,6 +541,8 @@ public:
 
   TFxP getFxWithColumnMovements(const PlacedFx &pf);
 
+  bool getColumnPlacement(PlacedFx &pf);
+
   bool addPlasticDeformerFx(PlacedFx &pf);
 };
 
@@ -635,6 +621,22 @@ TFxP FxBuilder::getFxWithColumnMovements(const PlacedFx &pf) {
 
 //-------------------------------------------------------------------
 
+//! Places pf in its column, using the camera placement already computed for
+//! the builder's frame. Returns false if the column is not visible.
+bool FxBuilder::getColumnPlacement(PlacedFx &pf) {
+  if (pf.m_columnIndex < 0) return false;
+  TStageObject *pegbar =
+      m_xsh->getStageObject(TStageObjectId::ColumnId(pf.m_columnIndex));
+  TAffine objAff = pegbar->getPlacement(m_frame);
+  pf.m_z         = pegbar->getZ(m_frame);
+  pf.m_so        = pegbar->getSO(m_frame);
+
+  return TStageObject::perspective(pf.m_aff, m_cameraAff, m_cameraZ, objAff,
+                                   pf.m_z, pegbar->getGlobalNoScaleZ());
+}
+
+//-------------------------------------------------------------------
+
 bool FxBuilder::addPlasticDeformerFx(PlacedFx &pf) {
   TStageObject *obj =
       m_xsh->getStageObject(TStageObjectId::ColumnId(pf.m_columnIndex));
@@ -674,18 +676,30 @@ bool FxBuilder::addPlasticDeformerFx(PlacedFx &pf) {
 PlacedFx FxBuilder::makePF(TFx *fx) {
   if (!fx) return PlacedFx();
 
+  std::pair<TFx *, bool> key(fx, m_particleDescendentCount > 0);
+  std::map<std::pair<TFx *, bool>, PlacedFx>::iterator it =
+      m_placedFxs.find(key);
+  if (it != m_placedFxs.end()) return it->second;
+
+  PlacedFx pf;
   if (TLevelColumnFx *lcfx = dynamic_cast<TLevelColumnFx *>(fx))
-    return makePF(lcfx);
+    pf = makePF(lcfx);
   else if (TPaletteColumnFx *pcfx = dynamic_cast<TPaletteColumnFx *>(fx))
-    return makePF(pcfx);
+    pf = makePF(pcfx);
   else if (TZeraryColumnFx *zcfx = dynamic_cast<TZeraryColumnFx *>(fx))
-    return makePF(zcfx);
+    pf = makePF(zcfx);
   else if (TXsheetFx *xsfx = dynamic_cast<TXsheetFx *>(fx))
-    return makePF(xsfx);
+    pf = makePF(xsfx);
   else if (fx->getInputPortCount() == 1)
-    return makePFfromUnaryFx(fx);
+    pf = makePFfromUnaryFx(fx);
   else
-    return makePFfromGenericFx(fx);
+    pf = makePFfromGenericFx(fx);
+
+  // Fxs with a dangling xsheet-like port get it connected by the xsheet
+  // expansion they take part in - so they can't be shared with other paths
+  if (!pf.m_leftXsheetPort) m_placedFxs[key] = pf;
+
+  return pf;
 }
 
 //-------------------------------------------------------------------
@@ -804,8 +818,7 @@ PlacedFx FxBuilder::makePF(TLevelColumnFx *lcfx) {
   pf.m_fx          = lcfx;
 
   // Build column placement
-  bool columnVisible =
-      getColumnPlacement(pf, m_xsh, m_frame, pf.m_columnIndex, m_isPreview);
+  bool columnVisible = getColumnPlacement(pf);
 
   /*-- subXsheetのとき、その中身もBuildFxを実行 --*/
   if (!cell.isEmpty() && cell.m_level->getChildLevel()) {
@@ -975,7 +988,7 @@ PlacedFx FxBuilder::makePF(TZeraryColumnFx *zcfx) {
   }
 
   // Add the column placement NaAffineFx
-  if (getColumnPlacement(pf, m_xsh, m_frame, pf.m_columnIndex, m_isPreview))
+  if (getColumnPlacement(pf))
     return pf;
   else
     return PlacedFx();
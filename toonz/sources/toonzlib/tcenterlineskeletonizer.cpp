@@ -2,6 +2,17 @@
 
 #include "tcenterlinevectP.h"
 
+// Qt includes
+#include <QThreadPool>
+#include <QRunnable>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QWaitCondition>
+#include <QAtomicInt>
+
+// STD includes
+#include <memory>
+
 //#define _SSDEBUG                                              // Uncomment to
 // enable the debug viewer
 //#define _UPDATE                                               // Shows borders
@@ -1793,10 +1804,88 @@ static SkeletonGraph *skeletonize(ContourFamily &regionContours,
 
 //--------------------------------------------------------------------------
 
+namespace {
+
+//! Shared state of a skeletonization whose contour families are processed
+//! concurrently. Families are picked up, biggest first, by the calling thread
+//! and by any pool thread that happened to be idle when the job was launched.
+class SkeletonizationJob {
+  Contours &m_contours;
+  VectorizerCore *m_vectorizer;
+  VectorizerCoreGlobals &m_globals;
+  SkeletonList &m_output;
+
+  std::vector<unsigned int> m_order;  //!< Families, sorted by node count
+  QAtomicInt m_next;                  //!< Index in m_order of the next family
+
+  QMutex m_mutex;
+  QWaitCondition m_allDone;
+  int m_doneCount;
+
+public:
+  SkeletonizationJob(Contours &contours, VectorizerCore *thisVectorizer,
+                     VectorizerCoreGlobals &g, SkeletonList &output)
+      : m_contours(contours)
+      , m_vectorizer(thisVectorizer)
+      , m_globals(g)
+      , m_output(output)
+      , m_next(0)
+      , m_doneCount(0) {
+    std::vector<std::pair<unsigned int, unsigned int>> sizes;
+    for (unsigned int i = 0; i < contours.size(); ++i) {
+      unsigned int nodes = 0;
+      for (unsigned int j = 0; j < contours[i].size(); ++j)
+        nodes += contours[i][j].size();
+      sizes.push_back(std::make_pair(nodes, i));
+    }
+
+    std::sort(sizes.begin(), sizes.end(),
+              std::greater<std::pair<unsigned int, unsigned int>>());
+    for (unsigned int i = 0; i < sizes.size(); ++i)
+      m_order.push_back(sizes[i].second);
+  }
+
+  //! Skeletonizes families until none is left.
+  void work() {
+    // Each thread needs its own context - families are independent, though
+    VectorizationContext context(&m_globals);
+
+    int count = (int)m_order.size(), i;
+    while ((i = m_next.fetchAndAddOrdered(1)) < count) {
+      unsigned int f = m_order[i];
+      if (!m_vectorizer->isCanceled())
+        m_output[f] = ::skeletonize(m_contours[f], context, m_vectorizer);
+
+      QMutexLocker locker(&m_mutex);
+      if (++m_doneCount == count) m_allDone.wakeAll();
+    }
+  }
+
+  //! Waits until all families have been processed.
+  void wait() {
+    QMutexLocker locker(&m_mutex);
+    while (m_doneCount < (int)m_order.size()) m_allDone.wait(&m_mutex);
+  }
+};
+
+//--------------------------------------------------------------------------
+
+class SkeletonizationTask final : public QRunnable {
+  std::shared_ptr<SkeletonizationJob> m_job;
+
+public:
+  SkeletonizationTask(const std::shared_ptr<SkeletonizationJob> &job)
+      : m_job(job) {}
+
+  void run() override { m_job->work(); }
+};
+
+}  // namespace
+
+//--------------------------------------------------------------------------
+
 SkeletonList *skeletonize(Contours &contours, VectorizerCore *thisVectorizer,
                           VectorizerCoreGlobals &g) {
-  VectorizationContext context(&g);
-
   SkeletonList *res = new SkeletonList;
   unsigned int i, j;
 
@@ -1808,6 +1897,35 @@ SkeletonList *skeletonize(Contours &contours, VectorizerCore *thisVectorizer,
 
   thisVectorizer->setOverallPartials(overallNodes);
 
+#ifndef _SSDEBUG
+  if (contours.size() > 1) {
+    // Contour families are disjoint regions, and can be thinned independently.
+    // Helpers are only launched on currently idle threads (this may itself be
+    // running inside a pool thread): the calling thread works on the
+    // families too, so the job always completes.
+    res->resize(contours.size(), 0);
+
+    std::shared_ptr<SkeletonizationJob> job(
+        new SkeletonizationJob(contours, thisVectorizer, g, *res));
+
+    QThreadPool *pool = QThreadPool::globalInstance();
+    for (i = 1; i < contours.size(); ++i) {
+      SkeletonizationTask *task = new SkeletonizationTask(job);
+      if (!pool->tryStart(task)) {
+        delete task;
+        break;
+      }
+    }
+
+    job->work();
+    job->wait();
+
+    return res;
+  }
+#endif
+
+  VectorizationContext context(&g);
+
   for (i = 0; i < contours.size(); ++i) {
     res->push_back(skeletonize(contours[i], context, thisVectorizer));
 
@@ -19,6 +19,9 @@
 #include "tstroke.h"
 #include "tropcm.h"
 
+// Qt includes
+#include <QMutexLocker>
+
 // STD includes
 #include <vector>
 #include <list>
@@ -171,6 +174,7 @@ TVectorImageP VectorizerCore::centerlineVectorize(
 
   if (configuration.m_naaSource) {
     if (TRaster32P ras32 = ras) {
+      QMutexLocker paletteLocker(palette->mutex());
       Naa2TlvConverter converter;
 
       converter.process(ras32);
@@ -214,8 +218,12 @@ TVectorImageP VectorizerCore::centerlineVectorize(
 
   calculateSequenceColors(ras, globals);  // Extract stroke colors here
   conversionToStrokes(sortibleResult, globals);
-  applyStrokeColors(sortibleResult, ras, palette,
-                    globals);  // Strokes get sorted here
+  {
+    // The palette could be shared with concurrent vectorizations
+    QMutexLocker paletteLocker(palette->mutex());
+    applyStrokeColors(sortibleResult, ras, palette,
+                      globals);  // Strokes get sorted here
+  }
   result = copyStrokes(sortibleResult);
 
   // Further misc adjustments
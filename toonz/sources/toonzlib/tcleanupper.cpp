@@ -18,6 +18,10 @@
 
 #include "toonz/tcleanupper.h"
 
+// Qt includes
+#include <QMutex>
+#include <QMutexLocker>
+
 using namespace CleanupTypes;
 
 /*  The Cleanup Process Reworked   -   EXPLANATION (by Daniele)
@@ -318,12 +322,20 @@ void transparencyCheck(const TRasterCM32P &cmin, const TRaster32P &rasout) {
 //**************************************************************************************
 
 TCleanupper *TCleanupper::instance() {
-  static TCleanupper theCleanupper;
+  static TCleanupper theCleanupper(true);
   return &theCleanupper;
 }
 
 //------------------------------------------------------------------------------------
 
+bool TCleanupper::isReentrant() const {
+  // Auto-adjust relies on the reference histogram taken from the first image
+  return !(m_parameters && m_parameters->m_lineProcessingMode == lpGrey &&
+           m_parameters->m_autoAdjustMode != AUTO_ADJ_NONE);
+}
+
+//------------------------------------------------------------------------------------
+
 void TCleanupper::setParameters(CleanupParameters *parameters) {
   m_parameters = parameters;
 }
@@ -578,7 +590,8 @@ CleanupPreprocessedImage *TCleanupper::process(
   bool isSameDpi    = false;
   bool autocentered = getResampleValues(image, aff, blur, outDim, outDpi,
                                         isCameraTest, isSameDpi);
-  if (m_parameters->m_autocenterType != AUTOCENTER_NONE && !autocentered)
+  if (m_notifyWarnings && m_parameters->m_autocenterType != AUTOCENTER_NONE &&
+      !autocentered)
     DVGui::warning(
         QObject::tr("The autocentering failed on the current drawing."));
 
@@ -904,6 +917,11 @@ bool TCleanupper::doAutocenter(
 
     const double xdpi, const double ydpi, const int raster_is_savebox,
     const TRect saveBox, const TRasterImageP &image, const double scalex) {
+  // The peg holes search in autopos.cpp works on global buffers - concurrent
+  // cleanup contexts have to take turns here
+  static QMutex autocenterMutex;
+  QMutexLocker locker(&autocenterMutex);
+
   double sigma = 0, theta = 0;
   FDG_INFO fdg_info = m_parameters->getFdgInfo();
 
@@ -5,6 +5,7 @@
 #include "tstream.h"
 #include "tthreadmessage.h"
 #include "tconvert.h"
+#include "tutil.h"
 #include "tstopwatch.h"
 #include "tlevel_io.h"
 #include "tflash.h"
@@ -726,6 +727,7 @@ class LevelFxBuilder final : public ResourceBuilder {
   bool m_64bit;
 
   TRect m_rasBounds;
+  TRect m_region;
 
 public:
   LevelFxBuilder(const std::string &resourceName, double frame,
@@ -739,11 +741,16 @@ public:
 
   void setRasBounds(const TRect &rasBounds) { m_rasBounds = rasBounds; }
 
+  //! Restricts loading to the specified image region (empty meaning the
+  //! whole image)
+  void setRegion(const TRect &region) { m_region = region; }
+
   void compute(const TRectD &tileRect) override {
     // Load the image
     TImageP img(m_sl->getFullsampledFrame(
         m_fid, (m_64bit ? ImageManager::is64bitEnabled : 0) |
-                   ImageManager::dontPutInCache));
+                   ImageManager::dontPutInCache,
+        m_region));
 
     if (!img) return;
 
@@ -754,6 +761,12 @@ public:
                        : timg ? (TRasterP)timg->getRaster() : TRasterP();
     assert(m_loadedRas);
 
+    // Images already available in full are returned whole
+    if (!m_region.isEmpty() && m_loadedRas->getSize() != m_region.getSize()) {
+      TRect region(m_region);
+      m_loadedRas = m_loadedRas->extract(region);
+    }
+
     if (timg) m_palette = timg->getPalette();
 
     assert(tileRect ==
@@ -795,6 +808,34 @@ public:
   }
 };
 
+//-------------------------------------------------------------------
+
+//! Returns the region of a fullcolor level image required to compute the
+//! specified tile, when it is worth loading alone - or an empty rect.
+static TRect getTileImageRegion(TXshSimpleLevel *sl,
+                                const TImageInfo &imageInfo,
+                                const TRectD &tileRectD, const TAffine &aff) {
+  // Levels whose images are processed as a whole must be loaded in full
+  if (sl->getType() != OVL_XSHLEVEL || TXshSimpleLevel::m_fillFullColorRaster ||
+      sl->getProperties()->antialiasSoftness() > 0)
+    return TRect();
+
+  TRectD rectD(tileRectD + TPointD(imageInfo.m_lx / 2.0 - aff.a13,
+                                   imageInfo.m_ly / 2.0 - aff.a23));
+  TRect region(tfloor(rectD.x0) - 1, tfloor(rectD.y0) - 1, tceil(rectD.x1),
+               tceil(rectD.y1));
+  region *= TRect(0, 0, imageInfo.m_lx - 1, imageInfo.m_ly - 1);
+
+  // Partial images are not shared among tiles - so, they are worth it only
+  // when much smaller than the whole image
+  if (region.getLx() < 2 || region.getLy() < 2 ||
+      2.0 * region.getLx() * region.getLy() >
+          (double)imageInfo.m_lx * imageInfo.m_ly)
+    return TRect();
+
+  return region;
+}
+
 //****************************************************************************************
 //    TLevelColumnFx  implementation
 //****************************************************************************************
@@ -979,19 +1020,41 @@ void TLevelColumnFx::doCompute(TTile &tile, double frame,
 
   TFrameId fid = cell.m_frameId;
 
+  // Extract the required geometry
+  TRect tileBounds(tile.getRaster()->getBounds());
+  TRectD tileRectD = TRectD(tileBounds.x0, tileBounds.y0, tileBounds.x1 + 1,
+                            tileBounds.y1 + 1) +
+                     tile.m_pos;
+
   TImageP img;
   TImageInfo imageInfo;
+  TRect region;
 
   // Now, fetch the image
   if (sl->getType() != PLI_XSHLEVEL) {
     // Raster case
-    LevelFxBuilder builder(getAlias(frame, TRenderSettings()) + "_image", frame,
-                           info, sl, fid);
-
     getImageInfo(imageInfo, sl, fid);
-    TRectD imgRect(0, 0, imageInfo.m_lx, imageInfo.m_ly);
 
-    builder.setRasBounds(TRect(0, 0, imageInfo.m_lx - 1, imageInfo.m_ly - 1));
+    // Big images seen through small tiles (eg zoomed-in background plates)
+    // are loaded just in the part the tile needs
+    region = getTileImageRegion(sl, imageInfo, tileRectD, info.m_affine);
+
+    std::string resourceName(getAlias(frame, TRenderSettings()) + "_image");
+    TRect rasBounds(0, 0, imageInfo.m_lx - 1, imageInfo.m_ly - 1);
+
+    if (!region.isEmpty()) {
+      resourceName += "_" + std::to_string(region.x0) + "_" +
+                      std::to_string(region.y0) + "_" +
+                      std::to_string(region.x1) + "_" +
+                      std::to_string(region.y1);
+      rasBounds = TRect(region.getSize());
+    }
+
+    LevelFxBuilder builder(resourceName, frame, info, sl, fid);
+    TRectD imgRect(0, 0, rasBounds.getLx(), rasBounds.getLy());
+
+    builder.setRasBounds(rasBounds);
+    builder.setRegion(region);
     builder.build(imgRect);
 
     img = builder.getImage();
@@ -1004,12 +1067,6 @@ void TLevelColumnFx::doCompute(TTile &tile, double frame,
     }
   }
 
-  // Extract the required geometry
-  TRect tileBounds(tile.getRaster()->getBounds());
-  TRectD tileRectD = TRectD(tileBounds.x0, tileBounds.y0, tileBounds.x1 + 1,
-                            tileBounds.y1 + 1) +
-                     tile.m_pos;
-
   // To be sure, if there is no image, return.
   if (!img) return;
 
@@ -1174,9 +1231,17 @@ void TLevelColumnFx::doCompute(TTile &tile, double frame,
     }
 
     if (ras) {
+      // Partially loaded images lie at their position in the whole image
+      TPoint rasPos;
       double lx_2 = ras->getLx() / 2.0;
       double ly_2 = ras->getLy() / 2.0;
 
+      if (!region.isEmpty()) {
+        rasPos = region.getP00();
+        lx_2   = imageInfo.m_lx / 2.0;
+        ly_2   = imageInfo.m_ly / 2.0;
+      }
+
       TRenderSettings infoAux(info);
       assert(info.m_affine.isTranslation());
       infoAux.m_data.clear();
@@ -1191,7 +1256,7 @@ void TLevelColumnFx::doCompute(TTile &tile, double frame,
         inTileRectD =
             TRectD(saveBox.x0, saveBox.y0, saveBox.x1 + 1, saveBox.y1 + 1);
       } else {
-        TRect rasBounds(ras->getBounds());
+        TRect rasBounds(ras->getBounds() + rasPos);
         inTileRectD = TRectD(rasBounds.x0, rasBounds.y0, rasBounds.x1 + 1,
                              rasBounds.y1 + 1);
       }
@@ -1206,6 +1271,7 @@ void TLevelColumnFx::doCompute(TTile &tile, double frame,
       // Output that intersection in the requested tile
       TRect inTileRect(tround(inTileRectD.x0), tround(inTileRectD.y0),
                        tround(inTileRectD.x1) - 1, tround(inTileRectD.y1) - 1);
+      inTileRect -= rasPos;
       TTile inTile(ras->extract(inTileRect),
                    inTileRectD.getP00() + TPointD(-lx_2, -ly_2));
 
@@ -31,6 +31,9 @@
 
 #undef INCLUDE_HPP
 
+// Qt includes
+#include <QMutexLocker>
+
 // STL includes
 #include <set>
 
@@ -753,8 +756,12 @@ void outlineVectorize(TVectorImageP &vi, const TRasterImageP &ri,
 
   TRop::copy(ras32, ras);
 
-  // Build palette color and discretize the raster
-  discretizeColors(ras32, palette, conf.m_maxColors, conf.m_transparentColor);
+  // Build palette color and discretize the raster. The palette could be
+  // shared with concurrent vectorizations.
+  {
+    QMutexLocker paletteLocker(palette->mutex());
+    discretizeColors(ras32, palette, conf.m_maxColors, conf.m_transparentColor);
+  }
 
   // Perform despeckling
   if (conf.m_despeckling > 0)
@@ -772,9 +779,11 @@ void outlineVectorize(TVectorImageP &vi, const TRasterImageP &ri,
   vi->transform(conf.m_affine);
   vi->findRegions();
 
-  if (!conf.m_leaveUnpainted)
+  if (!conf.m_leaveUnpainted) {
     // Finally, build region colors.
+    QMutexLocker paletteLocker(palette->mutex());
     buildColorsRGBM(vi, reader.scHash());
+  }
 }
 
 //-------------------------------------------------------------------
@@ -45,10 +45,13 @@
 #include "tcontenthistory.h"
 #include "toutputproperties.h"
 #include "trop.h"
+#include "tstopwatch.h"
 
 TOfflineGL *currentOfflineGL = 0;
 
 #include <QProgressDialog>
+#include <QThreadPool>
+#include <QRunnable>
 
 #ifdef MACOSX
 #include <QSurfaceFormat>
@@ -396,6 +399,52 @@ void ToonzScene::loadNoResources(const TFilePath &fp) {
   getXsheet()->updateFrameCount();
 }
 
+//-----------------------------------------------------------------------------
+
+namespace {
+
+class LevelPreloadTask final : public QRunnable {
+  TXshSimpleLevel *m_sl;
+  TUINT32 &m_time;
+
+public:
+  LevelPreloadTask(TXshSimpleLevel *sl, TUINT32 &time)
+      : m_sl(sl), m_time(time) {}
+
+  void run() override {
+    TStopWatch timer;
+    timer.start();
+
+    m_sl->preload();
+
+    m_time = timer.getTotalTime();
+  }
+};
+
+//-----------------------------------------------------------------------------
+
+//! Opens the files of the specified levels and reads their infos
+//! concurrently. That is mostly spent waiting on I/O, so more threads than
+//! cores are used.
+void preloadLevels(const std::vector<TXshSimpleLevel *> &levels,
+                   std::vector<TUINT32> &times) {
+  static const int minThreadsCount = 8;
+
+  times.assign(levels.size(), 0);
+  if (levels.size() < 2) return;
+
+  QThreadPool pool;
+  pool.setMaxThreadCount(
+      std::max(QThread::idealThreadCount(), minThreadsCount));
+
+  for (int i = 0; i < (int)levels.size(); ++i)
+    pool.start(new LevelPreloadTask(levels[i], times[i]));
+
+  pool.waitForDone();
+}
+
+}  // namespace
+
 //-----------------------------------------------------------------------------
 /*--
  * プログレスダイアログをGUIからの実行時でのみ表示させる。tcomposerから実行の場合は表示させない
@@ -417,15 +466,38 @@ void ToonzScene::loadResources(bool withProgressDialog) {
     progressDialog->show();
   }
 
-  int i;
-  for (i = 0; i < m_levelSet->getLevelCount(); i++) {
+  int i, levelsCount = m_levelSet->getLevelCount();
+
+  // The file accesses of independent levels are performed concurrently, while
+  // levels are still loaded in the level set order
+  std::vector<TXshSimpleLevel *> simpleLevels;
+  for (i = 0; i < levelsCount; i++)
+    if (TXshSimpleLevel *sl = m_levelSet->getLevel(i)->getSimpleLevel())
+      simpleLevels.push_back(sl);
+
+  std::vector<TUINT32> preloadTimes;
+  preloadLevels(simpleLevels, preloadTimes);
+
+  int s = 0;
+  for (i = 0; i < levelsCount; i++) {
     if (progressDialog) progressDialog->setValue(i + 1);
 
     TXshLevel *level = m_levelSet->getLevel(i);
+
+    TStopWatch timer;
+    timer.start();
+
     try {
       level->load();
     } catch (...) {
     }
+
+    if (level->getSimpleLevel() && s < (int)preloadTimes.size()) {
+      TUINT32 preloadTime = preloadTimes[s++];
+      TLogger::info() << "Loaded " << level->getPath() << " in "
+                      << (int)(preloadTime + timer.getTotalTime()) << " ms ("
+                      << (int)preloadTime << " ms reading files)";
+    }
   }
   getXsheet()->updateFrameCount();
 }
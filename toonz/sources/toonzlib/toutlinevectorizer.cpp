@@ -16,6 +16,9 @@
 // tcg includes
 #include "tcg/tcg_numeric_ops.h"
 
+// Qt includes
+#include <QMutexLocker>
+
 // STD includes
 #include <cmath>
 #include <functional>
@@ -1535,6 +1538,9 @@ TVectorImageP VectorizerCore::vectorize(const TImageP &img,
         }
       }
 
+      // Fill colors may add styles to the palette, which could be shared with
+      // concurrent vectorizations
+      QMutexLocker paletteLocker(plt ? plt->mutex() : 0);
       applyFillColors(vi, img2, plt, c);
     }
   }
@@ -1545,7 +1551,7 @@ TVectorImageP VectorizerCore::vectorize(const TImageP &img,
 //-----------------------------------------------------------------
 
 void VectorizerCore::emitPartialDone(void) {
-  emit partialDone(m_currPartial++, m_totalPartials);
+  emit partialDone(m_currPartial.fetchAndAddRelaxed(1), m_totalPartials);
 }
 
 //-----------------------------------------------------------------
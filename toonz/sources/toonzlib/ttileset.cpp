@@ -5,6 +5,41 @@
 #include "timagecache.h"
 #include "ttoonzimage.h"
 #include "trasterimage.h"
+#include "tthread.h"
+
+//------------------------------------------------------------------------------------------
+
+namespace {
+
+// Tiles are mostly stored for undo, and are seldom read back. They are
+// compressed in the cache as soon as they are added, on a background thread
+// so that tools do not stall while painting.
+class TileCompressor final : public TThread::Runnable {
+  std::string m_id;
+
+public:
+  TileCompressor(const std::string &id) : m_id(id) {}
+
+  // The tile may have been deleted in the meantime: compressing a missing id
+  // does nothing.
+  void run() override { TImageCache::instance()->compress(m_id); }
+};
+
+//------------------------------------------------------------------------------------------
+
+struct TileCompressorExecutor final : public TThread::Executor {
+  TileCompressorExecutor() { setMaxActiveTasks(1); }
+};
+
+//------------------------------------------------------------------------------------------
+
+void compressTile(const TTileSet::Tile *tile) {
+  static TileCompressorExecutor executor;
+  executor.addTask(new TileCompressor(tile->id().toStdString()));
+}
+
+}  // namespace
+
 //------------------------------------------------------------------------------------------
 
 TTileSet::Tile::Tile() : m_rasterBounds(TRect()), m_dim(), m_pixelSize(0) {}
@@ -26,7 +61,10 @@ TTileSet::~TTileSet() { clearPointerContainer(m_tiles); }
 
 //------------------------------------------------------------------------------------------
 
-void TTileSet::add(Tile *tile) { m_tiles.push_back(tile); }
+void TTileSet::add(Tile *tile) {
+  m_tiles.push_back(tile);
+  compressTile(tile);
+}
 
 //------------------------------------------------------------------------------------------
 
@@ -49,10 +87,15 @@ TRect TTileSet::getBBox() const {
 
 //------------------------------------------------------------------------------------------
 
+// Returns the size actually taken by the tiles in the cache, that is their
+// compressed size once compressed, and the swap file size for tiles shipped to
+// disk - the undo budget must bound those too.
 int TTileSet::getMemorySize() const {
-  int i, size = 0;
+  TImageCache *cache = TImageCache::instance();
+  int i, size        = 0;
   for (i = 0; i < m_tiles.size(); i++) {
-    size += m_tiles[i]->getSize();
+    std::string id(m_tiles[i]->id().toStdString());
+    size += cache->getMemUsage(id) + cache->getDiskUsage(id);
   }
   return size;
 }
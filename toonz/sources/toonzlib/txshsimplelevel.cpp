@@ -607,12 +607,22 @@ TImageP TXshSimpleLevel::getFrameIcon(const TFrameId &fid) const {
   // NOTE: Icons caching is DISABLED at this stage. It is now responsibility of
   // ToonzQt's IconGenerator class.
 
-  ImageLoader::BuildExtData extData(this, fid);
-  extData.m_subs = 1, extData.m_icon = true;
-
   const std::string &imgId = getImageId(fid);
-  TImageP img              = ImageManager::instance()->getImage(
-      imgId, ImageManager::dontPutInCache, &extData);
+
+  TImageP img;
+
+  // If the full image is already decoded, scale it down instead of reading
+  // the frame (or its embedded icon) again - whatever its subsampling.
+  if (ImageManager::instance()->isCached(imgId))
+    img = TImageCache::instance()->get(imgId, false);
+
+  if (!img) {
+    ImageLoader::BuildExtData extData(this, fid);
+    extData.m_subs = 1, extData.m_icon = true;
+
+    img = ImageManager::instance()->getImage(
+        imgId, ImageManager::dontPutInCache, &extData);
+  }
 
   TToonzImageP timg = (TToonzImageP)img;
   if (timg && m_palette) timg->setPalette(m_palette);
@@ -667,7 +677,8 @@ TRasterImageP TXshSimpleLevel::getFrameToCleanup(const TFrameId &fid) const {
 //-----------------------------------------------------------------------------
 
 TImageP TXshSimpleLevel::getFullsampledFrame(const TFrameId &fid,
-                                             UCHAR imFlags) const {
+                                             UCHAR imFlags,
+                                             const TRect &region) const {
   assert(m_type != UNKNOWN_XSHLEVEL);
 
   FramesSet::const_iterator it = m_frames.find(fid);
@@ -676,6 +687,8 @@ TImageP TXshSimpleLevel::getFullsampledFrame(const TFrameId &fid,
   std::string imageId = getImageId(fid);
 
   ImageLoader::BuildExtData extData(this, fid, 1);
+  extData.m_region = region;
+
   TImageP img = ImageManager::instance()->getImage(imageId, imFlags, &extData);
 
   if (imFlags & ImageManager::toBeModified) {
@@ -1063,6 +1076,101 @@ static TFilePath getLevelPathAndSetNameWithPsdLevelName(
 
   return retfp;
 }
+
+//-----------------------------------------------------------------------------
+
+struct TXshSimpleLevel::PreloadData {
+  //! What load() reads from a level file. The reader itself is released
+  //! right away: some (like tlv ones) keep their file open until destroyed,
+  //! and a scene may hold more levels than the open files limit.
+  struct Info {
+    TLevelP m_level;
+    QString m_creator;
+    std::unique_ptr<TContentHistory> m_contentHistory;
+    bool m_hasImageInfo;  //!< Whether the first frame's info was read
+    int m_samplePerPixel, m_bitsPerSample;
+
+    Info() : m_hasImageInfo(false), m_samplePerPixel(0), m_bitsPerSample(0) {}
+  };
+
+  std::map<TFilePath, Info> m_infos;  //!< Infos by decoded path
+  TFilePath m_decodedPath;            //!< Decoded level path
+  TFilePath m_hookFile;
+
+  //! Reads the infos of the specified level file, and optionally its first
+  //! frame's image info.
+  static void readInfo(const TFilePath &path, bool withImageInfo, Info &info) {
+    TLevelReaderP lr(path);  // May throw
+    assert(lr);
+
+    info.m_level   = lr->loadInfo();
+    info.m_creator = lr->getCreator();
+    info.m_contentHistory.reset(
+        lr->getContentHistory() ? lr->getContentHistory()->clone() : 0);
+
+    if (withImageInfo && info.m_level->getFrameCount() > 0) {
+      const TImageInfo *imageInfo =
+          lr->getImageInfo(info.m_level->begin()->first);
+      if (imageInfo) {
+        info.m_hasImageInfo   = true;
+        info.m_samplePerPixel = imageInfo->m_samplePerPixel;
+        info.m_bitsPerSample  = imageInfo->m_bitsPerSample;
+      }
+    }
+  }
+
+  //! Returns the infos of the specified level file - either as already read
+  //! by preload(), or reading them now.
+  static void openLevel(PreloadData *data, const TFilePath &path,
+                        bool withImageInfo, Info &info) {
+    if (data) {
+      std::map<TFilePath, Info>::iterator it = data->m_infos.find(path);
+      if (it != data->m_infos.end()) {
+        info = std::move(it->second);
+        data->m_infos.erase(it);
+        return;
+      }
+    }
+
+    readInfo(path, withImageInfo, info);  // May throw
+  }
+};
+
+//-----------------------------------------------------------------------------
+
+void TXshSimpleLevel::preload() {
+  if (!getScene()) return;
+
+  // Old psd level paths are fixed up by load()
+  if (m_path.getType() == "psd") return;
+
+  std::unique_ptr<PreloadData> preloadData(new PreloadData);
+  preloadData->m_decodedPath = getScene()->decodeFilePath(m_path);
+
+  TFilePath paths[2] = {preloadData->m_decodedPath, TFilePath()};
+  if (m_scannedPath != TFilePath())
+    paths[1] = getScene()->decodeFilePath(m_scannedPath);
+
+  for (int i = 0; i < 2; ++i) {
+    if (paths[i] == TFilePath()) continue;
+
+    try {
+      // load() checks the first frame's info of non-scanned levels only
+      PreloadData::Info info;
+      PreloadData::readInfo(paths[i], m_scannedPath == TFilePath(), info);
+
+      preloadData->m_infos[paths[i]] = std::move(info);
+    } catch (...) {
+      // load() will report the error
+    }
+  }
+
+  preloadData->m_hookFile =
+      TXshSimpleLevel::getExistingHookFile(preloadData->m_decodedPath);
+
+  m_preloadData = std::move(preloadData);
+}
+
 //-----------------------------------------------------------------------------
 
 // Nota: load() NON fa clearFrames(). si limita ad aggiungere le informazioni
@@ -1074,6 +1182,9 @@ void TXshSimpleLevel::load() {
   assert(getScene());
   if (!getScene()) return;
 
+  // Take any data read in advance by preload()
+  std::unique_ptr<PreloadData> preloadData(std::move(m_preloadData));
+
   m_isSubsequence = loadingLevelRange.isEnabled();
 
   TFilePath checkpath = getScene()->decodeFilePath(m_path);
@@ -1086,10 +1197,10 @@ void TXshSimpleLevel::load() {
     static const int ScannedCleanuppedMask = Scanned | Cleanupped;
     TFilePath path = getScene()->decodeFilePath(m_scannedPath);
     if (TSystem::doesExistFileOrLevel(path)) {
-      TLevelReaderP lr(path);
-      assert(lr);
-      TLevelP level = lr->loadInfo();
-      if (!checkCreatorString(creator = lr->getCreator()))
+      PreloadData::Info info;
+      PreloadData::openLevel(preloadData.get(), path, false, info);
+      TLevelP level = info.m_level;
+      if (!checkCreatorString(creator = info.m_creator))
         getProperties()->setIsForbidden(true);
       else
         for (TLevel::Iterator it = level->begin(); it != level->end(); it++) {
@@ -1103,14 +1214,14 @@ void TXshSimpleLevel::load() {
 
     path = getScene()->decodeFilePath(m_path);
     if (TSystem::doesExistFileOrLevel(path)) {
-      TLevelReaderP lr(path);
-      assert(lr);
-      TLevelP level = lr->loadInfo();
+      PreloadData::Info info;
+      PreloadData::openLevel(preloadData.get(), path, false, info);
+      TLevelP level = info.m_level;
       if (getType() & FULLCOLOR_TYPE)
         setPalette(FullColorPalette::instance()->getPalette(getScene()));
       else
         setPalette(level->getPalette());
-      if (!checkCreatorString(creator = lr->getCreator()))
+      if (!checkCreatorString(creator = info.m_creator))
         getProperties()->setIsForbidden(true);
       else
         for (TLevel::Iterator it = level->begin(); it != level->end(); it++) {
@@ -1119,8 +1230,7 @@ void TXshSimpleLevel::load() {
           setFrameStatus(fid, getFrameStatus(fid) | Cleanupped);
           setFrame(fid, TImageP());
         }
-      setContentHistory(
-          lr->getContentHistory() ? lr->getContentHistory()->clone() : 0);
+      setContentHistory(info.m_contentHistory.release());
     }
 
   } else {
@@ -1135,14 +1245,11 @@ void TXshSimpleLevel::load() {
     getProperties()->setDirtyFlag(
         false);  // Level is now supposedly loaded from disk
 
-    TLevelReaderP lr(path);  // May throw
-    assert(lr);
-
-    TLevelP level = lr->loadInfo();
-    if (level->getFrameCount() > 0) {
-      const TImageInfo *info = lr->getImageInfo(level->begin()->first);
-
-      if (info && info->m_samplePerPixel >= 5) {
+    PreloadData::Info info;
+    PreloadData::openLevel(preloadData.get(), path, true, info);  // May throw
+    TLevelP level = info.m_level;
+    if (info.m_hasImageInfo) {
+      if (info.m_samplePerPixel >= 5) {
         QString msg = QString(
                           "Failed to open %1.\nSamples per pixel is more than "
                           "4. It may contain more than one alpha channel.")
@@ -1151,14 +1258,14 @@ void TXshSimpleLevel::load() {
         return;
       }
 
-      if (info) set16BitChannelLevel(info->m_bitsPerSample == 16);
+      set16BitChannelLevel(info.m_bitsPerSample == 16);
     }
     if ((getType() & FULLCOLOR_TYPE) && !is16BitChannelLevel())
       setPalette(FullColorPalette::instance()->getPalette(getScene()));
     else
       setPalette(level->getPalette());
 
-    if (!checkCreatorString(creator = lr->getCreator()))
+    if (!checkCreatorString(creator = info.m_creator))
       getProperties()->setIsForbidden(true);
     else
       for (TLevel::Iterator it = level->begin(); it != level->end(); it++) {
@@ -1169,8 +1276,7 @@ void TXshSimpleLevel::load() {
         setFrame(it->first, TImageP());
       }
 
-    setContentHistory(lr->getContentHistory() ? lr->getContentHistory()->clone()
-                                              : 0);
+    setContentHistory(info.m_contentHistory.release());
   }
   getProperties()->setCreator(creator.toStdString());
 
@@ -1254,8 +1360,11 @@ void TXshSimpleLevel::load() {
   HookSet *hookSet = getHookSet();
   hookSet->clearHooks();
 
+  TFilePath decodedPath = getScene()->decodeFilePath(m_path);
   const TFilePath &hookFile =
-      TXshSimpleLevel::getExistingHookFile(getScene()->decodeFilePath(m_path));
+      (preloadData && preloadData->m_decodedPath == decodedPath)
+          ? preloadData->m_hookFile
+          : TXshSimpleLevel::getExistingHookFile(decodedPath);
 
   if (!hookFile.isEmpty()) {
     TIStream is(hookFile);
@@ -19,6 +19,7 @@
 #include "tconvert.h"
 #include "timagecache.h"
 #include "trop.h"
+#include "tutil.h"
 
 #include "../toonz/tapp.h"
 
@@ -142,7 +143,8 @@ bool FlipConsole::m_areLinked       = false;
 
 //==========================================================================================
 
-PlaybackExecutor::PlaybackExecutor() : m_fps(25), m_abort(false) {}
+PlaybackExecutor::PlaybackExecutor()
+    : m_fps(25), m_abort(false), m_dropFrames(false) {}
 
 //-----------------------------------------------------------------------------
 
@@ -190,9 +192,21 @@ void PlaybackExecutor::run() {
   while (!m_abort) {
     emissionInstant = timer.getTotalTime();
 
+    // In case the frames emission is late by whole frame times, drop those
+    // frames rather than slowing down the playback
+    int droppedFrames = 0;
+    if (m_dropFrames && playedFramesCount) {
+      double lateness = emissionInstant - emissionInstantD;
+      if (lateness >= targetFrameTime) {
+        droppedFrames = (int)(lateness / targetFrameTime);
+        emissionInstantD += droppedFrames * targetFrameTime;
+      }
+    }
+
     // Draw the next frame
-    if (playedFramesCount) emit nextFrame(fps);  // Show the next frame, telling
-                                                 // currently measured fps
+    if (playedFramesCount)
+      emit nextFrame(fps, droppedFrames);  // Show the next frame, telling
+                                           // currently measured fps
 
     if (FlipConsole::m_areLinked) {
       // In case there are linked consoles, update them too.
@@ -201,7 +215,8 @@ void PlaybackExecutor::run() {
       for (i = 0; i < consolesCount; ++i) {
         FlipConsole *console = FlipConsole::m_visibleConsoles.at(i);
         if (console->isLinkable() && console != FlipConsole::m_currentConsole)
-          console->playbackExecutor().emitNextFrame(m_fps < 0 ? -fps : fps);
+          console->playbackExecutor().emitNextFrame(m_fps < 0 ? -fps : fps,
+                                                    droppedFrames);
       }
     }
 
@@ -260,6 +275,127 @@ void PlaybackExecutor::run() {
 
 //==========================================================================================
 
+class PlaybackPrefetcher::Task final : public QRunnable {
+  PlaybackPrefetcher *m_prefetcher;
+  int m_frame, m_generation;
+  std::function<void()> m_job;
+
+public:
+  Task(PlaybackPrefetcher *prefetcher, int frame, int generation,
+       const std::function<void()> &job)
+      : m_prefetcher(prefetcher)
+      , m_frame(frame)
+      , m_generation(generation)
+      , m_job(job) {}
+
+  void run() override;
+};
+
+//-----------------------------------------------------------------------------
+
+void PlaybackPrefetcher::Task::run() {
+  {
+    QMutexLocker locker(&m_prefetcher->m_mutex);
+    // Skip stale requests - like frames that have been played or dropped
+    // in the meantime
+    if (m_generation != m_prefetcher->m_generation ||
+        !m_prefetcher->m_requestedFrames.count(m_frame))
+      return;
+
+    m_prefetcher->m_decodingFrames.insert(m_frame);
+  }
+
+  TStopWatch timer;
+  timer.start();
+
+  try {
+    m_job();
+  } catch (...) {
+  }
+
+  double decodeTime = timer.getTotalTime();
+
+  QMutexLocker locker(&m_prefetcher->m_mutex);
+
+  m_prefetcher->m_decodingFrames.erase(m_frame);
+  m_prefetcher->m_decodeTime =
+      0.8 * m_prefetcher->m_decodeTime + 0.2 * decodeTime;
+
+  m_prefetcher->m_frameDecoded.wakeAll();
+}
+
+//==========================================================================================
+
+PlaybackPrefetcher::PlaybackPrefetcher(FlipConsoleOwner *owner)
+    : m_owner(owner), m_generation(0), m_decodeTime(0.0) {
+  // Leave a core to the main thread, which draws the decoded frames
+  m_pool.setMaxThreadCount(std::max(QThread::idealThreadCount() - 1, 1));
+}
+
+//-----------------------------------------------------------------------------
+
+PlaybackPrefetcher::~PlaybackPrefetcher() { cancel(true); }
+
+//-----------------------------------------------------------------------------
+
+int PlaybackPrefetcher::getLookAhead(int fps) {
+  static const int maxLookAhead = 32;
+
+  QMutexLocker locker(&m_mutex);
+
+  // Decoded frames must be ready when shown - look ahead of the frames played
+  // while one is being decoded, plus one frame for each worker
+  int lookAhead = tceil(m_decodeTime * abs(fps) / 1000.0) +
+                  m_pool.maxThreadCount();
+
+  return tcrop(lookAhead, 1, maxLookAhead);
+}
+
+//-----------------------------------------------------------------------------
+
+void PlaybackPrefetcher::prefetch(
+    const std::vector<int> &frames,
+    const ImagePainter::VisualSettings &settings) {
+  QMutexLocker locker(&m_mutex);
+
+  std::set<int> requestedFrames(frames.begin(), frames.end());
+
+  int i, framesCount = frames.size();
+  for (i = 0; i < framesCount; ++i) {
+    if (m_requestedFrames.count(frames[i])) continue;
+
+    // The owner's data is gathered here, in the main thread
+    std::function<void()> job = m_owner->getPrefetchJob(frames[i], settings);
+    if (job)
+      m_pool.start(new Task(this, frames[i], m_generation, job),
+                   framesCount - i);
+  }
+
+  m_requestedFrames.swap(requestedFrames);
+}
+
+//-----------------------------------------------------------------------------
+
+void PlaybackPrefetcher::waitForFrame(int frame) {
+  QMutexLocker locker(&m_mutex);
+  while (m_decodingFrames.count(frame)) m_frameDecoded.wait(&m_mutex);
+}
+
+//-----------------------------------------------------------------------------
+
+void PlaybackPrefetcher::cancel(bool waitRunning) {
+  {
+    QMutexLocker locker(&m_mutex);
+    ++m_generation;
+    m_requestedFrames.clear();
+  }
+
+  m_pool.clear();
+  if (waitRunning) m_pool.waitForDone();
+}
+
+//==========================================================================================
+
 FlipSlider::FlipSlider(QWidget *parent)
     : QAbstractSlider(parent), m_enabled(false), m_progressBarStatus(0) {
   setObjectName("FlipSlider");
@@ -457,6 +593,7 @@ FlipConsole::FlipConsole(QVBoxLayout *mainLayout, std::vector<int> gadgetsMask,
     , m_markerFrom(0)
     , m_markerTo(-1)
     , m_playbackExecutor()
+    , m_droppedFramesCount(0)
     , m_drawBlanksEnabled(enableBlanks)
     , m_blanksCount(0)
     , m_blankColor(TPixel::Transparent)
@@ -525,8 +662,8 @@ FlipConsole::FlipConsole(QVBoxLayout *mainLayout, std::vector<int> gadgetsMask,
 
   applyCustomizeMask();
 
-  bool ret = connect(&m_playbackExecutor, SIGNAL(nextFrame(int)), this,
-                     SLOT(onNextFrame(int)), Qt::BlockingQueuedConnection);
+  bool ret = connect(&m_playbackExecutor, SIGNAL(nextFrame(int, int)), this,
+                     SLOT(onNextFrame(int, int)), Qt::BlockingQueuedConnection);
 
   assert(ret);
 
@@ -770,22 +907,27 @@ bool FlipConsole::drawBlanks(int from, int to) {
 
 //----------------------------------------------------------------------------
 
-void FlipConsole::onNextFrame(int fps) {
+void FlipConsole::onNextFrame(int fps, int droppedFrames) {
   if (fps < 0)  // can be negative only if is a linked console; it means that
                 // the master console is playing backward
   {
     bool reverse = m_reverse;
     m_reverse    = true;
     fps          = -fps;
-    playNextFrame();
+    playNextFrame(droppedFrames);
     m_reverse = reverse;
   } else
-    playNextFrame();
+    playNextFrame(droppedFrames);
 
   if (fps == -1) return;
-  if (m_fpsLabel)
+  if (m_fpsLabel) {
     m_fpsLabel->setText(tr(" FPS ") + QString::number(fps * tsign(m_fps)) +
                         "/");
+    m_fpsLabel->setToolTip(
+        m_droppedFramesCount
+            ? tr("%1 frames dropped").arg(m_droppedFramesCount)
+            : QString());
+  }
   if (m_fpsField) {
     if (fps == abs(m_fps))
       m_fpsField->setLineEditBackgroundColor(Qt::green);
@@ -796,7 +938,7 @@ void FlipConsole::onNextFrame(int fps) {
 
 //----------------------------------------------------------------------------
 
-void FlipConsole::playNextFrame() {
+void FlipConsole::playNextFrame(int droppedFrames) {
   int from = m_from, to = m_to;
   if (m_markerFrom <= m_markerTo) from = m_markerFrom, to = m_markerTo;
 
@@ -811,6 +953,16 @@ void FlipConsole::playNextFrame() {
   } else {
     if (drawBlanks(from, to)) return;
 
+    // Skip the dropped frames, leaving at least one frame to advance to
+    for (; droppedFrames > 0; --droppedFrames) {
+      int frame = m_reverse ? m_currentFrame - 2 * m_step
+                            : m_currentFrame + 2 * m_step;
+      if (frame < from || frame > to) break;
+
+      m_currentFrame += m_reverse ? -m_step : m_step;
+      ++m_droppedFramesCount;
+    }
+
     if (m_reverse)
       m_currentFrame =
           ((m_currentFrame - m_step < from) ? to : m_currentFrame - m_step);
@@ -823,7 +975,65 @@ void FlipConsole::playNextFrame() {
   m_editCurrFrame->setText(QString::number(m_currentFrame));
   m_settings.m_blankColor        = TPixel::Transparent;
   m_settings.m_recomputeIfNeeded = true;
+
+  if (m_prefetcher) m_prefetcher->waitForFrame(m_currentFrame);
   m_consoleOwner->onDrawFrame(m_currentFrame, m_settings);
+
+  if (m_playbackExecutor.isRunning() || m_isLinkedPlaying)
+    prefetchNextFrames();
+}
+
+//-----------------------------------------------------------------------------
+
+void FlipConsole::enablePrefetch(bool enable) {
+  if (enable == (bool)m_prefetcher) return;
+
+  if (enable)
+    m_prefetcher.reset(new PlaybackPrefetcher(m_consoleOwner));
+  else
+    m_prefetcher.reset();
+
+  m_playbackExecutor.enableFrameDropping(enable);
+}
+
+//-----------------------------------------------------------------------------
+
+//! Drops the frames requested to be decoded ahead, and waits for the ones
+//! being decoded. Owners call it when the content of their frames changes,
+//! so that no stale image is cached afterwards.
+void FlipConsole::cancelPrefetch() {
+  if (m_prefetcher) m_prefetcher->cancel(true);
+}
+
+//-----------------------------------------------------------------------------
+
+void FlipConsole::prefetchNextFrames() {
+  if (!m_prefetcher || m_framesCount <= 1) return;
+
+  int from = m_from, to = m_to;
+  if (m_markerFrom <= m_markerTo) from = m_markerFrom, to = m_markerTo;
+
+  int lookAhead = m_prefetcher->getLookAhead(m_fps);
+
+  // Follow the playback direction, wrapping around the range when looping
+  std::vector<int> frames;
+  int i, frame = m_currentFrame;
+  for (i = 0; i < lookAhead; ++i) {
+    frame += m_reverse ? -m_step : m_step;
+    if (frame < from || frame > to) {
+      if (m_isPlay) break;
+      frame = m_reverse ? to : from;
+    }
+
+    if (frame == m_currentFrame) break;
+    frames.push_back(frame);
+  }
+
+  ImagePainter::VisualSettings settings(m_settings);
+  settings.m_blankColor     = TPixel::Transparent;
+  settings.m_drawBlankFrame = false;
+
+  m_prefetcher->prefetch(frames, settings);
 }
 
 //-----------------------------------------------------------------------------
@@ -1505,7 +1715,8 @@ void FlipConsole::doButtonPressed(UINT button) {
     if (!m_playbackExecutor.isRunning()) m_playbackExecutor.start();
     m_isLinkedPlaying = linked;
 
-    m_reverse = (m_fps < 0);
+    m_reverse            = (m_fps < 0);
+    m_droppedFramesCount = 0;
 
     if (!linked) {
       // if the play button pressed at the end frame, then go back to the start
@@ -1518,6 +1729,8 @@ void FlipConsole::doButtonPressed(UINT button) {
       m_consoleOwner->onDrawFrame(m_currentFrame, m_settings);
     }
 
+    prefetchNextFrames();
+
     emit playStateChanged(true);
     return;
 
@@ -1527,6 +1740,7 @@ void FlipConsole::doButtonPressed(UINT button) {
     m_isLinkedPlaying = false;
 
     if (m_playbackExecutor.isRunning()) m_playbackExecutor.abort();
+    if (m_prefetcher) m_prefetcher->cancel(true);
 
     m_isPlay       = false;
     m_blanksToDraw = 0;
@@ -1751,6 +1965,8 @@ void FlipConsole::setFrameRange(int from, int to, int step, int current) {
     m_currFrameSlider->setRange(m_from, m_to);
     m_currFrameSlider->setSingleStep(m_step);
     m_currFrameSlider->blockSignals(false);
+
+    if (m_prefetcher) m_prefetcher->cancel();
   }
 
   if (m_playbackExecutor.isRunning() ||
@@ -1842,6 +2058,9 @@ void FlipConsole::OnSetCurrentFrame(int index) {
 
   int deltaFrame = index - m_currentFrame;
 
+  // Scrubbing makes frames requested ahead stale
+  if (m_prefetcher) m_prefetcher->cancel();
+
   m_currentFrame = index;
 
   assert(m_currentFrame <= m_to);
@@ -1860,7 +2079,10 @@ void FlipConsole::OnSetCurrentFrame(int index) {
 //--------------------------------------------------------------------
 
 void FlipConsole::setCurrentFrame(int frame, bool forceResetting) {
-  m_currentFrame = (frame == -1) ? m_from : frame;
+  if (frame == -1) frame = m_from;
+  if (m_prefetcher && frame != m_currentFrame) m_prefetcher->cancel();
+
+  m_currentFrame = frame;
   if ((m_playbackExecutor.isRunning() || m_isLinkedPlaying) &&
       !forceResetting)  // if in playing mode, the slider and the frame field
                         // are already set in the timer!
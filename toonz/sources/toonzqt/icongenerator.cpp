@@ -38,12 +38,23 @@
 #include "toonz/preferences.h"
 #include "toonz/sceneresources.h"
 #include "toonz/stage2.h"
+#include "toonz/toonzfolders.h"
 
 // TnzQt includes
 #include "toonzqt/gutil.h"
 
 #include "toonzqt/icongenerator.h"
 
+// Qt includes
+#include <QThread>
+#include <QFileInfo>
+#include <QDir>
+#include <QSaveFile>
+#include <QCryptographicHash>
+
+// STD includes
+#include <atomic>
+
 //=============================================================================
 
 //===================================
@@ -60,6 +71,24 @@ TDimension FilmstripIconSize(0, 0);
 std::set<std::string> iconsMap;
 typedef std::set<std::string>::iterator IconIterator;
 
+// Requests submitted to the executor and not yet completed, by icon id
+std::map<std::string, TThread::RunnableP> pendingRequests;
+
+// Stamp of the latest icon request. Newer requests are scheduled first, since
+// they typically come from the widgets' latest paint events.
+std::atomic<unsigned int> requestsCount(0);
+
+// Requests which were not repeated in this many newer ones are dropped
+const unsigned int MaxRequestAge = 512;
+
+//-----------------------------------------------------------------------------
+
+int iconWorkersCount() {
+  static const int count =
+      std::min(4, std::max(1, QThread::idealThreadCount() / 2));
+  return count;
+}
+
 //-----------------------------------------------------------------------------
 
 // Returns true if the image request was already submitted.
@@ -448,6 +477,10 @@ class IconRenderer : public TThread::Runnable {
 
   bool m_started;
   bool m_terminated;
+  bool m_dropped;
+
+  std::atomic<unsigned int> m_lastRequest;
+  int m_priority;
 
 public:
   IconRenderer(const std::string &id, const TDimension &iconSize);
@@ -455,6 +488,24 @@ public:
 
   void run() override = 0;
 
+  int taskLoad() override { return 1; }
+  int schedulingPriority() override { return m_priority; }
+
+  void setRequest(unsigned int request) {
+    m_lastRequest = request;
+    m_priority    = int(request & 0x3fffffff);
+  }
+  void touch(unsigned int request) { m_lastRequest = request; }
+
+  //! Returns true if the icon was not requested again while many newer icons
+  //! were - typically, because it scrolled out of view. Such requests are
+  //! dropped, and submitted again if the icon is requested again.
+  bool isOutdated() {
+    m_dropped = requestsCount - m_lastRequest > MaxRequestAge;
+    return m_dropped;
+  }
+  bool wasDropped() const { return m_dropped; }
+
   void setIcon(const TRaster32P &icon) { m_icon = icon; }
   TRaster32P getIcon() const { return m_icon; }
 
@@ -472,7 +523,10 @@ IconRenderer::IconRenderer(const std::string &id, const TDimension &iconSize)
     , m_iconSize(iconSize)
     , m_id(id)
     , m_started(false)
-    , m_terminated(false) {
+    , m_terminated(false)
+    , m_dropped(false)
+    , m_lastRequest(0)
+    , m_priority(0) {
   connect(this, SIGNAL(started(TThread::RunnableP)), IconGenerator::instance(),
           SLOT(onStarted(TThread::RunnableP)));
   connect(this, SIGNAL(finished(TThread::RunnableP)), IconGenerator::instance(),
@@ -488,6 +542,35 @@ IconRenderer::IconRenderer(const std::string &id, const TDimension &iconSize)
 
 IconRenderer::~IconRenderer() {}
 
+//-----------------------------------------------------------------------------
+
+namespace {
+
+// Marks a pending icon request as still needed
+void touchRequest(const std::string &id) {
+  std::map<std::string, TThread::RunnableP>::iterator it =
+      pendingRequests.find(id);
+  if (it != pendingRequests.end())
+    static_cast<IconRenderer *>(it->second.getPointer())
+        ->touch(++requestsCount);
+}
+
+//-----------------------------------------------------------------------------
+
+// Removes a completed request from the pending ones. Returns false if a newer
+// request for the same icon was submitted in the meantime.
+bool releaseRequest(IconRenderer *ir) {
+  std::map<std::string, TThread::RunnableP>::iterator it =
+      pendingRequests.find(ir->getId());
+  if (it == pendingRequests.end() || it->second.getPointer() != ir)
+    return false;
+
+  pendingRequests.erase(it);
+  return true;
+}
+
+}  // namespace
+
 //=============================================================================
 
 //===================================
@@ -558,6 +641,8 @@ TRaster32P VectorImageIconRenderer::generateRaster(
 //-----------------------------------------------------------------------------
 
 void VectorImageIconRenderer::run() {
+  if (isOutdated()) return;
+
   try {
     TRaster32P ras(generateRaster(getIconSize()));
 
@@ -651,7 +736,7 @@ public:
 //-----------------------------------------------------------------------------
 
 void RasterImageIconRenderer::run() {
-  if (!m_sl->isFid(m_fid)) return;
+  if (isOutdated() || !m_sl->isFid(m_fid)) return;
 
   TImageP image = m_sl->getFrameIcon(m_fid);
   if (!image) return;
@@ -696,7 +781,7 @@ public:
 //-----------------------------------------------------------------------------
 
 void ToonzImageIconRenderer::run() {
-  if (!m_sl->isFid(m_fid)) return;
+  if (isOutdated() || !m_sl->isFid(m_fid)) return;
 
   TImageP image = m_sl->getFrameIcon(m_fid);
   if (!image) return;
@@ -833,6 +918,8 @@ TRaster32P MeshImageIconRenderer::generateRaster(
 //-----------------------------------------------------------------------------
 
 void MeshImageIconRenderer::run() {
+  if (isOutdated()) return;
+
   try {
     TRaster32P ras(generateRaster(getIconSize()));
 
@@ -871,6 +958,10 @@ public:
 
   TRaster32P generateRaster(const TDimension &iconSize) const;
   void run() override;
+
+  // Rendering an xsheet touches global state (see generateRaster()) - so,
+  // these icons are rendered while no other icon is.
+  int taskLoad() override { return iconWorkersCount(); }
 };
 
 //-----------------------------------------------------------------------------
@@ -1148,13 +1239,130 @@ TRaster32P IconGenerator::generateSceneFileIcon(const TFilePath &path,
 
 //-----------------------------------------------------------------------------
 
+namespace {
+
+// Bytes the on-disk thumbnails may take; the oldest ones are removed beyond
+const qint64 MaxThumbnailsBytes = 64 << 20;
+// Thumbnails saved between checks of the folder size
+const int ThumbnailsTrimInterval = 256;
+
+// Returns the path of the on-disk thumbnail of an icon built from the
+// specified file, or an empty path if the icon is not cached. Thumbnails are
+// named after the file's modification time, so edited files get new ones.
+TFilePath getThumbnailPath(const TFilePath &path, const TFrameId &fid,
+                           const TDimension &iconSize) {
+  std::string type(path.getType());
+  if (type != "tnz" && type != "tab" && type != "pli" && type != "mesh" &&
+      type != "tlv" && !TFileType::isViewable(TFileType::getInfo(path)))
+    return TFilePath();
+
+  // Image sequences are not cached, as there is no single file to check
+  QFileInfo fileInfo(path.getQString());
+  if (!fileInfo.isFile()) return TFilePath();
+
+  std::string key(fid.expand(TFrameId::NO_PAD));
+  key += ":" + std::to_string(iconSize.lx) + "x" + std::to_string(iconSize.ly);
+
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+  hash.addData(fileInfo.absoluteFilePath().toUtf8());
+  hash.addData(key.c_str(), key.size());
+
+  // The modification time is left out of the hash, so that the thumbnails of
+  // previous versions of the file can be found
+  return ToonzFolder::getCacheRootFolder() + "icons" +
+         (hash.result().toHex().toStdString() + "_" +
+          std::to_string(fileInfo.lastModified().toMSecsSinceEpoch()) +
+          ".png");
+}
+
+//-----------------------------------------------------------------------------
+
+// Removes the thumbnails of the previous versions of a file
+void removeStaleThumbnails(const TFilePath &thumbnailPath) {
+  QFileInfo fileInfo(thumbnailPath.getQString());
+  QString name(fileInfo.fileName()),
+      pattern(name.left(name.indexOf('_') + 1) + "*.png");
+
+  QDir folder(fileInfo.absolutePath());
+  QStringList names = folder.entryList(QStringList(pattern), QDir::Files);
+  for (const QString &stale : names)
+    if (stale != name) folder.remove(stale);
+}
+
+//-----------------------------------------------------------------------------
+
+// Removes the oldest thumbnails until the folder fits in MaxThumbnailsBytes
+void trimThumbnails(const TFilePath &folderPath) {
+  QFileInfoList files = QDir(folderPath.getQString())
+                            .entryInfoList(QStringList("*.png"), QDir::Files,
+                                           QDir::Time | QDir::Reversed);
+  qint64 size = 0;
+  for (const QFileInfo &fileInfo : files) size += fileInfo.size();
+
+  for (int i = 0; i < files.size() && size > MaxThumbnailsBytes; ++i)
+    if (QFile::remove(files[i].absoluteFilePath())) size -= files[i].size();
+}
+
+//-----------------------------------------------------------------------------
+
+TRaster32P loadThumbnail(const TFilePath &thumbnailPath) {
+  QImage image(thumbnailPath.getQString());
+  if (image.isNull()) return TRaster32P();
+
+  return rasterFromQImage(image.convertToFormat(QImage::Format_ARGB32));
+}
+
+//-----------------------------------------------------------------------------
+
+void saveThumbnail(const TFilePath &thumbnailPath, const TRaster32P &icon) {
+  QDir().mkpath(thumbnailPath.getParentDir().getQString());
+
+  // Write to a temporary file first - concurrent readers must never find a
+  // partially written thumbnail
+  QSaveFile file(thumbnailPath.getQString());
+  if (!file.open(QIODevice::WriteOnly)) return;
+
+  if (!rasterToQImage(icon).save(&file, "PNG")) {
+    file.cancelWriting();
+    return;
+  }
+  if (!file.commit()) return;
+
+  removeStaleThumbnails(thumbnailPath);
+
+  // Thumbnails of deleted or no longer browsed files are never replaced, so
+  // the folder is trimmed at the first save and periodically after that
+  static std::atomic<int> savedCount(0);
+  if (savedCount++ % ThumbnailsTrimInterval == 0)
+    trimThumbnails(thumbnailPath.getParentDir());
+}
+
+}  // namespace
+
+//-----------------------------------------------------------------------------
+
 void FileIconRenderer::run() {
+  if (isOutdated()) return;
+
   TDimension iconSize(getIconSize());
 
   try {
     TRaster32P iconRaster;
     std::string type(m_path.getType());
 
+    // Psd and svg files get a generic icon
+    TFilePath thumbnailPath;
+    if (type != "psd" && type != "svg")
+      thumbnailPath = getThumbnailPath(m_path, m_fid, iconSize);
+
+    if (!thumbnailPath.isEmpty()) {
+      iconRaster = loadThumbnail(thumbnailPath);
+      if (iconRaster) {
+        setIcon(iconRaster);
+        return;
+      }
+    }
+
     if (type == "tnz" || type == "tab")
       iconRaster = IconGenerator::generateSceneFileIcon(m_path, iconSize,
                                                         m_fid.getNumber() - 1);
@@ -1256,6 +1464,7 @@ void FileIconRenderer::run() {
       setIcon(rasterFromQPixmap(broken));
       return;
     }
+    if (!thumbnailPath.isEmpty()) saveThumbnail(thumbnailPath, iconRaster);
     setIcon(iconRaster);
   } catch (const TImageVersionException &) {
     QPixmap unknown(svgToPixmap(":Resources/unknown.svg",
@@ -1287,6 +1496,8 @@ public:
 
   void run() override;
   TRaster32P generateIcon(const TDimension &iconSize) const;
+
+  int taskLoad() override { return iconWorkersCount(); }
 };
 
 //-----------------------------------------------------------------------------
@@ -1316,7 +1527,11 @@ void SceneIconRenderer::run() { setIcon(generateIcon(getIconSize())); }
 //-----------------------------------
 
 IconGenerator::IconGenerator() : m_iconSize(FilmstripIconSize) {
-  m_executor.setMaxActiveTasks(1);  // Only one thread to render icons...
+  // Icons are rendered by a few threads, each with its own offline GL
+  // context. Common icons have load 1, while xsheet icons take the whole
+  // executor's load to run alone.
+  m_executor.setMaxActiveTasks(iconWorkersCount());
+  m_executor.setMaxActiveLoad(iconWorkersCount());
   m_executor.setDedicatedThreads(true);
 }
 
@@ -1357,7 +1572,11 @@ TOfflineGL *IconGenerator::getOfflineGLContext() {
 
 void IconGenerator::addTask(const std::string &id,
                             TThread::RunnableP iconRenderer) {
+  static_cast<IconRenderer *>(iconRenderer.getPointer())
+      ->setRequest(++requestsCount);
+
   iconsMap.insert(id);
+  pendingRequests[id] = iconRenderer;
   m_executor.addTask(iconRenderer);
 }
 
@@ -1400,7 +1619,10 @@ QPixmap IconGenerator::getIcon(TXshLevel *xl, const TFrameId &fid,
     if (!filmStrip) id += "_small";
 
     QPixmap pix;
-    if (::getIcon(id, pix, xl->getSimpleLevel())) return pix;
+    if (::getIcon(id, pix, xl->getSimpleLevel())) {
+      if (pix.isNull()) touchRequest(id);
+      return pix;
+    }
 
     if (onDemand) return pix;
 
@@ -1590,7 +1812,10 @@ QPixmap IconGenerator::getIcon(const TFilePath &path, const TFrameId &fid) {
   TDimension fileIconSize(80, 60);
   // Here the fileIconSize is input in order to check if the icon is obtained
   // with high-dpi (i.e. devPixRatio > 1.0).
-  if (::getIcon(id, pix, 0, fileIconSize)) return pix;
+  if (::getIcon(id, pix, 0, fileIconSize)) {
+    if (pix.isNull()) touchRequest(id);
+    return pix;
+  }
 
   addTask(id, new FileIconRenderer(fileIconSize, path, fid));
 
@@ -1679,7 +1904,7 @@ void IconGenerator::onStarted(TThread::RunnableP iconRenderer) {
 void IconGenerator::onCanceled(TThread::RunnableP iconRenderer) {
   IconRenderer *ir = static_cast<IconRenderer *>(iconRenderer.getPointer());
 
-  if (!ir->hasStarted()) {
+  if (releaseRequest(ir) && !ir->hasStarted()) {
     removeIcon(ir->getId());
   }
 }
@@ -1689,6 +1914,18 @@ void IconGenerator::onCanceled(TThread::RunnableP iconRenderer) {
 void IconGenerator::onFinished(TThread::RunnableP iconRenderer) {
   IconRenderer *ir = static_cast<IconRenderer *>(iconRenderer.getPointer());
 
+  bool isLatestRequest = releaseRequest(ir);
+
+  if (ir->wasDropped()) {
+    // Views still showing the icon will request it again upon repaint
+    if (isLatestRequest) {
+      removeIcon(ir->getId());
+      emit iconGenerated();
+    }
+    if (ir->wasTerminated()) m_iconsTerminationLoop.quit();
+    return;
+  }
+
   // if the icon was generated in TToonzImage format, cache it instead
   ToonzImageIconRenderer *tir = dynamic_cast<ToonzImageIconRenderer *>(ir);
   if (tir) {
@@ -1714,6 +1951,7 @@ void IconGenerator::onFinished(TThread::RunnableP iconRenderer) {
 
 void IconGenerator::onException(TThread::RunnableP iconRenderer) {
   IconRenderer *ir = static_cast<IconRenderer *>(iconRenderer.getPointer());
+  releaseRequest(ir);
 
   if (ir->wasTerminated()) m_iconsTerminationLoop.quit();
 }